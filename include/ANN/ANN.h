@@ -30,6 +30,32 @@
 //		Added fixed-radius k-NN searching
 //	Revision 1.1.2  01/27/10
 //		Fixed minor compilation bugs for new versions of gcc
+//	Revision 1.2  10/17/26
+//		Made searches reentrant (search state is no longer global)
+//		Added annkSearchBatch to ANNpointSet
+//		Added query orders (ANNqueryOrder) for annkSearchBatch
+//		Added vectorized distance kernels (see annSetSimd)
+//		Added flat trees (ANNflat_tree)
+//		Added option to copy points into leaf order (copy_pts)
+//		Added single-precision version (ANN_FLOAT, namespace annf)
+//		Searches reuse per-thread scratch storage (no allocation)
+//		Added annSetHeapK (heap of k closest points for large k)
+//		Added annRangeSearch (all points within a radius)
+//		Range counting (annkFRSearch with k = 0) counts whole cells
+//		Added annApproxRangeCount (two-sided approximate counting)
+//		Added annAllkNN (k nearest neighbors of all data points)
+//		Added annRangeJoin (all close pairs between two trees)
+//		Added dynamic trees (ANNdynamic_tree)
+//		Added deletion of points from kd- and bd-trees (annDelete)
+//		Added self-rebuilding trees (ANNrebuild_tree)
+//		Added parallel construction of kd- and bd-trees (n_threads)
+//		Added presorted construction for the standard split (annSetPresort)
+//		Added out-of-core construction of dump files (annStreamBuild)
+//		Added binary dumps of flat trees, loaded by mapping the file
+//		Added paged trees (ANNpaged_tree)
+//		Added reading of binary point files (annReadPtsBin)
+//		Added parallel reading of text point files (annReadPts)
+//		Added compressed dumps of kd- and bd-trees (DumpCompressed)
 //----------------------------------------------------------------------
 
 //----------------------------------------------------------------------
@@ -56,8 +82,43 @@
 //				1994, 573-582.
 //----------------------------------------------------------------------
 
-#ifndef ANN_H
-#define ANN_H
+//----------------------------------------------------------------------
+//	Single precision
+//		ANN is normally compiled with double coordinates.  If the
+//		preprocessor symbol ANN_FLOAT is defined, then coordinates are
+//		float (see ANNcoord below), and all of ANN's declarations are
+//		placed in the namespace annf.  The makefiles build this version
+//		as a separate library (libANNf) from the same sources.  Because
+//		the names are different, both versions may be used in the same
+//		program, and even in the same source file, by including this
+//		file twice:
+//
+//			#include <ANN/ANN.h>	// double version (ANNkd_tree, ...)
+//			#define ANN_FLOAT
+//			#include <ANN/ANN.h>	// float version (annf::ANNkd_tree, ...)
+//			#undef ANN_FLOAT
+//
+//		ANN_NAMESPACE_BEGIN and ANN_NAMESPACE_END open and close the
+//		namespace (if any) in ANN's own files.
+//----------------------------------------------------------------------
+
+#if (!defined(ANN_FLOAT) && !defined(ANN_H)) || \
+	(defined(ANN_FLOAT) && !defined(ANNf_H))
+#ifdef ANN_FLOAT
+  #define ANNf_H
+#else
+  #define ANN_H
+#endif
+
+#undef ANN_NAMESPACE_BEGIN
+#undef ANN_NAMESPACE_END
+#ifdef ANN_FLOAT
+  #define ANN_NAMESPACE_BEGIN	namespace annf {
+  #define ANN_NAMESPACE_END		}
+#else
+  #define ANN_NAMESPACE_BEGIN
+  #define ANN_NAMESPACE_END
+#endif
 
 #ifdef WIN32
   //----------------------------------------------------------------------
@@ -93,6 +154,8 @@
 #include <cmath>			// math includes
 #include <iostream>			// I/O streams
 #include <cstring>			// C-style strings
+#include <vector>			// range search results
+#include <atomic>			// deletion marks
 
 //----------------------------------------------------------------------
 // Limits
@@ -111,10 +174,16 @@
 //----------------------------------------------------------------------
 #ifdef ANN_NO_LIMITS_H					// limits.h unavailable
   #include <cvalues>					// replacement for limits.h
-  const double ANN_DBL_MAX = MAXDOUBLE;	// insert maximum double
 #else
   #include <climits>
   #include <cfloat>
+#endif
+
+ANN_NAMESPACE_BEGIN						// (annf, if ANN_FLOAT)
+
+#ifdef ANN_NO_LIMITS_H					// limits.h unavailable
+  const double ANN_DBL_MAX = MAXDOUBLE;	// insert maximum double
+#else
   const double ANN_DBL_MAX = DBL_MAX;
 #endif
 
@@ -153,9 +222,17 @@ enum ANNbool {ANNfalse = 0, ANNtrue = 1}; // ANN boolean type (non ANSI C++)
 //
 //		It is the user's responsibility to make sure that overflow does
 //		not occur in distance calculation.
+//
+//		The single-precision version (ANN_FLOAT) uses float and double.
+//		This halves the storage for points, while distances are still
+//		summed in double precision.
 //----------------------------------------------------------------------
 
+#ifdef ANN_FLOAT
+typedef float	ANNcoord;				// coordinate data type
+#else
 typedef double	ANNcoord;				// coordinate data type
+#endif
 typedef double	ANNdist;				// distance data type
 
 //----------------------------------------------------------------------
@@ -214,9 +291,15 @@ const ANNdist	ANN_DIST_INF = ANN_DBL_MAX;
 //		long	 doesn't matter 19
 //		int		 doesn't matter 10
 //		short	 doesn't matter 5
+//
+//		For float we use 9 digits (rather than FLT_DIG), which is
+//		enough for a dumped tree to be loaded with exactly the same
+//		coordinates.
 //----------------------------------------------------------------------
 
-#ifdef DBL_DIG							// number of sig. bits in ANNcoord
+#if defined(ANN_FLOAT)					// number of sig. bits in ANNcoord
+	const int	 ANNcoordPrec	= 9;
+#elif defined(DBL_DIG)
 	const int	 ANNcoordPrec	= DBL_DIG;
 #else
 	const int	 ANNcoordPrec	= 15;	// default precision
@@ -337,6 +420,7 @@ const ANNbool	ANN_ALLOW_SELF_MATCH	= ANNtrue;
 #define ANN_ROOT(x)			sqrt(x)
 #define ANN_SUM(x,y)		((x) + (y))
 #define ANN_DIFF(x,y)		((y) - (x))
+#define ANN_L2_NORM						// (allows vectorized distances)
 
 //----------------------------------------------------------------------
 //	Use the following for the L_1 (Manhattan) norm
@@ -477,17 +561,133 @@ DLL_API ANNpoint annCopyPt(
 //		First, it computes the k nearest neighbors within the radius
 //		bound, and second, it returns the total number of points lying
 //		within the radius bound. It is permitted to set k = 0, in which
-//		case it effectively answers a range counting query.  If the
+//		case it effectively answers a range counting query.  (For kd-
+//		and bd-trees, each node stores the number of points in its
+//		subtree, and the points of any cell lying entirely within the
+//		ball are counted without visiting them.  So the cost of a
+//		range count depends on the number of cells crossing the
+//		boundary of the ball, not on the number of points in it.)  If the
 //		error bound epsilon is positive, then the search is approximate
 //		in the sense that it is free to ignore any point that lies
 //		outside a ball of radius r/(1+epsilon), where r is the given
 //		(unsquared) radius bound.
 //
+//		The search algorithm, annRangeSearch, finds all the points
+//		within a (squared) radius bound in a single pass.  Rather than
+//		filling arrays of fixed size, it appends the index and squared
+//		distance of each point it finds to the vectors nn_idx and dd
+//		(which it does not clear first), and it returns the number of
+//		points it added.  The vectors may be reused from one query to
+//		the next, so they only grow as needed.  If sorted is true, the
+//		points added are sorted by increasing distance (with ties
+//		broken by index).  Otherwise they are in the order in which the
+//		search found them.  The error bound has the same meaning as
+//		for annkFRSearch.  The generic version (used by flat trees)
+//		just calls annkFRSearch twice, once to count the points and
+//		once to get them.  The brute-force structure, kd-trees and
+//		bd-trees find them in a single search.
+//
+//		The search algorithm, annApproxRangeCount (for kd- and
+//		bd-trees), is an approximate range count.  Given a (squared)
+//		radius bound r^2 and an error bound epsilon, it returns a count
+//		which lies between the number of points within distance
+//		r/(1+epsilon) and the number within distance r*(1+epsilon).
+//		Cells lying entirely within the larger ball are counted in
+//		bulk, and cells disjoint from the smaller ball are skipped, so
+//		only the cells crossing the region between the two balls are
+//		visited.  For bd-trees there are O(1/epsilon^(d-1)) of these,
+//		independent of the number of points in range.  With epsilon =
+//		0 it returns the exact count.
+//
+//		The search algorithm, annkSearchBatch, answers a batch of m
+//		k-nearest neighbor queries, given as an array of query points
+//		(qa).  The results are returned in two arrays which are
+//		assumed to contain at least m*k elements.  The results for the
+//		i-th query are stored in entries i*k through i*k+k-1, in the
+//		same format as annkSearch.  The queries are distributed among
+//		n_threads threads (by default, one per hardware thread).  The
+//		threads are kept in a pool which persists between calls.
+//
+//		The queries of a batch may also be reordered, so that queries
+//		which are close to each other are run consecutively by the
+//		same thread, and so are more likely to find the parts of the
+//		structure they need already in the cache.  The order is given
+//		by a space-filling curve (Morton or Hilbert) through the
+//		bounding box of the structure (or of the queries for brute-force
+//		search).  The reordering only affects the order of execution,
+//		not the order in which the results are stored.
+//
+//		The search algorithm, annAllkNN (for kd- and bd-trees), finds
+//		the k nearest neighbors of every data point of the tree (a
+//		self join).  The results for the i-th data point are stored
+//		in entries i*k through i*k+k-1 of nn_idx and dd, which are
+//		assumed to contain at least n*k elements.  If self is false
+//		(the default), a point is not reported as its own neighbor
+//		(although other points at distance zero are).  The error bound
+//		has the same meaning as for annkSearch.  Rather than searching
+//		from the root for each point, groups of points which lie close
+//		together in the tree are searched for together, in a single
+//		traversal.  The groups are distributed among n_threads threads,
+//		as for annkSearchBatch.
+//
+//		The search algorithm, annRangeJoin (for kd- and bd-trees), is
+//		a range join.  Given another tree (of the same dimension, and
+//		possibly the same tree) and a (squared) radius bound, it finds
+//		all pairs (i, j), where i is a point of this tree and j is a
+//		point of the other one, whose distance is at most the radius.
+//		The pairs are passed in chunks to a callback function (see
+//		ANNjoinCallback below), and the total number of pairs is
+//		returned.  The two trees are traversed together, visiting
+//		pairs of nodes (one of each tree): a pair is pruned when the
+//		bounding boxes of the two subtrees' points are too far apart,
+//		and all of its pairs of points are accepted when the boxes
+//		are entirely within range.  The pairs of nodes are
+//		distributed among n_threads threads.  The callback may be
+//		called from any of them, but never by two at once.  The error
+//		bound has the same meaning as for annkFRSearch: with epsilon
+//		> 0, pairs at distance greater than r/(1+epsilon) may be
+//		missed.
+//
+//		Searching does not modify the search structure, so any number
+//		of threads may search the same structure at once.  (The
+//		exception is when ANN is compiled with ANN_PERF, since the
+//		performance counters are shared by all searches.)
+//
+//		Each thread keeps the working storage of its searches (the set
+//		of closest points and, for priority search, a queue which may
+//		hold an entry per data point) and reuses it from one query to
+//		the next.  Once it has grown to fit the largest k and structure
+//		the thread has searched, queries do no heap allocation.  It is
+//		freed when the thread exits.
+//
 //		The generic object from which all the search structures are
 //		dervied is given below.  It is a virtual object, and is useless
 //		by itself.
 //----------------------------------------------------------------------
 
+//----------------------------------------------------------------------
+//	Range join callback
+//		annRangeJoin passes the pairs it finds to a function of this
+//		type, n pairs at a time.  The k-th pair consists of point
+//		idx[k] of the tree being searched and point other_idx[k] of the
+//		other tree, and dd[k] is the squared distance between them.
+//		The arrays are only valid during the call.  The pointer data
+//		is the one given to annRangeJoin.
+//----------------------------------------------------------------------
+
+typedef void (*ANNjoinCallback)(		// receives pairs from a join
+	int					n,				// number of pairs
+	const ANNidx		*idx,			// points of this tree
+	const ANNidx		*other_idx,		// points of the other tree
+	const ANNdist		*dd,			// squared distances
+	void				*data);			// user data
+
+enum ANNqueryOrder {
+		ANN_ORDER_NONE			= 0,	// queries in the order given
+		ANN_ORDER_MORTON		= 1,	// Morton (Z-order) curve
+		ANN_ORDER_HILBERT		= 2};	// Hilbert curve
+const int ANN_N_QUERY_ORDERS	= 3;	// number of query orders
+
 class DLL_API ANNpointSet {
 public:
 	virtual ~ANNpointSet() {}			// virtual distructor
@@ -509,6 +709,26 @@ public:
 		double			eps=0.0			// error bound
 		) = 0;							// pure virtual (defined elsewhere)
 
+	virtual int annRangeSearch(			// all points within radius
+		ANNpoint		q,				// query point
+		ANNdist			sqRad,			// squared radius
+		std::vector<ANNidx>	&nn_idx,	// indices of points (appended)
+		std::vector<ANNdist> &dd,		// dist to points (appended)
+		ANNbool			sorted = ANNfalse,	// sort by distance?
+		double			eps=0.0			// error bound
+		);								// (defined in range_search.cpp)
+
+	virtual void annkSearchBatch(		// batch of k near neighbor searches
+		ANNpointArray	qa,				// query points
+		int				m,				// number of query points
+		int				k,				// number of near neighbors per query
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0,		// error bound
+		int				n_threads=0,	// number of threads (0 for all)
+		ANNqueryOrder	order=ANN_ORDER_NONE	// query order
+		);								// (defined in batch_search.cpp)
+
 	virtual int theDim() = 0;			// return dimension of space
 	virtual int nPoints() = 0;			// return number of points
 										// return pointer to points
@@ -562,6 +782,14 @@ public:
 		ANNdistArray	dd = NULL,		// dist to near neighbors (modified)
 		double			eps=0.0);		// error bound
 
+	int annRangeSearch(					// all points within radius
+		ANNpoint		q,				// query point
+		ANNdist			sqRad,			// squared radius
+		std::vector<ANNidx>	&nn_idx,	// indices of points (appended)
+		std::vector<ANNdist> &dd,		// dist to points (appended)
+		ANNbool			sorted = ANNfalse,	// sort by distance?
+		double			eps=0.0);		// error bound
+
 	int theDim()						// return dimension of space
 		{ return dim; }
 
@@ -625,6 +853,21 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 //		builds a tree from a file description that was created by the
 //		Dump operation.
 //
+//		If the last argument (copy_pts) is true, then the tree also
+//		keeps its own copy of the point coordinates, stored in leaf
+//		order (see leaf_pts below).  This doubles the storage for the
+//		points, but searches are faster, since the points of each
+//		leaf are adjacent in memory.  A tree which was dumped with
+//		such a copy will have one when it is loaded.
+//
+//		The tree may be built in parallel by giving the number of
+//		threads (n_threads) to the constructor (0 means all hardware
+//		threads).  The top levels of the tree are split using parallel
+//		scans of the points, and the subtrees below them are built
+//		concurrently.  The resulting tree is identical to the one built
+//		by a single thread (the default), whatever the splitting rule
+//		(and for bd-trees, whatever the shrinking rule).
+//
 //		Search:
 //		-------
 //		There are two search methods:
@@ -639,6 +882,27 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 //				fine, but priority search is safer for worst-case
 //				performance.
 //
+//		Batches of standard searches may be run in parallel with
+//		annkSearchBatch().  Queries are ordered (if requested) along a
+//		curve through the bounding box of the tree.
+//
+//		Deletion:
+//		---------
+//		A point may be deleted from the tree with annDelete(), given
+//		its index.  The point is only marked as deleted (the tree is
+//		not changed), and all the searches skip it from then on.  If
+//		fewer than k undeleted points remain, the extra results of a
+//		k-nearest neighbor search are ANN_NULL_IDX (at distance
+//		ANN_DIST_INF).  Counting with annkFRSearch() and
+//		annApproxRangeCount() is slower once a point has been deleted,
+//		since whole cells can no longer be counted at once.  Points
+//		should not be deleted from a kd- or bd-tree while searches are
+//		in progress (the marks are allocated by the first deletion),
+//		and the marks are not saved by Dump().  See ANNrebuild_tree
+//		below for a tree which is rebuilt when many of its points are
+//		deleted, and from which points may be deleted during searches
+//		(it allocates the marks in advance, and they are atomic).
+//
 //		Printing:
 //		---------
 //		There are two methods provided for printing the tree.  Print()
@@ -647,6 +911,18 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 //		format that is suitable reading by another program.  There is a
 //		"load" constructor, which constructs a tree which is assumed to
 //		have been saved by the Dump() procedure.
+//
+//		DumpCompressed() writes the same information (always with the
+//		points) in a compact binary form, for storage and transfer.
+//		Point indices are coded by runs of consecutive indices, and
+//		splitting nodes omit the bounds and cutting values which can
+//		be worked out from their cells.  If pack_pts is true, the
+//		points are also packed by a simple lossless codec (each
+//		coordinate is XORed with that of the previous point in leaf
+//		order, and its zero bytes are dropped).  The load constructor
+//		recognizes these dumps, and decodes them as they are read.
+//		The streams should be opened in binary mode.  (See kd_dump.cpp
+//		for the format.)
 //		
 //		Performance and Structure Statistics:
 //		-------------------------------------
@@ -679,6 +955,15 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 //		sizes.  This was done to avoid fragmentation.)  This array is
 //		also deallocated when the tree is deleted.
 //
+//		Optionally, there is a fourth chunk (leaf_pts), which holds a
+//		copy of the coordinates of the points in the order of pidx.
+//		The point with index pidx[i] is leaf_pts[i], and the rows are
+//		allocated contiguously (by annAllocPts()), so the points of
+//		each bucket occupy one block of memory, and the searches can
+//		scan them without looking up the points through pidx and pts.
+//		The original indices (in pidx) are still used in reporting
+//		results.  This array is also deallocated with the tree.
+//
 //		In addition to this, the tree consists of a number of other
 //		pieces of information which are used in searching and for
 //		subsequent tree operations.  These consist of the following:
@@ -691,6 +976,10 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 //		bnd_box_lo				Bounding box low point
 //		bnd_box_hi				Bounding box high point
 //		splitRule				Splitting method used
+//		leaf_pts				Copy of points in leaf order (or NULL)
+//		deleted					Marks for deleted points, by point
+//								index (or NULL if none were deleted)
+//		n_deleted				Number of deleted points
 //
 //----------------------------------------------------------------------
 
@@ -701,6 +990,7 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 class ANNkdStats;				// stats on kd-tree
 class ANNkd_node;				// generic node in a kd-tree
 typedef ANNkd_node*	ANNkd_ptr;	// pointer to a kd-tree node
+typedef std::atomic<char> ANNmark;	// deletion mark (see annDelete)
 
 class DLL_API ANNkd_tree: public ANNpointSet {
 protected:
@@ -712,6 +1002,27 @@ protected:
 	ANNkd_ptr		root;				// root of kd-tree
 	ANNpoint		bnd_box_lo;			// bounding box low point
 	ANNpoint		bnd_box_hi;			// bounding box high point
+	ANNpointArray	leaf_pts;			// points in leaf order (or NULL)
+	ANNmark			*deleted;			// deleted points (or NULL)
+	int				n_deleted;			// number of deleted points
+	int				n_marks;			// size of deleted array
+
+	void CopyLeafPts();					// copy points into leaf order
+	void MarkPoints();					// allocate deletion marks
+
+	void BuildTree(						// build tree for the points
+		ANNsplitRule	split,			// splitting method
+		ANNbool			copy_pts,		// copy to leaf order?
+		int				n_threads);		// number of threads (0 for all)
+
+	ANNkd_tree(							// build from subset of points
+		ANNpointArray	pa,				// point array
+		ANNidxArray		pi,				// indices of points (taken over)
+		int				n,				// number of points
+		int				dd,				// dimension
+		int				bs,				// bucket size
+		ANNsplitRule	split,			// splitting method
+		ANNbool			copy_pts);		// copy to leaf order?
 
 	void SkeletonTree(					// construct skeleton tree
 		int				n,				// number of points
@@ -720,6 +1031,10 @@ protected:
 		ANNpointArray pa = NULL,		// point array (optional)
 		ANNidxArray pi = NULL);			// point indices (optional)
 
+	friend class ANNflat_tree;			// flat trees are made from us
+	friend class ANNdynamic_tree;		// dynamic trees are made of us
+	friend class ANNrebuild_tree;		// ...and so are rebuilding trees
+
 public:
 	ANNkd_tree(							// build skeleton tree
 		int				n = 0,			// number of points
@@ -731,7 +1046,9 @@ public:
 		int				n,				// number of points
 		int				dd,				// dimension
 		int				bs = 1,			// bucket size
-		ANNsplitRule	split = ANN_KD_SUGGEST);	// splitting method
+		ANNsplitRule	split = ANN_KD_SUGGEST,		// splitting method
+		ANNbool			copy_pts = ANNfalse,		// copy to leaf order?
+		int				n_threads = 1);	// number of threads (0 for all)
 
 	ANNkd_tree(							// build from dump file
 		std::istream&	in);			// input stream for dump file
@@ -760,12 +1077,57 @@ public:
 		ANNdistArray	dd = NULL,		// dist to near neighbors (modified)
 		double			eps=0.0);		// error bound
 
+	int annRangeSearch(					// all points within radius
+		ANNpoint		q,				// query point
+		ANNdist			sqRad,			// squared radius
+		std::vector<ANNidx>	&nn_idx,	// indices of points (appended)
+		std::vector<ANNdist> &dd,		// dist to points (appended)
+		ANNbool			sorted = ANNfalse,	// sort by distance?
+		double			eps=0.0);		// error bound
+
+	int annApproxRangeCount(			// approx range count
+		ANNpoint		q,				// the query point
+		ANNdist			sqRad,			// squared radius of query ball
+		double			eps=0.0);		// error bound
+
+	void annAllkNN(						// k near neighbors of all points
+		int				k,				// number of near neighbors per point
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0,		// error bound
+		ANNbool			self=ANNfalse,	// may a point be its own neighbor?
+		int				n_threads=0);	// number of threads (0 for all)
+
+	size_t annRangeJoin(				// all pairs within radius
+		ANNkd_tree		&other,			// the other tree
+		ANNdist			sqRad,			// squared radius bound
+		ANNjoinCallback	callback,		// receives the pairs
+		void			*data = NULL,	// passed to callback
+		double			eps=0.0,		// error bound
+		int				n_threads=0);	// number of threads (0 for all)
+
+	void annkSearchBatch(				// batch of k near neighbor searches
+		ANNpointArray	qa,				// query points
+		int				m,				// number of query points
+		int				k,				// number of near neighbors per query
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0,		// error bound
+		int				n_threads=0,	// number of threads (0 for all)
+		ANNqueryOrder	order=ANN_ORDER_NONE);	// query order
+
+	ANNbool annDelete(					// delete a point
+		ANNidx			idx);			// its index
+
 	int theDim()						// return dimension of space
 		{ return dim; }
 
 	int nPoints()						// return number of points
 		{ return n_pts; }
 
+	int nDeleted()						// return number deleted
+		{ return n_deleted; }
+
 	ANNpointArray thePoints()			// return pointer to points
 		{  return pts;  }
 
@@ -776,6 +1138,10 @@ public:
 	virtual void Dump(					// dump entire tree
 		ANNbool			with_pts,		// print points as well?
 		std::ostream&	out);			// output stream
+
+	virtual void DumpCompressed(		// dump entire tree (compressed)
+		ANNbool			pack_pts,		// pack the points?
+		std::ostream&	out);			// output stream (binary mode)
 								
 	virtual void getStats(				// compute tree statistics
 		ANNkdStats&		st);			// the statistics (modified)
@@ -795,6 +1161,25 @@ public:
 //----------------------------------------------------------------------
 
 class DLL_API ANNbd_tree: public ANNkd_tree {
+protected:
+	void BuildTree(						// build tree for the points
+		ANNsplitRule	split,			// splitting rule
+		ANNshrinkRule	shrink,			// shrinking rule
+		ANNbool			copy_pts,		// copy to leaf order?
+		int				n_threads);		// number of threads (0 for all)
+
+	ANNbd_tree(							// build from subset of points
+		ANNpointArray	pa,				// point array
+		ANNidxArray		pi,				// indices of points (taken over)
+		int				n,				// number of points
+		int				dd,				// dimension
+		int				bs,				// bucket size
+		ANNsplitRule	split,			// splitting rule
+		ANNshrinkRule	shrink,			// shrinking rule
+		ANNbool			copy_pts);		// copy to leaf order?
+
+	friend class ANNrebuild_tree;		// rebuilding trees are made of us
+
 public:
 	ANNbd_tree(							// build skeleton tree
 		int				n,				// number of points
@@ -808,23 +1193,652 @@ public:
 		int				dd,				// dimension
 		int				bs = 1,			// bucket size
 		ANNsplitRule	split  = ANN_KD_SUGGEST,	// splitting rule
-		ANNshrinkRule	shrink = ANN_BD_SUGGEST);	// shrinking rule
+		ANNshrinkRule	shrink = ANN_BD_SUGGEST,	// shrinking rule
+		ANNbool			copy_pts = ANNfalse,		// copy to leaf order?
+		int				n_threads = 1);	// number of threads (0 for all)
 
 	ANNbd_tree(							// build from dump file
 		std::istream&	in);			// input stream for dump file
 };
 
+//----------------------------------------------------------------------
+//	Flat tree
+//		A flat tree is a compiled, read-only form of a kd- or bd-tree,
+//		which is faster to search.  Rather than allocating each node
+//		separately and visiting nodes by virtual function calls, all
+//		the nodes are stored in one contiguous array of small records,
+//		which refer to their children by index, and the tree is
+//		searched by a loop with an explicit stack.  The searches visit
+//		the same nodes and points in the same order as those of the
+//		tree it was made from, so the results are identical.
+//
+//		A flat tree may be made from an existing kd- or bd-tree, which
+//		may then be deleted (the flat tree copies everything it needs
+//		except for the points), or may be built directly from a point
+//		array, with the same arguments as the bd-tree constructor
+//		(shrinking rule ANN_BD_NONE, the default, gives a kd-tree).
+//		The point array is not copied, and must be kept constant for
+//		the lifetime of the flat tree.  The flat tree has its own copy
+//		of the points in leaf order (as described for kd-trees) if
+//		copy_pts is true, or if the tree it is made from has one.
+//
+//		The order of the nodes in the array (the layout) is one of:
+//
+//			ANN_FLAT_DFS	Depth-first (preorder).  The first child
+//							of each node immediately follows it.
+//			ANN_FLAT_VEB	van Emde Boas.  The top half of the tree
+//							(by height) is laid out recursively,
+//							followed by each of the subtrees hanging
+//							from it, so that each node and its nearby
+//							descendants tend to share cache lines and
+//							pages.
+//
+//		A flat tree can be saved by DumpBinary, which writes it to an
+//		output stream (opened in binary mode) in a binary format, and
+//		loaded by the constructor from a file name.  Unlike the text
+//		dumps of kd- and bd-trees (see Dump), which are parsed when
+//		they are loaded, the file is mapped into memory (by mmap, or
+//		MapViewOfFile on Windows) and searched in place, so that
+//		loading takes time independent of the size of the tree, and
+//		the pages of the file are read as the searches touch them.  The
+//		file holds the points (all those up to the largest index in
+//		the tree), the point indices, the bounding box, the nodes, the
+//		halfspaces, and the copy of the points in leaf order (if any).
+//		Only the array of pointers to the points (see thePoints) is
+//		allocated on loading.  The format begins with a header giving
+//		its version and the sizes of the types, and can only be loaded
+//		by a version of ANN with the same types (for example, not a
+//		dump of a float tree by the double library) on a machine of
+//		the same byte order.  The file must not be changed while the
+//		tree is in use.  (See src/flat_dump.cpp for the format.)
+//----------------------------------------------------------------------
+
+enum ANNflatLayout {
+		ANN_FLAT_DFS			= 0,	// depth-first order
+		ANN_FLAT_VEB			= 1};	// van Emde Boas order
+const int ANN_N_FLAT_LAYOUTS	= 2;	// number of layouts
+
+class ANNflatNode;						// node of a flat tree
+class ANNorthHalfSpace;					// orthogonal halfspace
+
+class DLL_API ANNflat_tree: public ANNpointSet {
+	int				dim;				// dimension of space
+	int				n_pts;				// number of points in tree
+	int				height;				// height of tree
+	ANNpointArray	pts;				// the points
+	int				n_nodes;			// number of nodes
+	ANNflatNode		*nodes;				// the nodes (root is nodes[0])
+	ANNidxArray		pidx;				// point indices (in leaf order)
+	ANNorthHalfSpace *bnds;				// halfspaces of shrinking nodes
+	ANNpoint		bnd_box_lo;			// bounding box low point
+	ANNpoint		bnd_box_hi;			// bounding box high point
+	ANNcoord		*leaf_crd;			// points in leaf order (or NULL)
+	char			*map_base;			// mapped binary dump (or NULL)
+	size_t			map_size;			// size of mapped dump
+
+	void Compile(						// compile from a kd- or bd-tree
+		ANNkd_tree		&tree,			// the tree
+		ANNflatLayout	layout,			// node layout
+		ANNbool			copy_pts);		// copy to leaf order?
+
+	void Unmap();						// release mapped binary dump
+
+public:
+	ANNflat_tree(						// build from a kd- or bd-tree
+		ANNkd_tree		&tree,			// the tree
+		ANNflatLayout	layout = ANN_FLAT_DFS,		// node layout
+		ANNbool			copy_pts = ANNfalse);		// copy to leaf order?
+
+	ANNflat_tree(						// build from point array
+		ANNpointArray	pa,				// point array
+		int				n,				// number of points
+		int				dd,				// dimension
+		int				bs = 1,			// bucket size
+		ANNsplitRule	split  = ANN_KD_SUGGEST,	// splitting rule
+		ANNshrinkRule	shrink = ANN_BD_NONE,		// shrinking rule
+		ANNflatLayout	layout = ANN_FLAT_DFS,		// node layout
+		ANNbool			copy_pts = ANNfalse);		// copy to leaf order?
+
+	ANNflat_tree(						// load (map) binary dump file
+		const char		*file_name);	// name of file
+
+	~ANNflat_tree();					// tree destructor
+
+	void DumpBinary(					// write binary dump
+		std::ostream	&out);			// output stream (binary mode)
+
+	void annkSearch(					// approx k near neighbor search
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	void annkPriSearch( 				// priority k near neighbor search
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	int annkFRSearch(					// approx fixed-radius kNN search
+		ANNpoint		q,				// the query point
+		ANNdist			sqRad,			// squared radius of query ball
+		int				k,				// number of neighbors to return
+		ANNidxArray		nn_idx = NULL,	// nearest neighbor array (modified)
+		ANNdistArray	dd = NULL,		// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	void annkSearchBatch(				// batch of k near neighbor searches
+		ANNpointArray	qa,				// query points
+		int				m,				// number of query points
+		int				k,				// number of near neighbors per query
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0,		// error bound
+		int				n_threads=0,	// number of threads (0 for all)
+		ANNqueryOrder	order=ANN_ORDER_NONE);	// query order
+
+	int theDim()						// return dimension of space
+		{ return dim; }
+
+	int nPoints()						// return number of points
+		{ return n_pts; }
+
+	ANNpointArray thePoints()			// return pointer to points
+		{  return pts;  }
+
+	int nNodes()						// return number of nodes
+		{ return n_nodes; }
+};
+
+//----------------------------------------------------------------------
+//	Paged tree
+//		A paged tree searches a binary dump of a flat tree (see
+//		DumpBinary above) which may be too large to fit in memory.  The
+//		top top_levels levels of the tree are read when it is loaded,
+//		and kept in memory.  Each subtree hanging from them (a page)
+//		is read from the file, with the indices and leaf-order
+//		coordinates of its points, when a search first reaches it.
+//		Pages are kept in a cache of at most cache_size bytes, from
+//		which the least recently used pages are dropped to make room.
+//		(Pages in use by searches which are in progress are not
+//		dropped, so the cache may exceed its budget briefly, and holds
+//		at least the most recent page.)
+//
+//		The dump must have the DFS layout (so that each page is a
+//		contiguous range of nodes) and the points in leaf order (the
+//		copy_pts option), which are all that is read of the points.
+//		Standard and fixed-radius searches are provided (and so
+//		range searches and batches of searches, through ANNpointSet),
+//		and give the same results as those of the flat tree.  Priority
+//		search is not supported.  Searches may run in several threads
+//		at once.  thePoints() returns NULL, since the points are not in
+//		memory.
+//
+//		The numbers of pages read from the file, of pages found in the
+//		cache, and of bytes read, are counted over the life of the
+//		tree (nPageReads, nPageHits, nBytesRead), and the pages and
+//		bytes read by each query are included in the performance
+//		statistics (see ANNperf.h) if ANN_PERF is defined.
+//		(See src/paged_tree.cpp.)
+//----------------------------------------------------------------------
+
+const size_t ANN_PAGE_CACHE = (size_t) 64 << 20;	// default cache size
+const int ANN_PAGE_TOP = 10;			// default levels in memory
+
+class ANNpageCache;						// pages of a paged tree
+
+class DLL_API ANNpaged_tree: public ANNpointSet {
+	int				dim;				// dimension of space
+	int				n_pts;				// number of points in tree
+	ANNpageCache	*cache;				// top levels, pages, file, ...
+
+public:
+	ANNpaged_tree(						// open binary dump file
+		const char		*file_name,		// name of file
+		size_t			cache_size = ANN_PAGE_CACHE,	// cache budget (bytes)
+		int				top_levels = ANN_PAGE_TOP);		// levels in memory
+
+	~ANNpaged_tree();					// tree destructor
+
+	void annkSearch(					// approx k near neighbor search
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	int annkFRSearch(					// approx fixed-radius kNN search
+		ANNpoint		q,				// the query point
+		ANNdist			sqRad,			// squared radius of query ball
+		int				k,				// number of neighbors to return
+		ANNidxArray		nn_idx = NULL,	// nearest neighbor array (modified)
+		ANNdistArray	dd = NULL,		// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	int theDim()						// return dimension of space
+		{ return dim; }
+
+	int nPoints()						// return number of points
+		{ return n_pts; }
+
+	ANNpointArray thePoints()			// points are not in memory
+		{  return NULL;  }
+
+	int nPages();						// return number of pages
+	size_t cacheBytes();				// return bytes now in cache
+	long long nPageReads();				// return pages read from file
+	long long nPageHits();				// return pages found in cache
+	long long nBytesRead();				// return bytes read from file
+};
+
+//----------------------------------------------------------------------
+//	Dynamic tree
+//		A dynamic tree is a kd-tree to which points may be added and
+//		from which they may be deleted.  Each point is given an index
+//		when it is added (the points given to the constructor are
+//		numbered from 0, and later ones follow in order), and this
+//		index is used to delete it and is returned by searches.  The
+//		indices of deleted points are not reused.  The points are
+//		copied, so the caller's points need not be kept.
+//
+//		Searches are the same as for kd-trees, and only return current
+//		points.  The error bound epsilon has the same meaning as for
+//		kd-trees (so with epsilon = 0, the true nearest neighbors are
+//		found).  Any number of searches may run at once, but not while
+//		a point is being added or deleted.
+//
+//		Internal information:
+//		---------------------
+//		This uses the logarithmic method of Bentley and Saxe
+//		(``Decomposable searching problems I: Static-to-dynamic
+//		transformation,'' J. Algorithms, 1:301-358, 1980).  The points
+//		are held in a forest of up to ANN_DYN_MAX_TREES static kd-trees,
+//		where tree i holds at most b*2^i points, together with a small
+//		buffer of up to b recently added points (b = ANN_DYN_BUFFER).
+//		When the buffer fills up, it is merged with the smallest trees
+//		into a single new tree, like carrying in a binary counter.  So
+//		each point is rebuilt into a tree O(log n) times, and the
+//		amortized cost of adding a point is O(log^2 n).  All the trees
+//		index a common array of points.
+//
+//		A deleted point is only marked, and the searches skip it.  It
+//		is dropped when its tree is next merged.  When the marked
+//		points outnumber the others, all the trees are merged into
+//		one, so the trees never hold more than twice the number of
+//		current points.
+//
+//		A search visits the buffer and then each tree (largest first),
+//		with a single set of closest points, so that the points found
+//		in one tree limit the search of the others.
+//----------------------------------------------------------------------
+
+const int ANN_DYN_MAX_TREES		= 32;	// max number of trees
+const int ANN_DYN_BUFFER		= 64;	// max points in buffer
+
+class ANNkdFRSearchCtx;					// fixed-radius search context
+
+class DLL_API ANNdynamic_tree: public ANNpointSet {
+	int				dim;				// dimension of space
+	int				bkt_size;			// bucket size
+	ANNsplitRule	split;				// splitting rule
+	ANNbool			copy_pts;			// copy points to leaf order?
+	int				n_pts;				// number of (undeleted) points
+	int				n_dead;				// deleted points still in trees
+	int				n_idx;				// number of indices given out
+	int				max_idx;			// space for indices
+	ANNpointArray	pts;				// points by index (NULL if dropped)
+	ANNmark			*deleted;			// has point been deleted?
+	int				n_buf;				// number of points in buffer
+	ANNidxArray		buf;				// points in buffer
+	ANNkd_tree		*trees[ANN_DYN_MAX_TREES];	// the trees (or NULL)
+
+	void Grow();						// add space for indices
+	int Collect(						// collect undeleted points
+		ANNidxArray		pi,				// point indices
+		int				n,				// number of them
+		ANNidxArray		out);			// undeleted ones (appended)
+	void Build(							// build tree for points
+		ANNidxArray		pi,				// point indices (taken over)
+		int				n);				// number of them
+	void Merge(							// merge buffer and trees
+		int				last);			// ...0 through last
+	void FRSearch(						// fixed-radius search
+		ANNkdFRSearchCtx &ctx);			// search context
+
+public:
+	ANNdynamic_tree(					// build from point array
+		ANNpointArray	pa,				// point array
+		int				n,				// number of points
+		int				dd,				// dimension
+		int				bs = 1,			// bucket size
+		ANNsplitRule	split = ANN_KD_SUGGEST,		// splitting rule
+		ANNbool			copy_pts = ANNfalse);		// copy to leaf order?
+
+	ANNdynamic_tree(					// build empty tree
+		int				dd,				// dimension
+		int				bs = 1,			// bucket size
+		ANNsplitRule	split = ANN_KD_SUGGEST,		// splitting rule
+		ANNbool			copy_pts = ANNfalse);		// copy to leaf order?
+
+	~ANNdynamic_tree();					// tree destructor
+
+	ANNidx annInsert(					// add a point
+		ANNpoint		p);				// the point (copied)
+
+	ANNbool annDelete(					// delete a point
+		ANNidx			idx);			// its index
+
+	void annkSearch(					// approx k near neighbor search
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	int annkFRSearch(					// approx fixed-radius kNN search
+		ANNpoint		q,				// the query point
+		ANNdist			sqRad,			// squared radius of query ball
+		int				k,				// number of neighbors to return
+		ANNidxArray		nn_idx = NULL,	// nearest neighbor array (modified)
+		ANNdistArray	dd = NULL,		// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	int annRangeSearch(					// all points within radius
+		ANNpoint		q,				// query point
+		ANNdist			sqRad,			// squared radius
+		std::vector<ANNidx>	&nn_idx,	// indices of points (appended)
+		std::vector<ANNdist> &dd,		// dist to points (appended)
+		ANNbool			sorted = ANNfalse,	// sort by distance?
+		double			eps=0.0);		// error bound
+
+	int theDim()						// return dimension of space
+		{ return dim; }
+
+	int nPoints()						// return number of points
+		{ return n_pts; }
+
+	ANNpointArray thePoints()			// return pointer to points
+		{  return pts;  }				// (indexed by point index)
+
+	int nTrees();						// return number of trees
+};
+
+//----------------------------------------------------------------------
+//	Self-rebuilding tree
+//		A self-rebuilding tree is a kd- or bd-tree from which points
+//		may be deleted (as with annDelete() for kd-trees), while other
+//		threads are searching it.  When the deleted points make up more
+//		than a given fraction (the threshold) of the points of the
+//		tree, a new tree is built for the remaining points in the
+//		background, and replaces the old one when it is done.  So
+//		neither deleting points nor searching waits for a rebuild.
+//
+//		The constructor takes the same arguments as the bd-tree
+//		constructor (shrinking rule ANN_BD_NONE, the default, gives a
+//		kd-tree), together with the threshold.  The point array is not
+//		copied, and must be kept constant for the lifetime of the tree.
+//		The points keep their indices in the point array through all
+//		rebuilds.
+//
+//		Any number of searches and deletions may run at once.  A search
+//		which is running when a point is deleted may or may not return
+//		it.  Each search uses the tree which is current when it starts
+//		until it finishes, and the old tree is deleted only when the
+//		last search using it is done.  annWaitRebuild() waits until any
+//		rebuild in progress is done (this is not needed, but it makes
+//		the timing of searches more predictable, say in tests).
+//
+//		Internal information:
+//		---------------------
+//		The current tree is held by a shared pointer, which is copied
+//		(atomically) by each search, and replaced (atomically) when a
+//		rebuild is done.  The rebuild runs in its own thread.  Points
+//		which are deleted while a rebuild is running are deleted from
+//		the old tree, and are also recorded, so that they can be
+//		deleted from the new tree before it replaces the old one.  The
+//		shared pointer, the rebuild thread, and so on, are held in an
+//		object of class ANNrebuildState (see src/rebuild_tree.cpp).
+//----------------------------------------------------------------------
+
+class ANNrebuildState;					// state of a rebuilding tree
+
+class DLL_API ANNrebuild_tree: public ANNpointSet {
+	int				dim;				// dimension of space
+	int				bkt_size;			// bucket size
+	ANNsplitRule	split;				// splitting rule
+	ANNshrinkRule	shrink;				// shrinking rule
+	ANNbool			copy_pts;			// copy points to leaf order?
+	double			threshold;			// fraction deleted for rebuild
+	ANNpointArray	pts;				// the points
+	ANNrebuildState	*state;				// current tree, rebuild thread, ...
+
+	void Rebuild();						// rebuild (in rebuild thread)
+
+public:
+	ANNrebuild_tree(					// build from point array
+		ANNpointArray	pa,				// point array
+		int				n,				// number of points
+		int				dd,				// dimension
+		int				bs = 1,			// bucket size
+		ANNsplitRule	split  = ANN_KD_SUGGEST,	// splitting rule
+		ANNshrinkRule	shrink = ANN_BD_NONE,		// shrinking rule
+		ANNbool			copy_pts = ANNfalse,		// copy to leaf order?
+		double			threshold = 0.25);			// rebuild threshold
+
+	~ANNrebuild_tree();					// tree destructor
+
+	ANNbool annDelete(					// delete a point
+		ANNidx			idx);			// its index
+
+	void annWaitRebuild();				// wait for rebuild to finish
+
+	void annkSearch(					// approx k near neighbor search
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	void annkPriSearch( 				// priority k near neighbor search
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	int annkFRSearch(					// approx fixed-radius kNN search
+		ANNpoint		q,				// the query point
+		ANNdist			sqRad,			// squared radius of query ball
+		int				k,				// number of neighbors to return
+		ANNidxArray		nn_idx = NULL,	// nearest neighbor array (modified)
+		ANNdistArray	dd = NULL,		// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	int annRangeSearch(					// all points within radius
+		ANNpoint		q,				// query point
+		ANNdist			sqRad,			// squared radius
+		std::vector<ANNidx>	&nn_idx,	// indices of points (appended)
+		std::vector<ANNdist> &dd,		// dist to points (appended)
+		ANNbool			sorted = ANNfalse,	// sort by distance?
+		double			eps=0.0);		// error bound
+
+	int theDim()						// return dimension of space
+		{ return dim; }
+
+	int nPoints();						// return number of points
+
+	ANNpointArray thePoints()			// return pointer to points
+		{  return pts;  }
+
+	int nRebuilds();					// return number of rebuilds
+};
+
+//----------------------------------------------------------------------
+//	Out-of-core construction
+//		annStreamBuild builds a kd-tree for a set of points which may
+//		be too large to fit in memory, and writes it to an output
+//		stream as a dump file (with the points), rather than building
+//		it in memory.  The dump can then be loaded by the ANNkd_tree
+//		(or ANNbd_tree) load constructor, on a machine with enough
+//		memory.  The points are read from an input stream of text, dim
+//		coordinates per point, separated by white space (as in the
+//		point files of ann_test and ann_sample), until the end of the
+//		stream.  The number of points read is returned.
+//
+//		The points are copied to temporary files (made by tmpfile()),
+//		which are divided by splits at the top of the tree, until the
+//		points of each file fit in max_mem bytes.  The subtree below
+//		each file is then built in memory, using the splitting rule
+//		split, dumped, and deleted.  The splits at the top are not
+//		made by the splitting rule, but at the (sampled) median of the
+//		points along the dimension of greatest spread.  Peak memory is
+//		max_mem, plus a small amount for buffers.  The temporary files
+//		need about as much disk space as the points (in binary), twice
+//		over at the top level.  (See src/stream_build.cpp.)
+//----------------------------------------------------------------------
+
+const size_t ANN_STREAM_MEM = (size_t) 256 << 20;	// default budget
+
+DLL_API int annStreamBuild(		// out-of-core build of tree dump
+	std::istream	&in,		// input stream for points
+	int				dim,		// dimension of space
+	std::ostream	&out,		// output stream for dump
+	int				bs = 1,		// bucket size
+	ANNsplitRule	split = ANN_KD_SUGGEST,	// splitting rule
+	size_t			max_mem = ANN_STREAM_MEM);	// memory budget (bytes)
+
+//----------------------------------------------------------------------
+//	Reading binary point files
+//		annReadPtsBin reads a file of points in one of the following
+//		binary formats, and returns them in a point array allocated by
+//		annAllocPts (so the coordinates are one contiguous block, which
+//		starts at pa[0], and are freed by annDeallocPts).
+//
+//			ANN_PTS_FLOAT	Raw little-endian 4-byte floats, dim per
+//							point.
+//			ANN_PTS_DOUBLE	Raw little-endian 8-byte doubles, dim per
+//							point.
+//			ANN_PTS_FVECS	For each point, its dimension (a 4-byte
+//							little-endian integer), followed by its
+//							coordinates as 4-byte floats.
+//			ANN_PTS_BVECS	As fvecs, but with each coordinate an
+//							unsigned byte.
+//
+//		For the raw formats, dim must be given.  For fvecs and bvecs,
+//		the dimension is taken from the file if dim is 0, and otherwise
+//		must agree with it, and all points must have the same one.  At
+//		most n points are read (all of them if n is 0), and n is set
+//		to the number read.  If map_file is true, the file is mapped
+//		into memory (as for binary dumps of flat trees), rather than
+//		read through a stream.  Errors are fatal.
+//		(See src/point_file.cpp.)
+//----------------------------------------------------------------------
+
+enum ANNptsFormat {
+		ANN_PTS_FLOAT			= 0,	// raw floats
+		ANN_PTS_DOUBLE			= 1,	// raw doubles
+		ANN_PTS_FVECS			= 2,	// fvecs (dimension and floats)
+		ANN_PTS_BVECS			= 3};	// bvecs (dimension and bytes)
+const int ANN_N_PTS_FORMATS		= 4;	// number of formats
+
+DLL_API ANNpointArray annReadPtsBin(	// read binary point file
+	const char		*file_name,	// name of file
+	ANNptsFormat	format,		// format of file
+	int				&dim,		// dimension (may be returned)
+	int				&n,			// max number of points (returned)
+	ANNbool			map_file = ANNtrue);	// map the file?
+
+//----------------------------------------------------------------------
+//	Reading text point files
+//		annReadPts reads a text file of points, with dim coordinates
+//		per line, separated by white space.  Blank lines are skipped,
+//		and every other line must hold exactly one point (unlike
+//		reading with operator>>, a point cannot span lines).  The file
+//		is mapped into memory and cut into chunks at line boundaries,
+//		which are parsed in parallel by n_threads threads (all the
+//		hardware threads if n_threads <= 0), straight into a point
+//		array allocated by annAllocPts.  At most n points are read
+//		(all of them if n is 0), and n is set to the number read.  If
+//		n_file is not NULL, *n_file is set to the number of points in
+//		the file.  The line numbers of malformed lines (up to 10) are
+//		reported by warnings, after which the error is fatal.
+//----------------------------------------------------------------------
+
+DLL_API ANNpointArray annReadPts(		// read text point file
+	const char		*file_name,	// name of file
+	int				dim,		// dimension
+	int				&n,			// max number of points (returned)
+	int				n_threads = 0,		// number of threads
+	int				*n_file = NULL);	// points in file (returned)
+
 //----------------------------------------------------------------------
 //	Other functions
 //	annMaxPtsVisit		Sets a limit on the maximum number of points
 //						to visit in the search.
+//	annSimd				Returns the kernel used for computing distances
+//						between points (in the leaves of the trees,
+//						in brute-force search, and in annDist()).
+//						By default this is the fastest one that the
+//						processor supports.
+//	annSetSimd			Selects the distance kernel.  If the processor
+//						does not support it, the next lower one is
+//						used.  Returns the kernel selected.  This
+//						should not be called while searches are in
+//						progress.  All the kernels give identical
+//						results.
+//	annSetHeapK			Sets the number of nearest neighbors above
+//						which searches keep the k closest points in
+//						a heap (O(log k) time per point) rather than
+//						a sorted array (O(k) time per point).  Both
+//						give identical results, and the heap is only
+//						faster for large k.  The default is 128.  This
+//						should not be called while searches are in
+//						progress.
+//	annSetPresort		Selects how trees with the standard splitting
+//						rule (ANN_KD_STD) are built, for kd-trees and
+//						bd-trees without shrinking.  By default, each
+//						split scans the points of its cell to find
+//						their spreads, and then selects their median.
+//						If set to true, the points are instead sorted
+//						along each dimension once, and the sorted
+//						lists are divided along with the cells, so the
+//						spreads and medians are found in O(dim) time
+//						per cell, without scanning the points.  This
+//						needs dim extra arrays of n indices.  The
+//						cutting planes are the same, but points which
+//						tie with the median may be put on different
+//						sides.  (See test/bench_presort.in for build
+//						times.)  This should not be called while
+//						trees are being built.
 //  annClose			Can be called when all use of ANN is finished.
-//						It clears up a minor memory leak.
+//						It clears up a minor memory leak, and stops
+//						the threads used by batched searches.
 //----------------------------------------------------------------------
 
 DLL_API void annMaxPtsVisit(	// max. pts to visit in search
 	int				maxPts);	// the limit
 
+enum ANNsimd {					// distance kernels
+		ANN_SIMD_NONE			= 0,	// scalar code
+		ANN_SIMD_AVX2			= 1,	// AVX2 (4 doubles per vector)
+		ANN_SIMD_AVX512			= 2};	// AVX-512 (8 doubles per vector)
+const int ANN_N_SIMD			= 3;	// number of kernels
+
+DLL_API ANNsimd annSimd();		// distance kernel in use
+
+DLL_API ANNsimd annSetSimd(		// select distance kernel
+	ANNsimd			level);		// the desired kernel
+
+DLL_API void annSetHeapK(		// set threshold for heap of k closest
+	int				k);			// largest k for sorted array
+
+DLL_API void annSetPresort(		// build from presorted points?
+	ANNbool			presort);	// true to presort
+
 DLL_API void annClose();		// called to end use of ANN
 
+ANN_NAMESPACE_END
+
 #endif
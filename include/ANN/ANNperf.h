@@ -25,10 +25,18 @@
 //          Initial release
 //      Revision 1.0  04/01/05
 //          Added ANN_ prefix to avoid name conflicts.
+//      Revision 1.2  10/17/26
+//          Added single-precision version (see ANN_FLOAT in ANN.h)
+//          Added page reads and bytes read (for paged trees)
 //----------------------------------------------------------------------
 
-#ifndef ANNperf_H
-#define ANNperf_H
+#if (!defined(ANN_FLOAT) && !defined(ANNperf_H)) || \
+	(defined(ANN_FLOAT) && !defined(ANNfperf_H))
+#ifdef ANN_FLOAT
+  #define ANNfperf_H
+#else
+  #define ANNperf_H
+#endif
 
 //----------------------------------------------------------------------
 //	basic includes
@@ -36,6 +44,8 @@
 
 #include <ANN/ANN.h>					// basic ANN includes
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 // kd-tree stats object
 //	This object is used for collecting information about a kd-tree
@@ -127,6 +137,8 @@ public :
   #define ANN_SHR(n)	{ann_Nvisit_shr += (n);}
   #define ANN_PTS(n)	{ann_Nvisit_pts += (n);}
   #define ANN_COORD(n)	{ann_Ncoord_hts += (n);}
+  #define ANN_PAGE(n)	{ann_Npage_rds += (n);}
+  #define ANN_READ(n)	{ann_Nbytes_rd += (n);}
 #else
   #define ANN_FLOP(n)
   #define ANN_LEAF(n)
@@ -134,6 +146,8 @@ public :
   #define ANN_SHR(n)
   #define ANN_PTS(n)
   #define ANN_COORD(n)
+  #define ANN_PAGE(n)
+  #define ANN_READ(n)
 #endif
 
 //----------------------------------------------------------------------
@@ -174,6 +188,12 @@ public :
 //				This includes all operations in the heap
 //				as well as distance calculations to boxes.
 //
+//	page_rds	The number of pages of a paged tree read
+//				from its file (those found in the cache
+//				are not counted).
+//
+//	bytes_rd	The number of bytes read for these pages.
+//
 //	average_err	The average error of each query (the
 //				error of the reported point to the true
 //				nearest neighbor).  For k nearest neighbors
@@ -194,6 +214,8 @@ extern int			ann_Nvisit_shr;	// number of shrinking nodes visited
 extern int			ann_Nvisit_pts;	// visited points for one query
 extern int			ann_Ncoord_hts;	// coordinate hits for one query
 extern int			ann_Nfloat_ops;	// floating ops for one query
+extern int			ann_Npage_rds;	// pages read for one query
+extern int			ann_Nbytes_rd;	// bytes read for one query
 extern ANNsampStat	ann_visit_lfs;	// stats on leaf nodes visits
 extern ANNsampStat	ann_visit_spl;	// stats on splitting nodes visits
 extern ANNsampStat	ann_visit_shr;	// stats on shrinking nodes visits
@@ -201,6 +223,8 @@ extern ANNsampStat	ann_visit_nds;	// stats on total nodes visits
 extern ANNsampStat	ann_visit_pts;	// stats on points visited
 extern ANNsampStat	ann_coord_hts;	// stats on coordinate hits
 extern ANNsampStat	ann_float_ops;	// stats on floating ops
+extern ANNsampStat	ann_page_rds;	// stats on pages read
+extern ANNsampStat	ann_bytes_rd;	// stats on bytes read
 //----------------------------------------------------------------------
 //  The following need to be part of the public interface, because
 //  they are accessed outside the DLL in ann_test.cpp.
@@ -220,4 +244,6 @@ DLL_API void annUpdateStats();				// update stats with current counts
 
 DLL_API void annPrintStats(ANNbool validate); // print statistics for a run
 
+ANN_NAMESPACE_END
+
 #endif
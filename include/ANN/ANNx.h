@@ -31,14 +31,26 @@
 //	    Changed LO, HI, IN, OUT to ANN_LO, ANN_HI, etc.
 //	Revision 1.1.2  01/27/10
 //		Fixed minor compilation bugs for new versions of gcc
+//	Revision 1.2  10/17/26
+//		Added single-precision version (see ANN_FLOAT in ANN.h)
+//		Added ANNheapK
+//		Added ANNpresort
+//		Added annMapFile and annUnmapFile
 //----------------------------------------------------------------------
 
-#ifndef ANNx_H
-#define ANNx_H
+#if (!defined(ANN_FLOAT) && !defined(ANNx_H)) || \
+	(defined(ANN_FLOAT) && !defined(ANNfx_H))
+#ifdef ANN_FLOAT
+  #define ANNfx_H
+#else
+  #define ANNx_H
+#endif
 
 #include <iomanip>				// I/O manipulators
 #include <ANN/ANN.h>			// ANN includes
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Global constants and types
 //----------------------------------------------------------------------
@@ -56,7 +68,25 @@ enum ANNerr {ANNwarn = 0, ANNabort = 1};
 //----------------------------------------------------------------------
 
 extern int		ANNmaxPtsVisited;	// maximum number of pts visited
-extern int		ANNptsVisited;		// number of pts visited in search
+
+//----------------------------------------------------------------------
+//	Threshold for heap of k closest points
+//	If more than ANNheapK nearest neighbors are requested, the k
+//	closest points are kept in a heap (see pr_queue_k.h).  It is set
+//	by annSetHeapK().
+//----------------------------------------------------------------------
+
+const int		ANN_DEF_HEAP_K = 128;	// default threshold
+extern int		ANNheapK;			// largest k for sorted array
+
+//----------------------------------------------------------------------
+//	Presorted construction
+//	If ANNpresort is true, then trees with the standard splitting
+//	rule are built from the points presorted along each dimension
+//	(see kd_presort.cpp).  It is set by annSetPresort().
+//----------------------------------------------------------------------
+
+extern ANNbool	ANNpresort;			// presort for standard split?
 
 //----------------------------------------------------------------------
 //	Global function declarations
@@ -71,6 +101,14 @@ void annPrintPt(				// print a point
 	int				dim,		// the dimension
 	std::ostream	&out);		// output stream
 
+char *annMapFile(				// map a file (NULL if fails)
+	const char		*file_name,	// name of file
+	size_t			&size);		// size of file (returned)
+
+void annUnmapFile(				// unmap a file
+	char			*p,			// address of mapping
+	size_t			size);		// size of file
+
 //----------------------------------------------------------------------
 //	Orthogonal (axis aligned) rectangle
 //	Orthogonal rectangles are represented by two points, one
@@ -166,4 +204,6 @@ public:
 								// array of halfspaces
 typedef ANNorthHalfSpace *ANNorthHSArray;
 
+ANN_NAMESPACE_END
+
 #endif
@@ -33,6 +33,7 @@ using namespace std;					// make std:: accessible
 // it can be run as follows.
 // 
 // ann_sample [-d dim] [-max mpts] [-nn k] [-e eps] [-df data] [-qf query]
+//		[-bf format]
 //
 // where
 //		dim				is the dimension of the space (default = 2)
@@ -41,6 +42,10 @@ using namespace std;					// make std:: accessible
 //		eps				is the error bound (default = 0.0)
 //		data			file containing data points
 //		query			file containing query points
+//		format			format of the data and query files, if they are
+//						binary (see annReadPtsBin in ANN.h): float,
+//						double, fvecs or bvecs.  For fvecs and bvecs,
+//						the dimension is taken from the data file.
 //
 // Results are sent to the standard output.
 //----------------------------------------------------------------------
@@ -57,6 +62,12 @@ int				maxPts			= 1000;			// maximum number of data points
 
 istream*		dataIn			= NULL;			// input for data points
 istream*		queryIn			= NULL;			// input for query points
+char*			dataFile		= NULL;			// name of data file
+char*			queryFile		= NULL;			// name of query file
+int				binFormat		= -1;			// binary format (-1 if text)
+
+const char*		binFormats[ANN_N_PTS_FORMATS] = {	// binary formats
+		"float", "double", "fvecs", "bvecs"};
 
 bool readPt(istream &in, ANNpoint p)			// read point (false on EOF)
 {
@@ -80,23 +91,41 @@ int main(int argc, char **argv)
 	int					nPts;					// actual number of data points
 	ANNpointArray		dataPts;				// data points
 	ANNpoint			queryPt;				// query point
+	int					nQueries = 0;			// number of (binary) queries
+	ANNpointArray		queryPts = NULL;		// query points (if binary)
 	ANNidxArray			nnIdx;					// near neighbor indices
 	ANNdistArray		dists;					// near neighbor distances
 	ANNkd_tree*			kdTree;					// search structure
 
 	getArgs(argc, argv);						// read command-line arguments
 
+	if (binFormat >= 0) {						// read binary files
+		if (binFormat == ANN_PTS_FVECS || binFormat == ANN_PTS_BVECS)
+			dim = 0;							// (take it from data file)
+		nPts = maxPts;
+		dataPts = annReadPtsBin(dataFile, (ANNptsFormat) binFormat,
+						dim, nPts);
+		queryPts = annReadPtsBin(queryFile, (ANNptsFormat) binFormat,
+						dim, nQueries);
+	}
+
 	queryPt = annAllocPt(dim);					// allocate query point
-	dataPts = annAllocPts(maxPts, dim);			// allocate data points
 	nnIdx = new ANNidx[k];						// allocate near neigh indices
 	dists = new ANNdist[k];						// allocate near neighbor dists
 
-	nPts = 0;									// read data points
-
 	cout << "Data Points:\n";
-	while (nPts < maxPts && readPt(*dataIn, dataPts[nPts])) {
-		printPt(cout, dataPts[nPts]);
-		nPts++;
+	if (binFormat >= 0) {						// already read
+		for (int i = 0; i < nPts; i++) {
+			printPt(cout, dataPts[i]);
+		}
+	}
+	else {										// read data points
+		dataPts = annAllocPts(maxPts, dim);		// allocate data points
+		nPts = 0;
+		while (nPts < maxPts && readPt(*dataIn, dataPts[nPts])) {
+			printPt(cout, dataPts[nPts]);
+			nPts++;
+		}
 	}
 
 	kdTree = new ANNkd_tree(					// build search structure
@@ -104,7 +133,12 @@ int main(int argc, char **argv)
 					nPts,						// number of points
 					dim);						// dimension of space
 
-	while (readPt(*queryIn, queryPt)) {			// read query points
+	for (int q = 0; ; q++) {					// read query points
+		if (binFormat >= 0) {					// next binary query
+			if (q >= nQueries) break;
+			for (int d = 0; d < dim; d++) queryPt[d] = queryPts[q][d];
+		}
+		else if (!readPt(*queryIn, queryPt)) break;
 		cout << "Query point: ";				// echo query point
 		printPt(cout, queryPt);
 
@@ -124,6 +158,7 @@ int main(int argc, char **argv)
     delete [] nnIdx;							// clean things up
     delete [] dists;
     delete kdTree;
+	if (queryPts != NULL) annDeallocPts(queryPts);
 	annClose();									// done with ANN
 
 	return EXIT_SUCCESS;
@@ -141,14 +176,16 @@ void getArgs(int argc, char **argv)
 	if (argc <= 1) {							// no arguments
 		cerr << "Usage:\n\n"
 		<< "  ann_sample [-d dim] [-max m] [-nn k] [-e eps] [-df data]"
-		   " [-qf query]\n\n"
+		   " [-qf query] [-bf format]\n\n"
 		<< "  where:\n"
 		<< "    dim      dimension of the space (default = 2)\n"
 		<< "    m        maximum number of data points (default = 1000)\n"
 		<< "    k        number of nearest neighbors per query (default 1)\n"
 		<< "    eps      the error bound (default = 0.0)\n"
 		<< "    data     name of file containing data points\n"
-		<< "    query    name of file containing query points\n\n"
+		<< "    query    name of file containing query points\n"
+		<< "    format   format of binary data and query files (float,\n"
+		<< "             double, fvecs, or bvecs)\n\n"
 		<< " Results are sent to the standard output.\n"
 		<< "\n"
 		<< " To run this demo use:\n"
@@ -176,6 +213,7 @@ void getArgs(int argc, char **argv)
 				exit(1);
 			}
 			dataIn = &dataStream;				// make this the data stream
+			dataFile = argv[i];					// (for binary files)
 		}
 		else if (!strcmp(argv[i], "-qf")) {		// -qf option
 			queryStream.open(argv[++i], ios::in);// open query file
@@ -184,6 +222,17 @@ void getArgs(int argc, char **argv)
 				exit(1);
 			}
 			queryIn = &queryStream;			// make this query stream
+			queryFile = argv[i];				// (for binary files)
+		}
+		else if (!strcmp(argv[i], "-bf")) {		// -bf option
+			i++;								// get binary format
+			for (binFormat = 0; binFormat < ANN_N_PTS_FORMATS; binFormat++) {
+				if (!strcmp(argv[i], binFormats[binFormat])) break;
+			}
+			if (binFormat >= ANN_N_PTS_FORMATS) {
+				cerr << "Unknown binary format\n";
+				exit(1);
+			}
 		}
 		else {									// illegal syntax
 			cerr << "Unrecognized option.\n";
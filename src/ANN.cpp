@@ -24,14 +24,21 @@
 //		Added performance counting to annDist()
 //	Revision 1.1.2  01/27/10
 //		Fixed minor compilation bugs for new versions of gcc
+//	Revision 1.2  10/17/26
+//		annDist() uses the distance kernel (see dist_kernel.h)
+//		Added annSetHeapK()
+//		Added annSetPresort()
 //----------------------------------------------------------------------
 
 #include <cstdlib>						// C standard lib defs
 #include <ANN/ANNx.h>					// all ANN includes
 #include <ANN/ANNperf.h>				// ANN performance 
+#include "dist_kernel.h"				// distance kernels
 
 using namespace std;					// make std:: accessible
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Point methods
 //----------------------------------------------------------------------
@@ -40,7 +47,8 @@ using namespace std;					// make std:: accessible
 //	Distance utility.
 //		(Note: In the nearest neighbor search, most distances are
 //		computed using partial distance calculations, not this
-//		procedure.)
+//		procedure.)  The coordinate and floating point operation
+//		counts are made by the kernel.
 //----------------------------------------------------------------------
 
 ANNdist annDist(						// interpoint squared distance
@@ -48,19 +56,8 @@ ANNdist annDist(						// interpoint squared distance
 	ANNpoint			p,
 	ANNpoint			q)
 {
-	register int d;
-	register ANNcoord diff;
-	register ANNcoord dist;
-
-	dist = 0;
-	for (d = 0; d < dim; d++) {
-		diff = p[d] - q[d];
-		dist = ANN_SUM(dist, ANN_POW(diff));
-	}
-	ANN_FLOP(3*dim)					// performance counts
-	ANN_PTS(1)
-	ANN_COORD(dim)
-	return dist;
+	ANN_PTS(1)							// performance count
+	return annDistBnd(dim, p, q, ANN_DBL_MAX);
 }
 
 //----------------------------------------------------------------------
@@ -188,7 +185,6 @@ void annError(const char* msg, ANNerr level)
 //----------------------------------------------------------------------
 
 int	ANNmaxPtsVisited = 0;	// maximum number of pts visited
-int	ANNptsVisited;			// number of pts visited in search
 
 //----------------------------------------------------------------------
 //	Global function declarations
@@ -199,3 +195,37 @@ void annMaxPtsVisit(			// set limit on max. pts to visit in search
 {
 	ANNmaxPtsVisited = maxPts;
 }
+
+//----------------------------------------------------------------------
+//	Threshold for heap representation of k closest points
+//		If more than ANNheapK nearest neighbors are requested, the k
+//		closest points are kept in a heap rather than a sorted array
+//		(see ANNmin_k in pr_queue_k.h).  The default was chosen by
+//		benchmarking (see test/bench_heap_k.in).
+//----------------------------------------------------------------------
+
+int	ANNheapK = ANN_DEF_HEAP_K;	// largest k for sorted array
+
+void annSetHeapK(				// set threshold for heap of k closest
+	int					k)				// the threshold
+{
+	ANNheapK = (k < 0 ? 0 : k);
+}
+
+//----------------------------------------------------------------------
+//	Presorted construction
+//		If ANNpresort is true, kd- and bd-trees (without shrinking)
+//		with the standard splitting rule are built by presorting the
+//		points along each dimension (see rkd_tree_presort() in
+//		kd_presort.cpp).
+//----------------------------------------------------------------------
+
+ANNbool	ANNpresort = ANNfalse;	// presort for standard split?
+
+void annSetPresort(				// build from presorted points?
+	ANNbool				presort)		// true to presort
+{
+	ANNpresort = presort;
+}
+
+ANN_NAMESPACE_END
@@ -36,28 +36,11 @@ extern "C"
   }
 
   ///\note right now, this function handles only one query point
-  void ann_kSearch_c(double *_queryPt, int dim, int k, int *&_nnIdx, double *&_dists, double eps, ANNkd_tree *kdTree)
+  ///\note ANNcoord and ANNdist are double and ANNidx is int, so the
+  /// caller's arrays are searched and filled in place (no allocation)
+  void ann_kSearch_c(double *_queryPt, int /* dim */, int k, int *&_nnIdx, double *&_dists, double eps, ANNkd_tree *kdTree)
   {
-    ANNpoint queryPt;   // query point
-    ANNidxArray nnIdx;  // near neighbor indices
-    ANNdistArray dists; // near neighbor distances
-    /// allocate dimensions
-    queryPt = annAllocPt(dim);
-    nnIdx = new ANNidx[k];  // allocate near neigh indices
-    dists = new ANNdist[k]; // allocate near neighbor dists
-    for (int di = 0; di < dim; ++di)
-    {
-      queryPt[di] = _queryPt[di];
-    }
-    kdTree->annkSearch(queryPt, k, nnIdx, dists, eps);
-    for (int idx = 0; idx < k; ++idx)
-    {
-      _dists[idx] = dists[idx];
-      _nnIdx[idx] = nnIdx[idx];
-    }
-    delete queryPt;
-    delete nnIdx;
-    delete dists;
+    kdTree->annkSearch(_queryPt, k, _nnIdx, _dists, eps);
   }
 
   // Deallocation of memory 
@@ -0,0 +1,287 @@
+//----------------------------------------------------------------------
+// File:			batch_search.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Batched k-nearest neighbor search
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//		Added Morton and Hilbert query orders
+//		Added flat tree version
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "thread_pool.h"				// parallel loops
+
+#include <algorithm>					// sort
+#include <utility>						// pair
+#include <vector>						// key arrays
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Space-filling curve keys
+//		To improve locality of reference among consecutive queries of
+//		a batch, the queries may be sorted by their position along a
+//		space-filling curve through a bounding box (usually that of
+//		the search structure).  Each coordinate is quantized to a
+//		grid of 2^b cells across the box (clamped, if the query lies
+//		outside it), and the quantized coordinates are combined into
+//		a 64-bit key.
+//
+//		For the Morton (Z-order) curve the key is just the bitwise
+//		interleaving of the coordinates, from the most significant bit
+//		down.  For the Hilbert curve the coordinates are first
+//		transformed by the algorithm of J. Skilling ("Programming the
+//		Hilbert curve," AIP Conf. Proc. 707, 2004), after which the
+//		interleaved bits give the position along the curve.  The
+//		Hilbert curve has no long jumps, so it generally gives better
+//		locality, at a slightly higher cost per key.
+//
+//		Since a key has only 64 bits, in dimensions higher than 64 we
+//		use only the 64 coordinates along which the box is widest, and
+//		in lower dimensions we use b = 64/d bits per coordinate (but
+//		no more than ANN_SFC_MAX_BITS, which is plenty).
+//----------------------------------------------------------------------
+
+typedef unsigned long long ANNsfcKey;	// space-filling curve key
+
+const int ANN_SFC_KEY_BITS	= 64;		// bits in a key
+const int ANN_SFC_MAX_BITS	= 20;		// max bits per coordinate
+
+static void annHilbertTranspose(		// Skilling's AxesToTranspose
+	ANNsfcKey			*x,				// quantized coordinates (modified)
+	int					n,				// number of coordinates
+	int					b)				// bits per coordinate
+{
+	ANNsfcKey m = ((ANNsfcKey) 1) << (b-1);
+	ANNsfcKey p, q, t;
+	int i;
+
+	for (q = m; q > 1; q >>= 1) {		// inverse undo
+		p = q - 1;
+		for (i = 0; i < n; i++) {
+			if (x[i] & q) {				// invert
+				x[0] ^= p;
+			}
+			else {						// exchange
+				t = (x[0] ^ x[i]) & p;
+				x[0] ^= t;
+				x[i] ^= t;
+			}
+		}
+	}
+	for (i = 1; i < n; i++) {			// Gray encode
+		x[i] ^= x[i-1];
+	}
+	t = 0;
+	for (q = m; q > 1; q >>= 1) {
+		if (x[n-1] & q) t ^= q - 1;
+	}
+	for (i = 0; i < n; i++) {
+		x[i] ^= t;
+	}
+}
+
+static void annSfcOrder(				// sort queries along a curve
+	ANNpointArray		qa,				// query points
+	int					m,				// number of query points
+	int					dim,			// dimension of space
+	ANNpoint			lo,				// low point of box
+	ANNpoint			hi,				// high point of box
+	ANNqueryOrder		order,			// the curve
+	int					n_threads,		// number of threads
+	ANNidxArray			perm)			// query order (returned)
+{
+	int i, j;
+										// sort dims by decreasing width
+	std::vector<std::pair<ANNcoord,int> > wid(dim);
+	for (i = 0; i < dim; i++) {
+		wid[i] = std::make_pair(-(hi[i] - lo[i]), i);
+	}
+	std::sort(wid.begin(), wid.end());
+										// number of dims used
+	int nd = (dim < ANN_SFC_KEY_BITS ? dim : ANN_SFC_KEY_BITS);
+	int b = ANN_SFC_KEY_BITS / nd;		// bits per coordinate
+	if (b > ANN_SFC_MAX_BITS) b = ANN_SFC_MAX_BITS;
+	ANNcoord n_cells = (ANNcoord) (((ANNsfcKey) 1) << b);
+
+	std::vector<int> cd(nd);			// the dims used
+	std::vector<ANNcoord> scale(nd);	// cells per unit length
+	for (j = 0; j < nd; j++) {
+		cd[j] = wid[j].second;
+		ANNcoord w = hi[cd[j]] - lo[cd[j]];
+		scale[j] = (w > 0 ? n_cells / w : 0);
+	}
+										// (key, query index) pairs
+	std::vector<std::pair<ANNsfcKey,int> > key(m);
+
+	annParallelFor(m, n_threads, [&](int q_lo, int q_hi) {
+		std::vector<ANNsfcKey> x(nd);	// quantized coordinates
+		for (int qi = q_lo; qi < q_hi; qi++) {
+			for (int jj = 0; jj < nd; jj++) {
+				ANNcoord c = (qa[qi][cd[jj]] - lo[cd[jj]]) * scale[jj];
+				if (c < 0) c = 0;		// clamp to box
+				if (c > n_cells - 1) c = n_cells - 1;
+				x[jj] = (ANNsfcKey) c;
+			}
+			if (order == ANN_ORDER_HILBERT) {
+				annHilbertTranspose(&x[0], nd, b);
+			}
+			ANNsfcKey k = 0;			// interleave bits
+			for (int bit = b-1; bit >= 0; bit--) {
+				for (int jj = 0; jj < nd; jj++) {
+					k = (k << 1) | ((x[jj] >> bit) & 1);
+				}
+			}
+			key[qi] = std::make_pair(k, qi);
+		}
+	});
+
+	std::sort(key.begin(), key.end());
+	for (i = 0; i < m; i++) {
+		perm[i] = key[i].second;
+	}
+}
+
+//----------------------------------------------------------------------
+//	annBatchSearch - the common part of annkSearchBatch
+//		The m query points are divided among the threads of the ANN
+//		thread pool (see thread_pool.h), each of which applies the
+//		structure's own annkSearch() to its share of the queries.
+//		Since the search routines keep all their state in a local
+//		search context, they may safely run concurrently on the same
+//		structure.
+//
+//		If a query order is given, the queries are run in order of
+//		their position along the curve through the box [lo, hi], so
+//		that each thread works on a run of queries which are near each
+//		other, and hence visit many of the same nodes and points.  The
+//		results for query i are stored in entries i*k through i*k+k-1
+//		of nn_idx and dd regardless of the order in which the queries
+//		are run.
+//----------------------------------------------------------------------
+
+static void annBatchSearch(
+	ANNpointSet			*ps,			// the search structure
+	ANNpointArray		qa,				// query points
+	int					m,				// number of query points
+	int					k,				// number of near neighbors per query
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps,			// error bound
+	int					n_threads,		// number of threads (<= 0 for all)
+	ANNqueryOrder		order,			// query order
+	ANNpoint			lo,				// low point of box for ordering
+	ANNpoint			hi)				// high point of box for ordering
+{
+	if (k > ps->nPoints()) {			// too many near neighbors?
+		annError("Requesting more near neighbors than data points", ANNabort);
+	}
+
+	ANNidxArray perm = NULL;			// query order (NULL if none)
+	if (order != ANN_ORDER_NONE && m > 1) {
+		perm = new ANNidx[m];
+		annSfcOrder(qa, m, ps->theDim(), lo, hi, order, n_threads, perm);
+	}
+
+	annParallelFor(m, n_threads, [&](int q_lo, int q_hi) {
+		for (int j = q_lo; j < q_hi; j++) {	// search each query in range
+			int i = (perm == NULL ? j : perm[j]);
+			ps->annkSearch(qa[i], k, nn_idx + (size_t) i*k,
+						dd + (size_t) i*k, eps);
+		}
+	});
+
+	if (perm != NULL) delete [] perm;
+}
+
+//----------------------------------------------------------------------
+//	annkSearchBatch - search for the k nearest neighbors of many points
+//		The generic version orders the queries (if requested) within
+//		their own bounding box.  The kd-tree version (which is also
+//		used by bd-trees) and the flat tree version use the bounding
+//		box of the tree instead.
+//----------------------------------------------------------------------
+
+void ANNpointSet::annkSearchBatch(
+	ANNpointArray		qa,				// query points
+	int					m,				// number of query points
+	int					k,				// number of near neighbors per query
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps,			// error bound
+	int					n_threads,		// number of threads (<= 0 for all)
+	ANNqueryOrder		order)			// query order
+{
+	ANNpoint lo = NULL;					// bounding box of queries
+	ANNpoint hi = NULL;
+	if (order != ANN_ORDER_NONE && m > 0) {
+		int dim = theDim();
+		lo = annCopyPt(dim, qa[0]);
+		hi = annCopyPt(dim, qa[0]);
+		for (int i = 1; i < m; i++) {
+			for (int d = 0; d < dim; d++) {
+				if (qa[i][d] < lo[d]) lo[d] = qa[i][d];
+				if (qa[i][d] > hi[d]) hi[d] = qa[i][d];
+			}
+		}
+	}
+	annBatchSearch(this, qa, m, k, nn_idx, dd, eps, n_threads, order, lo, hi);
+	if (lo != NULL) {
+		annDeallocPt(lo);
+		annDeallocPt(hi);
+	}
+}
+
+void ANNkd_tree::annkSearchBatch(
+	ANNpointArray		qa,				// query points
+	int					m,				// number of query points
+	int					k,				// number of near neighbors per query
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps,			// error bound
+	int					n_threads,		// number of threads (<= 0 for all)
+	ANNqueryOrder		order)			// query order
+{
+	if (bnd_box_lo == NULL) {			// no box (empty skeleton tree)
+		ANNpointSet::annkSearchBatch(qa, m, k, nn_idx, dd, eps, n_threads, order);
+		return;
+	}
+	annBatchSearch(this, qa, m, k, nn_idx, dd, eps, n_threads, order,
+				bnd_box_lo, bnd_box_hi);
+}
+
+void ANNflat_tree::annkSearchBatch(
+	ANNpointArray		qa,				// query points
+	int					m,				// number of query points
+	int					k,				// number of near neighbors per query
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps,			// error bound
+	int					n_threads,		// number of threads (<= 0 for all)
+	ANNqueryOrder		order)			// query order
+{
+	if (bnd_box_lo == NULL) {			// no box (empty tree)
+		ANNpointSet::annkSearchBatch(qa, m, k, nn_idx, dd, eps, n_threads, order);
+		return;
+	}
+	annBatchSearch(this, qa, m, k, nn_idx, dd, eps, n_threads, order,
+				bnd_box_lo, bnd_box_hi);
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,90 @@
+//----------------------------------------------------------------------
+// File:			bd_allknn.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		All k-nearest neighbors for bd-trees
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "bd_tree.h"					// bd-tree declarations
+#include "kd_allknn.h"					// all-kNN declarations
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	All k-nearest neighbors for bd-trees.
+//		See the file kd_allknn.cpp for general information on the
+//		group search.  Here we include the extension for shrinking
+//		nodes.
+//----------------------------------------------------------------------
+
+//----------------------------------------------------------------------
+//	bd_shrink::ann_group_search - search a shrinking node
+//		As in the standard search, the distance from each point to the
+//		inner box is computed from the bounding halfspaces.  The child
+//		which is closer for most of the active points is visited
+//		first.
+//----------------------------------------------------------------------
+
+void ANNbd_shrink::ann_group_search(
+	int					n_act,			// number of active points
+	int					*act,			// the active points
+	ANNdist				*box_dist,		// their distances to this cell
+	ANNkdGroupCtx		&ctx)			// search context
+{
+	ANNdist inner_dist[ANN_GROUP_SIZE];			// distances to inner box
+	int child_act[ANN_GROUP_SIZE];				// points active at child
+	int n_in = 0;								// inner box is closer
+
+	for (int a = 0; a < n_act; a++) {
+		int j = act[a];
+		ANNpoint q = ctx.grp_pts[j];
+		inner_dist[j] = 0;
+		for (int i = 0; i < n_bnds; i++) {		// is point in the box?
+			if (bnds[i].out(q)) {				// outside this bounding side?
+												// add to inner distance
+				inner_dist[j] = (ANNdist) ANN_SUM(inner_dist[j],
+						bnds[i].dist(q));
+			}
+		}
+		if (inner_dist[j] <= box_dist[j]) n_in++;
+	}
+	ANN_FLOP(3*n_bnds*n_act)					// increment floating ops
+	ANN_SHR(1)									// one more shrinking node
+
+	int n_child;								// number active at child
+	if (2*n_in >= n_act) {						// visit inner child first
+		n_child = annGroupActive(n_act, act, inner_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_IN]->ann_group_search(n_child, child_act, inner_dist, ctx);
+		n_child = annGroupActive(n_act, act, box_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_OUT]->ann_group_search(n_child, child_act, box_dist, ctx);
+	}
+	else {										// visit outer child first
+		n_child = annGroupActive(n_act, act, box_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_OUT]->ann_group_search(n_child, child_act, box_dist, ctx);
+		n_child = annGroupActive(n_act, act, inner_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_IN]->ann_group_search(n_child, child_act, inner_dist, ctx);
+	}
+}
+
+ANN_NAMESPACE_END
@@ -20,11 +20,16 @@
 // History:
 //	Revision 1.1  05/03/05
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Added ann_FR_count() for range counting
+//		Counting whole cells uses the outer radius of the context
 //----------------------------------------------------------------------
 
 #include "bd_tree.h"					// bd-tree declarations
 #include "kd_fix_rad_search.h"			// kd-tree FR search declarations
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Approximate searching for bd-trees.
 //		See the file kd_FR_search.cpp for general information on the
@@ -36,26 +41,93 @@
 //	bd_shrink::ann_FR_search - search a shrinking node
 //----------------------------------------------------------------------
 
-void ANNbd_shrink::ann_FR_search(ANNdist box_dist)
+void ANNbd_shrink::ann_FR_search(ANNdist box_dist, ANNkdFRSearchCtx &ctx)
 {
 												// check dist calc term cond.
-	if (ANNmaxPtsVisited != 0 && ANNptsVisited > ANNmaxPtsVisited) return;
+	if (ANNmaxPtsVisited != 0 && ctx.pts_visited > ANNmaxPtsVisited) return;
 
 	ANNdist inner_dist = 0;						// distance to inner box
 	for (int i = 0; i < n_bnds; i++) {			// is query point in the box?
-		if (bnds[i].out(ANNkdFRQ)) {			// outside this bounding side?
+		if (bnds[i].out(ctx.q)) {				// outside this bounding side?
 												// add to inner distance
-			inner_dist = (ANNdist) ANN_SUM(inner_dist, bnds[i].dist(ANNkdFRQ));
+			inner_dist = (ANNdist) ANN_SUM(inner_dist, bnds[i].dist(ctx.q));
 		}
 	}
 	if (inner_dist <= box_dist) {				// if inner box is closer
-		child[ANN_IN]->ann_FR_search(inner_dist);// search inner child first
-		child[ANN_OUT]->ann_FR_search(box_dist);// ...then outer child
+		child[ANN_IN]->ann_FR_search(inner_dist, ctx);	// search inner child first
+		child[ANN_OUT]->ann_FR_search(box_dist, ctx);	// ...then outer child
 	}
 	else {										// if outer box is closer
-		child[ANN_OUT]->ann_FR_search(box_dist);// search outer child first
-		child[ANN_IN]->ann_FR_search(inner_dist);// ...then outer child
+		child[ANN_OUT]->ann_FR_search(box_dist, ctx);	// search outer child first
+		child[ANN_IN]->ann_FR_search(inner_dist, ctx);	// ...then outer child
 	}
 	ANN_FLOP(3*n_bnds)							// increment floating ops
 	ANN_SHR(1)									// one more shrinking node
 }
+
+//----------------------------------------------------------------------
+//	bd_shrink::ann_FR_count - count points in range below shrinking node
+//		If the node's cell lies within the ball, all its points are
+//		counted.  Otherwise, the children are counted.  The cell of
+//		the inner child is the current cell cut down by the bounding
+//		halfspaces, and so the cell bounds are narrowed while it is
+//		counted (the old bounds are saved on ctx.cell_stk).  The inner
+//		child is skipped if its box is out of range.  The outer child's
+//		cell is the current cell minus the inner box, and the current
+//		cell is used as its bounding box.
+//----------------------------------------------------------------------
+
+void ANNbd_shrink::ann_FR_count(
+	ANNdist				box_dist,				// distance to cell
+	ANNdist				far_dist,				// dist to farthest point
+	ANNkdFRSearchCtx	&ctx)					// search context
+{
+	if (annCellInside(far_dist, ctx.sq_rad_out)) {	// cell is inside ball
+		ctx.pts_in_range += n_sub;				// count all of its points
+		return;
+	}
+												// check dist calc term cond.
+	if (ANNmaxPtsVisited != 0 && ctx.pts_visited > ANNmaxPtsVisited) return;
+
+	ANNdist inner_dist = 0;						// distance to inner box
+	for (int i = 0; i < n_bnds; i++) {			// is query point in the box?
+		if (bnds[i].out(ctx.q)) {				// outside this bounding side?
+												// add to inner distance
+			inner_dist = (ANNdist) ANN_SUM(inner_dist, bnds[i].dist(ctx.q));
+		}
+	}
+	if (inner_dist * ctx.max_err > ctx.sq_rad) {	// inner box out of range
+		child[ANN_OUT]->ann_FR_count(box_dist, far_dist, ctx);
+		ANN_FLOP(3*n_bnds)						// increment floating ops
+		ANN_SHR(1)								// one more shrinking node
+		return;
+	}
+	ANNdist inner_far = far_dist;				// dist to its farthest point
+	for (int i = 0; i < n_bnds; i++) {
+		int cd = bnds[i].cd;					// narrow the cell
+		ANNcoord lo = ctx.cell_lo[cd];
+		ANNcoord hi = ctx.cell_hi[cd];
+		ctx.cell_stk->push_back(lo);			// (saving its bounds)
+		ctx.cell_stk->push_back(hi);
+		if (bnds[i].sd > 0 && bnds[i].cv > lo)	// lower bound
+			ctx.cell_lo[cd] = bnds[i].cv;
+		else if (bnds[i].sd < 0 && bnds[i].cv < hi)	// upper bound
+			ctx.cell_hi[cd] = bnds[i].cv;
+		inner_far = (ANNdist) ANN_SUM(
+				ANN_DIFF(annCellFarDist(ctx.q[cd], lo, hi), inner_far),
+				annCellFarDist(ctx.q[cd], ctx.cell_lo[cd], ctx.cell_hi[cd]));
+	}
+	child[ANN_IN]->ann_FR_count(inner_dist, inner_far, ctx);
+	for (int i = n_bnds-1; i >= 0; i--) {		// restore cell bounds
+		int cd = bnds[i].cd;
+		ctx.cell_hi[cd] = ctx.cell_stk->back();
+		ctx.cell_stk->pop_back();
+		ctx.cell_lo[cd] = ctx.cell_stk->back();
+		ctx.cell_stk->pop_back();
+	}
+	child[ANN_OUT]->ann_FR_count(box_dist, far_dist, ctx);
+	ANN_FLOP(12*n_bnds)							// increment floating ops
+	ANN_SHR(1)									// one more shrinking node
+}
+
+ANN_NAMESPACE_END
@@ -24,14 +24,23 @@
 //		Fixed centroid shrink threshold condition to depend on the
 //			dimension.
 //		Moved dump routine to kd_dump.cpp.
+//	Revision 1.2  10/17/26
+//		Added optional copy of points in leaf order
+//		Added constructor from a subset of a point array
+//		Added parallel construction (rbd_tree_par)
+//		Presorted construction when there is no shrinking
 //----------------------------------------------------------------------
 
 #include "bd_tree.h"					// bd-tree declarations
 #include "kd_util.h"					// kd-tree utilities
 #include "kd_split.h"					// kd-tree splitting rules
+#include "thread_pool.h"				// thread counts
+#include <vector>						// top nodes and tasks
 
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Printing a bd-tree 
 //		These routines print a bd-tree.   See the analogous procedure
@@ -100,7 +109,13 @@ void ANNbd_shrink::getStats(					// get subtree statistics
 //		It first builds a skeleton kd-tree as a basis, then computes the
 //		bounding box of the data points, and then invokes rbd_tree() to
 //		actually build the tree, passing it the appropriate splitting
-//		and shrinking information.
+//		and shrinking information.  If n_threads is not 1, the tree
+//		is built by rbd_tree_par() instead (see below), which gives
+//		the same tree.
+//
+//		The second constructor (which is protected) builds the tree
+//		for just the points of pa whose indices are given in pi, as
+//		for kd-trees.  The tree takes over the array pi.
 //----------------------------------------------------------------------
 
 ANNkd_ptr rbd_tree(						// recursive construction of bd-tree
@@ -113,46 +128,101 @@ ANNkd_ptr rbd_tree(						// recursive construction of bd-tree
 	ANNkd_splitter		splitter,		// splitting routine
 	ANNshrinkRule		shrink);		// shrinking rule
 
+ANNkd_ptr rbd_tree_par(					// parallel construction of bd-tree
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in tree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for root
+	ANNkd_splitter		splitter,		// splitting routine
+	ANNshrinkRule		shrink,			// shrinking rule
+	int					n_thr);			// number of threads
+
 ANNbd_tree::ANNbd_tree(					// construct from point array
 	ANNpointArray		pa,				// point array (with at least n pts)
 	int					n,				// number of points
 	int					dd,				// dimension
 	int					bs,				// bucket size
 	ANNsplitRule		split,			// splitting rule
-	ANNshrinkRule		shrink)			// shrinking rule
+	ANNshrinkRule		shrink,			// shrinking rule
+	ANNbool				copy_pts,		// copy points to leaf order?
+	int					n_threads)		// number of threads for building
 	: ANNkd_tree(n, dd, bs)				// build skeleton base tree
 {
 	pts = pa;							// where the points are
-	if (n == 0) return;					// no points--no sweat
+	BuildTree(split, shrink, copy_pts, n_threads);	// build the tree
+}
 
-	ANNorthRect bnd_box(dd);			// bounding box for points
-										// construct bounding rectangle
-	annEnclRect(pa, pidx, n, dd, bnd_box);
-										// copy to tree structure
-	bnd_box_lo = annCopyPt(dd, bnd_box.lo);
-	bnd_box_hi = annCopyPt(dd, bnd_box.hi);
+ANNbd_tree::ANNbd_tree(					// construct from subset of points
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pi,				// indices of points (n of them)
+	int					n,				// number of points
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		split,			// splitting rule
+	ANNshrinkRule		shrink,			// shrinking rule
+	ANNbool				copy_pts)		// copy points to leaf order?
+	: ANNkd_tree(0, dd, bs)				// build empty base tree
+{
+	delete [] pidx;						// use the given indices instead
+	SkeletonTree(n, dd, bs, pa, pi);
+	BuildTree(split, shrink, copy_pts, 1);	// build the tree
+}
+
+void ANNbd_tree::BuildTree(				// build tree for pts[pidx[...]]
+	ANNsplitRule		split,			// splitting rule
+	ANNshrinkRule		shrink,			// shrinking rule
+	ANNbool				copy_pts,		// copy points to leaf order?
+	int					n_threads)		// number of threads for building
+{
+	if (n_pts == 0) return;				// no points--no sweat
 
-	switch (split) {					// build by rule
+	ANNpointArray pa = pts;				// (shorthand)
+	int n = n_pts;
+	int dd = dim;
+	int bs = bkt_size;
+
+	ANNkd_splitter splitter = NULL;		// splitting routine
+	switch (split) {					// select by rule
 	case ANN_KD_STD:					// standard kd-splitting rule
-		root = rbd_tree(pa, pidx, n, dd, bs, bnd_box, kd_split, shrink);
+		splitter = kd_split;
 		break;
 	case ANN_KD_MIDPT:					// midpoint split
-		root = rbd_tree(pa, pidx, n, dd, bs, bnd_box, midpt_split, shrink);
+		splitter = midpt_split;
 		break;
 	case ANN_KD_SUGGEST:				// best (in our opinion)
 	case ANN_KD_SL_MIDPT:				// sliding midpoint split
-		root = rbd_tree(pa, pidx, n, dd, bs, bnd_box, sl_midpt_split, shrink);
+		splitter = sl_midpt_split;
 		break;
 	case ANN_KD_FAIR:					// fair split
-		root = rbd_tree(pa, pidx, n, dd, bs, bnd_box, fair_split, shrink);
+		splitter = fair_split;
 		break;
 	case ANN_KD_SL_FAIR:				// sliding fair split
-		root = rbd_tree(pa, pidx, n, dd, bs,
-						bnd_box, sl_fair_split, shrink);
+		splitter = sl_fair_split;
 		break;
 	default:
 		annError("Illegal splitting method", ANNabort);
 	}
+
+	int n_thr = annNumThreads(n_threads, n);
+	ANNorthRect bnd_box(dd);			// bounding box for points
+										// construct bounding rectangle
+	int old_thr = annSetScanThreads(n_thr);
+	annEnclRect(pa, pidx, n, dd, bnd_box);
+	annSetScanThreads(old_thr);
+										// copy to tree structure
+	bnd_box_lo = annCopyPt(dd, bnd_box.lo);
+	bnd_box_hi = annCopyPt(dd, bnd_box.hi);
+
+	if (ANNpresort && split == ANN_KD_STD && shrink == ANN_BD_NONE)
+		root = rkd_tree_presort(pa, pidx, n, dd, bs, bnd_box, n_thr);
+	else if (n_thr > 1)					// build in parallel
+		root = rbd_tree_par(pa, pidx, n, dd, bs, bnd_box,
+						splitter, shrink, n_thr);
+	else
+		root = rbd_tree(pa, pidx, n, dd, bs, bnd_box, splitter, shrink);
+	if (copy_pts) CopyLeafPts();		// copy points if desired
 }
 
 //----------------------------------------------------------------------
@@ -415,3 +485,139 @@ ANNkd_ptr rbd_tree(				// recursive construction of bd-tree
 		return new ANNbd_shrink(n_bnds, bnds, in, out);
 	}
 } 
+
+//----------------------------------------------------------------------
+//	rbd_tree_par - parallel construction of a bd-tree
+//
+//		This builds the same tree as rbd_tree(), using n_thr threads,
+//		in the same way as rkd_tree_par() (see kd_tree.cpp).  The top
+//		levels of the tree are built by rbd_tree_top(), which makes
+//		the same choices as rbd_tree() (with parallel scans of the
+//		points, including those of the shrinking rules), and records
+//		each node in preorder, along with the bounds of shrinking
+//		nodes.  Both children of a splitting or shrinking node may
+//		become tasks, so the inner and outer subtrees of a shrink are
+//		built concurrently.  The tasks are then built by rbd_tree(),
+//		and the top nodes are created bottom-up by rbd_tree_join().
+//----------------------------------------------------------------------
+
+class ANNbdBuildTop {					// top node (split, shrink, or task)
+public:
+	int					task;			// task number (-1 if not a task)
+	ANNdecomp			decomp;			// split or shrink
+	int					cd;				// cutting dimension (split)
+	ANNcoord			cv;				// cutting value (split)
+	ANNcoord			lv, hv;			// bounds along cutting dim (split)
+	int					n_bnds;			// number of bounds (shrink)
+	ANNorthHSArray		bnds;			// bounds (shrink)
+};
+
+static void rbd_tree_top(				// build top levels of bd-tree
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in subtree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	ANNkd_splitter		splitter,		// splitting routine
+	ANNshrinkRule		shrink,			// shrinking rule
+	int					cutoff,			// max points for a task
+	std::vector<ANNbdBuildTop> &top,	// top nodes (appended)
+	std::vector<ANNkdBuildTask> &tasks)	// tasks (appended)
+{
+	ANNbdBuildTop nd;
+	nd.task = -1;
+	nd.decomp = SPLIT;
+	nd.cd = 0;
+	nd.cv = nd.lv = nd.hv = 0;
+	nd.n_bnds = 0;
+	nd.bnds = NULL;
+	if (n <= cutoff || n <= bsp) {		// small enough for a task
+		nd.task = annAddBuildTask(pidx, n, dim, bnd_box, tasks);
+		top.push_back(nd);
+		return;
+	}
+
+	ANNorthRect inner_box(dim);			// inner box (if shrinking)
+	nd.decomp = selectDecomp(			// select decomposition method
+				pa, pidx, n, dim, bnd_box, splitter, shrink, inner_box);
+
+	if (nd.decomp == SPLIT) {			// split selected
+		int n_lo;						// number on low side of cut
+		(*splitter)(pa, pidx, bnd_box, n, dim, nd.cd, nd.cv, n_lo);
+		nd.lv = bnd_box.lo[nd.cd];		// save bounds for cutting dimension
+		nd.hv = bnd_box.hi[nd.cd];
+		top.push_back(nd);
+
+		bnd_box.hi[nd.cd] = nd.cv;		// left subtree
+		rbd_tree_top(pa, pidx, n_lo, dim, bsp, bnd_box, splitter, shrink,
+					cutoff, top, tasks);
+		bnd_box.hi[nd.cd] = nd.hv;
+
+		bnd_box.lo[nd.cd] = nd.cv;		// right subtree
+		rbd_tree_top(pa, pidx + n_lo, n-n_lo, dim, bsp, bnd_box, splitter,
+					shrink, cutoff, top, tasks);
+		bnd_box.lo[nd.cd] = nd.lv;
+	}
+	else {								// shrink selected
+		int n_in;						// number of points in box
+		annBoxSplit(pa, pidx, n, dim, inner_box, n_in);
+										// bounds (freed by shrinking node)
+		annBox2Bnds(inner_box, bnd_box, dim, nd.n_bnds, nd.bnds);
+		top.push_back(nd);
+										// inner and outer subtrees
+		rbd_tree_top(pa, pidx, n_in, dim, bsp, inner_box, splitter, shrink,
+					cutoff, top, tasks);
+		rbd_tree_top(pa, pidx+n_in, n - n_in, dim, bsp, bnd_box, splitter,
+					shrink, cutoff, top, tasks);
+	}
+}
+
+static ANNkd_ptr rbd_tree_join(			// create top nodes of bd-tree
+	const std::vector<ANNbdBuildTop> &top,	// top nodes
+	const std::vector<ANNkdBuildTask> &tasks, // tasks (with results)
+	int					&pos)			// next top node (updated)
+{
+	const ANNbdBuildTop &nd = top[pos++];
+	if (nd.task >= 0) return tasks[nd.task].root;
+	ANNkd_ptr c0 = rbd_tree_join(top, tasks, pos);
+	ANNkd_ptr c1 = rbd_tree_join(top, tasks, pos);
+	if (nd.decomp == SPLIT)
+		return new ANNkd_split(nd.cd, nd.cv, nd.lv, nd.hv, c0, c1);
+	else
+		return new ANNbd_shrink(nd.n_bnds, nd.bnds, c0, c1);
+}
+
+ANNkd_ptr rbd_tree_par(					// parallel construction of bd-tree
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in tree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for root
+	ANNkd_splitter		splitter,		// splitting routine
+	ANNshrinkRule		shrink,			// shrinking rule
+	int					n_thr)			// number of threads
+{
+	if (n_thr <= 1) {					// just one thread--build serially
+		return rbd_tree(pa, pidx, n, dim, bsp, bnd_box, splitter, shrink);
+	}
+	std::vector<ANNbdBuildTop> top;		// build top levels
+	std::vector<ANNkdBuildTask> tasks;
+	int old_thr = annSetScanThreads(n_thr);
+	rbd_tree_top(pa, pidx, n, dim, bsp, bnd_box, splitter, shrink,
+				annBuildCutoff(n, n_thr), top, tasks);
+	annSetScanThreads(old_thr);
+										// build the subtrees
+	annRunBuildTasks(tasks, n_thr, [&](ANNkdBuildTask &t) {
+		return rbd_tree(pa, t.pidx, t.n, dim, bsp, *t.bnd_box,
+						splitter, shrink);
+	});
+
+	int pos = 0;						// create the top nodes
+	ANNkd_ptr root = rbd_tree_join(top, tasks, pos);
+	for (size_t i = 0; i < tasks.size(); i++) delete tasks[i].bnd_box;
+	return root;
+}
+
+ANN_NAMESPACE_END
@@ -22,6 +22,11 @@
 //		Initial release
 //	Revision 1.0  04/01/05
 //		Changed IN, OUT to ANN_IN, ANN_OUT
+//	Revision 1.2  10/17/26
+//		Added flatten() for conversion to flat trees
+//		Added subtree point counts and ann_FR_count()
+//		Added ann_group_search() for all k-nearest neighbors
+//		Added encode() for compressed dumps
 //----------------------------------------------------------------------
 
 #ifndef ANN_bd_tree_H
@@ -30,6 +35,8 @@
 #include <ANN/ANNx.h>					// all ANN includes
 #include "kd_tree.h"					// kd-tree includes
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	bd-tree shrinking node.
 //		The main addition in the bd-tree is the shrinking node, which
@@ -56,6 +63,9 @@
 //		the list of bounding halfspaces is irredundant, meaning that there
 //		are no two distinct halfspaces in the list with the same outward
 //		pointing normals.
+//
+//		As in splitting nodes, the number of points in the subtree is
+//		stored for range counting.
 //----------------------------------------------------------------------
 
 class ANNbd_shrink : public ANNkd_node	// splitting node of a kd-tree
@@ -63,6 +73,7 @@ class ANNbd_shrink : public ANNkd_node	// splitting node of a kd-tree
 	int					n_bnds;			// number of bounding halfspaces
 	ANNorthHSArray		bnds;			// list of bounding halfspaces
 	ANNkd_ptr			child[2];		// in and out children
+	int					n_sub;			// no. of points in subtree
 public:
 	ANNbd_shrink(						// constructor
 		int				nb,				// number of bounding halfspaces
@@ -73,6 +84,8 @@ public:
 			bnds			= bds;				// assign bounds
 			child[ANN_IN]	= ic;				// set children
 			child[ANN_OUT]	= oc;
+			n_sub = (ic != NULL ? ic->subtree_pts() : 0) +
+					(oc != NULL ? oc->subtree_pts() : 0);
 		}
 
 	~ANNbd_shrink()						// destructor
@@ -85,16 +98,30 @@ public:
 				delete [] bnds;			// delete bounds
 		}
 
+	virtual int subtree_pts()			// number of points in subtree
+		{ return n_sub; }
+
 	virtual void getStats(						// get tree statistics
 				int dim,						// dimension of space
 				ANNkdStats &st,					// statistics
 				ANNorthRect &bnd_box);			// bounding box
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
+	virtual int flatten(ANNflatBuilder &fb);	// convert to flat node
+	virtual void encode(ANNdumpWriter &dw);		// write compressed node
 
-	virtual void ann_search(ANNdist);			// standard search
-	virtual void ann_pri_search(ANNdist);		// priority search
-	virtual void ann_FR_search(ANNdist); 		// fixed-radius search
+												// standard search
+	virtual void ann_search(ANNdist, ANNkdSearchCtx&);
+												// priority search
+	virtual void ann_pri_search(ANNdist, ANNprSearchCtx&);
+												// fixed-radius search
+	virtual void ann_FR_search(ANNdist, ANNkdFRSearchCtx&);
+												// fixed-radius counting
+	virtual void ann_FR_count(ANNdist, ANNdist, ANNkdFRSearchCtx&);
+												// group search (all-kNN)
+	virtual void ann_group_search(int, int*, ANNdist*, ANNkdGroupCtx&);
 };
 
+ANN_NAMESPACE_END
+
 #endif
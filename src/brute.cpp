@@ -22,10 +22,18 @@
 //		Initial release
 //	Revision 1.1  05/03/05
 //		Added fixed-radius kNN search
+//	Revision 1.2  10/17/26
+//		Distances are computed by the distance kernel, with early exit
+//		Priority queue is taken from the thread's search scratch
 //----------------------------------------------------------------------
 
 #include <ANN/ANNx.h>					// all ANN includes
 #include "pr_queue_k.h"					// k element priority queue
+#include "search_scratch.h"				// per-thread search scratch
+#include "dist_kernel.h"				// distance kernels
+#include <ANN/ANNperf.h>				// performance evaluation
+
+ANN_NAMESPACE_BEGIN
 
 //----------------------------------------------------------------------
 //		Brute-force search simply stores a pointer to the list of
@@ -58,23 +66,29 @@ void ANNbruteForce::annkSearch(			// approx k near neighbor search
 	ANNdistArray		dd,				// dist to near neighbors (returned)
 	double				eps)			// error bound (ignored)
 {
-	ANNmin_k mk(k);						// construct a k-limited priority queue
 	int i;
 
 	if (k > n_pts) {					// too many near neighbors?
 		annError("Requesting more near neighbors than data points", ANNabort);
 	}
+	ANNsearchScratch *scr = annGetScratch();
+	ANNmin_k &mk = scr->point_mk;		// k-limited priority queue
+	mk.reset(k);
 										// run every point through queue
 	for (i = 0; i < n_pts; i++) {
 										// compute distance to point
-		ANNdist sqDist = annDist(dim, pts[i], q);
-		if (ANN_ALLOW_SELF_MATCH || sqDist != 0)
+										// (if not beyond the k-th)
+		ANNdist bound = mk.max_key();
+		ANNdist sqDist = annDistBnd(dim, pts[i], q, bound);
+		ANN_PTS(1)
+		if (sqDist <= bound && (ANN_ALLOW_SELF_MATCH || sqDist != 0))
 			mk.insert(sqDist, i);
 	}
 	for (i = 0; i < k; i++) {			// extract the k closest points
 		dd[i] = mk.ith_smallest_key(i);
 		nn_idx[i] = mk.ith_smallest_info(i);
 	}
+	annReleaseScratch(scr);				// done with scratch
 }
 
 int ANNbruteForce::annkFRSearch(		// approx fixed-radius kNN search
@@ -85,13 +99,16 @@ int ANNbruteForce::annkFRSearch(		// approx fixed-radius kNN search
 	ANNdistArray		dd,				// dist to near neighbors (returned)
 	double				eps)			// error bound
 {
-	ANNmin_k mk(k);						// construct a k-limited priority queue
+	ANNsearchScratch *scr = annGetScratch();
+	ANNmin_k &mk = scr->point_mk;		// k-limited priority queue
+	mk.reset(k);
 	int i;
 	int pts_in_range = 0;				// number of points in query range
 										// run every point through queue
 	for (i = 0; i < n_pts; i++) {
 										// compute distance to point
-		ANNdist sqDist = annDist(dim, pts[i], q);
+		ANNdist sqDist = annDistBnd(dim, pts[i], q, sqRad);
+		ANN_PTS(1)
 		if (sqDist <= sqRad &&			// within radius bound
 			(ANN_ALLOW_SELF_MATCH || sqDist != 0)) { // ...and no self match
 			mk.insert(sqDist, i);
@@ -104,6 +121,9 @@ int ANNbruteForce::annkFRSearch(		// approx fixed-radius kNN search
 		if (nn_idx != NULL)
 			nn_idx[i] = mk.ith_smallest_info(i);
 	}
+	annReleaseScratch(scr);				// done with scratch
 
 	return pts_in_range;
 }
+
+ANN_NAMESPACE_END
@@ -0,0 +1,376 @@
+//----------------------------------------------------------------------
+// File:			dist_kernel.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Point-to-point distance kernels
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//		Kernel selected on first call rather than at static init
+//----------------------------------------------------------------------
+
+#include "dist_kernel.h"				// distance kernel declarations
+#include <ANN/ANNperf.h>				// performance evaluation
+
+//----------------------------------------------------------------------
+//	Vectorized kernels are available only for the Euclidean norm, and
+//	only when compiling with gcc or clang for x86 processors (which
+//	allow us to compile individual functions for particular
+//	instruction sets and to test the processor at run time).  They
+//	may be disabled by compiling with -DANN_NO_SIMD.
+//----------------------------------------------------------------------
+
+#if defined(ANN_L2_NORM) && !defined(ANN_NO_SIMD) && \
+	(defined(__GNUC__) || defined(__clang__)) && \
+	(defined(__x86_64__) || defined(__i386__))
+  #define ANN_SIMD_X86
+  #include <immintrin.h>				// Intel intrinsics
+#endif
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	All the kernels must round each product before adding it to the
+//	sum, but compilers are free to contract a multiply followed by an
+//	add into a single fused multiply-add (which does not), and gcc
+//	does so even for intrinsics.  ANN_ROUNDED(v) prevents this by
+//	making v opaque to the optimizer (at no cost, since it is already
+//	in a register).  The scalar kernel needs this only when compiling
+//	for processors with fused multiply-add.
+//----------------------------------------------------------------------
+
+#ifdef ANN_SIMD_X86
+  #define ANN_ROUNDED(v)	__asm__("" : "+v" (v));
+#else
+  #define ANN_ROUNDED(v)
+#endif
+
+#if defined(ANN_SIMD_X86) && defined(__FMA__)
+  #define ANN_ROUNDED_SCALAR(v)	ANN_ROUNDED(v)
+#else
+  #define ANN_ROUNDED_SCALAR(v)
+#endif
+
+//----------------------------------------------------------------------
+//	annDistScalar - the scalar kernel
+//		The partial sums are combined in the order
+//
+//			((s0 + s4) + (s2 + s6)) + ((s1 + s5) + (s3 + s7))
+//
+//		which is the natural order for a vector of 8 sums (add the
+//		upper half to the lower half, and repeat).  The vectorized
+//		kernels below must do the same.
+//----------------------------------------------------------------------
+
+static inline ANNdist annSumLanes(		// combine the partial sums
+	const ANNdist		*s)				// the sums
+{
+	return ANN_SUM(
+		ANN_SUM(ANN_SUM(s[0], s[4]), ANN_SUM(s[2], s[6])),
+		ANN_SUM(ANN_SUM(s[1], s[5]), ANN_SUM(s[3], s[7])));
+}
+
+static ANNdist annDistScalar(
+	int					dim,			// dimension of space
+	const ANNcoord		*p,				// first point
+	const ANNcoord		*q,				// second point
+	ANNdist				bound)			// distance bound
+{
+	ANNdist s[ANN_DIST_LANES] = {0, 0, 0, 0, 0, 0, 0, 0};
+	ANNdist dist;
+	int d = 0;
+
+	for (;;) {
+		int end = (dim - d > ANN_DIST_BLOCK ? d + ANN_DIST_BLOCK : dim);
+		for (; d < end; d++) {			// add block to sums
+			ANNdist t = (ANNdist) q[d] - (ANNdist) p[d];
+			ANNdist t2 = ANN_POW(t);
+			ANN_ROUNDED_SCALAR(t2)
+			s[d % ANN_DIST_LANES] = ANN_SUM(s[d % ANN_DIST_LANES], t2);
+		}
+		dist = annSumLanes(s);			// partial distance
+		if (d >= dim || dist > bound) break;
+	}
+	ANN_COORD(d)						// coordinate hits
+	ANN_FLOP(3*d)						// floating ops
+	return dist;
+}
+
+#ifdef ANN_SIMD_X86
+//----------------------------------------------------------------------
+//	Loading coordinates
+//		The vectorized kernels always compute in double precision.
+//		These load 4 (for AVX2) or 8 (for AVX-512) coordinates into a
+//		vector of doubles, converting them if they are float (which is
+//		exact, and so gives the same result as the scalar kernel).  The
+//		masked versions load only the first r coordinates (or those
+//		given by mask m), and set the others to zero.
+//----------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static inline __m256d annLoad4(const ANNcoord *p)
+{
+#ifdef ANN_FLOAT
+	return _mm256_cvtps_pd(_mm_loadu_ps(p));
+#else
+	return _mm256_loadu_pd(p);
+#endif
+}
+
+__attribute__((target("avx2")))
+static inline __m256d annMaskLoad4(const ANNcoord *p, int r)
+{
+#ifdef ANN_FLOAT
+	__m128i m = _mm_cmpgt_epi32(_mm_set1_epi32(r), _mm_setr_epi32(0, 1, 2, 3));
+	return _mm256_cvtps_pd(_mm_maskload_ps(p, m));
+#else
+	__m256i m = _mm256_cmpgt_epi64(_mm256_set1_epi64x(r),
+								   _mm256_setr_epi64x(0, 1, 2, 3));
+	return _mm256_maskload_pd(p, m);
+#endif
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d annLoad8(const ANNcoord *p)
+{
+#ifdef ANN_FLOAT
+	return _mm512_cvtps_pd(_mm256_loadu_ps(p));
+#else
+	return _mm512_loadu_pd(p);
+#endif
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d annMaskLoad8(const ANNcoord *p, __mmask8 m)
+{
+#ifdef ANN_FLOAT
+	return _mm512_cvtps_pd(_mm512_castps512_ps256(
+				_mm512_maskz_loadu_ps((__mmask16) m, p)));
+#else
+	return _mm512_maskz_loadu_pd(m, p);
+#endif
+}
+
+//----------------------------------------------------------------------
+//	annDistAVX2 - the AVX2 kernel
+//		The sums are held in two vectors, a (sums 0-3) and b (sums
+//		4-7).  Each step handles 8 coordinates.  The last step of the
+//		last block may have fewer, and the others are masked out (and
+//		so add zero).  We use separate multiplies and adds (not fused
+//		multiply-add; see ANN_ROUNDED) so the result agrees with the
+//		scalar kernel.
+//----------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static ANNdist annDistAVX2(
+	int					dim,			// dimension of space
+	const ANNcoord		*p,				// first point
+	const ANNcoord		*q,				// second point
+	ANNdist				bound)			// distance bound
+{
+	__m256d a = _mm256_setzero_pd();	// sums 0-3
+	__m256d b = _mm256_setzero_pd();	// sums 4-7
+	ANNdist dist;
+	int d = 0;
+
+	for (;;) {
+		int end = (dim - d > ANN_DIST_BLOCK ? d + ANN_DIST_BLOCK : dim);
+		for (; d + 8 <= end; d += 8) {	// full steps
+			__m256d t0 = _mm256_sub_pd(annLoad4(q+d), annLoad4(p+d));
+			__m256d t1 = _mm256_sub_pd(annLoad4(q+d+4), annLoad4(p+d+4));
+			t0 = _mm256_mul_pd(t0, t0);
+			t1 = _mm256_mul_pd(t1, t1);
+			ANN_ROUNDED(t0)
+			ANN_ROUNDED(t1)
+			a = _mm256_add_pd(a, t0);
+			b = _mm256_add_pd(b, t1);
+		}
+		if (d < end) {					// partial step
+			int r = end - d;			// coordinates left (1-7)
+			__m256d t0 = _mm256_sub_pd(annMaskLoad4(q+d, r),
+									   annMaskLoad4(p+d, r));
+			__m256d t1 = _mm256_sub_pd(annMaskLoad4(q+d+4, r-4),
+									   annMaskLoad4(p+d+4, r-4));
+			t0 = _mm256_mul_pd(t0, t0);
+			t1 = _mm256_mul_pd(t1, t1);
+			ANN_ROUNDED(t0)
+			ANN_ROUNDED(t1)
+			a = _mm256_add_pd(a, t0);
+			b = _mm256_add_pd(b, t1);
+			d = end;
+		}
+										// combine sums
+		__m256d s4 = _mm256_add_pd(a, b);
+		__m128d s2 = _mm_add_pd(_mm256_castpd256_pd128(s4),
+								_mm256_extractf128_pd(s4, 1));
+		dist = _mm_cvtsd_f64(_mm_add_sd(s2, _mm_unpackhi_pd(s2, s2)));
+		if (d >= dim || dist > bound) break;
+	}
+	ANN_COORD(d)						// coordinate hits
+	ANN_FLOP(3*d)						// floating ops
+	return dist;
+}
+
+//----------------------------------------------------------------------
+//	annDistAVX512 - the AVX-512 kernel
+//		The 8 sums are held in a single vector.  The last step uses a
+//		masked load for the remaining coordinates.
+//----------------------------------------------------------------------
+
+__attribute__((target("avx512f")))
+static ANNdist annDistAVX512(
+	int					dim,			// dimension of space
+	const ANNcoord		*p,				// first point
+	const ANNcoord		*q,				// second point
+	ANNdist				bound)			// distance bound
+{
+	__m512d s = _mm512_setzero_pd();	// the sums
+	ANNdist dist;
+	int d = 0;
+
+	for (;;) {
+		int end = (dim - d > ANN_DIST_BLOCK ? d + ANN_DIST_BLOCK : dim);
+		for (; d + 8 <= end; d += 8) {	// full steps
+			__m512d t = _mm512_sub_pd(annLoad8(q+d), annLoad8(p+d));
+			t = _mm512_mul_pd(t, t);
+			ANN_ROUNDED(t)
+			s = _mm512_add_pd(s, t);
+		}
+		if (d < end) {					// partial step
+			__mmask8 m = (__mmask8) ((1u << (end - d)) - 1);
+			__m512d t = _mm512_sub_pd(annMaskLoad8(q+d, m),
+									  annMaskLoad8(p+d, m));
+			t = _mm512_mul_pd(t, t);
+			ANN_ROUNDED(t)
+			s = _mm512_add_pd(s, t);
+			d = end;
+		}
+										// combine sums
+		__m256d s4 = _mm256_add_pd(_mm512_castpd512_pd256(s),
+								   _mm512_extractf64x4_pd(s, 1));
+		__m128d s2 = _mm_add_pd(_mm256_castpd256_pd128(s4),
+								_mm256_extractf128_pd(s4, 1));
+		dist = _mm_cvtsd_f64(_mm_add_sd(s2, _mm_unpackhi_pd(s2, s2)));
+		if (d >= dim || dist > bound) break;
+	}
+	ANN_COORD(d)						// coordinate hits
+	ANN_FLOP(3*d)						// floating ops
+	return dist;
+}
+#endif
+
+//----------------------------------------------------------------------
+//	Kernel selection
+//		annSimdSupported() determines whether the processor (and
+//		operating system) support a given kernel.  The kernel is
+//		initially the best one supported, and may be changed with
+//		annSetSimd().  (This should not be done while searches are in
+//		progress.)
+//
+//		annDistKernel is constant initialized to annDistFirst(), so
+//		that it is valid even in distance computations made by static
+//		initializers in other files.  The first call replaces it with
+//		the best kernel (unless annSetSimd() got there first) and
+//		forwards the call.  The best kernel is found just once, by a
+//		function-local static, and annDistKernel and annCurrSimd are
+//		atomic, since the first calls may come from several search
+//		threads at once.  (annCurrSimd is ANN_N_SIMD until a kernel
+//		is set explicitly, meaning the best one.)
+//----------------------------------------------------------------------
+
+static ANNbool annSimdSupported(		// is kernel supported?
+	ANNsimd				level)			// the kernel
+{
+	switch (level) {
+	case ANN_SIMD_NONE:
+		return ANNtrue;
+#ifdef ANN_SIMD_X86
+	case ANN_SIMD_AVX2:
+		return (ANNbool) (__builtin_cpu_supports("avx2") != 0);
+	case ANN_SIMD_AVX512:
+		return (ANNbool) (__builtin_cpu_supports("avx512f") != 0);
+#endif
+	default:
+		return ANNfalse;
+	}
+}
+
+static ANNdistKernel annKernelTable(		// kernel for given level
+	ANNsimd				level)			// the level
+{
+	switch (level) {
+#ifdef ANN_SIMD_X86
+	case ANN_SIMD_AVX2:		return annDistAVX2;
+	case ANN_SIMD_AVX512:	return annDistAVX512;
+#endif
+	default:				return annDistScalar;
+	}
+}
+
+static std::atomic<int> annCurrSimd(ANN_N_SIMD);	// current level
+
+static ANNsimd annFindSimd()			// find best kernel
+{
+#ifdef ANN_SIMD_X86
+	__builtin_cpu_init();				// (needed before main)
+#endif
+	for (int lev = ANN_N_SIMD-1; lev > ANN_SIMD_NONE; lev--) {
+		if (annSimdSupported((ANNsimd) lev)) return (ANNsimd) lev;
+	}
+	return ANN_SIMD_NONE;
+}
+
+static ANNsimd annBestSimd()			// best kernel (found once)
+{
+	static const ANNsimd best = annFindSimd();
+	return best;
+}
+
+static ANNdist annDistFirst(			// first call - select kernel
+	int					dim,			// dimension of space
+	const ANNcoord		*p,				// first point
+	const ANNcoord		*q,				// second point
+	ANNdist				bound)			// distance bound
+{
+	ANNdistKernel first = annDistFirst;
+	annDistKernel.compare_exchange_strong(first,
+				annKernelTable(annBestSimd()), std::memory_order_relaxed);
+	return annDistBnd(dim, p, q, bound);
+}
+
+std::atomic<ANNdistKernel> annDistKernel(annDistFirst);	// the current kernel
+
+ANNsimd annSimd()						// kernel in use
+{
+	int level = annCurrSimd.load(std::memory_order_relaxed);
+	return (level == ANN_N_SIMD ? annBestSimd() : (ANNsimd) level);
+}
+
+ANNsimd annSetSimd(						// select kernel
+	ANNsimd				level)			// desired kernel
+{
+	if (level > annBestSimd())			// (also initializes cpu checks)
+		level = annBestSimd();
+	while (level > ANN_SIMD_NONE && !annSimdSupported(level)) {
+		level = (ANNsimd) (level - 1);	// fall back to a lower one
+	}
+	annCurrSimd.store(level, std::memory_order_relaxed);
+	annDistKernel.store(annKernelTable(level), std::memory_order_relaxed);
+	return level;
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,88 @@
+//----------------------------------------------------------------------
+// File:			dist_kernel.h
+// Programmer:		Sunil Arya and David Mount
+// Description:		Point-to-point distance kernels
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//		Kernel pointer made atomic
+//----------------------------------------------------------------------
+
+#ifndef ANN_dist_kernel_H
+#define ANN_dist_kernel_H
+
+#include <ANN/ANNx.h>					// all ANN includes
+#include <atomic>						// atomic kernel pointer
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Distance kernels
+//		annDistBnd(dim, p, q, bound) returns the distance between
+//		points p and q if it is at most bound.  Otherwise it returns
+//		some value greater than bound.  (This is the partial distance
+//		calculation used in the leaves of the search trees.)  With
+//		bound = ANN_DBL_MAX it returns the exact distance, and this
+//		is how annDist() is computed.
+//
+//		The call goes through a pointer to one of several kernels,
+//		which is set when the library is loaded according to what the
+//		processor supports (see annSetSimd() in ANN.h).  All of them
+//		compute the same result, bit for bit.  They accumulate the
+//		squared coordinate differences in ANN_DIST_LANES separate sums,
+//		coordinate d going to sum d mod ANN_DIST_LANES, and combine the
+//		sums in a fixed order.  The partial distance is checked
+//		against the bound only after every ANN_DIST_BLOCK coordinates.
+//
+//		Because the summation order differs from a plain left-to-right
+//		sum, distances may differ from those of earlier versions of ANN
+//		in the last few bits (by a relative amount of at most about
+//		dim * DBL_EPSILON).  Since the partial sums only grow, a point
+//		is accepted if and only if its (full) distance is at most the
+//		bound, just as before.
+//
+//		The vectorized kernels assume the Euclidean norm.  (If other
+//		norms are selected in ANN.h, the scalar kernel is always used.)
+//		All kernels compute in double precision, so with float
+//		coordinates (ANN_FLOAT) each coordinate is converted to double
+//		before the difference is taken.
+//----------------------------------------------------------------------
+
+const int ANN_DIST_LANES	= 8;		// number of partial sums
+const int ANN_DIST_BLOCK	= 16;		// coordinates between checks
+
+typedef ANNdist (*ANNdistKernel)(		// distance kernel
+	int					dim,			// dimension of space
+	const ANNcoord		*p,				// first point
+	const ANNcoord		*q,				// second point
+	ANNdist				bound);			// distance bound
+
+extern std::atomic<ANNdistKernel> annDistKernel;	// the current kernel
+
+inline ANNdist annDistBnd(				// distance (if at most bound)
+	int					dim,			// dimension of space
+	const ANNcoord		*p,				// first point
+	const ANNcoord		*q,				// second point
+	ANNdist				bound)			// distance bound
+{
+	return (*annDistKernel.load(std::memory_order_relaxed))(dim, p, q, bound);
+}
+
+ANN_NAMESPACE_END
+
+#endif
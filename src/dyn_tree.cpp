@@ -0,0 +1,407 @@
+//----------------------------------------------------------------------
+// File:			dyn_tree.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Dynamic trees (point insertion and deletion)
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "kd_search.h"					// kd-search declarations
+#include "kd_fix_rad_search.h"			// kd fixed-radius search decls
+#include "search_scratch.h"				// per-thread search scratch
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Dynamic tree constructors and destructor
+//		The points are copied into an array indexed by point index,
+//		which is shared by all the trees.  The initial points are put
+//		in a single tree.
+//----------------------------------------------------------------------
+
+ANNdynamic_tree::ANNdynamic_tree(		// build empty tree
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		sp,				// splitting rule
+	ANNbool				cp)				// copy points to leaf order?
+{
+	dim = dd;
+	bkt_size = bs;
+	split = sp;
+	copy_pts = cp;
+	n_pts = n_dead = 0;
+	n_idx = max_idx = 0;
+	pts = NULL;
+	deleted = NULL;
+	n_buf = 0;
+	buf = new ANNidx[ANN_DYN_BUFFER];
+	for (int i = 0; i < ANN_DYN_MAX_TREES; i++) {
+		trees[i] = NULL;
+	}
+}
+
+ANNdynamic_tree::ANNdynamic_tree(		// build from point array
+	ANNpointArray		pa,				// point array
+	int					n,				// number of points
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		sp,				// splitting rule
+	ANNbool				cp)				// copy points to leaf order?
+{
+	dim = dd;
+	bkt_size = bs;
+	split = sp;
+	copy_pts = cp;
+	n_pts = n_dead = 0;
+	n_idx = max_idx = 0;
+	pts = NULL;
+	deleted = NULL;
+	n_buf = 0;
+	buf = new ANNidx[ANN_DYN_BUFFER];
+	for (int i = 0; i < ANN_DYN_MAX_TREES; i++) {
+		trees[i] = NULL;
+	}
+
+	while (max_idx < n) Grow();			// make room for the points
+	ANNidxArray pi = new ANNidx[n + 1];	// their indices
+	for (int i = 0; i < n; i++) {		// copy the points
+		pts[i] = annCopyPt(dim, pa[i]);
+		deleted[i].store(0, memory_order_relaxed);
+		pi[i] = i;
+	}
+	n_idx = n_pts = n;
+	Build(pi, n);						// build their tree
+}
+
+ANNdynamic_tree::~ANNdynamic_tree()		// tree destructor
+{
+	for (int i = 0; i < ANN_DYN_MAX_TREES; i++) {
+		if (trees[i] != NULL) delete trees[i];
+	}
+	for (int i = 0; i < n_idx; i++) {
+		if (pts[i] != NULL) annDeallocPt(pts[i]);
+	}
+	if (pts != NULL) delete [] pts;
+	if (deleted != NULL) delete [] deleted;
+	delete [] buf;
+}
+
+//----------------------------------------------------------------------
+//	Grow - add space for more point indices
+//		The arrays are doubled in size.  The trees refer to the array
+//		of points, so they are given the new one.
+//----------------------------------------------------------------------
+
+void ANNdynamic_tree::Grow()
+{
+	int new_max = (max_idx > 0 ? 2*max_idx : ANN_DYN_BUFFER);
+	ANNpointArray new_pts = new ANNpoint[new_max];
+	ANNmark *new_deleted = new ANNmark[new_max];
+	for (int i = 0; i < n_idx; i++) {	// copy existing entries
+		new_pts[i] = pts[i];
+		new_deleted[i].store(deleted[i].load(memory_order_relaxed),
+					memory_order_relaxed);
+	}
+	if (pts != NULL) delete [] pts;
+	if (deleted != NULL) delete [] deleted;
+	pts = new_pts;
+	deleted = new_deleted;
+	max_idx = new_max;
+
+	for (int i = 0; i < ANN_DYN_MAX_TREES; i++) {
+		if (trees[i] != NULL) trees[i]->pts = pts;
+	}
+}
+
+//----------------------------------------------------------------------
+//	Collect - collect the undeleted points of a list
+//		The undeleted points among pi[0..n-1] are appended to out, and
+//		their number is returned.  The deleted ones are dropped, and
+//		their storage is freed.
+//----------------------------------------------------------------------
+
+int ANNdynamic_tree::Collect(
+	ANNidxArray			pi,				// point indices
+	int					n,				// number of them
+	ANNidxArray			out)			// undeleted ones (appended)
+{
+	int m = 0;
+	for (int i = 0; i < n; i++) {
+		ANNidx id = pi[i];
+		if (annIsDeleted(deleted, id)) {	// deleted--drop it
+			annDeallocPt(pts[id]);
+			pts[id] = NULL;
+			n_dead--;
+		}
+		else {
+			out[m++] = id;
+		}
+	}
+	return m;
+}
+
+//----------------------------------------------------------------------
+//	Build - build a tree for a list of points
+//		The tree is put in the first empty slot which may hold that
+//		many points (slot i holds at most ANN_DYN_BUFFER*2^i).  The
+//		tree takes over the array of indices.
+//----------------------------------------------------------------------
+
+void ANNdynamic_tree::Build(
+	ANNidxArray			pi,				// point indices
+	int					n)				// number of them
+{
+	if (n == 0) {						// no points--no tree
+		delete [] pi;
+		return;
+	}
+	int i = 0;							// find a slot for the tree
+	while (trees[i] != NULL || (size_t) n > ((size_t) ANN_DYN_BUFFER << i)) {
+		i++;
+	}
+	trees[i] = new ANNkd_tree(pts, pi, n, dim, bkt_size, split, copy_pts);
+}
+
+//----------------------------------------------------------------------
+//	Merge - merge the buffer and the first trees into one tree
+//		The undeleted points of the buffer and of trees 0 through last
+//		are collected, these trees are deleted, and a tree is built on
+//		the points.  (It goes in one of the emptied slots.)
+//----------------------------------------------------------------------
+
+void ANNdynamic_tree::Merge(
+	int					last)			// last tree to merge
+{
+	int n = n_buf;						// number of points (at most)
+	for (int i = 0; i <= last; i++) {
+		if (trees[i] != NULL) n += trees[i]->n_pts;
+	}
+	ANNidxArray pi = new ANNidx[n + 1];	// collect the points
+	int m = Collect(buf, n_buf, pi);
+	n_buf = 0;
+	for (int i = 0; i <= last; i++) {
+		if (trees[i] != NULL) {
+			m += Collect(trees[i]->pidx, trees[i]->n_pts, pi + m);
+			delete trees[i];
+			trees[i] = NULL;
+		}
+	}
+	Build(pi, m);						// build their tree
+}
+
+//----------------------------------------------------------------------
+//	annInsert - add a point
+//		The point is added to the buffer.  When the buffer is full, it
+//		is merged with trees 0 through i, where i is the first tree
+//		such that these trees and the buffer together hold at most
+//		ANN_DYN_BUFFER*2^i points.  (Tree i is empty, or else there are
+//		deleted points to drop.)
+//----------------------------------------------------------------------
+
+ANNidx ANNdynamic_tree::annInsert(
+	ANNpoint			p)				// the point
+{
+	if (n_idx == max_idx) Grow();		// need more space?
+	ANNidx id = n_idx++;				// the new index
+	pts[id] = annCopyPt(dim, p);
+	deleted[id].store(0, memory_order_relaxed);
+	buf[n_buf++] = id;					// add to buffer
+	n_pts++;
+
+	if (n_buf == ANN_DYN_BUFFER) {		// buffer is full
+		size_t n = n_buf;
+		int last = 0;					// find the trees to merge
+		for (;; last++) {
+			if (trees[last] != NULL) n += trees[last]->n_pts;
+			if (n <= ((size_t) ANN_DYN_BUFFER << last)) break;
+		}
+		Merge(last);
+	}
+	return id;
+}
+
+//----------------------------------------------------------------------
+//	annDelete - delete a point
+//		The point is marked deleted.  If this makes the deleted points
+//		in the trees and buffer outnumber the undeleted ones, all the
+//		trees are merged.  Returns false if there is no such point (or
+//		it has already been deleted).
+//----------------------------------------------------------------------
+
+ANNbool ANNdynamic_tree::annDelete(
+	ANNidx				idx)			// index of point
+{
+	if (idx < 0 || idx >= n_idx || annIsDeleted(deleted, idx)) {
+		return ANNfalse;				// no such point
+	}
+	deleted[idx].store(1, memory_order_relaxed);	// mark it deleted
+	n_pts--;
+	n_dead++;
+
+	if (n_dead > n_pts) {				// too many deleted?
+		int last = ANN_DYN_MAX_TREES - 1;	// merge all the trees
+		while (last > 0 && trees[last] == NULL) last--;
+		Merge(last);
+	}
+	return ANNtrue;
+}
+
+int ANNdynamic_tree::nTrees()			// return number of trees
+{
+	int n = 0;
+	for (int i = 0; i < ANN_DYN_MAX_TREES; i++) {
+		if (trees[i] != NULL) n++;
+	}
+	return n;
+}
+
+//----------------------------------------------------------------------
+//	annkSearch - search for the k nearest neighbors
+//		The buffer is searched as if it were a leaf, and then each tree
+//		is searched (largest first), as in ANNkd_tree::annkSearch(),
+//		all with the same set of closest points.  A tree is skipped if
+//		its bounding box is too far away.
+//----------------------------------------------------------------------
+
+void ANNdynamic_tree::annkSearch(
+	ANNpoint			q,				// the query point
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
+{
+	ANNkdSearchCtx ctx;					// context for this search
+
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.pts = pts;
+	ctx.deleted = deleted;				// skip deleted points
+	ctx.pts_visited = 0;				// initialize count of points visited
+
+	if (k > n_pts) {					// too many near neighbors?
+		annError("Requesting more near neighbors than data points", ANNabort);
+	}
+
+	ctx.max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+
+	ANNsearchScratch *scr = annGetScratch();
+	scr->point_mk.reset(k);				// set for closest k points
+	ctx.point_mk = &scr->point_mk;
+
+	ANNkd_leaf buf_leaf(n_buf, buf);	// search the buffer
+	ctx.pidx = buf;
+	ctx.leaf_pts = NULL;
+	buf_leaf.ann_search(0, ctx);
+
+	for (int i = ANN_DYN_MAX_TREES-1; i >= 0; i--) {
+		ANNkd_tree *t = trees[i];		// search each tree
+		if (t == NULL) continue;
+		ctx.pidx = t->pidx;				// ...and points in leaf order
+		ctx.leaf_pts = (t->leaf_pts != NULL ? t->leaf_pts[0] : NULL);
+		ANNdist box_dist = annBoxDistance(q, t->bnd_box_lo, t->bnd_box_hi, dim);
+		if (box_dist * ctx.max_err < ctx.point_mk->max_key())
+			t->root->ann_search(box_dist, ctx);
+	}
+
+	for (int i = 0; i < k; i++) {		// extract the k-th closest points
+		dd[i] = ctx.point_mk->ith_smallest_key(i);
+		nn_idx[i] = ctx.point_mk->ith_smallest_info(i);
+	}
+	annReleaseScratch(scr);				// done with scratch
+}
+
+//----------------------------------------------------------------------
+//	FRSearch - fixed-radius search of the buffer and the trees
+//		This is used by annkFRSearch() and annRangeSearch(), which set
+//		up the context.  The trees are searched as in
+//		ANNkd_tree::annkFRSearch().  Cells are not counted whole (as
+//		for k = 0 there), since their counts include deleted points.
+//----------------------------------------------------------------------
+
+void ANNdynamic_tree::FRSearch(
+	ANNkdFRSearchCtx	&ctx)			// search context
+{
+	ctx.pts = pts;
+	ctx.deleted = deleted;				// skip deleted points
+
+	ANNkd_leaf buf_leaf(n_buf, buf);	// search the buffer
+	ctx.pidx = buf;
+	ctx.leaf_pts = NULL;
+	buf_leaf.ann_FR_search(0, ctx);
+
+	for (int i = ANN_DYN_MAX_TREES-1; i >= 0; i--) {
+		ANNkd_tree *t = trees[i];		// search each tree
+		if (t == NULL) continue;
+		ctx.pidx = t->pidx;				// ...and points in leaf order
+		ctx.leaf_pts = (t->leaf_pts != NULL ? t->leaf_pts[0] : NULL);
+		ANNdist box_dist = annBoxDistance(ctx.q, t->bnd_box_lo,
+					t->bnd_box_hi, dim);
+		if (box_dist * ctx.max_err <= ctx.sq_rad)
+			t->root->ann_FR_search(box_dist, ctx);
+	}
+}
+
+//----------------------------------------------------------------------
+//	annkFRSearch - fixed radius search for k nearest neighbors
+//----------------------------------------------------------------------
+
+int ANNdynamic_tree::annkFRSearch(
+	ANNpoint			q,				// the query point
+	ANNdist				sqRad,			// squared radius search bound
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
+{
+	ANNkdFRSearchCtx ctx;				// context for this search
+
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.sq_rad = sqRad;
+	ctx.sq_rad_out = sqRad;
+	ctx.pts_visited = 0;				// initialize count of points visited
+	ctx.pts_in_range = 0;				// ...and points in the range
+	ctx.range_idx = NULL;				// (not a range search)
+	ctx.range_dd = NULL;
+	ctx.cell_lo = ctx.cell_hi = NULL;	// (not counting)
+	ctx.cell_stk = NULL;
+
+	ctx.max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+
+	ANNsearchScratch *scr = annGetScratch();
+	scr->point_mk.reset(k);				// set for closest k points
+	ctx.point_mk = &scr->point_mk;
+
+	FRSearch(ctx);						// search buffer and trees
+
+	for (int i = 0; i < k; i++) {		// extract the k-th closest points
+		if (dd != NULL)
+			dd[i] = ctx.point_mk->ith_smallest_key(i);
+		if (nn_idx != NULL)
+			nn_idx[i] = ctx.point_mk->ith_smallest_info(i);
+	}
+
+	annReleaseScratch(scr);				// done with scratch
+	return ctx.pts_in_range;			// return final point count
+}
+
+ANN_NAMESPACE_END
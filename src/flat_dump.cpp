@@ -0,0 +1,318 @@
+//----------------------------------------------------------------------
+// File:			flat_dump.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Binary dump and mapped load of flat trees
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "flat_tree.h"					// flat tree declarations
+
+#ifdef _WIN32							// file mapping
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;					// make std:: available
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	ANN flat tree binary dump format
+//		The file is the header (ANNflatHeader, see flat_tree.h)
+//		followed by these sections, each starting at a multiple of
+//		ANN_FLAT_ALIGN bytes from the start of the file (the gaps are
+//		filled with zeros).  All values are in the machine's format.
+//
+//		Section		Contents
+//		-------		--------
+//		box			lower, then upper, end of the bounding box (2*dim
+//					coordinates)
+//		pts			coordinates of points 0 through n_arr-1 (n_arr*dim
+//					coordinates), where n_arr is one more than the
+//					largest point index in the tree
+//		nodes		the nodes (n_nodes of ANNflatNode)
+//		pidx		the point indices (n_idx of ANNidx)
+//		bnds		the halfspaces (n_bnds of ANNorthHalfSpace)
+//		leaf		the points in leaf order (n_idx*dim coordinates),
+//					if leaf_pts is 1
+//
+//		An empty section has offset 0.  Since the sections are
+//		aligned, and the mapping of the file is aligned to a page, the
+//		arrays of the tree can point straight into the mapping.
+//----------------------------------------------------------------------
+
+const char ANN_FLAT_MAGIC[8] = {'A','N','N','f','l','a','t','\0'};
+
+static long long annFlatAlign(long long off)	// round up to alignment
+{
+	return (off + ANN_FLAT_ALIGN - 1) / ANN_FLAT_ALIGN * ANN_FLAT_ALIGN;
+}
+
+static long long annFlatSection(		// place a section
+	long long			&off,			// end of file so far (modified)
+	long long			size)			// size of section
+{
+	if (size == 0) return 0;			// empty section
+	long long start = annFlatAlign(off);
+	off = start + size;
+	return start;
+}
+
+static void annFlatWrite(				// write a section
+	ostream				&out,			// output stream
+	long long			&pos,			// position in file (modified)
+	long long			off,			// offset of section
+	const void			*data,			// contents
+	long long			size)			// size of section
+{
+	if (size == 0) return;
+	for (; pos < off; pos++) out.put('\0');	// fill the gap
+	out.write((const char *) data, size);
+	pos += size;
+}
+
+//----------------------------------------------------------------------
+//	DumpBinary - write a flat tree as a binary dump
+//----------------------------------------------------------------------
+
+void ANNflat_tree::DumpBinary(
+	ostream				&out)			// output stream (binary mode)
+{
+	int n_idx = 0;						// number of point indices
+	int n_bnds = 0;						// number of halfspaces
+	for (int i = 0; i < n_nodes; i++) {
+		if (nodes[i].kind == ANN_FLAT_LEAF)
+			n_idx += nodes[i].n;
+		else if (nodes[i].kind == ANN_FLAT_SHRINK)
+			n_bnds += nodes[i].n;
+	}
+	int n_arr = 0;						// points needed (max index + 1)
+	for (int j = 0; j < n_idx; j++) {
+		if (pidx[j] >= n_arr) n_arr = pidx[j] + 1;
+	}
+
+	ANNflatHeader hdr;					// fill in the header
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, ANN_FLAT_MAGIC, sizeof(hdr.magic));
+	hdr.version = ANN_FLAT_VERSION;
+	hdr.byte_order = 0x01020304;
+	hdr.coord_size = sizeof(ANNcoord);
+	hdr.idx_size = sizeof(ANNidx);
+	hdr.node_size = sizeof(ANNflatNode);
+	hdr.bnd_size = sizeof(ANNorthHalfSpace);
+	hdr.dim = dim;
+	hdr.n_pts = n_pts;
+	hdr.n_arr = n_arr;
+	hdr.height = height;
+	hdr.n_nodes = n_nodes;
+	hdr.n_idx = n_idx;
+	hdr.n_bnds = n_bnds;
+	hdr.leaf_pts = (leaf_crd != NULL && n_idx > 0 ? 1 : 0);
+
+	long long crd_size = sizeof(ANNcoord);
+	long long pt_size = crd_size * dim;
+	long long off = sizeof(hdr);		// place the sections
+	hdr.off_box = annFlatSection(off, 2 * pt_size);
+	hdr.off_pts = annFlatSection(off, n_arr * pt_size);
+	hdr.off_nodes = annFlatSection(off, n_nodes * (long long) sizeof(ANNflatNode));
+	hdr.off_pidx = annFlatSection(off, n_idx * (long long) sizeof(ANNidx));
+	hdr.off_bnds = annFlatSection(off,
+				n_bnds * (long long) sizeof(ANNorthHalfSpace));
+	hdr.off_leaf = annFlatSection(off, hdr.leaf_pts * n_idx * pt_size);
+	hdr.file_size = off;
+
+	long long pos = 0;					// write them
+	annFlatWrite(out, pos, 0, &hdr, sizeof(hdr));
+	ANNpoint box = annAllocPt(2*dim, 0);
+	if (bnd_box_lo != NULL) {
+		for (int d = 0; d < dim; d++) {
+			box[d] = bnd_box_lo[d];
+			box[dim + d] = bnd_box_hi[d];
+		}
+	}
+	annFlatWrite(out, pos, hdr.off_box, box, 2 * pt_size);
+	annDeallocPt(box);
+	for (int i = 0; i < n_arr; i++) {
+		annFlatWrite(out, pos, hdr.off_pts + i * pt_size, pts[i], pt_size);
+	}
+	annFlatWrite(out, pos, hdr.off_nodes, nodes,
+				n_nodes * (long long) sizeof(ANNflatNode));
+	annFlatWrite(out, pos, hdr.off_pidx, pidx,
+				n_idx * (long long) sizeof(ANNidx));
+	annFlatWrite(out, pos, hdr.off_bnds, bnds,
+				n_bnds * (long long) sizeof(ANNorthHalfSpace));
+	annFlatWrite(out, pos, hdr.off_leaf, leaf_crd,
+				hdr.leaf_pts * n_idx * pt_size);
+}
+
+//----------------------------------------------------------------------
+//	Mapping files
+//		annMapFile maps a whole file (read only), and returns its
+//		address and size, or NULL if this fails (or the file is
+//		empty).  These are also used for reading point files (see
+//		point_file.cpp).
+//----------------------------------------------------------------------
+
+char *annMapFile(				// map a file
+	const char			*file_name,		// name of file
+	size_t				&size)			// size of file (returned)
+{
+#ifdef _WIN32
+	HANDLE fh = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ,
+				NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fh == INVALID_HANDLE_VALUE) return NULL;
+	LARGE_INTEGER sz;
+	if (!GetFileSizeEx(fh, &sz) || sz.QuadPart == 0) {
+		CloseHandle(fh);
+		return NULL;
+	}
+	size = (size_t) sz.QuadPart;
+	HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(fh);					// (the mapping keeps it open)
+	if (mh == NULL) return NULL;
+	void *p = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mh);					// (the view keeps it open)
+	return (char *) p;
+#else
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0) return NULL;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	size = (size_t) st.st_size;
+	void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);							// (the mapping keeps it open)
+	return (p == MAP_FAILED ? NULL : (char *) p);
+#endif
+}
+
+void annUnmapFile(				// unmap a file
+	char				*p,				// address of mapping
+	size_t				size)			// size of file
+{
+#ifdef _WIN32
+	UnmapViewOfFile(p);
+#else
+	munmap(p, size);
+#endif
+}
+
+//----------------------------------------------------------------------
+//	annFlatCheckHeader - check the header of a binary dump
+//		The header must be of this version of the format, made by a
+//		compatible version of ANN, and every section must lie within
+//		the file.  Errors are fatal.
+//----------------------------------------------------------------------
+
+void annFlatCheckHeader(
+	const ANNflatHeader	&hdr,			// the header
+	long long			file_size)		// actual size of file
+{
+	if (memcmp(hdr.magic, ANN_FLAT_MAGIC, sizeof(hdr.magic)) != 0 ||
+		hdr.file_size != file_size) {
+		annError("Incorrect header for binary dump file", ANNabort);
+	}
+	if (hdr.version != ANN_FLAT_VERSION) {
+		annError("Unknown binary dump file version", ANNabort);
+	}
+	if (hdr.byte_order != 0x01020304 ||
+		hdr.coord_size != (int) sizeof(ANNcoord) ||
+		hdr.idx_size != (int) sizeof(ANNidx) ||
+		hdr.node_size != (int) sizeof(ANNflatNode) ||
+		hdr.bnd_size != (int) sizeof(ANNorthHalfSpace)) {
+		annError("Binary dump file made by incompatible version of ANN",
+					ANNabort);
+	}
+										// check the sections
+	long long pt_size = hdr.dim * (long long) sizeof(ANNcoord);
+	long long sect_off[6] = {hdr.off_box, hdr.off_pts, hdr.off_nodes,
+				hdr.off_pidx, hdr.off_bnds, hdr.off_leaf};
+	long long sect_size[6] = {2 * pt_size, hdr.n_arr * pt_size,
+				hdr.n_nodes * (long long) sizeof(ANNflatNode),
+				hdr.n_idx * (long long) sizeof(ANNidx),
+				hdr.n_bnds * (long long) sizeof(ANNorthHalfSpace),
+				hdr.leaf_pts * hdr.n_idx * pt_size};
+	for (int s = 0; s < 6; s++) {
+		if (sect_size[s] < 0 || (sect_size[s] > 0 &&
+			(sect_off[s] % ANN_FLAT_ALIGN != 0 ||
+			 sect_off[s] < (long long) sizeof(hdr) ||
+			 sect_off[s] + sect_size[s] > hdr.file_size))) {
+			annError("Illegal section in binary dump file", ANNabort);
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+//	Load flat tree from binary dump file
+//		This maps the file, checks its header, and points the arrays
+//		of the tree at its sections.  Nothing is read until it is used.
+//		The only thing allocated is the array of pointers to the
+//		points.  Errors in the file are fatal, as for text dumps.
+//----------------------------------------------------------------------
+
+ANNflat_tree::ANNflat_tree(				// load (map) binary dump file
+	const char			*file_name)		// name of file
+{
+	map_base = annMapFile(file_name, map_size);
+	if (map_base == NULL) {
+		annError("Cannot map binary dump file", ANNabort);
+	}
+	ANNflatHeader hdr;
+	if (map_size < sizeof(hdr)) {
+		annError("Incorrect header for binary dump file", ANNabort);
+	}
+	memcpy(&hdr, map_base, sizeof(hdr));
+	annFlatCheckHeader(hdr, (long long) map_size);
+
+	dim = hdr.dim;						// point into the mapping
+	n_pts = hdr.n_pts;
+	height = hdr.height;
+	n_nodes = hdr.n_nodes;
+	nodes = (hdr.off_nodes ? (ANNflatNode *) (map_base + hdr.off_nodes) : NULL);
+	pidx = (hdr.off_pidx ? (ANNidxArray) (map_base + hdr.off_pidx) : NULL);
+	bnds = (hdr.off_bnds ? (ANNorthHalfSpace *) (map_base + hdr.off_bnds) : NULL);
+	bnd_box_lo = (ANNpoint) (map_base + hdr.off_box);
+	bnd_box_hi = bnd_box_lo + dim;
+	leaf_crd = (hdr.off_leaf ? (ANNcoord *) (map_base + hdr.off_leaf) : NULL);
+	pts = NULL;
+	if (hdr.n_arr > 0) {				// pointers to the points
+		ANNcoord *crd = (ANNcoord *) (map_base + hdr.off_pts);
+		pts = new ANNpoint[hdr.n_arr];
+		for (int i = 0; i < hdr.n_arr; i++) {
+			pts[i] = crd + (size_t) i * dim;
+		}
+	}
+}
+
+void ANNflat_tree::Unmap()				// release mapped binary dump
+{
+	if (pts != NULL) delete [] pts;
+	annUnmapFile(map_base, map_size);
+	map_base = NULL;
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,404 @@
+//----------------------------------------------------------------------
+// File:			flat_search.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Searching flat (pointer-free) trees
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "flat_tree.h"					// flat tree declarations
+#include "search_scratch.h"				// per-thread search scratch
+#include "kd_util.h"					// kd-tree utilities
+#include "pr_queue.h"					// priority queue declarations
+#include "pr_queue_k.h"					// k-element priority queue
+#include "dist_kernel.h"				// distance kernels
+
+#include <ANN/ANNperf.h>				// performance evaluation
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Searching flat trees
+//		These are the same algorithms as for kd- and bd-trees (see
+//		kd_search.cpp, kd_pr_search.cpp, kd_fix_rad_search.cpp and the
+//		bd-tree versions), and they make the same decisions in the same
+//		order, but the recursion is replaced by a loop.
+//
+//		In standard and fixed-radius search, the loop descends from a
+//		node to the child to be visited first, after pushing the other
+//		child on a stack, together with its distance from the query
+//		point.  When a leaf is reached, the next node is popped from the
+//		stack.  In the recursive version, whether to visit the second
+//		child of a splitting node is decided after the first child's
+//		subtree has been searched, so this test (flagged by check) is
+//		made when the entry is popped.  The second child of a shrinking
+//		node is always visited.
+//
+//		No more than one entry is pushed for each node on the path from
+//		the root, so the stack never holds more entries than the height
+//		of the tree.  A small stack is allocated locally, and for very
+//		deep trees the stack of the thread's search scratch (see
+//		search_scratch.h) is used instead.
+//----------------------------------------------------------------------
+
+//----------------------------------------------------------------------
+//	annFlatLeaf - search points in a leaf node
+//		This is the same as ANNkd_leaf::ann_search, except that the
+//		bound against which distances are checked depends on the kind
+//		of search.  For kNN search it is the distance to the k-th
+//		closest point (which changes as points are added), and for
+//		fixed-radius search it is the radius.  If leaf_crd is not NULL,
+//		the coordinates of the points are taken from it (in leaf
+//		order) rather than from pts.  Returns the number of points
+//		added.
+//----------------------------------------------------------------------
+
+static inline int annFlatLeaf(
+	const ANNflatNode	&nd,			// the leaf
+	int					dim,			// dimension of space
+	ANNpoint			q,				// query point
+	ANNpointArray		pts,			// the points
+	ANNidxArray			pidx,			// point indices
+	const ANNcoord		*leaf_crd,		// points in leaf order (or NULL)
+	ANNmin_k			*point_mk,		// set of k closest points
+	ANNbool				fr,				// fixed-radius search?
+	ANNdist				sq_rad,			// squared radius (if fr)
+	int					&pts_visited)	// number of points visited
+{
+	int n_in = 0;						// number of points added
+	ANNidxArray bkt = pidx + nd.first;	// the bucket
+										// distance bound
+	ANNdist bound = (fr ? sq_rad : point_mk->max_key());
+	const ANNcoord *lp = NULL;			// points in leaf order (if copied)
+	if (leaf_crd != NULL) lp = leaf_crd + (size_t) nd.first * dim;
+	for (int i = 0; i < nd.n; i++) {	// check points in bucket
+										// distance (if not too far)
+		ANNdist dist = annDistBnd(dim,
+			(lp != NULL ? lp + i*dim : pts[bkt[i]]), q, bound);
+		if (dist <= bound &&					// close enough?
+		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
+												// add it to the list
+			point_mk->insert(dist, bkt[i]);
+			n_in++;
+			if (!fr) bound = point_mk->max_key();
+		}
+	}
+	ANN_LEAF(1)							// one more leaf node visited
+	ANN_PTS(nd.n)						// increment points visited
+	pts_visited += nd.n;				// increment number of points visited
+	return n_in;
+}
+
+//----------------------------------------------------------------------
+//	annFlatInnerDist - distance to the inner box of a shrinking node
+//----------------------------------------------------------------------
+
+static inline ANNdist annFlatInnerDist(
+	const ANNflatNode	&nd,			// the shrinking node
+	const ANNorthHalfSpace *bnds,		// the tree's halfspaces
+	ANNpoint			q)				// query point
+{
+	ANNdist inner_dist = 0;				// distance to inner box
+	const ANNorthHalfSpace *b = bnds + nd.first;
+	for (int i = 0; i < nd.n; i++) {	// is query point in the box?
+		if (b[i].out(q)) {				// outside this bounding side?
+										// add to inner distance
+			inner_dist = (ANNdist) ANN_SUM(inner_dist, b[i].dist(q));
+		}
+	}
+	ANN_FLOP(3*nd.n)					// increment floating ops
+	ANN_SHR(1)							// one more shrinking node
+	return inner_dist;
+}
+
+//----------------------------------------------------------------------
+//	annFlatFarDist - distance to the far child of a splitting node
+//		Also returns the near and far children.
+//----------------------------------------------------------------------
+
+static inline ANNdist annFlatFarDist(
+	const ANNflatNode	&nd,			// the splitting node
+	ANNpoint			q,				// query point
+	ANNdist				box_dist,		// distance to node's box
+	int					&near,			// closer child (returned)
+	int					&far)			// further child (returned)
+{
+	ANNcoord cut_diff = q[nd.kind] - nd.cut_val;
+	ANNcoord box_diff;
+	if (cut_diff < 0) {					// left of cutting plane
+		near = nd.child[ANN_LO];
+		far = nd.child[ANN_HI];
+		box_diff = nd.cd_bnds[ANN_LO] - q[nd.kind];
+	}
+	else {								// right of cutting plane
+		near = nd.child[ANN_HI];
+		far = nd.child[ANN_LO];
+		box_diff = q[nd.kind] - nd.cd_bnds[ANN_HI];
+	}
+	if (box_diff < 0)					// within bounds - ignore
+		box_diff = 0;
+										// distance to further box
+	return (ANNdist) ANN_SUM(box_dist,
+			ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
+}
+
+//----------------------------------------------------------------------
+//	annFlatSearch - standard and fixed-radius search
+//		If fr is true, then this is a fixed-radius search, and the
+//		far child of a splitting node is visited if its box is
+//		within the radius.  Otherwise, it is a kNN search, and the far
+//		child is visited if its box is closer than the k-th closest
+//		point.  The closest points are collected in the point_mk of
+//		the search scratch (which the caller has reset), and the
+//		number of points added is returned.  Paged subtrees are
+//		searched by the pager (see flat_tree.h).
+//----------------------------------------------------------------------
+
+int annFlatSearch(
+	const ANNflatNode	*nodes,			// the nodes
+	int					height,			// height of tree
+	const ANNorthHalfSpace *bnds,		// halfspaces
+	ANNidxArray			pidx,			// point indices
+	ANNpointArray		pts,			// the points
+	const ANNcoord		*leaf_crd,		// points in leaf order (or NULL)
+	int					dim,			// dimension of space
+	ANNpoint			q,				// query point
+	ANNdist				root_dist,		// distance to root box
+	double				max_err,		// max tolerable squared error
+	ANNbool				fr,				// fixed-radius search?
+	ANNdist				sq_rad,			// squared radius (if fr)
+	ANNsearchScratch	*scr,			// search scratch
+	ANNflatPager		*pager,			// pager (or NULL)
+	int					&pts_visited)	// points visited (modified)
+{
+	ANNmin_k *point_mk = &scr->point_mk;// set of k closest points
+	ANNflatStackEnt local_stk[ANN_FLAT_STACK];
+	ANNflatStackEnt *stk = local_stk;
+	if (height >= ANN_FLAT_STACK) {		// deep tree--use scratch stack
+		if ((int) scr->flat_stk.size() < height+1)
+			scr->flat_stk.resize(height+1);
+		stk = &scr->flat_stk[0];
+	}
+	int top = 0;						// stack top
+	int n_in = 0;						// number of points added
+
+	stk[top].node = 0;					// start with the root
+	stk[top].check = ANNfalse;
+	stk[top].box_dist = root_dist;
+	top++;
+	while (top > 0) {
+		top--;							// pop next node
+		ANNdist box_dist = stk[top].box_dist;
+		if (stk[top].check) {			// still close enough?
+			if (fr ? !(box_dist * max_err <= sq_rad)
+						   : !(box_dist * max_err < point_mk->max_key()))
+				continue;
+		}
+		int i = stk[top].node;
+		for (;;) {						// descend to a leaf
+			const ANNflatNode &nd = nodes[i];
+			if (nd.kind == ANN_FLAT_LEAF) {
+				n_in += annFlatLeaf(nd, dim, q, pts, pidx, leaf_crd, point_mk,
+							fr, sq_rad, pts_visited);
+				break;
+			}
+			if (nd.kind == ANN_FLAT_PAGE) {	// search paged subtree
+				n_in += pager->searchPage(nd.first, q, box_dist, max_err,
+							fr, sq_rad, scr, pts_visited);
+				break;
+			}
+										// check dist calc term condition
+			if (ANNmaxPtsVisited != 0 && pts_visited > ANNmaxPtsVisited)
+				break;
+			if (nd.kind == ANN_FLAT_SHRINK) {
+				ANNdist inner_dist = annFlatInnerDist(nd, bnds, q);
+				stk[top].check = ANNfalse;
+				if (inner_dist <= box_dist) {	// inner box is closer
+					stk[top].node = nd.child[ANN_OUT];
+					stk[top].box_dist = box_dist;
+					i = nd.child[ANN_IN];
+					box_dist = inner_dist;
+				}
+				else {							// outer box is closer
+					stk[top].node = nd.child[ANN_IN];
+					stk[top].box_dist = inner_dist;
+					i = nd.child[ANN_OUT];
+				}
+				top++;
+			}
+			else {						// splitting node
+				int near, far;
+				stk[top].box_dist = annFlatFarDist(nd, q, box_dist, near, far);
+				stk[top].node = far;
+				stk[top].check = ANNtrue;
+				top++;
+				i = near;				// visit closer child first
+				ANN_FLOP(fr ? 13 : 10)	// increment floating ops
+				ANN_SPL(1)				// one more splitting node visited
+			}
+		}
+	}
+	return n_in;
+}
+
+//----------------------------------------------------------------------
+//	annkSearch - search for the k nearest neighbors
+//----------------------------------------------------------------------
+
+void ANNflat_tree::annkSearch(
+	ANNpoint			q,				// the query point
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
+{
+	if (k > n_pts) {					// too many near neighbors?
+		annError("Requesting more near neighbors than data points", ANNabort);
+	}
+	double max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+	ANNsearchScratch *scr = annGetScratch();
+	ANNmin_k *point_mk = &scr->point_mk;// set for closest k points
+	point_mk->reset(k);
+	int pts_visited = 0;				// number of points visited
+	if (n_nodes > 0) {
+		annFlatSearch(nodes, height, bnds, pidx, pts,
+				leaf_crd, dim, q,
+				annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim),
+				max_err, ANNfalse, 0, scr, NULL, pts_visited);
+	}
+	for (int i = 0; i < k; i++) {		// extract the k-th closest points
+		dd[i] = point_mk->ith_smallest_key(i);
+		nn_idx[i] = point_mk->ith_smallest_info(i);
+	}
+	annReleaseScratch(scr);				// done with scratch
+}
+
+//----------------------------------------------------------------------
+//	annkFRSearch - fixed-radius search for the k nearest neighbors
+//----------------------------------------------------------------------
+
+int ANNflat_tree::annkFRSearch(
+	ANNpoint			q,				// the query point
+	ANNdist				sqRad,			// squared radius search bound
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
+{
+	double max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+	ANNsearchScratch *scr = annGetScratch();
+	ANNmin_k *point_mk = &scr->point_mk;// set for closest k points
+	point_mk->reset(k);
+	int pts_in_range = 0;				// number of points in range
+	int pts_visited = 0;				// number of points visited
+	if (n_nodes > 0) {
+		pts_in_range = annFlatSearch(nodes, height, bnds, pidx, pts,
+				leaf_crd, dim,
+				q, annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim),
+				max_err, ANNtrue, sqRad, scr, NULL, pts_visited);
+	}
+	for (int i = 0; i < k; i++) {		// extract the k-th closest points
+		if (dd != NULL)
+			dd[i] = point_mk->ith_smallest_key(i);
+		if (nn_idx != NULL)
+			nn_idx[i] = point_mk->ith_smallest_info(i);
+	}
+	annReleaseScratch(scr);				// done with scratch
+	return pts_in_range;				// return final point count
+}
+
+//----------------------------------------------------------------------
+//	annkPriSearch - priority search for k nearest neighbors
+//		Each node taken from the priority queue is searched down to a
+//		leaf, always taking the closer child, and the other children
+//		along the way are enqueued (unless they are trivial leaves).
+//----------------------------------------------------------------------
+
+void ANNflat_tree::annkPriSearch(
+	ANNpoint			q,				// query point
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// dist to near neighbors (returned)
+	double				eps)			// error bound (ignored)
+{
+	double max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating ops
+	int pts_visited = 0;				// number of points visited
+	ANNsearchScratch *scr = annGetScratch();
+	ANNmin_k *point_mk = &scr->point_mk;// set for closest k points
+	point_mk->reset(k);
+	ANNpr_queue *box_pq = &scr->box_pq;	// queue for boxes
+	box_pq->reset(n_pts);
+	if (n_nodes > 0) {					// insert root in priority queue
+		box_pq->insert(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim),
+				(PQinfo) nodes);
+	}
+	while (box_pq->non_empty() &&
+		(!(ANNmaxPtsVisited != 0 && pts_visited > ANNmaxPtsVisited))) {
+		ANNdist box_dist;				// distance to box
+		ANNflatNode *np;				// next box from prior queue
+										// extract closest box from queue
+		box_pq->extr_min(box_dist, (void *&) np);
+		ANN_FLOP(2)						// increment floating ops
+		if (box_dist*max_err >= point_mk->max_key())
+			break;
+		for (;;) {						// search this subtree
+			const ANNflatNode &nd = *np;
+			if (nd.kind == ANN_FLAT_LEAF) {
+				annFlatLeaf(nd, dim, q, pts, pidx, leaf_crd, point_mk,
+						ANNfalse, 0, pts_visited);
+				break;
+			}
+			int near, far;				// closer and further children
+			ANNdist far_dist;			// distance to further child
+			if (nd.kind == ANN_FLAT_SHRINK) {
+				ANNdist inner_dist = annFlatInnerDist(nd, bnds, q);
+				if (inner_dist <= box_dist) {	// inner box is closer
+					near = nd.child[ANN_IN];
+					far = nd.child[ANN_OUT];
+					far_dist = box_dist;
+					box_dist = inner_dist;
+				}
+				else {							// outer box is closer
+					near = nd.child[ANN_OUT];
+					far = nd.child[ANN_IN];
+					far_dist = inner_dist;
+				}
+			}
+			else {						// splitting node
+				far_dist = annFlatFarDist(nd, q, box_dist, near, far);
+				ANN_SPL(1)				// one more splitting node visited
+				ANN_FLOP(8)				// increment floating ops
+			}
+										// enqueue if not trivial
+			if (nodes[far].kind != ANN_FLAT_LEAF || nodes[far].n > 0)
+				box_pq->insert(far_dist, (PQinfo) (nodes + far));
+			np = nodes + near;			// continue with closer child
+		}
+	}
+	for (int i = 0; i < k; i++) {		// extract the k-th closest points
+		dd[i] = point_mk->ith_smallest_key(i);
+		nn_idx[i] = point_mk->ith_smallest_info(i);
+	}
+	annReleaseScratch(scr);				// done with scratch
+}
+
+ANN_NAMESPACE_END
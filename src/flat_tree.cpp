@@ -0,0 +1,263 @@
+//----------------------------------------------------------------------
+// File:			flat_tree.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Construction of flat (pointer-free) trees
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "flat_tree.h"					// flat tree declarations
+#include "kd_tree.h"					// kd-tree declarations
+#include "bd_tree.h"					// bd-tree declarations
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	flatten - convert a node (and its subtree) to flat nodes
+//		Each node appends itself to the builder, then its children,
+//		and returns its own index.  The result is the preorder (DFS)
+//		layout.  The trivial leaf is copied each time it occurs (it
+//		has no points, so this costs only a node).
+//----------------------------------------------------------------------
+
+int ANNkd_split::flatten(ANNflatBuilder &fb)
+{
+	int i = fb.newNode(cut_dim);		// add this node
+	fb.nodes[i].cut_val = cut_val;
+	fb.nodes[i].cd_bnds[ANN_LO] = cd_bnds[ANN_LO];
+	fb.nodes[i].cd_bnds[ANN_HI] = cd_bnds[ANN_HI];
+										// add children
+	int lo = child[ANN_LO]->flatten(fb);
+	int hi = child[ANN_HI]->flatten(fb);
+	fb.nodes[i].child[ANN_LO] = lo;		// (nodes may have moved)
+	fb.nodes[i].child[ANN_HI] = hi;
+	return i;
+}
+
+int ANNkd_leaf::flatten(ANNflatBuilder &fb)
+{
+	int i = fb.newNode(ANN_FLAT_LEAF);	// add this node
+	int first = (int) fb.idx.size();
+	for (int j = 0; j < n_pts; j++) {	// add its (undeleted) points
+		if (!annIsDeleted(fb.deleted, bkt[j]))
+			fb.idx.push_back(bkt[j]);
+	}
+	fb.nodes[i].n = (int) fb.idx.size() - first;
+	fb.nodes[i].first = first;
+	return i;
+}
+
+int ANNbd_shrink::flatten(ANNflatBuilder &fb)
+{
+	int i = fb.newNode(ANN_FLAT_SHRINK);// add this node
+	fb.nodes[i].n = n_bnds;
+	fb.nodes[i].first = (int) fb.bnds.size();
+	for (int j = 0; j < n_bnds; j++) {	// add its halfspaces
+		fb.bnds.push_back(bnds[j]);
+	}
+										// add children
+	int in = child[ANN_IN]->flatten(fb);
+	int out = child[ANN_OUT]->flatten(fb);
+	fb.nodes[i].child[ANN_IN] = in;		// (nodes may have moved)
+	fb.nodes[i].child[ANN_OUT] = out;
+	return i;
+}
+
+//----------------------------------------------------------------------
+//	van Emde Boas layout
+//		To lay out the top h levels of the subtree rooted at node i,
+//		we lay out its top h/2 levels (recursively), and then each of
+//		the subtrees rooted at depth h/2 below i (recursively, with h -
+//		h/2 levels each).  Applying this to the whole tree (with h
+//		equal to its height) lists every node once.  Unlike the usual
+//		description, our trees need not be balanced, and so subtrees
+//		may end (in leaves) above the given depth.
+//----------------------------------------------------------------------
+
+static int annFlatHeight(				// height of subtree
+	const std::vector<ANNflatNode> &nd,	// the nodes
+	int					i)				// root of subtree
+{
+	if (nd[i].kind == ANN_FLAT_LEAF) return 1;
+	int h0 = annFlatHeight(nd, nd[i].child[0]);
+	int h1 = annFlatHeight(nd, nd[i].child[1]);
+	return 1 + (h0 > h1 ? h0 : h1);
+}
+
+static void annFlatFrontier(			// nodes at given depth below i
+	const std::vector<ANNflatNode> &nd,	// the nodes
+	int					i,				// root of subtree
+	int					depth,			// the depth
+	std::vector<int>	&front)			// the nodes (appended)
+{
+	if (depth == 0) {
+		front.push_back(i);
+	}
+	else if (nd[i].kind != ANN_FLAT_LEAF) {
+		annFlatFrontier(nd, nd[i].child[0], depth-1, front);
+		annFlatFrontier(nd, nd[i].child[1], depth-1, front);
+	}
+}
+
+static void annFlatVeb(					// van Emde Boas order
+	const std::vector<ANNflatNode> &nd,	// the nodes
+	int					i,				// root of subtree
+	int					h,				// number of levels to lay out
+	std::vector<int>	&order)			// the order (appended)
+{
+	if (h <= 1 || nd[i].kind == ANN_FLAT_LEAF) {
+		order.push_back(i);
+		return;
+	}
+	int h_top = h/2;					// levels in top part
+	annFlatVeb(nd, i, h_top, order);	// lay out top part
+	std::vector<int> front;				// roots of bottom parts
+	annFlatFrontier(nd, i, h_top, front);
+	for (size_t j = 0; j < front.size(); j++) {
+		annFlatVeb(nd, front[j], h - h_top, order);
+	}
+}
+
+//----------------------------------------------------------------------
+//	Compile - convert a kd- or bd-tree into a flat tree
+//		The tree is first flattened in preorder, and then (for the
+//		van Emde Boas layout) the nodes are permuted and their child
+//		indices renumbered.  The root is first in both layouts.  Points
+//		deleted from the tree are left out of the flat tree.  If
+//		copy_pts is true (or the tree has its own copy), the points are
+//		copied in the order of the point index array, so that the
+//		points of each leaf are contiguous.
+//----------------------------------------------------------------------
+
+void ANNflat_tree::Compile(
+	ANNkd_tree			&tree,			// the tree
+	ANNflatLayout		layout,			// node layout
+	ANNbool				copy_pts)		// copy points to leaf order?
+{
+	dim = tree.dim;						// copy basic information
+	n_pts = tree.n_pts - tree.n_deleted;
+	pts = tree.pts;
+	height = 0;
+	n_nodes = 0;
+	nodes = NULL;
+	pidx = NULL;
+	bnds = NULL;
+	leaf_crd = NULL;
+	bnd_box_lo = bnd_box_hi = NULL;
+	map_base = NULL;
+	map_size = 0;
+
+	if (tree.root == NULL) return;		// empty tree--nothing more
+
+	bnd_box_lo = annCopyPt(dim, tree.bnd_box_lo);
+	bnd_box_hi = annCopyPt(dim, tree.bnd_box_hi);
+
+	ANNflatBuilder fb;					// flatten in preorder
+	fb.deleted = tree.deleted;			// (leaving out deleted points)
+	tree.root->flatten(fb);
+	height = annFlatHeight(fb.nodes, 0);
+	n_nodes = (int) fb.nodes.size();
+
+	nodes = new ANNflatNode[n_nodes];	// copy nodes in layout order
+	if (layout == ANN_FLAT_VEB) {
+		std::vector<int> order;			// new order of nodes
+		order.reserve(n_nodes);
+		annFlatVeb(fb.nodes, 0, height, order);
+		std::vector<int> pos(n_nodes);	// new position of each node
+		for (int i = 0; i < n_nodes; i++) {
+			pos[order[i]] = i;
+		}
+		for (int i = 0; i < n_nodes; i++) {
+			nodes[i] = fb.nodes[order[i]];
+			if (nodes[i].kind != ANN_FLAT_LEAF) {
+				nodes[i].child[0] = pos[nodes[i].child[0]];
+				nodes[i].child[1] = pos[nodes[i].child[1]];
+			}
+		}
+	}
+	else {
+		for (int i = 0; i < n_nodes; i++) {
+			nodes[i] = fb.nodes[i];
+		}
+	}
+
+	pidx = new ANNidx[fb.idx.size() + 1];	// copy point indices
+	for (size_t j = 0; j < fb.idx.size(); j++) {
+		pidx[j] = fb.idx[j];
+	}
+	bnds = new ANNorthHalfSpace[fb.bnds.size() + 1];	// copy halfspaces
+	for (size_t j = 0; j < fb.bnds.size(); j++) {
+		bnds[j] = fb.bnds[j];
+	}
+
+	if ((copy_pts || tree.leaf_pts != NULL) && !fb.idx.empty()) {
+		int n_idx = (int) fb.idx.size();	// copy points to leaf order
+		leaf_crd = new ANNcoord[(size_t) n_idx * dim];
+		for (int j = 0; j < n_idx; j++) {
+			for (int d = 0; d < dim; d++) {
+				leaf_crd[(size_t) j*dim + d] = pts[pidx[j]][d];
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+//	Flat tree constructors and destructor
+//		The constructor from a point array just builds a bd-tree (which
+//		is a kd-tree if there is no shrinking), compiles it, and then
+//		deletes it.
+//----------------------------------------------------------------------
+
+ANNflat_tree::ANNflat_tree(				// build from a kd- or bd-tree
+	ANNkd_tree			&tree,			// the tree
+	ANNflatLayout		layout,			// node layout
+	ANNbool				copy_pts)		// copy points to leaf order?
+{
+	Compile(tree, layout, copy_pts);
+}
+
+ANNflat_tree::ANNflat_tree(				// build from point array
+	ANNpointArray		pa,				// point array
+	int					n,				// number of points
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		split,			// splitting rule
+	ANNshrinkRule		shrink,			// shrinking rule
+	ANNflatLayout		layout,			// node layout
+	ANNbool				copy_pts)		// copy points to leaf order?
+{
+	ANNbd_tree tree(pa, n, dd, bs, split, shrink);
+	Compile(tree, layout, copy_pts);
+}
+
+ANNflat_tree::~ANNflat_tree()			// tree destructor
+{
+	if (map_base != NULL) {				// mapped from a binary dump
+		Unmap();
+		return;
+	}
+	if (nodes != NULL) delete [] nodes;
+	if (pidx != NULL) delete [] pidx;
+	if (bnds != NULL) delete [] bnds;
+	if (leaf_crd != NULL) delete [] leaf_crd;
+	if (bnd_box_lo != NULL) annDeallocPt(bnd_box_lo);
+	if (bnd_box_hi != NULL) annDeallocPt(bnd_box_hi);
+}
+
+ANN_NAMESPACE_END
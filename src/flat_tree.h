@@ -0,0 +1,202 @@
+//----------------------------------------------------------------------
+// File:			flat_tree.h
+// Programmer:		Sunil Arya and David Mount
+// Description:		Declarations for flat (pointer-free) trees
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#ifndef ANN_flat_tree_H
+#define ANN_flat_tree_H
+
+#include <vector>						// node arrays (for building)
+#include <ANN/ANNx.h>					// all ANN includes
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Flat tree nodes
+//		A flat tree stores all of its nodes in a single array, and
+//		refers to nodes by their index in this array.  There is just
+//		one node type, which is used for all three kinds of nodes of
+//		kd- and bd-trees.  The field kind tells which it is:
+//
+//		kind >= 0			Splitting node.  kind is the cutting
+//							dimension, and cut_val, cd_bnds, and child
+//							are as in ANNkd_split.
+//		ANN_FLAT_LEAF		Leaf node.  Its n points are given by
+//							entries first through first+n-1 of the
+//							tree's point index array.  The trivial
+//							leaf (KD_TRIVIAL) has n = 0.
+//		ANN_FLAT_SHRINK		Shrinking node.  Its n bounding halfspaces
+//							are entries first through first+n-1 of the
+//							tree's halfspace array, and child[ANN_IN]
+//							and child[ANN_OUT] are its children.
+//		ANN_FLAT_PAGE		Paged subtree (only in the top levels of a
+//							paged tree, see paged_tree.cpp).  first is
+//							the number of the page holding the subtree.
+//
+//		The root is always node 0.
+//----------------------------------------------------------------------
+
+const int ANN_FLAT_LEAF		= -1;		// kind for leaf nodes
+const int ANN_FLAT_SHRINK	= -2;		// kind for shrinking nodes
+const int ANN_FLAT_PAGE		= -3;		// kind for paged subtrees
+
+class ANNflatNode {						// node of a flat tree
+public:
+	int					kind;			// cutting dim or node type
+	int					n;				// no. of points or halfspaces
+	int					first;			// first point or halfspace
+	int					child[2];		// children
+	ANNcoord			cut_val;		// location of cutting plane
+	ANNcoord			cd_bnds[2];		// bounds along cut_dim
+};
+
+//----------------------------------------------------------------------
+//	Flat tree search stack
+//		The iterative searches (see flat_search.cpp) keep the nodes
+//		still to be visited on a stack of these entries.  Stacks of up
+//		to ANN_FLAT_STACK entries are allocated locally.
+//----------------------------------------------------------------------
+
+const int ANN_FLAT_STACK = 64;			// size of local stack
+
+class ANNflatStackEnt {					// search stack entry
+public:
+	int					node;			// node index
+	ANNbool				check;			// check distance before visiting?
+	ANNdist				box_dist;		// distance to node's box
+};
+
+//----------------------------------------------------------------------
+//	Binary dump header
+//		A binary dump (see flat_dump.cpp) begins with this header.  The
+//		sections follow it, each at the given offset from the start
+//		of the file (a multiple of ANN_FLAT_ALIGN).
+//----------------------------------------------------------------------
+
+const int ANN_FLAT_VERSION	= 1;		// binary dump format version
+const int ANN_FLAT_ALIGN	= 64;		// alignment of sections
+
+class ANNflatHeader {					// header of binary dump
+public:
+	char				magic[8];		// "ANNflat" (with null)
+	int					version;		// format version
+	int					byte_order;		// 0x01020304 (in machine order)
+	int					coord_size;		// sizeof(ANNcoord)
+	int					idx_size;		// sizeof(ANNidx)
+	int					node_size;		// sizeof(ANNflatNode)
+	int					bnd_size;		// sizeof(ANNorthHalfSpace)
+	int					dim;			// dimension of space
+	int					n_pts;			// number of points in tree
+	int					n_arr;			// number of points in file
+	int					height;			// height of tree
+	int					n_nodes;		// number of nodes
+	int					n_idx;			// number of point indices
+	int					n_bnds;			// number of halfspaces
+	int					leaf_pts;		// points in leaf order? (0 or 1)
+	long long			off_box;		// bounding box (lo, then hi)
+	long long			off_pts;		// points (n_arr of them)
+	long long			off_nodes;		// nodes
+	long long			off_pidx;		// point indices
+	long long			off_bnds;		// halfspaces
+	long long			off_leaf;		// points in leaf order (n_idx)
+	long long			file_size;		// size of file
+};
+
+void annFlatCheckHeader(				// check binary dump header
+	const ANNflatHeader	&hdr,			// the header
+	long long			file_size);		// actual size of file
+
+//----------------------------------------------------------------------
+//	Flat tree search
+//		annFlatSearch (see flat_search.cpp) does standard and
+//		fixed-radius search on the nodes of a flat tree.  When it
+//		reaches a paged subtree, it calls the searchPage() function of
+//		the pager, which searches the subtree (with annFlatSearch) and
+//		returns the number of points added.  The number of points
+//		visited is carried through pts_visited, so that the limit
+//		ANNmaxPtsVisited applies to the search as a whole.
+//----------------------------------------------------------------------
+
+class ANNsearchScratch;					// per-thread search scratch
+
+class ANNflatPager {					// searches paged subtrees
+public:
+	virtual ~ANNflatPager() {}
+	virtual int searchPage(				// search a page
+		int				page,			// page number
+		ANNpoint		q,				// query point
+		ANNdist			box_dist,		// distance to subtree's box
+		double			max_err,		// max tolerable squared error
+		ANNbool			fr,				// fixed-radius search?
+		ANNdist			sq_rad,			// squared radius (if fr)
+		ANNsearchScratch *scr,			// search scratch
+		int				&pts_visited) = 0;	// points visited (modified)
+};
+
+int annFlatSearch(						// standard or fixed-radius search
+	const ANNflatNode	*nodes,			// the nodes
+	int					height,			// height of tree
+	const ANNorthHalfSpace *bnds,		// halfspaces
+	ANNidxArray			pidx,			// point indices
+	ANNpointArray		pts,			// the points
+	const ANNcoord		*leaf_crd,		// points in leaf order (or NULL)
+	int					dim,			// dimension of space
+	ANNpoint			q,				// query point
+	ANNdist				root_dist,		// distance to root box
+	double				max_err,		// max tolerable squared error
+	ANNbool				fr,				// fixed-radius search?
+	ANNdist				sq_rad,			// squared radius (if fr)
+	ANNsearchScratch	*scr,			// search scratch
+	ANNflatPager		*pager,			// pager (or NULL)
+	int					&pts_visited);	// points visited (modified)
+
+//----------------------------------------------------------------------
+//	Flat tree builder
+//		This collects the contents of a flat tree while a kd- or bd-tree
+//		is being converted.  Each node of the source tree appends itself
+//		and its subtree (in preorder) through the virtual function
+//		flatten(), which returns the index of the node.  Points which
+//		have been deleted from the source tree are left out.
+//----------------------------------------------------------------------
+
+class ANNflatBuilder {
+public:
+	std::vector<ANNflatNode>		nodes;	// the nodes
+	std::vector<ANNidx>				idx;	// point indices
+	std::vector<ANNorthHalfSpace>	bnds;	// halfspaces
+	const ANNmark				*deleted;	// deleted points (or NULL)
+
+	int newNode(int kind)				// append a new node
+		{
+			ANNflatNode nd;
+			nd.kind = kind;
+			nd.n = nd.first = 0;
+			nd.child[0] = nd.child[1] = 0;
+			nd.cut_val = nd.cd_bnds[0] = nd.cd_bnds[1] = 0;
+			nodes.push_back(nd);
+			return (int) nodes.size() - 1;
+		}
+};
+
+ANN_NAMESPACE_END
+
+#endif
@@ -0,0 +1,240 @@
+//----------------------------------------------------------------------
+// File:			kd_allknn.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		All k-nearest neighbors of the points of a kd-tree
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "kd_allknn.h"					// all-kNN declarations
+#include "dist_kernel.h"				// distance kernels
+#include "thread_pool.h"				// parallel loops
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	All k-nearest neighbors (self join)
+//		annAllkNN() computes the k nearest neighbors of every data
+//		point of the tree.  Rather than searching from the root once
+//		for each point, it takes the points in the order of the point
+//		index array, in which the points of each subtree are
+//		consecutive, and so groups of consecutive points are close
+//		together.  The points of a group are searched for together,
+//		in a single traversal of the tree.
+//
+//		The traversal follows that of the standard search (see
+//		kd_search.cpp) for each point of the group at once.  The
+//		distance from each point to the cell of the current node is
+//		maintained incrementally, just as in the standard search, and
+//		a node is visited if it would be visited by the standard search
+//		for some point of the group.  In a leaf, the points of the
+//		leaf are compared only with those points of the group for
+//		which the leaf would be visited.  So each point gets the same
+//		guarantee as with annkSearch(), but the nodes near the group
+//		(which are visited for most of its points) are visited just
+//		once, and the points of the group share the cost of finding
+//		them.
+//
+//		The groups are divided among the threads of the ANN thread
+//		pool (see thread_pool.h).  The results for data point i are
+//		stored in entries i*k through i*k+k-1 of nn_idx and dd.
+//
+//		Points deleted from the tree are skipped, both as neighbors
+//		and as points of the groups.  (So no search is done for them,
+//		and their entries are set to ANN_NULL_IDX and ANN_DIST_INF.)
+//----------------------------------------------------------------------
+
+void ANNkd_tree::annAllkNN(
+	int					k,				// number of near neighbors per point
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps,			// error bound
+	ANNbool				self,			// may a point be its own neighbor?
+	int					n_threads)		// number of threads (<= 0 for all)
+{
+	if (k > (self ? n_pts : n_pts-1)) {	// too many near neighbors?
+		annError("Requesting more near neighbors than data points", ANNabort);
+	}
+	if (k <= 0) return;					// nothing to do
+
+	int n_grps = (n_pts + ANN_GROUP_SIZE - 1) / ANN_GROUP_SIZE;
+	double max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+
+	annParallelFor(n_grps, n_threads, [&](int g_lo, int g_hi) {
+		ANNmin_k *mk[ANN_GROUP_SIZE];	// sets of k closest points
+		for (int j = 0; j < ANN_GROUP_SIZE; j++) {
+			mk[j] = new ANNmin_k(k);
+		}
+		ANNkdGroupCtx ctx;				// context for these searches
+		ctx.dim = dim;
+		ctx.pts = pts;
+		ctx.pidx = pidx;
+		ctx.leaf_pts = (leaf_pts != NULL ? leaf_pts[0] : NULL);
+		ctx.deleted = deleted;
+		ctx.max_err = max_err;
+		ctx.self = self;
+		ctx.point_mk = mk;
+		ANNdist box_dist[ANN_GROUP_SIZE];	// distances to root box
+		int act[ANN_GROUP_SIZE];		// points active at root
+
+		for (int g = g_lo; g < g_hi; g++) {	// search for each group
+			ctx.first = g * ANN_GROUP_SIZE;
+			ctx.n_grp = n_pts - ctx.first;
+			if (ctx.n_grp > ANN_GROUP_SIZE) ctx.n_grp = ANN_GROUP_SIZE;
+			ctx.pts_visited = 0;
+			int n_act = 0;				// number active at root
+			int j;
+			for (j = 0; j < ctx.n_grp; j++) {	// initialize each point
+				ANNpoint q = (leaf_pts != NULL ? leaf_pts[ctx.first+j]
+							: pts[pidx[ctx.first+j]]);
+				ctx.grp_pts[j] = q;
+				mk[j]->reset(k);
+				ctx.kth[j] = mk[j]->max_key();
+				box_dist[j] = annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim);
+				if (!annIsDeleted(deleted, pidx[ctx.first+j]))
+					act[n_act++] = j;	// (unless deleted)
+			}
+			if (n_act > 0)				// search starting at the root
+				root->ann_group_search(n_act, act, box_dist, ctx);
+
+			for (j = 0; j < ctx.n_grp; j++) {	// extract the results
+				ANNidx *idx = nn_idx + (size_t) pidx[ctx.first+j]*k;
+				ANNdist *dst = dd + (size_t) pidx[ctx.first+j]*k;
+				for (int i = 0; i < k; i++) {
+					dst[i] = mk[j]->ith_smallest_key(i);
+					idx[i] = mk[j]->ith_smallest_info(i);
+				}
+			}
+		}
+
+		for (int j = 0; j < ANN_GROUP_SIZE; j++) {
+			delete mk[j];
+		}
+	});
+}
+
+//----------------------------------------------------------------------
+//	kd_split::ann_group_search - search a splitting node
+//		As in the standard search, the distance from a point to the
+//		child on its side of the cutting plane is the same as to this
+//		node, and the distance to the other child is updated along
+//		the cutting dimension.  The child on the side of most of the
+//		active points is visited first, and each child is visited
+//		only if some point is active there.
+//----------------------------------------------------------------------
+
+void ANNkd_split::ann_group_search(
+	int					n_act,			// number of active points
+	int					*act,			// the active points
+	ANNdist				*box_dist,		// their distances to this cell
+	ANNkdGroupCtx		&ctx)			// search context
+{
+	ANNdist lo_dist[ANN_GROUP_SIZE];	// distances to low child
+	ANNdist hi_dist[ANN_GROUP_SIZE];	// distances to high child
+	int child_act[ANN_GROUP_SIZE];		// points active at child
+	int n_lo = 0;						// active points on low side
+
+	for (int a = 0; a < n_act; a++) {
+		int j = act[a];
+		ANNcoord qc = ctx.grp_pts[j][cut_dim];
+		ANNcoord cut_diff = qc - cut_val;	// distance to cutting plane
+		ANNcoord box_diff;
+		if (cut_diff < 0) {				// left of cutting plane
+			box_diff = cd_bnds[ANN_LO] - qc;
+			if (box_diff < 0) box_diff = 0;
+			lo_dist[j] = box_dist[j];
+			hi_dist[j] = (ANNdist) ANN_SUM(box_dist[j],
+					ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
+			n_lo++;
+		}
+		else {							// right of cutting plane
+			box_diff = qc - cd_bnds[ANN_HI];
+			if (box_diff < 0) box_diff = 0;
+			hi_dist[j] = box_dist[j];
+			lo_dist[j] = (ANNdist) ANN_SUM(box_dist[j],
+					ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
+		}
+	}
+	ANN_FLOP(10*n_act)					// increment floating ops
+	ANN_SPL(1)							// one more splitting node visited
+
+	int n_child;						// number active at child
+	if (2*n_lo >= n_act) {				// visit low child first
+		n_child = annGroupActive(n_act, act, lo_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_LO]->ann_group_search(n_child, child_act, lo_dist, ctx);
+		n_child = annGroupActive(n_act, act, hi_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_HI]->ann_group_search(n_child, child_act, hi_dist, ctx);
+	}
+	else {								// visit high child first
+		n_child = annGroupActive(n_act, act, hi_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_HI]->ann_group_search(n_child, child_act, hi_dist, ctx);
+		n_child = annGroupActive(n_act, act, lo_dist, ctx, child_act);
+		if (n_child > 0)
+			child[ANN_LO]->ann_group_search(n_child, child_act, lo_dist, ctx);
+	}
+}
+
+//----------------------------------------------------------------------
+//	kd_leaf::ann_group_search - search points in a leaf node
+//		The points of the leaf are compared with each active point of
+//		the group, using the distance kernel as in the standard search.
+//----------------------------------------------------------------------
+
+void ANNkd_leaf::ann_group_search(
+	int					n_act,			// number of active points
+	int					*act,			// the active points
+	ANNdist				*box_dist,		// their distances to this cell
+	ANNkdGroupCtx		&ctx)			// search context
+{
+	int dim = ctx.dim;
+	const ANNcoord *lp = NULL;			// points in leaf order (if copied)
+	if (ctx.leaf_pts != NULL && n_pts > 0)
+		lp = ctx.leaf_pts + (size_t) (bkt - ctx.pidx) * dim;
+
+	for (int a = 0; a < n_act; a++) {	// for each active point
+		int j = act[a];
+		ANNdist min_dist = ctx.kth[j];	// k-th smallest distance so far
+		ANNmin_k *mk = ctx.point_mk[j];
+		const ANNcoord *q = ctx.grp_pts[j];
+		ANNidx q_idx = (ctx.self ? ANN_NULL_IDX : ctx.pidx[ctx.first+j]);
+
+		for (int i = 0; i < n_pts; i++) {	// check points in bucket
+			if (annIsDeleted(ctx.deleted, bkt[i]))
+				continue;				// skip deleted points
+										// distance (if not too far)
+			ANNdist dist = annDistBnd(dim,
+				(lp != NULL ? lp + i*dim : ctx.pts[bkt[i]]), q, min_dist);
+
+			if (dist <= min_dist && bkt[i] != q_idx) {	// among k best?
+				mk->insert(dist, bkt[i]);
+				min_dist = mk->max_key();
+			}
+		}
+		ctx.kth[j] = min_dist;
+	}
+	ANN_LEAF(1)							// one more leaf node visited
+	ANN_PTS(n_pts * n_act)				// increment points visited
+	ctx.pts_visited += n_pts * n_act;	// increment number of points visited
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,103 @@
+//----------------------------------------------------------------------
+// File:			kd_allknn.h
+// Programmer:		Sunil Arya and David Mount
+// Description:		All k-nearest neighbors of the points of a tree
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#ifndef ANN_kd_allknn_H
+#define ANN_kd_allknn_H
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "kd_util.h"					// kd-tree utilities
+#include "pr_queue_k.h"					// k-element priority queue
+
+#include <ANN/ANNperf.h>				// performance evaluation
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Group size
+//		annAllkNN() searches for the neighbors of a group of up to
+//		ANN_GROUP_SIZE consecutive points (in the order of the tree's
+//		point index array) at once.
+//----------------------------------------------------------------------
+
+const int ANN_GROUP_SIZE	= 16;		// max points in a group
+
+//----------------------------------------------------------------------
+//	Group search context
+//		This holds the state of the search for the neighbors of one
+//		group of points.  The points are the entries first through
+//		first+n_grp-1 of the point index array.  Each point has its
+//		own set of k closest points, and kth holds their current k-th
+//		smallest distances.
+//
+//		Each node is passed a list of the points of the group which
+//		are active there, and an array with the distance from each of
+//		them to the node's cell.  A point is active at a node if this
+//		distance, multiplied by max_err, is less than its k-th smallest
+//		distance (that is, if the standard search would visit the node
+//		for this point).  A node is visited only if some point is
+//		active there.
+//----------------------------------------------------------------------
+
+class ANNkdGroupCtx {
+public:
+	int					dim;			// dimension of space
+	ANNpointArray		pts;			// the points
+	ANNidxArray			pidx;			// the point indices
+	ANNcoord			*leaf_pts;		// points in leaf order (or NULL)
+	const ANNmark		*deleted;		// deleted points (or NULL)
+	double				max_err;		// max tolerable squared error
+	ANNbool				self;			// may a point be its own neighbor?
+	int					first;			// first index of group
+	int					n_grp;			// number of points in group
+	ANNpoint			grp_pts[ANN_GROUP_SIZE];	// the group's points
+	ANNmin_k			**point_mk;		// their sets of k closest points
+	ANNdist				kth[ANN_GROUP_SIZE];	// their k-th smallest dists
+	int					pts_visited;	// number of points visited
+};
+
+//----------------------------------------------------------------------
+//	annGroupActive - list the points of the group active at a node
+//		Given the list of points active at the parent (act, with n_act
+//		entries) and the distances to the node's cell, this stores the
+//		ones active at the node in new_act, and returns their number.
+//----------------------------------------------------------------------
+
+inline int annGroupActive(				// list the active points
+	int					n_act,			// number active at parent
+	const int			*act,			// points active at parent
+	const ANNdist		*box_dist,		// distances to node's cell
+	const ANNkdGroupCtx	&ctx,			// the group
+	int					*new_act)		// points active at node (returned)
+{
+	int n_new = 0;
+	for (int a = 0; a < n_act; a++) {
+		int j = act[a];
+		if (box_dist[j] * ctx.max_err < ctx.kth[j]) new_act[n_new++] = j;
+	}
+	return n_new;
+}
+
+ANN_NAMESPACE_END
+
+#endif
@@ -23,6 +23,9 @@
 //	Revision 1.0  04/01/05
 //		Moved dump out of kd_tree.cc into this file.
 //		Added kd-tree load constructor.
+//	Revision 1.2  10/17/26
+//		Added leaf_pts flag for trees with points in leaf order
+//		Added compressed dumps (DumpCompressed)
 //----------------------------------------------------------------------
 // This file contains routines for dumping kd-trees and bd-trees and
 // reloading them. (It is an abuse of policy to include both kd- and
@@ -34,8 +37,13 @@
 #include "kd_tree.h"					// kd-tree declarations
 #include "bd_tree.h"					// bd-tree declarations
 
+#include <climits>						// INT_MAX
+#include <cstring>						// memcpy
+
 using namespace std;					// make std:: available
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //		Constants
 //----------------------------------------------------------------------
@@ -58,7 +66,8 @@ static ANNkd_ptr annReadDump(			// read dump file
 	int					&the_n_pts,				// number of points (returned)
 	int					&the_bkt_size,			// bucket size (returned)
 	ANNpoint			&the_bnd_box_lo,		// low bounding point
-	ANNpoint			&the_bnd_box_hi);		// high bounding point
+	ANNpoint			&the_bnd_box_hi,		// high bounding point
+	ANNbool				&the_leaf_pts);			// copy pts to leaf order?
 
 static ANNkd_ptr annReadTree(			// read tree-part of dump file
 	istream				&in,					// input stream
@@ -66,6 +75,18 @@ static ANNkd_ptr annReadTree(			// read tree-part of dump file
 	ANNidxArray			the_pidx,				// point indices (modified)
 	int					&next_idx);				// next index (modified)
 
+static ANNkd_ptr annReadZDump(			// read compressed dump
+	istream				&in,					// input stream
+	ANNtreeType			tree_type,				// type of tree expected
+	ANNpointArray		&the_pts,				// new points (returned)
+	ANNidxArray			&the_pidx,				// point indices (returned)
+	int					&the_dim,				// dimension (returned)
+	int					&the_n_pts,				// number of points (returned)
+	int					&the_bkt_size,			// bucket size (returned)
+	ANNpoint			&the_bnd_box_lo,		// low bounding point
+	ANNpoint			&the_bnd_box_hi,		// high bounding point
+	ANNbool				&the_leaf_pts);			// copy pts to leaf order?
+
 //----------------------------------------------------------------------
 //	ANN kd- and bd-tree Dump Format
 //		The dump file begins with a header containing the version of
@@ -78,9 +99,13 @@ static ANNkd_ptr annReadTree(			// read tree-part of dump file
 //		0 <xxx> <xxx> ... <xxx>			(point indices and coordinates)
 //		1 <xxx> <xxx> ... <xxx>
 //		  ...
-//		tree <dim> <n_pts> <bkt_size>
+//		tree <dim> <n_pts> <bkt_size> [leaf_pts]
 //		<xxx> <xxx> ... <xxx>			(lower end of bounding box)
 //		<xxx> <xxx> ... <xxx>			(upper end of bounding box)
+//				The optional word leaf_pts indicates that the tree
+//				keeps a copy of the points in leaf order.  (The copy
+//				itself is not dumped, but is made again from the
+//				points when the tree is loaded.)
 //				If the tree is null, then a single line "null" is
 //				output.	 Otherwise the nodes of the tree are printed
 //				one per line in preorder.  Leaves and splitting nodes 
@@ -116,7 +141,10 @@ void ANNkd_tree::Dump(					// dump entire tree
 	out << "tree "						// print tree elements
 		<< dim << " "
 		<< n_pts << " "
-		<< bkt_size << "\n";
+		<< bkt_size;
+	if (leaf_pts != NULL)				// points copied to leaf order
+		out << " leaf_pts";
+	out << "\n";
 
 	annPrintPt(bnd_box_lo, dim, out);	// print lower bound
 	out << "\n";
@@ -180,7 +208,8 @@ void ANNbd_shrink::dump(				// dump a shrinking node
 //		tree.  When the tree is destroyed, all but the points are
 //		deallocated.
 //
-//		This routine calls annReadDump to do all the work.
+//		This routine calls annReadDump to do all the work.  Dumps
+//		written by DumpCompressed are also accepted.
 //----------------------------------------------------------------------
 
 ANNkd_tree::ANNkd_tree(					// build from dump file
@@ -194,6 +223,7 @@ ANNkd_tree::ANNkd_tree(					// build from dump file
 	ANNpointArray the_pts;						// point storage
 	ANNidxArray the_pidx;						// point index storage
 	ANNkd_ptr the_root;							// root of the tree
+	ANNbool the_leaf_pts;						// copy points to leaf order?
 
 	the_root = annReadDump(						// read the dump file
 		in,										// input stream
@@ -201,7 +231,8 @@ ANNkd_tree::ANNkd_tree(					// build from dump file
 		the_pts,								// point array (returned)
 		the_pidx,								// point indices (returned)
 		the_dim, the_n_pts, the_bkt_size,		// basic tree info (returned)
-		the_bnd_box_lo, the_bnd_box_hi);		// bounding box info (returned)
+		the_bnd_box_lo, the_bnd_box_hi,			// bounding box info (returned)
+		the_leaf_pts);							// leaf order flag (returned)
 
 												// create a skeletal tree
 	SkeletonTree(the_n_pts, the_dim, the_bkt_size, the_pts, the_pidx);
@@ -210,6 +241,7 @@ ANNkd_tree::ANNkd_tree(					// build from dump file
 	bnd_box_hi = the_bnd_box_hi;
 
 	root = the_root;							// set the root
+	if (the_leaf_pts) CopyLeafPts();			// copy points if needed
 }
 
 ANNbd_tree::ANNbd_tree(					// build bd-tree from dump file
@@ -223,6 +255,7 @@ ANNbd_tree::ANNbd_tree(					// build bd-tree from dump file
 	ANNpointArray the_pts;						// point storage
 	ANNidxArray the_pidx;						// point index storage
 	ANNkd_ptr the_root;							// root of the tree
+	ANNbool the_leaf_pts;						// copy points to leaf order?
 
 	the_root = annReadDump(						// read the dump file
 		in,										// input stream
@@ -230,7 +263,8 @@ ANNbd_tree::ANNbd_tree(					// build bd-tree from dump file
 		the_pts,								// point array (returned)
 		the_pidx,								// point indices (returned)
 		the_dim, the_n_pts, the_bkt_size,		// basic tree info (returned)
-		the_bnd_box_lo, the_bnd_box_hi);		// bounding box info (returned)
+		the_bnd_box_lo, the_bnd_box_hi,			// bounding box info (returned)
+		the_leaf_pts);							// leaf order flag (returned)
 
 												// create a skeletal tree
 	SkeletonTree(the_n_pts, the_dim, the_bkt_size, the_pts, the_pidx);
@@ -238,6 +272,7 @@ ANNbd_tree::ANNbd_tree(					// build bd-tree from dump file
 	bnd_box_hi = the_bnd_box_hi;
 
 	root = the_root;							// set the root
+	if (the_leaf_pts) CopyLeafPts();			// copy points if needed
 }
 
 //----------------------------------------------------------------------
@@ -259,17 +294,25 @@ static ANNkd_ptr annReadDump(
 	int					&the_n_pts,				// number of points (returned)
 	int					&the_bkt_size,			// bucket size (returned)
 	ANNpoint			&the_bnd_box_lo,		// low bounding point (ret'd)
-	ANNpoint			&the_bnd_box_hi)		// high bounding point (ret'd)
+	ANNpoint			&the_bnd_box_hi,		// high bounding point (ret'd)
+	ANNbool				&the_leaf_pts)			// leaf order flag (ret'd)
 {
 	int j;
 	char str[STRING_LEN];						// storage for string
 	char version[STRING_LEN];					// ANN version number
 	ANNkd_ptr the_root = NULL;
+	the_leaf_pts = ANNfalse;
 
 	//------------------------------------------------------------------
 	//	Input file header
 	//------------------------------------------------------------------
 	in >> str;									// input header
+	if (strcmp(str, "#ANNZ") == 0) {			// compressed dump
+		in.getline(version, STRING_LEN);		// get version (ignore)
+		return annReadZDump(in, tree_type, the_pts, the_pidx, the_dim,
+					the_n_pts, the_bkt_size, the_bnd_box_lo, the_bnd_box_hi,
+					the_leaf_pts);
+	}
 	if (strcmp(str, "#ANN") != 0) {				// incorrect header
 		annError("Incorrect header for dump file", ANNabort);
 	}
@@ -314,6 +357,10 @@ static ANNkd_ptr annReadDump(
 		in >> the_dim;							// read dimension
 		in >> the_n_pts;						// number of points
 		in >> the_bkt_size;						// bucket size
+		in.getline(str, STRING_LEN);			// rest of line (options)
+		if (strstr(str, "leaf_pts") != NULL) {	// points in leaf order?
+			the_leaf_pts = ANNtrue;
+		}
 		the_bnd_box_lo = annAllocPt(the_dim);	// allocate bounding box pts
 		the_bnd_box_hi = annAllocPt(the_dim);
 
@@ -442,3 +489,596 @@ static ANNkd_ptr annReadTree(
 		exit(0);								// to keep the compiler happy
 	}
 }
+
+//----------------------------------------------------------------------
+//	ANN kd- and bd-tree Compressed Dump Format
+//		DumpCompressed writes the same information as Dump (always
+//		with the points), in a compact binary form for storage and
+//		transfer.  It begins with a line of text, by which the load
+//		constructors tell the two formats apart:
+//
+//		#ANNZ <version number> [END_OF_LINE]
+//
+//		The rest is binary.  Integers are written as varints (7 bits
+//		per byte, low bits first, with the high bit set in every byte
+//		but the last), and signed integers are zigzag coded first (0,
+//		-1, 1, -2, ... become 0, 1, 2, 3, ...).  Coordinates are written
+//		as little-endian floats or doubles (whichever ANNcoord is), and
+//		are converted if ANNcoord is the other type when loaded.
+//
+//		<coord size> <flags>			(bytes: 4 or 8, and ANN_Z_xxx flags)
+//		<dim> <n_pts> <bkt_size>
+//		<xxx> <xxx> ... <xxx>			(lower end of bounding box)
+//		<xxx> <xxx> ... <xxx>			(upper end of bounding box)
+//		<nodes>							(in preorder)
+//		<points>
+//
+//		Each node begins with a tag byte, whose low 3 bits give its
+//		type.  The cell of each node is tracked (from the bounding box
+//		down, as in getStats), so a splitting node whose bounds are
+//		those of its cell need not give them, and one whose cutting
+//		value is the midpoint of its bounds need not give that.  The
+//		ANN_Z_LO, ANN_Z_HI, and ANN_Z_MID bits of its tag tell which
+//		are left out.
+//
+//		Null tree:
+//				ANN_Z_NULL
+//		Leaf node:
+//				ANN_Z_LEAF <n_pts> <run> <run> ...
+//				The point indices are given in runs of consecutive
+//				indices.  Each run is given by the (signed) difference
+//				of its first index from the index following the
+//				previous run (of this or an earlier leaf), and its
+//				length less one.
+//		Trivial leaf:
+//				ANN_Z_TRIVIAL
+//		Splitting nodes:
+//				ANN_Z_SPLIT <cut_dim> [<lo_bound>] [<hi_bound>] [<cut_val>]
+//		Shrinking nodes:
+//				ANN_Z_SHRINK <n_bnds>
+//						<cut_dim> <cut_val> <side>
+//						... (repeated n_bnds times)
+//
+//		The points follow, in the order of their indices in the leaves
+//		(and then any points which are in no leaf, by index), so that
+//		nearby points are adjacent.  If the ANN_Z_PACK flag is set,
+//		they are packed by a simple lossless codec.  Each coordinate
+//		is XORed (as an integer) with the same coordinate of the
+//		previous point, and the result is written as a byte giving its
+//		number of leading zero bytes (in the high 4 bits) and trailing
+//		zero bytes (in the low 4 bits), followed by the bytes between
+//		them.  Otherwise the coordinates are written as they are.
+//
+//		The dump is decoded as it is read, straight into the nodes,
+//		point indices, and points of the new tree.  As it is binary, the
+//		streams should be opened in binary mode.
+//----------------------------------------------------------------------
+
+const int		ANN_Z_NULL		= 0;	// node types (low bits of tags)
+const int		ANN_Z_LEAF		= 1;
+const int		ANN_Z_TRIVIAL	= 2;
+const int		ANN_Z_SPLIT		= 3;
+const int		ANN_Z_SHRINK	= 4;
+const int		ANN_Z_TYPE		= 0x07;	// mask for node type
+const int		ANN_Z_LO		= 0x08;	// split: lo_bound is cell's
+const int		ANN_Z_HI		= 0x10;	// split: hi_bound is cell's
+const int		ANN_Z_MID		= 0x20;	// split: cut_val is midpoint
+
+const int		ANN_Z_LEAF_PTS	= 0x01;	// flags: copy to leaf order
+const int		ANN_Z_PACK		= 0x02;	// flags: points are packed
+
+const size_t	ANN_Z_BUF		= 1 << 16;	// size of output buffer
+
+typedef unsigned long long ANNzBits;	// bits of a coordinate
+
+static inline ANNzBits annCoordBits(	// bits of a coordinate
+	ANNcoord			c)				// the coordinate
+{
+	if (sizeof(ANNcoord) == 8) {
+		unsigned long long u;
+		memcpy(&u, &c, 8);
+		return u;
+	}
+	else {
+		unsigned int u;
+		memcpy(&u, &c, 4);
+		return u;
+	}
+}
+
+static inline ANNcoord annBitsCoord(	// coordinate from its bits
+	ANNzBits			u,				// the bits
+	int					width)			// bytes in coordinate (4 or 8)
+{
+	if (width == 8) {
+		double c;
+		memcpy(&c, &u, 8);
+		return (ANNcoord) c;
+	}
+	else {
+		unsigned int u4 = (unsigned int) u;
+		float c;
+		memcpy(&c, &u4, 4);
+		return (ANNcoord) c;
+	}
+}
+
+static inline ANNcoord annMidCoord(		// midpoint of two coordinates
+	ANNcoord			lo,				// low end
+	ANNcoord			hi,				// high end
+	int					width)			// bytes in coordinate (4 or 8)
+{										// (computed as written)
+	if (width == 8) return (ANNcoord) (((double) lo + (double) hi)/2);
+	else return (ANNcoord) (((float) lo + (float) hi)/2);
+}
+
+//----------------------------------------------------------------------
+//	ANNdumpWriter - writes a compressed dump
+//		The output is collected in a buffer, which is written to the
+//		stream whenever it fills.  The writer also holds the cell of
+//		the current node, the point indices in leaf order, and the
+//		index following the last run.
+//----------------------------------------------------------------------
+
+class ANNdumpWriter {
+public:
+	ostream				&out;			// output stream
+	vector<unsigned char> buf;			// output buffer
+	int					dim;			// dimension
+	vector<ANNcoord>	lo;				// cell of current node
+	vector<ANNcoord>	hi;
+	vector<ANNidx>		order;			// point indices in leaf order
+	long long			next;			// index following last run
+
+	ANNdumpWriter(ostream &o, int dd, ANNpoint l, ANNpoint h)
+		: out(o), dim(dd), lo(l, l + dd), hi(h, h + dd), next(0)
+		{  buf.reserve(ANN_Z_BUF);  }
+
+	void flush()						// write out the buffer
+		{
+			if (!buf.empty())
+				out.write((const char *) &buf[0], (streamsize) buf.size());
+			buf.clear();
+		}
+
+	void put(int b)						// write a byte
+		{
+			buf.push_back((unsigned char) b);
+			if (buf.size() >= ANN_Z_BUF) flush();
+		}
+
+	void putVar(unsigned long long v)	// write a varint
+		{
+			while (v >= 0x80) {
+				put((int) (v & 0x7f) | 0x80);
+				v >>= 7;
+			}
+			put((int) v);
+		}
+
+	void putInt(long long v)			// write a signed varint
+		{
+			putVar(((unsigned long long) v << 1) ^
+					(unsigned long long) (v < 0 ? -1 : 0));
+		}
+
+	void putCoord(ANNcoord c)			// write a coordinate
+		{
+			ANNzBits u = annCoordBits(c);
+			for (int i = 0; i < (int) sizeof(ANNcoord); i++) {
+				put((int) (u & 0xff));
+				u >>= 8;
+			}
+		}
+
+	void putPacked(ANNzBits x)			// write a packed (XORed) coordinate
+		{
+			int width = (int) sizeof(ANNcoord);
+			int lead = 0, trail = 0;	// leading and trailing zero bytes
+			if (x == 0) {
+				lead = width;
+			}
+			else {
+				while (((x >> (8*(width-1-lead))) & 0xff) == 0) lead++;
+				while (((x >> (8*trail)) & 0xff) == 0) trail++;
+			}
+			put((lead << 4) | trail);
+			x >>= 8*trail;
+			for (int i = lead + trail; i < width; i++) {
+				put((int) (x & 0xff));
+				x >>= 8;
+			}
+		}
+};
+
+//----------------------------------------------------------------------
+//	DumpCompressed - write a compressed dump
+//		The nodes are written by their encode() methods, which also
+//		list the point indices in leaf order.  The points are then
+//		written in that order.
+//----------------------------------------------------------------------
+
+void ANNkd_tree::DumpCompressed(		// dump entire tree (compressed)
+		ANNbool pack_pts,				// pack the points?
+		ostream &out)					// output stream
+{
+	out << "#ANNZ " << ANNversion << "\n";
+	ANNdumpWriter dw(out, dim, bnd_box_lo, bnd_box_hi);
+	dw.put((int) sizeof(ANNcoord));		// header
+	dw.put((leaf_pts != NULL ? ANN_Z_LEAF_PTS : 0) |
+			(pack_pts ? ANN_Z_PACK : 0));
+	dw.putVar(dim);
+	dw.putVar(n_pts);
+	dw.putVar(bkt_size);
+	for (int d = 0; d < dim; d++) dw.putCoord(bnd_box_lo[d]);
+	for (int d = 0; d < dim; d++) dw.putCoord(bnd_box_hi[d]);
+
+	if (root == NULL)					// empty tree?
+		dw.put(ANN_Z_NULL);
+	else
+		root->encode(dw);				// write nodes
+
+	vector<char> done(n_pts, 0);		// points written
+	vector<ANNzBits> prev(dim, 0);		// previous point (for packing)
+	size_t k = 0;						// next in leaf order
+	int r = 0;							// next in index order
+	for (int i = 0; i < n_pts; i++) {	// write the points
+		ANNidx idx;						// (leaf order, then the rest)
+		while (k < dw.order.size() && done[dw.order[k]]) k++;
+		if (k < dw.order.size()) idx = dw.order[k];
+		else {
+			while (done[r]) r++;
+			idx = r;
+		}
+		done[idx] = 1;
+		ANNpoint p = pts[idx];
+		for (int d = 0; d < dim; d++) {
+			if (pack_pts) {
+				ANNzBits u = annCoordBits(p[d]);
+				dw.putPacked(u ^ prev[d]);
+				prev[d] = u;
+			}
+			else {
+				dw.putCoord(p[d]);
+			}
+		}
+	}
+	dw.flush();
+}
+
+void ANNkd_split::encode(				// encode a splitting node
+		ANNdumpWriter &dw)				// the writer
+{
+	int tag = ANN_Z_SPLIT;
+	if (annCoordBits(cd_bnds[ANN_LO]) == annCoordBits(dw.lo[cut_dim]))
+		tag |= ANN_Z_LO;
+	if (annCoordBits(cd_bnds[ANN_HI]) == annCoordBits(dw.hi[cut_dim]))
+		tag |= ANN_Z_HI;
+	if (annCoordBits(cut_val) == annCoordBits(annMidCoord(cd_bnds[ANN_LO],
+				cd_bnds[ANN_HI], (int) sizeof(ANNcoord))))
+		tag |= ANN_Z_MID;
+	dw.put(tag);
+	dw.putVar(cut_dim);
+	if (!(tag & ANN_Z_LO)) dw.putCoord(cd_bnds[ANN_LO]);
+	if (!(tag & ANN_Z_HI)) dw.putCoord(cd_bnds[ANN_HI]);
+	if (!(tag & ANN_Z_MID)) dw.putCoord(cut_val);
+
+	ANNcoord save = dw.hi[cut_dim];		// write low child
+	dw.hi[cut_dim] = cut_val;
+	child[ANN_LO]->encode(dw);
+	dw.hi[cut_dim] = save;
+	save = dw.lo[cut_dim];				// write high child
+	dw.lo[cut_dim] = cut_val;
+	child[ANN_HI]->encode(dw);
+	dw.lo[cut_dim] = save;
+}
+
+void ANNkd_leaf::encode(				// encode a leaf node
+		ANNdumpWriter &dw)				// the writer
+{
+	if (this == KD_TRIVIAL || n_pts == 0) {	// trivial leaf
+		dw.put(ANN_Z_TRIVIAL);
+		return;
+	}
+	dw.put(ANN_Z_LEAF);
+	dw.putVar(n_pts);
+	int j = 0;
+	while (j < n_pts) {					// write runs of indices
+		int len = 1;
+		while (j + len < n_pts && bkt[j+len] == bkt[j+len-1] + 1) len++;
+		dw.putInt(bkt[j] - dw.next);
+		dw.putVar(len - 1);
+		dw.next = (long long) bkt[j+len-1] + 1;
+		j += len;
+	}
+	for (j = 0; j < n_pts; j++) {		// list them in leaf order
+		dw.order.push_back(bkt[j]);
+	}
+}
+
+void ANNbd_shrink::encode(				// encode a shrinking node
+		ANNdumpWriter &dw)				// the writer
+{
+	dw.put(ANN_Z_SHRINK);
+	dw.putVar(n_bnds);
+	for (int j = 0; j < n_bnds; j++) {
+		dw.putVar(bnds[j].cd);
+		dw.putCoord(bnds[j].cv);
+		dw.putInt(bnds[j].sd);
+	}
+	vector<ANNcoord> lo(dw.lo), hi(dw.hi);	// save cell
+	ANNpoint p_lo = &dw.lo[0];			// inner box of shrink
+	ANNpoint p_hi = &dw.hi[0];
+	for (int j = 0; j < n_bnds; j++) {
+		bnds[j].project(p_lo);
+		bnds[j].project(p_hi);
+	}
+	child[ANN_IN]->encode(dw);			// write in-child
+	dw.lo.swap(lo);						// restore cell
+	dw.hi.swap(hi);
+	child[ANN_OUT]->encode(dw);			// write out-child
+}
+
+//----------------------------------------------------------------------
+//	ANNdumpReader - reads a compressed dump
+//		Bytes are taken straight from the stream buffer.  The reader
+//		also holds the cell of the current node (as the writer does).
+//----------------------------------------------------------------------
+
+class ANNdumpReader {
+public:
+	streambuf			*sb;			// input stream buffer
+	int					width;			// bytes in coordinate
+	int					dim;			// dimension
+	vector<ANNcoord>	lo;				// cell of current node
+	vector<ANNcoord>	hi;
+
+	ANNdumpReader(istream &in) : sb(in.rdbuf()), width(0), dim(0) {}
+
+	int get()							// read a byte
+		{
+			int c = sb->sbumpc();
+			if (c == EOF) {
+				annError("Unexpected end of compressed dump", ANNabort);
+			}
+			return c;
+		}
+
+	unsigned long long getVar()			// read a varint
+		{
+			unsigned long long v = 0;
+			for (int shift = 0; ; shift += 7) {
+				if (shift > 63) {
+					annError("Illegal number in compressed dump", ANNabort);
+				}
+				int c = get();
+				v |= (unsigned long long) (c & 0x7f) << shift;
+				if (!(c & 0x80)) return v;
+			}
+		}
+
+	long long getInt()					// read a signed varint
+		{
+			unsigned long long v = getVar();
+			return (long long) (v >> 1) ^ -(long long) (v & 1);
+		}
+
+	int getCount(int max)				// read a count in [0, max]
+		{
+			unsigned long long v = getVar();
+			if (v > (unsigned long long) max) {
+				annError("Illegal count in compressed dump", ANNabort);
+			}
+			return (int) v;
+		}
+
+	ANNzBits getBits()					// read a coordinate's bits
+		{
+			ANNzBits u = 0;
+			for (int i = 0; i < width; i++) {
+				u |= (ANNzBits) get() << (8*i);
+			}
+			return u;
+		}
+
+	ANNcoord getCoord()					// read a coordinate
+		{  return annBitsCoord(getBits(), width);  }
+
+	ANNzBits getPacked()				// read a packed coordinate
+		{
+			int c = get();
+			int lead = c >> 4;
+			int trail = c & 0x0f;
+			if (lead + trail > width) {
+				annError("Illegal packed coordinate in compressed dump",
+						ANNabort);
+			}
+			ANNzBits x = 0;
+			for (int i = 0; i < width - lead - trail; i++) {
+				x |= (ANNzBits) get() << (8*(trail+i));
+			}
+			return x;
+		}
+};
+
+//----------------------------------------------------------------------
+// annReadZTree - read a node of a compressed dump
+//		This is the analogue of annReadTree.  It reads a node (and its
+//		subtrees), storing the point indices of leaves in the_pidx, and
+//		keeping track of the cell of the node.
+//----------------------------------------------------------------------
+
+static ANNkd_ptr annReadZTree(
+	ANNdumpReader		&dr,					// the reader
+	ANNtreeType			tree_type,				// type of tree expected
+	int					the_n_pts,				// number of points
+	ANNidxArray			the_pidx,				// point indices (modified)
+	int					&next_idx,				// next index (modified)
+	long long			&next)					// index after last run
+{
+	int tag = dr.get();							// input node tag
+	switch (tag & ANN_Z_TYPE) {
+	case ANN_Z_NULL:							// null tree
+		return NULL;
+	case ANN_Z_TRIVIAL:							// trivial leaf
+		return KD_TRIVIAL;
+	//------------------------------------------------------------------
+	//	Read a leaf
+	//------------------------------------------------------------------
+	case ANN_Z_LEAF: {
+		int n_pts = dr.getCount(the_n_pts - next_idx);
+		int old_idx = next_idx;					// save next_idx
+		while (next_idx < old_idx + n_pts) {	// read runs of indices
+			long long first = next + dr.getInt();
+			int len = dr.getCount(old_idx + n_pts - next_idx - 1) + 1;
+			if (first < 0 || first + len > the_n_pts) {
+				annError("Point index is out of range", ANNabort);
+			}
+			for (int i = 0; i < len; i++) {
+				the_pidx[next_idx++] = (ANNidx) (first + i);
+			}
+			next = first + len;
+		}
+		if (n_pts == 0) return KD_TRIVIAL;
+		return new ANNkd_leaf(n_pts, &the_pidx[old_idx]);
+	}
+	//------------------------------------------------------------------
+	//	Read a splitting node
+	//------------------------------------------------------------------
+	case ANN_Z_SPLIT: {
+		int cd = dr.getCount(dr.dim - 1);		// cut dimension
+		ANNcoord lb = (tag & ANN_Z_LO ? dr.lo[cd] : dr.getCoord());
+		ANNcoord hb = (tag & ANN_Z_HI ? dr.hi[cd] : dr.getCoord());
+		ANNcoord cv = (tag & ANN_Z_MID ? annMidCoord(lb, hb, dr.width)
+					: dr.getCoord());
+												// read low subtree
+		ANNcoord save = dr.hi[cd];
+		dr.hi[cd] = cv;
+		ANNkd_ptr lc = annReadZTree(dr, tree_type, the_n_pts, the_pidx,
+					next_idx, next);
+		dr.hi[cd] = save;
+		save = dr.lo[cd];						// read high subtree
+		dr.lo[cd] = cv;
+		ANNkd_ptr hc = annReadZTree(dr, tree_type, the_n_pts, the_pidx,
+					next_idx, next);
+		dr.lo[cd] = save;
+												// create new node and return
+		return new ANNkd_split(cd, cv, lb, hb, lc, hc);
+	}
+	//------------------------------------------------------------------
+	//	Read a shrinking node (bd-tree only)
+	//------------------------------------------------------------------
+	case ANN_Z_SHRINK: {
+		if (tree_type != BD_TREE) {
+			annError("Shrinking node not allowed in kd-tree", ANNabort);
+		}
+		int n_bnds = dr.getCount(INT_MAX);		// number of bounding sides
+		ANNorthHSArray bds = new ANNorthHalfSpace[n_bnds];
+		for (int i = 0; i < n_bnds; i++) {
+			int cd = dr.getCount(dr.dim - 1);	// input bounding halfspace
+			ANNcoord cv = dr.getCoord();
+			int sd = (int) dr.getInt();
+			bds[i] = ANNorthHalfSpace(cd, cv, sd);
+		}
+		vector<ANNcoord> lo(dr.lo), hi(dr.hi);	// save cell
+		ANNpoint p_lo = &dr.lo[0];				// inner box of shrink
+		ANNpoint p_hi = &dr.hi[0];
+		for (int i = 0; i < n_bnds; i++) {
+			bds[i].project(p_lo);
+			bds[i].project(p_hi);
+		}
+		ANNkd_ptr ic = annReadZTree(dr, tree_type, the_n_pts, the_pidx,
+					next_idx, next);
+		dr.lo.swap(lo);							// restore cell
+		dr.hi.swap(hi);
+		ANNkd_ptr oc = annReadZTree(dr, tree_type, the_n_pts, the_pidx,
+					next_idx, next);
+												// create new node and return
+		return new ANNbd_shrink(n_bnds, bds, ic, oc);
+	}
+	default:
+		annError("Illegal node type in dump file", ANNabort);
+		exit(0);								// to keep the compiler happy
+	}
+}
+
+//----------------------------------------------------------------------
+//	annReadZDump - read a compressed dump
+//		This is called by annReadDump (after the header line), and
+//		returns the same information.
+//----------------------------------------------------------------------
+
+static ANNkd_ptr annReadZDump(
+	istream				&in,					// input stream
+	ANNtreeType			tree_type,				// type of tree expected
+	ANNpointArray		&the_pts,				// new points (returned)
+	ANNidxArray			&the_pidx,				// point indices (returned)
+	int					&the_dim,				// dimension (returned)
+	int					&the_n_pts,				// number of points (returned)
+	int					&the_bkt_size,			// bucket size (returned)
+	ANNpoint			&the_bnd_box_lo,		// low bounding point (ret'd)
+	ANNpoint			&the_bnd_box_hi,		// high bounding point (ret'd)
+	ANNbool				&the_leaf_pts)			// leaf order flag (ret'd)
+{
+	ANNdumpReader dr(in);
+	dr.width = dr.get();						// coordinate size
+	if (dr.width != 4 && dr.width != 8) {
+		annError("Illegal coordinate size in compressed dump", ANNabort);
+	}
+	int flags = dr.get();
+	if (flags & ~(ANN_Z_LEAF_PTS | ANN_Z_PACK)) {
+		annError("Unknown flags in compressed dump", ANNabort);
+	}
+	the_leaf_pts = (ANNbool) ((flags & ANN_Z_LEAF_PTS) != 0);
+	the_dim = dr.getCount(INT_MAX);				// basic tree info
+	the_n_pts = dr.getCount(INT_MAX);
+	the_bkt_size = dr.getCount(INT_MAX);
+	if (the_dim < 1) {
+		annError("Illegal dimension in compressed dump", ANNabort);
+	}
+	dr.dim = the_dim;
+	the_bnd_box_lo = annAllocPt(the_dim);		// bounding box
+	the_bnd_box_hi = annAllocPt(the_dim);
+	for (int d = 0; d < the_dim; d++) the_bnd_box_lo[d] = dr.getCoord();
+	for (int d = 0; d < the_dim; d++) the_bnd_box_hi[d] = dr.getCoord();
+	dr.lo.assign(the_bnd_box_lo, the_bnd_box_lo + the_dim);
+	dr.hi.assign(the_bnd_box_hi, the_bnd_box_hi + the_dim);
+
+	the_pidx = new ANNidx[the_n_pts];			// read the tree and indices
+	int next_idx = 0;
+	long long next = 0;							// index following last run
+	ANNkd_ptr the_root = annReadZTree(dr, tree_type, the_n_pts, the_pidx,
+				next_idx, next);
+	if (next_idx != the_n_pts) {				// didn't see all the points?
+		annError("Didn't see as many points as expected", ANNwarn);
+	}
+												// read the points
+	the_pts = annAllocPts(the_n_pts, the_dim);
+	vector<char> done(the_n_pts, 0);			// points read
+	vector<ANNzBits> prev(the_dim, 0);			// previous point (if packed)
+	int k = 0;									// next in leaf order
+	int r = 0;									// next in index order
+	for (int i = 0; i < the_n_pts; i++) {		// (leaf order, then the rest)
+		ANNidx idx;
+		while (k < next_idx && done[the_pidx[k]]) k++;
+		if (k < next_idx) idx = the_pidx[k];
+		else {
+			while (done[r]) r++;
+			idx = r;
+		}
+		done[idx] = 1;
+		ANNpoint p = the_pts[idx];
+		for (int d = 0; d < the_dim; d++) {
+			if (flags & ANN_Z_PACK) {
+				prev[d] ^= dr.getPacked();
+				p[d] = annBitsCoord(prev[d], dr.width);
+			}
+			else {
+				p[d] = dr.getCoord();
+			}
+		}
+	}
+	return the_root;
+}
+
+ANN_NAMESPACE_END
@@ -20,9 +20,23 @@
 // History:
 //	Revision 1.1  05/03/05
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Replaced global search variables by a search context
+//		Leaf distances are computed by the distance kernel
+//		Closest point set is taken from the thread's search scratch
+//		Leaves can append to range search results (annRangeSearch)
+//		Counting (k = 0) counts whole cells inside the ball
+//		Added annApproxRangeCount()
+//		Leaves skip deleted points (for dynamic trees)
+//		Searches skip points deleted from the tree, and then do not
+//			count whole cells
 //----------------------------------------------------------------------
 
 #include "kd_fix_rad_search.h"			// kd fixed-radius search decls
+#include "dist_kernel.h"				// distance kernels
+#include "search_scratch.h"				// per-thread search scratch
+
+ANN_NAMESPACE_BEGIN
 
 //----------------------------------------------------------------------
 //	Approximate fixed-radius k nearest neighbor search
@@ -37,22 +51,56 @@
 //----------------------------------------------------------------------
 
 //----------------------------------------------------------------------
-//		To keep argument lists short, a number of global variables
-//		are maintained which are common to all the recursive calls.
-//		These are given below.
+//		To keep argument lists short, the information which is common
+//		to all the recursive calls is stored in a search context (see
+//		kd_fix_rad_search.h), which is passed to each of the recursive
+//		calls.
 //----------------------------------------------------------------------
 
-int				ANNkdFRDim;				// dimension of space
-ANNpoint		ANNkdFRQ;				// query point
-ANNdist			ANNkdFRSqRad;			// squared radius search bound
-double			ANNkdFRMaxErr;			// max tolerable squared error
-ANNpointArray	ANNkdFRPts;				// the points
-ANNmin_k*		ANNkdFRPointMK;			// set of k closest points
-int				ANNkdFRPtsVisited;		// total points visited
-int				ANNkdFRPtsInRange;		// number of points in the range
+//----------------------------------------------------------------------
+//	annFRCount - count points in range, starting at the root
+//		This sets up the cell bounds for ann_FR_count() (in the thread's
+//		search scratch), starting with the tree's bounding box, and
+//		then counts from the root.  The other fields of the context
+//		must already be set.
+//----------------------------------------------------------------------
+
+static void annFRCount(
+	ANNkd_ptr			root,			// root of tree
+	ANNpoint			bnd_box_lo,		// bounding box of tree
+	ANNpoint			bnd_box_hi,
+	ANNdist				box_dist,		// distance to bounding box
+	ANNsearchScratch	*scr,			// search scratch
+	ANNkdFRSearchCtx	&ctx)			// search context
+{
+	int dim = ctx.dim;
+	ANNpoint q = ctx.q;
+	scr->cell_lo.resize(dim);			// start with the bounding box
+	scr->cell_hi.resize(dim);
+	ANNdist far_dist = 0;				// distance to farthest point
+	for (int d = 0; d < dim; d++) {
+		scr->cell_lo[d] = bnd_box_lo[d];
+		scr->cell_hi[d] = bnd_box_hi[d];
+		far_dist = (ANNdist) ANN_SUM(far_dist,
+				annCellFarDist(q[d], bnd_box_lo[d], bnd_box_hi[d]));
+	}
+	ANN_FLOP(4*dim)						// increment floating op count
+	ctx.cell_lo = &scr->cell_lo[0];
+	ctx.cell_hi = &scr->cell_hi[0];
+	ctx.cell_stk = &scr->cell_stk;
+	root->ann_FR_count(box_dist, far_dist, ctx);
+}
 
 //----------------------------------------------------------------------
 //	annkFRSearch - fixed radius search for k nearest neighbors
+//		If k = 0, only the number of points in range is wanted.  Then
+//		ann_FR_count() is used, which counts the points of any cell
+//		lying entirely within the ball (using the number of points
+//		stored in its node) rather than visiting them.  So the cost is
+//		roughly proportional to the number of cells crossing the
+//		boundary of the ball, rather than to the number of points
+//		inside it.  (This cannot be done once points have been deleted
+//		from the tree, as the node counts include them.)
 //----------------------------------------------------------------------
 
 int ANNkd_tree::annkFRSearch(
@@ -63,29 +111,105 @@ int ANNkd_tree::annkFRSearch(
 	ANNdistArray		dd,				// the approximate nearest neighbor
 	double				eps)			// the error bound
 {
-	ANNkdFRDim = dim;					// copy arguments to static equivs
-	ANNkdFRQ = q;
-	ANNkdFRSqRad = sqRad;
-	ANNkdFRPts = pts;
-	ANNkdFRPtsVisited = 0;				// initialize count of points visited
-	ANNkdFRPtsInRange = 0;				// ...and points in the range
-
-	ANNkdFRMaxErr = ANN_POW(1.0 + eps);
+	ANNkdFRSearchCtx ctx;				// context for this search
+
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.sq_rad = sqRad;
+	ctx.pts = pts;
+	ctx.pidx = pidx;					// ...and points in leaf order
+	ctx.leaf_pts = (leaf_pts != NULL ? leaf_pts[0] : NULL);
+	ctx.deleted = deleted;				// (skip deleted points)
+	ctx.pts_visited = 0;				// initialize count of points visited
+	ctx.pts_in_range = 0;				// ...and points in the range
+	ctx.range_idx = NULL;				// (not a range search)
+	ctx.range_dd = NULL;
+	ctx.cell_lo = ctx.cell_hi = NULL;	// (not counting yet)
+	ctx.cell_stk = NULL;
+
+	ctx.max_err = ANN_POW(1.0 + eps);
 	ANN_FLOP(2)							// increment floating op count
 
-	ANNkdFRPointMK = new ANNmin_k(k);	// create set for closest k points
-										// search starting at the root
-	root->ann_FR_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim));
+	ANNsearchScratch *scr = annGetScratch();
+	scr->point_mk.reset(k);				// set for closest k points
+	ctx.point_mk = &scr->point_mk;
+										// distance to root box
+	ANNdist box_dist = annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim);
+
+	if (k == 0 && ANN_ALLOW_SELF_MATCH && deleted == NULL) {
+										// counting only
+		ctx.sq_rad_out = sqRad;			// count cells inside the ball
+		annFRCount(root, bnd_box_lo, bnd_box_hi, box_dist, scr, ctx);
+	}
+	else {								// search starting at the root
+		root->ann_FR_search(box_dist, ctx);
+	}
 
 	for (int i = 0; i < k; i++) {		// extract the k-th closest points
 		if (dd != NULL)
-			dd[i] = ANNkdFRPointMK->ith_smallest_key(i);
+			dd[i] = ctx.point_mk->ith_smallest_key(i);
 		if (nn_idx != NULL)
-			nn_idx[i] = ANNkdFRPointMK->ith_smallest_info(i);
+			nn_idx[i] = ctx.point_mk->ith_smallest_info(i);
 	}
 
-	delete ANNkdFRPointMK;				// deallocate closest point set
-	return ANNkdFRPtsInRange;			// return final point count
+	annReleaseScratch(scr);				// done with scratch
+	return ctx.pts_in_range;			// return final point count
+}
+
+//----------------------------------------------------------------------
+//	annApproxRangeCount - approximate range counting
+//		This is the approximate range counting algorithm of Arya and
+//		Mount ("Approximate range searching," Computational Geometry:
+//		Theory and Applications, 17:135-152, 2000), with an inner ball
+//		of radius r/(1+eps) and an outer ball of radius r*(1+eps),
+//		where r is the radius bound.  It is the same as counting with
+//		annkFRSearch(), except that the points of a cell are counted
+//		if it lies within the outer ball, and (as with annkFRSearch)
+//		a cell is skipped if it is disjoint from the inner ball.  The
+//		points of the remaining cells which are visited are counted if
+//		they lie within distance r.  So every point within the inner
+//		ball is counted, and no point outside the outer ball.
+//
+//		Only cells which meet the inner ball but are not inside the
+//		outer ball are visited, and in a bd-tree (whose cells decrease
+//		in size geometrically as we descend) there are O(1/eps^(d-1))
+//		such cells.
+//----------------------------------------------------------------------
+
+int ANNkd_tree::annApproxRangeCount(
+	ANNpoint			q,				// the query point
+	ANNdist				sqRad,			// squared radius bound
+	double				eps)			// the error bound
+{
+	if (!ANN_ALLOW_SELF_MATCH || deleted != NULL) {	// cannot count cells
+		return annkFRSearch(q, sqRad, 0, NULL, NULL, eps);
+	}
+	ANNkdFRSearchCtx ctx;				// context for this search
+
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.sq_rad = sqRad;
+	ctx.pts = pts;
+	ctx.pidx = pidx;					// ...and points in leaf order
+	ctx.leaf_pts = (leaf_pts != NULL ? leaf_pts[0] : NULL);
+	ctx.deleted = deleted;				// (skip deleted points)
+	ctx.pts_visited = 0;				// initialize count of points visited
+	ctx.pts_in_range = 0;				// ...and points in the range
+	ctx.range_idx = NULL;				// (not a range search)
+	ctx.range_dd = NULL;
+
+	ctx.max_err = ANN_POW(1.0 + eps);	// skip cells outside inner ball
+	ctx.sq_rad_out = sqRad * ctx.max_err;	// count cells in outer ball
+	ANN_FLOP(3)							// increment floating op count
+
+	ANNsearchScratch *scr = annGetScratch();
+	scr->point_mk.reset(0);				// (no closest points)
+	ctx.point_mk = &scr->point_mk;
+	annFRCount(root, bnd_box_lo, bnd_box_hi,
+			annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim), scr, ctx);
+
+	annReleaseScratch(scr);				// done with scratch
+	return ctx.pts_in_range;			// return final point count
 }
 
 //----------------------------------------------------------------------
@@ -97,18 +221,18 @@ int ANNkd_tree::annkFRSearch(
 //		code structure for the sake of uniformity.
 //----------------------------------------------------------------------
 
-void ANNkd_split::ann_FR_search(ANNdist box_dist)
+void ANNkd_split::ann_FR_search(ANNdist box_dist, ANNkdFRSearchCtx &ctx)
 {
 										// check dist calc term condition
-	if (ANNmaxPtsVisited != 0 && ANNkdFRPtsVisited > ANNmaxPtsVisited) return;
+	if (ANNmaxPtsVisited != 0 && ctx.pts_visited > ANNmaxPtsVisited) return;
 
 										// distance to cutting plane
-	ANNcoord cut_diff = ANNkdFRQ[cut_dim] - cut_val;
+	ANNcoord cut_diff = ctx.q[cut_dim] - cut_val;
 
 	if (cut_diff < 0) {					// left of cutting plane
-		child[ANN_LO]->ann_FR_search(box_dist);// visit closer child first
+		child[ANN_LO]->ann_FR_search(box_dist, ctx);// visit closer child first
 
-		ANNcoord box_diff = cd_bnds[ANN_LO] - ANNkdFRQ[cut_dim];
+		ANNcoord box_diff = cd_bnds[ANN_LO] - ctx.q[cut_dim];
 		if (box_diff < 0)				// within bounds - ignore
 			box_diff = 0;
 										// distance to further box
@@ -116,14 +240,14 @@ void ANNkd_split::ann_FR_search(ANNdist box_dist)
 				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
 
 										// visit further child if in range
-		if (box_dist * ANNkdFRMaxErr <= ANNkdFRSqRad)
-			child[ANN_HI]->ann_FR_search(box_dist);
+		if (box_dist * ctx.max_err <= ctx.sq_rad)
+			child[ANN_HI]->ann_FR_search(box_dist, ctx);
 
 	}
 	else {								// right of cutting plane
-		child[ANN_HI]->ann_FR_search(box_dist);// visit closer child first
+		child[ANN_HI]->ann_FR_search(box_dist, ctx);// visit closer child first
 
-		ANNcoord box_diff = ANNkdFRQ[cut_dim] - cd_bnds[ANN_HI];
+		ANNcoord box_diff = ctx.q[cut_dim] - cd_bnds[ANN_HI];
 		if (box_diff < 0)				// within bounds - ignore
 			box_diff = 0;
 										// distance to further box
@@ -131,8 +255,8 @@ void ANNkd_split::ann_FR_search(ANNdist box_dist)
 				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
 
 										// visit further child if close enough
-		if (box_dist * ANNkdFRMaxErr <= ANNkdFRSqRad)
-			child[ANN_LO]->ann_FR_search(box_dist);
+		if (box_dist * ctx.max_err <= ctx.sq_rad)
+			child[ANN_LO]->ann_FR_search(box_dist, ctx);
 
 	}
 	ANN_FLOP(13)						// increment floating ops
@@ -140,44 +264,147 @@ void ANNkd_split::ann_FR_search(ANNdist box_dist)
 }
 
 //----------------------------------------------------------------------
-//	kd_leaf::ann_FR_search - search points in a leaf node
-//		Note: The unreadability of this code is the result of
-//		some fine tuning to replace indexing by pointer operations.
+//	kd_split::ann_FR_count - count points in range below splitting node
+//		If the node's cell lies within the ball, all its points are
+//		counted.  Otherwise, the children are counted as in
+//		ann_FR_search().  The cell bounds along the cutting dimension
+//		are narrowed for each child (and restored afterwards), and the
+//		distance to the farthest point of the cell is updated to match.
+//		The child's cell bounds are also intersected with cd_bnds
+//		(which may be tighter, within the inner box of a shrinking
+//		node).
 //----------------------------------------------------------------------
 
-void ANNkd_leaf::ann_FR_search(ANNdist box_dist)
+void ANNkd_split::ann_FR_count(
+	ANNdist				box_dist,		// distance to cell
+	ANNdist				far_dist,		// distance to farthest point of cell
+	ANNkdFRSearchCtx	&ctx)			// search context
 {
-	register ANNdist dist;				// distance to data point
-	register ANNcoord* pp;				// data coordinate pointer
-	register ANNcoord* qq;				// query coordinate pointer
-	register ANNcoord t;
-	register int d;
+	if (annCellInside(far_dist, ctx.sq_rad_out)) {	// cell is inside the ball
+		ctx.pts_in_range += n_sub;		// count all of its points
+		return;
+	}
+										// check dist calc term condition
+	if (ANNmaxPtsVisited != 0 && ctx.pts_visited > ANNmaxPtsVisited) return;
 
-	for (int i = 0; i < n_pts; i++) {	// check points in bucket
+	ANNcoord lo = ctx.cell_lo[cut_dim];	// save cell bounds
+	ANNcoord hi = ctx.cell_hi[cut_dim];
+										// far dist without cut_dim
+	ANNdist far_rest = (ANNdist) ANN_DIFF(
+			annCellFarDist(ctx.q[cut_dim], lo, hi), far_dist);
+										// bounds of children
+	ANNcoord lo_lo = (cd_bnds[ANN_LO] > lo ? cd_bnds[ANN_LO] : lo);
+	ANNcoord hi_hi = (cd_bnds[ANN_HI] < hi ? cd_bnds[ANN_HI] : hi);
+										// distances to their far points
+	ANNdist far_lo = (ANNdist) ANN_SUM(far_rest,
+			annCellFarDist(ctx.q[cut_dim], lo_lo, cut_val));
+	ANNdist far_hi = (ANNdist) ANN_SUM(far_rest,
+			annCellFarDist(ctx.q[cut_dim], cut_val, hi_hi));
 
-		pp = ANNkdFRPts[bkt[i]];		// first coord of next data point
-		qq = ANNkdFRQ;					// first coord of query point
-		dist = 0;
+										// distance to cutting plane
+	ANNcoord cut_diff = ctx.q[cut_dim] - cut_val;
 
-		for(d = 0; d < ANNkdFRDim; d++) {
-			ANN_COORD(1)				// one more coordinate hit
-			ANN_FLOP(5)					// increment floating ops
+	if (cut_diff < 0) {					// left of cutting plane
+		ctx.cell_lo[cut_dim] = lo_lo;	// visit closer child first
+		ctx.cell_hi[cut_dim] = cut_val;
+		child[ANN_LO]->ann_FR_count(box_dist, far_lo, ctx);
 
-			t = *(qq++) - *(pp++);		// compute length and adv coordinate
-										// exceeds dist to k-th smallest?
-			if( (dist = ANN_SUM(dist, ANN_POW(t))) > ANNkdFRSqRad) {
-				break;
-			}
+		ANNcoord box_diff = cd_bnds[ANN_LO] - ctx.q[cut_dim];
+		if (box_diff < 0)				// within bounds - ignore
+			box_diff = 0;
+										// distance to further box
+		box_dist = (ANNdist) ANN_SUM(box_dist,
+				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
+
+										// visit further child if in range
+		if (box_dist * ctx.max_err <= ctx.sq_rad) {
+			ctx.cell_lo[cut_dim] = cut_val;
+			ctx.cell_hi[cut_dim] = hi_hi;
+			child[ANN_HI]->ann_FR_count(box_dist, far_hi, ctx);
+		}
+	}
+	else {								// right of cutting plane
+		ctx.cell_lo[cut_dim] = cut_val;	// visit closer child first
+		ctx.cell_hi[cut_dim] = hi_hi;
+		child[ANN_HI]->ann_FR_count(box_dist, far_hi, ctx);
+
+		ANNcoord box_diff = ctx.q[cut_dim] - cd_bnds[ANN_HI];
+		if (box_diff < 0)				// within bounds - ignore
+			box_diff = 0;
+										// distance to further box
+		box_dist = (ANNdist) ANN_SUM(box_dist,
+				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
+
+										// visit further child if close enough
+		if (box_dist * ctx.max_err <= ctx.sq_rad) {
+			ctx.cell_lo[cut_dim] = lo_lo;
+			ctx.cell_hi[cut_dim] = cut_val;
+			child[ANN_LO]->ann_FR_count(box_dist, far_lo, ctx);
 		}
+	}
+	ctx.cell_lo[cut_dim] = lo;			// restore cell bounds
+	ctx.cell_hi[cut_dim] = hi;
+	ANN_FLOP(25)						// increment floating ops
+	ANN_SPL(1)							// one more splitting node visited
+}
+
+//----------------------------------------------------------------------
+//	kd_leaf::ann_FR_count - count points in range in a leaf node
+//		If the leaf's cell lies within the ball, all its points are
+//		counted.  Otherwise they are checked as in ann_FR_search().
+//----------------------------------------------------------------------
+
+void ANNkd_leaf::ann_FR_count(
+	ANNdist				box_dist,		// distance to cell
+	ANNdist				far_dist,		// distance to farthest point of cell
+	ANNkdFRSearchCtx	&ctx)			// search context
+{
+	if (annCellInside(far_dist, ctx.sq_rad_out)) {	// cell is inside ball
+		ctx.pts_in_range += n_pts;		// count all of its points
+		return;
+	}
+	ann_FR_search(box_dist, ctx);		// else check each point
+}
+
+//----------------------------------------------------------------------
+//	kd_leaf::ann_FR_search - search points in a leaf node
+//		The distance to each point is computed by the distance
+//		kernel (see dist_kernel.h), which gives up as soon as the
+//		distance is known to exceed the radius.  The points in range
+//		are added to the k closest, or for range search, appended to
+//		the results.  Deleted points (in a dynamic tree) are skipped.
+//----------------------------------------------------------------------
+
+void ANNkd_leaf::ann_FR_search(ANNdist box_dist, ANNkdFRSearchCtx &ctx)
+{
+	ANNdist dist;						// distance to data point
 
-		if (d >= ANNkdFRDim &&					// among the k best?
+	const ANNcoord *lp = NULL;			// points in leaf order (if copied)
+	if (ctx.leaf_pts != NULL && n_pts > 0)
+		lp = ctx.leaf_pts + (size_t) (bkt - ctx.pidx) * ctx.dim;
+
+	for (int i = 0; i < n_pts; i++) {	// check points in bucket
+		if (annIsDeleted(ctx.deleted, bkt[i]))
+			continue;					// skip deleted points
+										// distance (if within radius)
+		dist = annDistBnd(ctx.dim,
+			(lp != NULL ? lp + i*ctx.dim : ctx.pts[bkt[i]]), ctx.q, ctx.sq_rad);
+
+		if (dist <= ctx.sq_rad &&				// within the radius?
 		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
-												// add it to the list
-			ANNkdFRPointMK->insert(dist, bkt[i]);
-			ANNkdFRPtsInRange++;				// increment point count
+			if (ctx.range_idx != NULL) {		// range search--append it
+				ctx.range_idx->push_back(bkt[i]);
+				ctx.range_dd->push_back(dist);
+			}
+			else {								// add it to the list
+				ctx.point_mk->insert(dist, bkt[i]);
+			}
+			ctx.pts_in_range++;					// increment point count
 		}
 	}
 	ANN_LEAF(1)							// one more leaf node visited
 	ANN_PTS(n_pts)						// increment points visited
-	ANNkdFRPtsVisited += n_pts;			// increment number of points visited
+	ctx.pts_visited += n_pts;			// increment number of points visited
 }
+
+ANN_NAMESPACE_END
@@ -20,6 +20,12 @@
 // History:
 //	Revision 1.1  05/03/05
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Replaced global search variables by a search context
+//		Added range search results to the context
+//		Added cell bounds for range counting
+//		Added outer radius for approximate range counting
+//		Added deleted point flags (for dynamic trees)
 //----------------------------------------------------------------------
 
 #ifndef ANN_kd_fix_rad_search_H
@@ -31,14 +37,89 @@
 
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Search context
+//		This holds the state which is active for the life of each call
+//		to annkFRSearch().  It is passed (by reference) among the
+//		various search procedures in place of the global variables used
+//		in earlier versions.  It is also used by annRangeSearch(), in
+//		which case range_idx and range_dd are not NULL, and the points
+//		in range are appended to them rather than to point_mk.
+//
+//		When annkFRSearch() is called with k = 0, it only counts the
+//		points in range, using ann_FR_count().  Each node's cell (or a
+//		box containing it) is then kept in cell_lo and cell_hi, and
+//		cell_stk holds bounds which are saved while the inner child of
+//		a shrinking node is searched.  A cell is counted whole if it
+//		lies within squared distance sq_rad_out.  This equals sq_rad
+//		for annkFRSearch(), and is larger for annApproxRangeCount().
+//
+//		If deleted is not NULL, the points marked in it (by index) are
+//		skipped.  This is used by dynamic trees (see dyn_tree.cpp),
+//		which do not count whole cells.
+//----------------------------------------------------------------------
+
+class ANNkdFRSearchCtx {
+public:
+	int					dim;			// dimension of space
+	ANNpoint			q;				// query point
+	ANNdist				sq_rad;			// squared radius search bound
+	ANNdist				sq_rad_out;		// squared radius for whole cells
+	double				max_err;		// max tolerable squared error
+	ANNpointArray		pts;			// the points
+	ANNidxArray			pidx;			// the point indices
+	ANNcoord			*leaf_pts;		// points in leaf order (or NULL)
+	const ANNmark		*deleted;		// deleted points (or NULL)
+	ANNmin_k			*point_mk;		// set of k closest points
+	std::vector<ANNidx>	*range_idx;		// points in range (or NULL)
+	std::vector<ANNdist> *range_dd;		// their distances (or NULL)
+	ANNcoord			*cell_lo;		// lower bounds of cell (counting)
+	ANNcoord			*cell_hi;		// upper bounds of cell (counting)
+	std::vector<ANNcoord> *cell_stk;	// saved bounds (counting)
+	int					pts_visited;	// total points visited
+	int					pts_in_range;	// number of points in the range
+};
+
 //----------------------------------------------------------------------
-//	Global variables
-//		These are active for the life of each call to
-//		annRangeSearch().  They are set to save the number of
-//		variables that need to be passed among the various search
-//		procedures.
+//	Range counting utilities
+//		annCellFarDist() returns the contribution of one coordinate to
+//		the distance from the query point to the farthest point of a
+//		cell, that is, to the farthest of the cell's bounds along this
+//		coordinate.  The sum over all coordinates is maintained
+//		incrementally as the search descends.
+//
+//		annCellInside() decides whether a cell whose farthest distance
+//		is far_dist lies entirely within the radius bound, so that all
+//		of its points may be counted without visiting them.  Because
+//		far_dist is maintained incrementally, it may be off by a few
+//		rounding errors.  So the test is made a little stricter, to be
+//		sure that every point of the cell would also have been found in
+//		range by computing its distance.  (If not, the cell is just
+//		searched.)  Points at distance zero are not counted unless
+//		ANN_ALLOW_SELF_MATCH is true, so counting is only done then.
 //----------------------------------------------------------------------
 
-extern ANNpoint			ANNkdFRQ;			// query point (static copy)
+const double ANN_CELL_TOL = 1e-9;		// relative tolerance for far dist
+
+inline ANNdist annCellFarDist(			// far dist along one coordinate
+	ANNcoord			qc,				// query coordinate
+	ANNcoord			lo,				// low bound of cell
+	ANNcoord			hi)				// high bound of cell
+{
+	ANNdist d_lo = (ANNdist) qc - (ANNdist) lo;
+	ANNdist d_hi = (ANNdist) hi - (ANNdist) qc;
+	return (ANNdist) ANN_POW(d_lo > d_hi ? d_lo : d_hi);
+}
+
+inline ANNbool annCellInside(			// is cell within radius bound?
+	ANNdist				far_dist,		// distance to farthest point
+	ANNdist				sq_rad)			// squared radius bound
+{
+	return (ANNbool) (far_dist * (1 + ANN_CELL_TOL) <= sq_rad);
+}
+
+ANN_NAMESPACE_END
 
 #endif
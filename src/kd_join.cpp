@@ -0,0 +1,319 @@
+//----------------------------------------------------------------------
+// File:			kd_join.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Range join of two kd-trees
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//		Changed to a dual-tree traversal
+//----------------------------------------------------------------------
+
+#include "kd_join.h"					// range join declarations
+#include "dist_kernel.h"				// distance kernels
+#include "thread_pool.h"				// parallel loops
+
+#include <mutex>						// serializing callbacks
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Range join (dual-tree)
+//		annRangeJoin() finds all pairs (i, j) where i is a point of
+//		this tree and j is a point of another tree (which may be the
+//		same one), such that the distance between them is at most a
+//		given radius r.  Rather than running a fixed-radius search in
+//		this tree for each point of the other one, it traverses the
+//		two trees together, visiting pairs of nodes, one from each
+//		tree, starting with the pair of roots.
+//
+//		The two trees are first flattened, and the bounding box of
+//		the points of each subtree is computed (see kd_join.h).  A
+//		pair of nodes is pruned, along with all the pairs of nodes of
+//		their subtrees, if the distance between their boxes is greater
+//		than r/(1+eps).  If the maximum distance between the boxes is
+//		at most r, all pairs of points of the two subtrees are in
+//		range, and no more boxes are checked below this pair.
+//		Otherwise, the node with more points (or the one which is not
+//		a leaf) is split, and each of its children is paired with the
+//		other node.  Here a subtree with at most ANN_JOIN_GROUP points
+//		counts as a leaf.  When both nodes are leaves, their points
+//		are compared, and the pairs within distance r are reported.  So
+//		every pair within distance r/(1+eps) is reported, and no pair
+//		farther than r.  (With eps = 0, exactly the pairs within
+//		distance r are reported.)  Points deleted from either tree are
+//		skipped.
+//
+//		For the parallel join, the pairs of nodes are first expanded
+//		(by the calling thread) to a fixed depth.  The pairs reached at
+//		that depth are collected as tasks, which are divided among the
+//		threads of the ANN thread pool (see thread_pool.h).  The pairs
+//		of points are collected in per-thread buffers, and passed to
+//		the callback in chunks.  The calls to the callback are
+//		serialized, so the callback need not be thread-safe.  The
+//		order of the pairs is unspecified.
+//----------------------------------------------------------------------
+
+class ANNjoinFlusher {					// passes pairs to callback
+public:
+	ANNjoinCallback		callback;		// the callback
+	void				*data;			// its user data
+	size_t				n_pairs;		// total pairs passed
+	std::mutex			lock;			// serializes the calls
+};
+
+void annJoinFlush(						// pass pairs to callback
+	ANNkdJoinCtx		&ctx)			// search context
+{
+	int n = (int) ctx.res_idx.size();
+	if (n == 0) return;					// nothing to pass
+	{
+		std::lock_guard<std::mutex> guard(ctx.flusher->lock);
+		(*ctx.flusher->callback)(n, &ctx.res_idx[0], &ctx.res_oidx[0],
+					&ctx.res_dd[0], ctx.flusher->data);
+		ctx.flusher->n_pairs += n;
+	}
+	ctx.res_idx.clear();
+	ctx.res_oidx.clear();
+	ctx.res_dd.clear();
+}
+
+//----------------------------------------------------------------------
+//	annJoinPrepare - flatten a tree and compute its boxes
+//		In the preorder layout, the children of a node follow it, so
+//		the boxes are computed from the last node to the first.
+//----------------------------------------------------------------------
+
+static void annJoinPrepare(
+	ANNkd_node			*root,			// root of the tree
+	ANNpointArray		pts,			// its points
+	const ANNmark		*deleted,		// its deleted points (or NULL)
+	int					dim,			// dimension of space
+	ANNjoinTree			&jt)			// the join tree (returned)
+{
+	jt.pts = pts;
+	jt.fb.deleted = deleted;
+	root->flatten(jt.fb);				// flatten in preorder
+	int n_nodes = (int) jt.fb.nodes.size();
+	jt.cnt.resize(n_nodes);
+	jt.first.resize(n_nodes);
+	jt.box.resize((size_t) 2*n_nodes*dim);
+
+	for (int k = n_nodes-1; k >= 0; k--) {
+		const ANNflatNode &nd = jt.fb.nodes[k];
+		ANNcoord *lo = &jt.box[(size_t) 2*k*dim];
+		ANNcoord *hi = lo + dim;
+		if (nd.kind == ANN_FLAT_LEAF) {	// box of leaf's points
+			jt.cnt[k] = nd.n;
+			jt.first[k] = nd.first;
+			for (int i = 0; i < nd.n; i++) {
+				ANNpoint p = pts[jt.fb.idx[nd.first+i]];
+				for (int d = 0; d < dim; d++) {
+					if (i == 0 || p[d] < lo[d]) lo[d] = p[d];
+					if (i == 0 || p[d] > hi[d]) hi[d] = p[d];
+				}
+			}
+		}
+		else {							// union of children's boxes
+			jt.cnt[k] = 0;
+			jt.first[k] = jt.first[nd.child[0]];
+			for (int c = 0; c < 2; c++) {
+				int ch = nd.child[c];
+				if (jt.cnt[ch] == 0) continue;	// (no box)
+				const ANNcoord *c_lo = &jt.box[(size_t) 2*ch*dim];
+				const ANNcoord *c_hi = c_lo + dim;
+				for (int d = 0; d < dim; d++) {
+					if (jt.cnt[k] == 0 || c_lo[d] < lo[d]) lo[d] = c_lo[d];
+					if (jt.cnt[k] == 0 || c_hi[d] > hi[d]) hi[d] = c_hi[d];
+				}
+				jt.cnt[k] += jt.cnt[ch];
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+//	annJoinLeaves - compare the points of two leaves
+//		The leaves may be whole subtrees of at most ANN_JOIN_GROUP
+//		points.  The points of leaf a which are too far from b's box are
+//		skipped.  The others are compared with each point of b, using
+//		the distance kernel as in the fixed-radius search.
+//----------------------------------------------------------------------
+
+static void annJoinLeaves(
+	int					a,				// leaf of this tree
+	int					b,				// leaf of the other tree
+	ANNbool				all_in,			// all pairs in range?
+	ANNkdJoinCtx		&ctx)			// search context
+{
+	int dim = ctx.dim;
+	int n_a = ctx.jt->cnt[a];
+	int n_b = ctx.ojt->cnt[b];
+	const ANNidx *a_idx = &ctx.jt->fb.idx[ctx.jt->first[a]];
+	const ANNidx *b_idx = &ctx.ojt->fb.idx[ctx.ojt->first[b]];
+	ANNpoint b_lo = (ANNpoint) &ctx.ojt->box[(size_t) 2*b*dim];
+
+	for (int i = 0; i < n_a; i++) {	// for each point of a
+		ANNpoint p = ctx.jt->pts[a_idx[i]];
+		if (!all_in &&
+			annBoxDistance(p, b_lo, b_lo + dim, dim) * ctx.max_err
+					> ctx.sq_rad)
+			continue;					// too far from b
+		for (int j = 0; j < n_b; j++) {	// ...against each of b
+										// distance (if not too far)
+			ANNdist dist = annDistBnd(dim, p, ctx.ojt->pts[b_idx[j]],
+						ctx.sq_rad);
+			if (dist <= ctx.sq_rad) {	// in range?
+				ctx.res_idx.push_back(a_idx[i]);
+				ctx.res_oidx.push_back(b_idx[j]);
+				ctx.res_dd.push_back(dist);
+				if ((int) ctx.res_idx.size() >= ANN_JOIN_CHUNK)
+					annJoinFlush(ctx);
+			}
+		}
+		ANN_PTS(n_b)					// increment points visited
+	}
+	ANN_LEAF(2)							// two more leaf nodes visited
+}
+
+//----------------------------------------------------------------------
+//	annJoinPair - visit a pair of nodes
+//		Unless the pair is pruned (or added to the task list), one of
+//		the nodes is split, or the points of two leaves are compared.
+//----------------------------------------------------------------------
+
+static void annJoinPair(
+	int					a,				// node of this tree
+	int					b,				// node of the other tree
+	ANNbool				all_in,			// all pairs in range?
+	int					depth,			// splits from the roots
+	ANNkdJoinCtx		&ctx)			// search context
+{
+	const ANNjoinTree &jt = *ctx.jt;
+	const ANNjoinTree &ojt = *ctx.ojt;
+	if (jt.cnt[a] == 0 || ojt.cnt[b] == 0) return;	// no points to pair
+
+	if (!all_in) {						// check distances between boxes
+		ANNdist near_dist, far_dist;
+		annJoinBoxes(ctx.dim, &jt.box[(size_t) 2*a*ctx.dim],
+					&ojt.box[(size_t) 2*b*ctx.dim], near_dist, far_dist);
+		if (near_dist * ctx.max_err > ctx.sq_rad)
+			return;						// boxes too far apart
+		if (far_dist <= ctx.sq_rad)		// all pairs in range
+			all_in = ANNtrue;
+	}
+
+	if (ctx.tasks != NULL && depth >= ctx.tasks->depth) {
+		ANNjoinTask t;					// save pair as a task
+		t.a = a;
+		t.b = b;
+		t.all_in = all_in;
+		ctx.tasks->tasks.push_back(t);
+		return;
+	}
+
+	const ANNflatNode &na = jt.fb.nodes[a];
+	const ANNflatNode &nb = ojt.fb.nodes[b];
+	ANNbool a_leaf = (ANNbool) (na.kind == ANN_FLAT_LEAF
+						|| jt.cnt[a] <= ANN_JOIN_GROUP);
+	ANNbool b_leaf = (ANNbool) (nb.kind == ANN_FLAT_LEAF
+						|| ojt.cnt[b] <= ANN_JOIN_GROUP);
+	if (a_leaf && b_leaf) {				// compare points
+		annJoinLeaves(a, b, all_in, ctx);
+	}
+	else if (b_leaf || (!a_leaf && jt.cnt[a] >= ojt.cnt[b])) {
+		ANN_SPL(1)						// split a
+		annJoinPair(na.child[0], b, all_in, depth+1, ctx);
+		annJoinPair(na.child[1], b, all_in, depth+1, ctx);
+	}
+	else {
+		ANN_SPL(1)						// split b
+		annJoinPair(a, nb.child[0], all_in, depth+1, ctx);
+		annJoinPair(a, nb.child[1], all_in, depth+1, ctx);
+	}
+}
+
+size_t ANNkd_tree::annRangeJoin(
+	ANNkd_tree			&other,			// the other tree
+	ANNdist				sqRad,			// squared radius bound
+	ANNjoinCallback		callback,		// receives the pairs
+	void				*data,			// passed to callback
+	double				eps,			// error bound
+	int					n_threads)		// number of threads (<= 0 for all)
+{
+	if (other.dim != dim) {				// different dimensions?
+		annError("Joining trees of different dimensions", ANNabort);
+	}
+	if (n_pts == 0 || other.n_pts == 0) return 0;	// no pairs
+
+	ANNjoinFlusher flusher;				// passes pairs to callback
+	flusher.callback = callback;
+	flusher.data = data;
+	flusher.n_pairs = 0;
+
+	ANNjoinTree jt;						// the trees, prepared
+	ANNjoinTree ojt;
+	annJoinPrepare(root, pts, deleted, dim, jt);
+	if (&other != this)					// (a self join needs just one)
+		annJoinPrepare(other.root, other.pts, other.deleted, dim, ojt);
+	const ANNjoinTree *o_jt = (&other != this ? &ojt : &jt);
+
+	double max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+
+	auto init = [&](ANNkdJoinCtx &ctx) {	// initialize a context
+		ctx.dim = dim;
+		ctx.sq_rad = sqRad;
+		ctx.max_err = max_err;
+		ctx.jt = &jt;
+		ctx.ojt = o_jt;
+		ctx.res_idx.reserve(ANN_JOIN_CHUNK);
+		ctx.res_oidx.reserve(ANN_JOIN_CHUNK);
+		ctx.res_dd.reserve(ANN_JOIN_CHUNK);
+		ctx.flusher = &flusher;
+		ctx.tasks = NULL;
+	};
+
+	ANNjoinTaskList task_list;			// pairs left to the threads
+	task_list.depth = 0;
+	int n_thr = annNumThreads(n_threads, n_pts + other.n_pts);
+
+	ANNkdJoinCtx ctx;					// context for the first levels
+	init(ctx);
+	if (n_thr > 1) {					// expand to depth for n_thr
+		while ((1 << task_list.depth) < n_thr*ANN_JOIN_TASKS_PER_THR)
+			task_list.depth++;
+		ctx.tasks = &task_list;
+	}
+	annJoinPair(0, 0, ANNfalse, 0, ctx);	// start with the roots
+	annJoinFlush(ctx);					// pass pairs found so far
+
+	int n_tasks = (int) task_list.tasks.size();
+	annParallelFor(n_tasks, n_thr, [&](int t_lo, int t_hi) {
+		ANNkdJoinCtx t_ctx;				// context for these tasks
+		init(t_ctx);
+		for (int k = t_lo; k < t_hi; k++) {
+			const ANNjoinTask &t = task_list.tasks[k];
+			annJoinPair(t.a, t.b, t.all_in, task_list.depth, t_ctx);
+		}
+		annJoinFlush(t_ctx);			// pass remaining pairs
+	});
+
+	return flusher.n_pairs;
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,157 @@
+//----------------------------------------------------------------------
+// File:			kd_join.h
+// Programmer:		Sunil Arya and David Mount
+// Description:		Range join of two trees
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//		Changed to a dual-tree traversal
+//----------------------------------------------------------------------
+
+#ifndef ANN_kd_join_H
+#define ANN_kd_join_H
+
+#include <vector>						// result buffers
+#include "kd_tree.h"					// kd-tree declarations
+#include "kd_util.h"					// kd-tree utilities
+#include "flat_tree.h"					// flattened trees
+
+#include <ANN/ANNperf.h>				// performance evaluation
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Join constants
+//		For a parallel join, the pairs of nodes are first expanded (by
+//		the calling thread) to a depth at which there are about
+//		ANN_JOIN_TASKS_PER_THR pairs per thread, and these are then
+//		divided among the threads.  The pairs of points found are
+//		passed to the callback in chunks of up to ANN_JOIN_CHUNK.
+//		Subtrees with at most ANN_JOIN_GROUP points are not split
+//		further, but treated as leaves (their points are compared
+//		directly), since splitting such small boxes rarely prunes
+//		enough pairs to repay the box tests.
+//----------------------------------------------------------------------
+
+const int ANN_JOIN_TASKS_PER_THR = 16;	// target pairs per thread
+const int ANN_JOIN_CHUNK	= 1024;		// max pairs per callback
+const int ANN_JOIN_GROUP	= 32;		// max points in a join leaf
+
+//----------------------------------------------------------------------
+//	Join trees
+//		Each of the two trees of a join is first flattened in preorder
+//		(see flat_tree.h), leaving out its deleted points, so that its
+//		nodes can be referred to by index.  For each node we then find
+//		the number of points in its subtree (cnt) and the bounding box
+//		of these points (entries 2*k*dim through 2*k*dim+dim-1 of box
+//		for the low corner of node k, followed by the high corner).
+//		The box is unused if the subtree has no points.  In preorder
+//		the points of a subtree are contiguous in fb.idx, starting at
+//		entry first[k].
+//----------------------------------------------------------------------
+
+class ANNjoinTree {
+public:
+	ANNflatBuilder		fb;				// the flattened tree
+	std::vector<int>	cnt;			// points in each subtree
+	std::vector<int>	first;			// their first index in fb.idx
+	std::vector<ANNcoord> box;			// their bounding boxes
+	ANNpointArray		pts;			// the points
+};
+
+//----------------------------------------------------------------------
+//	Join tasks
+//		A pair of nodes (a of the tree being searched, b of the other
+//		tree) whose traversal is left to the threads.  all_in is true
+//		if all pairs of points of the two subtrees are known to be
+//		within range.
+//----------------------------------------------------------------------
+
+class ANNjoinTask {
+public:
+	int					a;				// node of this tree
+	int					b;				// node of the other tree
+	ANNbool				all_in;			// all pairs in range?
+};
+
+class ANNjoinTaskList {
+public:
+	std::vector<ANNjoinTask> tasks;		// the tasks
+	int					depth;			// depth at which tasks are made
+};
+
+//----------------------------------------------------------------------
+//	Join search context
+//		This holds the state of one thread's traversal of pairs of
+//		nodes.  The pairs found are appended to the buffers (res_idx,
+//		res_oidx, res_dd), which are flushed by annJoinFlush() when
+//		they hold ANN_JOIN_CHUNK pairs.  If tasks is not NULL, pairs of
+//		nodes at depth tasks->depth are added to the task list rather
+//		than being traversed.
+//----------------------------------------------------------------------
+
+class ANNjoinFlusher;					// passes pairs to callback
+
+class ANNkdJoinCtx {
+public:
+	int					dim;			// dimension of space
+	ANNdist				sq_rad;			// squared radius bound
+	double				max_err;		// max tolerable squared error
+	const ANNjoinTree	*jt;			// this tree
+	const ANNjoinTree	*ojt;			// the other tree
+	std::vector<ANNidx>	res_idx;		// pairs found (this tree)
+	std::vector<ANNidx>	res_oidx;		// ...(other tree)
+	std::vector<ANNdist> res_dd;		// ...and their squared distances
+	ANNjoinFlusher		*flusher;		// passes pairs to callback
+	ANNjoinTaskList		*tasks;			// task list (or NULL)
+};
+
+//----------------------------------------------------------------------
+//	Join utilities
+//		annJoinBoxes() computes the distances between two boxes: the
+//		minimum (near_dist) and the maximum (far_dist) distance between
+//		a point of one and a point of the other.  annJoinFlush() passes
+//		the pairs in the buffers to the callback, and empties them.
+//----------------------------------------------------------------------
+
+inline void annJoinBoxes(				// distances between boxes
+	int					dim,			// dimension of space
+	const ANNcoord		*a,				// first box (lo, then hi)
+	const ANNcoord		*b,				// second box
+	ANNdist				&near_dist,		// min distance (returned)
+	ANNdist				&far_dist)		// max distance (returned)
+{
+	near_dist = far_dist = 0;
+	for (int d = 0; d < dim; d++) {
+		ANNcoord g0 = a[d] - b[dim+d];	// gaps between the boxes
+		ANNcoord g1 = b[d] - a[dim+d];
+		ANNcoord g = (g0 > g1 ? g0 : g1);
+		if (g > 0) near_dist = (ANNdist) ANN_SUM(near_dist, ANN_POW(g));
+		ANNcoord f0 = a[dim+d] - b[d];	// farthest extents
+		ANNcoord f1 = b[dim+d] - a[d];
+		far_dist = (ANNdist) ANN_SUM(far_dist, ANN_POW(f0 > f1 ? f0 : f1));
+	}
+	ANN_FLOP(8*dim)						// increment floating ops
+}
+
+void annJoinFlush(						// pass pairs to callback
+	ANNkdJoinCtx		&ctx);			// search context
+
+ANN_NAMESPACE_END
+
+#endif
@@ -20,9 +20,18 @@
 // History:
 //	Revision 0.1  03/04/98
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Replaced global search variables by a search context
+//		Leaf distances are computed by the distance kernel
+//		Point set and box queue are taken from the thread's scratch
+//		Leaves skip deleted points
 //----------------------------------------------------------------------
 
 #include "kd_pr_search.h"				// kd priority search declarations
+#include "dist_kernel.h"				// distance kernels
+#include "search_scratch.h"				// per-thread search scratch
+
+ANN_NAMESPACE_BEGIN
 
 //----------------------------------------------------------------------
 //	Approximate nearest neighbor searching by priority search.
@@ -67,19 +76,11 @@
 //----------------------------------------------------------------------
 
 //----------------------------------------------------------------------
-//		To keep argument lists short, a number of global variables
-//		are maintained which are common to all the recursive calls.
-//		These are given below.
+//		To keep argument lists short, the information which is common
+//		to all the recursive calls is stored in a search context (see
+//		kd_pr_search.h), which is passed to each of the recursive calls.
 //----------------------------------------------------------------------
 
-double			ANNprEps;				// the error bound
-int				ANNprDim;				// dimension of space
-ANNpoint		ANNprQ;					// query point
-double			ANNprMaxErr;			// max tolerable squared error
-ANNpointArray	ANNprPts;				// the points
-ANNpr_queue		*ANNprBoxPQ;			// priority queue for boxes
-ANNmin_k		*ANNprPointMK;			// set of k closest points
-
 //----------------------------------------------------------------------
 //	annkPriSearch - priority search for k nearest neighbors
 //----------------------------------------------------------------------
@@ -91,59 +92,65 @@ void ANNkd_tree::annkPriSearch(
 	ANNdistArray		dd,				// dist to near neighbors (returned)
 	double				eps)			// error bound (ignored)
 {
+	ANNprSearchCtx ctx;					// context for this search
 										// max tolerable squared error
-	ANNprMaxErr = ANN_POW(1.0 + eps);
+	ctx.max_err = ANN_POW(1.0 + eps);
 	ANN_FLOP(2)							// increment floating ops
 
-	ANNprDim = dim;						// copy arguments to static equivs
-	ANNprQ = q;
-	ANNprPts = pts;
-	ANNptsVisited = 0;					// initialize count of points visited
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.pts = pts;
+	ctx.pidx = pidx;					// ...and points in leaf order
+	ctx.leaf_pts = (leaf_pts != NULL ? leaf_pts[0] : NULL);
+	ctx.deleted = deleted;				// (skip deleted points)
+	ctx.pts_visited = 0;				// initialize count of points visited
 
-	ANNprPointMK = new ANNmin_k(k);		// create set for closest k points
+	ANNsearchScratch *scr = annGetScratch();
+	scr->point_mk.reset(k);				// set for closest k points
+	ctx.point_mk = &scr->point_mk;
 
 										// distance to root box
 	ANNdist box_dist = annBoxDistance(q,
 				bnd_box_lo, bnd_box_hi, dim);
 
-	ANNprBoxPQ = new ANNpr_queue(n_pts);// create priority queue for boxes
-	ANNprBoxPQ->insert(box_dist, root); // insert root in priority queue
+	scr->box_pq.reset(n_pts);			// priority queue for boxes
+	ctx.box_pq = &scr->box_pq;
+	ctx.box_pq->insert(box_dist, root); // insert root in priority queue
 
-	while (ANNprBoxPQ->non_empty() &&
-		(!(ANNmaxPtsVisited != 0 && ANNptsVisited > ANNmaxPtsVisited))) {
+	while (ctx.box_pq->non_empty() &&
+		(!(ANNmaxPtsVisited != 0 && ctx.pts_visited > ANNmaxPtsVisited))) {
 		ANNkd_ptr np;					// next box from prior queue
 
 										// extract closest box from queue
-		ANNprBoxPQ->extr_min(box_dist, (void *&) np);
+		ctx.box_pq->extr_min(box_dist, (void *&) np);
 
 		ANN_FLOP(2)						// increment floating ops
-		if (box_dist*ANNprMaxErr >= ANNprPointMK->max_key())
+		if (box_dist*ctx.max_err >= ctx.point_mk->max_key())
 			break;
 
-		np->ann_pri_search(box_dist);	// search this subtree.
+		np->ann_pri_search(box_dist, ctx);	// search this subtree.
 	}
 
 	for (int i = 0; i < k; i++) {		// extract the k-th closest points
-		dd[i] = ANNprPointMK->ith_smallest_key(i);
-		nn_idx[i] = ANNprPointMK->ith_smallest_info(i);
+		dd[i] = ctx.point_mk->ith_smallest_key(i);
+		nn_idx[i] = ctx.point_mk->ith_smallest_info(i);
 	}
 
-	delete ANNprPointMK;				// deallocate closest point set
-	delete ANNprBoxPQ;					// deallocate priority queue
+	annReleaseScratch(scr);				// done with scratch
 }
 
 //----------------------------------------------------------------------
 //	kd_split::ann_pri_search - search a splitting node
 //----------------------------------------------------------------------
 
-void ANNkd_split::ann_pri_search(ANNdist box_dist)
+void ANNkd_split::ann_pri_search(ANNdist box_dist, ANNprSearchCtx &ctx)
 {
 	ANNdist new_dist;					// distance to child visited later
 										// distance to cutting plane
-	ANNcoord cut_diff = ANNprQ[cut_dim] - cut_val;
+	ANNcoord cut_diff = ctx.q[cut_dim] - cut_val;
 
 	if (cut_diff < 0) {					// left of cutting plane
-		ANNcoord box_diff = cd_bnds[ANN_LO] - ANNprQ[cut_dim];
+		ANNcoord box_diff = cd_bnds[ANN_LO] - ctx.q[cut_dim];
 		if (box_diff < 0)				// within bounds - ignore
 			box_diff = 0;
 										// distance to further box
@@ -151,12 +158,12 @@ void ANNkd_split::ann_pri_search(ANNdist box_dist)
 				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
 
 		if (child[ANN_HI] != KD_TRIVIAL)// enqueue if not trivial
-			ANNprBoxPQ->insert(new_dist, child[ANN_HI]);
+			ctx.box_pq->insert(new_dist, child[ANN_HI]);
 										// continue with closer child
-		child[ANN_LO]->ann_pri_search(box_dist);
+		child[ANN_LO]->ann_pri_search(box_dist, ctx);
 	}
 	else {								// right of cutting plane
-		ANNcoord box_diff = ANNprQ[cut_dim] - cd_bnds[ANN_HI];
+		ANNcoord box_diff = ctx.q[cut_dim] - cd_bnds[ANN_HI];
 		if (box_diff < 0)				// within bounds - ignore
 			box_diff = 0;
 										// distance to further box
@@ -164,9 +171,9 @@ void ANNkd_split::ann_pri_search(ANNdist box_dist)
 				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
 
 		if (child[ANN_LO] != KD_TRIVIAL)// enqueue if not trivial
-			ANNprBoxPQ->insert(new_dist, child[ANN_LO]);
+			ctx.box_pq->insert(new_dist, child[ANN_LO]);
 										// continue with closer child
-		child[ANN_HI]->ann_pri_search(box_dist);
+		child[ANN_HI]->ann_pri_search(box_dist, ctx);
 	}
 	ANN_SPL(1)							// one more splitting node visited
 	ANN_FLOP(8)							// increment floating ops
@@ -178,42 +185,34 @@ void ANNkd_split::ann_pri_search(ANNdist box_dist)
 //		This is virtually identical to the ann_search for standard search.
 //----------------------------------------------------------------------
 
-void ANNkd_leaf::ann_pri_search(ANNdist box_dist)
+void ANNkd_leaf::ann_pri_search(ANNdist box_dist, ANNprSearchCtx &ctx)
 {
 	register ANNdist dist;				// distance to data point
-	register ANNcoord* pp;				// data coordinate pointer
-	register ANNcoord* qq;				// query coordinate pointer
 	register ANNdist min_dist;			// distance to k-th closest point
-	register ANNcoord t;
-	register int d;
-
-	min_dist = ANNprPointMK->max_key(); // k-th smallest distance so far
-
-	for (int i = 0; i < n_pts; i++) {	// check points in bucket
 
-		pp = ANNprPts[bkt[i]];			// first coord of next data point
-		qq = ANNprQ;					// first coord of query point
-		dist = 0;
+	min_dist = ctx.point_mk->max_key(); // k-th smallest distance so far
 
-		for(d = 0; d < ANNprDim; d++) {
-			ANN_COORD(1)				// one more coordinate hit
-			ANN_FLOP(4)					// increment floating ops
+	const ANNcoord *lp = NULL;			// points in leaf order (if copied)
+	if (ctx.leaf_pts != NULL && n_pts > 0)
+		lp = ctx.leaf_pts + (size_t) (bkt - ctx.pidx) * ctx.dim;
 
-			t = *(qq++) - *(pp++);		// compute length and adv coordinate
-										// exceeds dist to k-th smallest?
-			if( (dist = ANN_SUM(dist, ANN_POW(t))) > min_dist) {
-				break;
-			}
-		}
+	for (int i = 0; i < n_pts; i++) {	// check points in bucket
+		if (annIsDeleted(ctx.deleted, bkt[i]))
+			continue;					// skip deleted points
+										// distance (if not too far)
+		dist = annDistBnd(ctx.dim,
+			(lp != NULL ? lp + i*ctx.dim : ctx.pts[bkt[i]]), ctx.q, min_dist);
 
-		if (d >= ANNprDim &&					// among the k best?
+		if (dist <= min_dist &&					// among the k best?
 		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
 												// add it to the list
-			ANNprPointMK->insert(dist, bkt[i]);
-			min_dist = ANNprPointMK->max_key();
+			ctx.point_mk->insert(dist, bkt[i]);
+			min_dist = ctx.point_mk->max_key();
 		}
 	}
 	ANN_LEAF(1)							// one more leaf node visited
 	ANN_PTS(n_pts)						// increment points visited
-	ANNptsVisited += n_pts;				// increment number of points visited
+	ctx.pts_visited += n_pts;			// increment number of points visited
 }
+
+ANN_NAMESPACE_END
@@ -20,6 +20,9 @@
 // History:
 //	Revision 0.1  03/04/98
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Replaced global search variables by a search context
+//		Added deleted points to search context
 //----------------------------------------------------------------------
 
 #ifndef ANN_kd_pr_search_H
@@ -32,18 +35,29 @@
 
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
-//	Global variables
-//		Active for the life of each call to Appx_Near_Neigh() or
-//		Appx_k_Near_Neigh().
+//	Search context
+//		Active for the life of each call to annkPriSearch().  It is
+//		passed (by reference) among the various search procedures in
+//		place of the global variables used in earlier versions.
 //----------------------------------------------------------------------
 
-extern double			ANNprEps;		// the error bound
-extern int				ANNprDim;		// dimension of space
-extern ANNpoint			ANNprQ;			// query point
-extern double			ANNprMaxErr;	// max tolerable squared error
-extern ANNpointArray	ANNprPts;		// the points
-extern ANNpr_queue		*ANNprBoxPQ;	// priority queue for boxes
-extern ANNmin_k			*ANNprPointMK;	// set of k closest points
+class ANNprSearchCtx {
+public:
+	int					dim;			// dimension of space
+	ANNpoint			q;				// query point
+	double				max_err;		// max tolerable squared error
+	ANNpointArray		pts;			// the points
+	ANNidxArray			pidx;			// the point indices
+	ANNcoord			*leaf_pts;		// points in leaf order (or NULL)
+	const ANNmark		*deleted;		// deleted points (or NULL)
+	ANNpr_queue			*box_pq;		// priority queue for boxes
+	ANNmin_k			*point_mk;		// set of k closest points
+	int					pts_visited;	// number of points visited
+};
+
+ANN_NAMESPACE_END
 
 #endif
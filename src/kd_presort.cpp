@@ -0,0 +1,293 @@
+//----------------------------------------------------------------------
+// File:			kd_presort.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Presorted construction of kd-trees (standard split)
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "thread_pool.h"				// parallel loops
+
+#include <vector>						// sorted lists and buffers
+#include <algorithm>					// std::sort
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Presorted construction
+//		This builds a kd-tree with the standard splitting rule (see
+//		kd_split() in kd_split.cpp), which cuts each cell along the
+//		dimension of greatest spread of its points, at their median.
+//		Rather than finding these by scanning the points of each cell,
+//		we sort the point indices along each dimension once, at the
+//		start.  The points of a cell are always those of a subarray
+//		[lo, lo+n) of each of these lists, in sorted order.  So the
+//		spread along dimension d is just the difference of the last
+//		and first coordinates of subarray d, and the median along the
+//		cutting dimension is in the middle of its subarray.  The points
+//		are assigned to the two sides of the cut by their positions in
+//		the list of the cutting dimension.  The other lists are then
+//		divided by a stable partition (which keeps them sorted), using
+//		a mark (side) for each point.  At a leaf, the indices of its
+//		points are copied from the first list into the tree's array.
+//
+//		The cutting dimensions and values are the same as those of
+//		kd_split(), but when several points have the median coordinate
+//		the ones which go to each side may differ, and the points of
+//		each leaf may be in a different order.  (Ties in the sorted
+//		lists are broken by the point index.)
+//
+//		As in rkd_tree_par(), with more than one thread the top levels
+//		are built first (dividing the lists of the different dimensions
+//		in parallel), and the subtrees below them are built as tasks.
+//		The tasks work on disjoint subarrays of the lists, and mark
+//		disjoint sets of points.  The initial sorts are done in
+//		parallel, one dimension at a time.
+//----------------------------------------------------------------------
+
+class ANNsortedLists {					// presorted point lists
+public:
+	ANNpointArray		pa;				// point array
+	int					dim;			// dimension of space
+	int					bsp;			// bucket space
+	ANNidxArray			pidx;			// tree's point indices (output)
+	ANNidxArray			*sorted;		// indices sorted along each dim
+	char				*side;			// side of cut (by point index)
+};
+
+class ANNsortEnt {						// entry in sorting buffer
+public:
+	ANNcoord			c;				// coordinate
+	ANNidx				idx;			// point index
+};
+
+//----------------------------------------------------------------------
+//	annPresortSplit - split the cell with subarray [lo, lo+n)
+//		Returns the number of points on the low side, and the cutting
+//		dimension and value.  tmp has space for n indices (it is only
+//		used if n_thr is 1; otherwise each thread has its own).
+//----------------------------------------------------------------------
+
+static int annPresortSplit(
+	ANNsortedLists		&ps,			// the sorted lists
+	int					lo,				// start of subarray
+	int					n,				// number of points
+	int					&cd,			// cutting dimension (returned)
+	ANNcoord			&cv,			// cutting value (returned)
+	ANNidxArray			tmp,			// temporary space
+	int					n_thr)			// number of threads
+{
+	ANNpointArray pa = ps.pa;
+	ANNcoord max_spr = 0;				// find dimension of max spread
+	cd = 0;
+	for (int d = 0; d < ps.dim; d++) {
+		ANNcoord spr = pa[ps.sorted[d][lo+n-1]][d] - pa[ps.sorted[d][lo]][d];
+		if (spr > max_spr) {
+			max_spr = spr;
+			cd = d;
+		}
+	}
+	int n_lo = n/2;						// split about the median
+	ANNidxArray s = ps.sorted[cd] + lo;
+	cv = (pa[s[n_lo-1]][cd] + pa[s[n_lo]][cd])/2.0;
+	for (int i = 0; i < n; i++) {		// mark sides
+		ps.side[s[i]] = (i < n_lo ? ANN_LO : ANN_HI);
+	}
+										// divide the other lists
+	auto divide = [&](int d, ANNidxArray t) {
+		ANNidxArray s = ps.sorted[d] + lo;
+		int k_lo = 0, k_hi = 0;
+		for (int i = 0; i < n; i++) {
+			if (ps.side[s[i]] == ANN_LO) s[k_lo++] = s[i];
+			else t[k_hi++] = s[i];
+		}
+		for (int i = 0; i < k_hi; i++) s[k_lo+i] = t[i];
+	};
+	if (n_thr <= 1) {
+		for (int d = 0; d < ps.dim; d++) {
+			if (d != cd) divide(d, tmp);
+		}
+	}
+	else {
+		annParallelFor(ps.dim, n_thr, [&](int d_lo, int d_hi) {
+			std::vector<ANNidx> t(n);	// temporary space for this thread
+			for (int d = d_lo; d < d_hi; d++) {
+				if (d != cd) divide(d, &t[0]);
+			}
+		});
+	}
+	return n_lo;
+}
+
+//----------------------------------------------------------------------
+//	rkd_presort - recursive presorted construction of a subtree
+//		This is like rkd_tree(), for the cell with subarray [lo, lo+n)
+//		of the sorted lists.
+//----------------------------------------------------------------------
+
+static ANNkd_ptr rkd_presort(
+	ANNsortedLists		&ps,			// the sorted lists
+	int					lo,				// start of subarray
+	int					n,				// number of points
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	ANNidxArray			tmp)			// temporary space (for n indices)
+{
+	if (n <= ps.bsp) {					// n small, make a leaf node
+		if (n == 0)						// empty leaf node
+			return KD_TRIVIAL;			// return (canonical) empty leaf
+		for (int i = 0; i < n; i++) {	// copy its point indices
+			ps.pidx[lo+i] = ps.sorted[0][lo+i];
+		}
+		return new ANNkd_leaf(n, ps.pidx + lo);
+	}
+	int cd;								// cutting dimension
+	ANNcoord cv;						// cutting value
+	int n_lo = annPresortSplit(ps, lo, n, cd, cv, tmp, 1);
+
+	ANNcoord lv = bnd_box.lo[cd];		// save bounds for cutting dimension
+	ANNcoord hv = bnd_box.hi[cd];
+
+	bnd_box.hi[cd] = cv;				// build left subtree
+	ANNkd_ptr lo_child = rkd_presort(ps, lo, n_lo, bnd_box, tmp);
+	bnd_box.hi[cd] = hv;
+
+	bnd_box.lo[cd] = cv;				// build right subtree
+	ANNkd_ptr hi_child = rkd_presort(ps, lo + n_lo, n - n_lo, bnd_box, tmp);
+	bnd_box.lo[cd] = lv;
+										// create the splitting node
+	return new ANNkd_split(cd, cv, lv, hv, lo_child, hi_child);
+}
+
+//----------------------------------------------------------------------
+//	rkd_presort_top - build top levels of a presorted tree
+//		This is like rkd_tree_top() in kd_tree.cpp.
+//----------------------------------------------------------------------
+
+static void rkd_presort_top(
+	ANNsortedLists		&ps,			// the sorted lists
+	int					lo,				// start of subarray
+	int					n,				// number of points
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	int					n_thr,			// number of threads
+	int					cutoff,			// max points for a task
+	std::vector<ANNkdBuildTop> &top,	// top nodes (appended)
+	std::vector<ANNkdBuildTask> &tasks)	// tasks (appended)
+{
+	ANNkdBuildTop nd;
+	if (n <= cutoff || n <= ps.bsp) {	// small enough for a task
+		nd.task = annAddBuildTask(ps.pidx + lo, n, ps.dim, bnd_box, tasks);
+		nd.cd = 0;
+		nd.cv = nd.lv = nd.hv = 0;
+		top.push_back(nd);
+		return;
+	}
+	int n_lo = annPresortSplit(ps, lo, n, nd.cd, nd.cv, NULL, n_thr);
+	nd.task = -1;
+	nd.lv = bnd_box.lo[nd.cd];			// save bounds for cutting dimension
+	nd.hv = bnd_box.hi[nd.cd];
+	top.push_back(nd);
+
+	bnd_box.hi[nd.cd] = nd.cv;			// left subtree
+	rkd_presort_top(ps, lo, n_lo, bnd_box, n_thr, cutoff, top, tasks);
+	bnd_box.hi[nd.cd] = nd.hv;
+
+	bnd_box.lo[nd.cd] = nd.cv;			// right subtree
+	rkd_presort_top(ps, lo + n_lo, n - n_lo, bnd_box, n_thr, cutoff,
+				top, tasks);
+	bnd_box.lo[nd.cd] = nd.lv;
+}
+
+//----------------------------------------------------------------------
+//	rkd_tree_presort - presorted construction of a kd-tree
+//		Builds a kd-tree with the standard splitting rule for the
+//		points pa[pidx[0..n-1]], using n_thr threads.  On return, pidx
+//		holds the point indices in leaf order.
+//----------------------------------------------------------------------
+
+ANNkd_ptr rkd_tree_presort(				// presorted construction of kd-tree
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in tree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for root
+	int					n_thr)			// number of threads
+{
+	ANNidx max_idx = 0;					// largest point index
+	for (int i = 0; i < n; i++) {
+		if (pidx[i] > max_idx) max_idx = pidx[i];
+	}
+	ANNsortedLists ps;
+	ps.pa = pa;
+	ps.dim = dim;
+	ps.bsp = bsp;
+	ps.pidx = pidx;
+	ps.side = new char[max_idx + 1];
+	ps.sorted = new ANNidxArray[dim];
+	for (int d = 0; d < dim; d++) {
+		ps.sorted[d] = new ANNidx[n];
+	}
+										// sort along each dimension
+	annParallelFor(dim, n_thr, [&](int d_lo, int d_hi) {
+		std::vector<ANNsortEnt> buf(n);	// coordinates with indices
+		for (int d = d_lo; d < d_hi; d++) {
+			for (int i = 0; i < n; i++) {
+				buf[i].c = pa[pidx[i]][d];
+				buf[i].idx = pidx[i];
+			}
+			std::sort(buf.begin(), buf.end(),
+				[](const ANNsortEnt &a, const ANNsortEnt &b) {
+					return a.c < b.c || (a.c == b.c && a.idx < b.idx);
+				});
+			for (int i = 0; i < n; i++) {
+				ps.sorted[d][i] = buf[i].idx;
+			}
+		}
+	});
+
+	ANNkd_ptr root;
+	if (n_thr <= 1) {					// build serially
+		std::vector<ANNidx> tmp(n);
+		root = rkd_presort(ps, 0, n, bnd_box, &tmp[0]);
+	}
+	else {								// build in parallel
+		std::vector<ANNkdBuildTop> top;
+		std::vector<ANNkdBuildTask> tasks;
+		rkd_presort_top(ps, 0, n, bnd_box, n_thr,
+					annBuildCutoff(n, n_thr), top, tasks);
+		annRunBuildTasks(tasks, n_thr, [&](ANNkdBuildTask &t) {
+			std::vector<ANNidx> tmp(t.n + 1);
+			return rkd_presort(ps, (int) (t.pidx - pidx), t.n,
+						*t.bnd_box, &tmp[0]);
+		});
+		int pos = 0;					// create the top nodes
+		root = rkd_tree_join(top, tasks, pos);
+		for (size_t i = 0; i < tasks.size(); i++) delete tasks[i].bnd_box;
+	}
+
+	for (int d = 0; d < dim; d++) {
+		delete [] ps.sorted[d];
+	}
+	delete [] ps.sorted;
+	delete [] ps.side;
+	return root;
+}
+
+ANN_NAMESPACE_END
@@ -22,9 +22,19 @@
 //		Initial release
 //	Revision 1.0  04/01/05
 //		Changed names LO, HI to ANN_LO, ANN_HI
+//	Revision 1.2  10/17/26
+//		Replaced global search variables by a search context
+//		Leaf distances are computed by the distance kernel
+//		Closest point set is taken from the thread's search scratch
+//		Leaves skip deleted points (for dynamic trees)
+//		Searches skip points deleted from the tree
 //----------------------------------------------------------------------
 
 #include "kd_search.h"					// kd-search declarations
+#include "dist_kernel.h"				// distance kernels
+#include "search_scratch.h"				// per-thread search scratch
+
+ANN_NAMESPACE_BEGIN
 
 //----------------------------------------------------------------------
 //	Approximate nearest neighbor searching by kd-tree search
@@ -71,17 +81,12 @@
 //----------------------------------------------------------------------
 
 //----------------------------------------------------------------------
-//		To keep argument lists short, a number of global variables
-//		are maintained which are common to all the recursive calls.
-//		These are given below.
+//		To keep argument lists short, the information which is common
+//		to all the recursive calls is stored in a search context (see
+//		kd_search.h), which is allocated on the stack of annkSearch()
+//		and passed by reference to each of the recursive calls.
 //----------------------------------------------------------------------
 
-int				ANNkdDim;				// dimension of space
-ANNpoint		ANNkdQ;					// query point
-double			ANNkdMaxErr;			// max tolerable squared error
-ANNpointArray	ANNkdPts;				// the points
-ANNmin_k		*ANNkdPointMK;			// set of k closest points
-
 //----------------------------------------------------------------------
 //	annkSearch - search for the k nearest neighbors
 //----------------------------------------------------------------------
@@ -93,46 +98,52 @@ void ANNkd_tree::annkSearch(
 	ANNdistArray		dd,				// the approximate nearest neighbor
 	double				eps)			// the error bound
 {
+	ANNkdSearchCtx ctx;					// context for this search
 
-	ANNkdDim = dim;						// copy arguments to static equivs
-	ANNkdQ = q;
-	ANNkdPts = pts;
-	ANNptsVisited = 0;					// initialize count of points visited
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.pts = pts;
+	ctx.pidx = pidx;					// ...and points in leaf order
+	ctx.leaf_pts = (leaf_pts != NULL ? leaf_pts[0] : NULL);
+	ctx.deleted = deleted;				// (skip deleted points)
+	ctx.pts_visited = 0;				// initialize count of points visited
 
 	if (k > n_pts) {					// too many near neighbors?
 		annError("Requesting more near neighbors than data points", ANNabort);
 	}
 
-	ANNkdMaxErr = ANN_POW(1.0 + eps);
+	ctx.max_err = ANN_POW(1.0 + eps);
 	ANN_FLOP(2)							// increment floating op count
 
-	ANNkdPointMK = new ANNmin_k(k);		// create set for closest k points
+	ANNsearchScratch *scr = annGetScratch();
+	scr->point_mk.reset(k);				// set for closest k points
+	ctx.point_mk = &scr->point_mk;
 										// search starting at the root
-	root->ann_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim));
+	root->ann_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim), ctx);
 
 	for (int i = 0; i < k; i++) {		// extract the k-th closest points
-		dd[i] = ANNkdPointMK->ith_smallest_key(i);
-		nn_idx[i] = ANNkdPointMK->ith_smallest_info(i);
+		dd[i] = ctx.point_mk->ith_smallest_key(i);
+		nn_idx[i] = ctx.point_mk->ith_smallest_info(i);
 	}
-	delete ANNkdPointMK;				// deallocate closest point set
+	annReleaseScratch(scr);				// done with scratch
 }
 
 //----------------------------------------------------------------------
 //	kd_split::ann_search - search a splitting node
 //----------------------------------------------------------------------
 
-void ANNkd_split::ann_search(ANNdist box_dist)
+void ANNkd_split::ann_search(ANNdist box_dist, ANNkdSearchCtx &ctx)
 {
 										// check dist calc term condition
-	if (ANNmaxPtsVisited != 0 && ANNptsVisited > ANNmaxPtsVisited) return;
+	if (ANNmaxPtsVisited != 0 && ctx.pts_visited > ANNmaxPtsVisited) return;
 
 										// distance to cutting plane
-	ANNcoord cut_diff = ANNkdQ[cut_dim] - cut_val;
+	ANNcoord cut_diff = ctx.q[cut_dim] - cut_val;
 
 	if (cut_diff < 0) {					// left of cutting plane
-		child[ANN_LO]->ann_search(box_dist);// visit closer child first
+		child[ANN_LO]->ann_search(box_dist, ctx);// visit closer child first
 
-		ANNcoord box_diff = cd_bnds[ANN_LO] - ANNkdQ[cut_dim];
+		ANNcoord box_diff = cd_bnds[ANN_LO] - ctx.q[cut_dim];
 		if (box_diff < 0)				// within bounds - ignore
 			box_diff = 0;
 										// distance to further box
@@ -140,14 +151,14 @@ void ANNkd_split::ann_search(ANNdist box_dist)
 				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
 
 										// visit further child if close enough
-		if (box_dist * ANNkdMaxErr < ANNkdPointMK->max_key())
-			child[ANN_HI]->ann_search(box_dist);
+		if (box_dist * ctx.max_err < ctx.point_mk->max_key())
+			child[ANN_HI]->ann_search(box_dist, ctx);
 
 	}
 	else {								// right of cutting plane
-		child[ANN_HI]->ann_search(box_dist);// visit closer child first
+		child[ANN_HI]->ann_search(box_dist, ctx);// visit closer child first
 
-		ANNcoord box_diff = ANNkdQ[cut_dim] - cd_bnds[ANN_HI];
+		ANNcoord box_diff = ctx.q[cut_dim] - cd_bnds[ANN_HI];
 		if (box_diff < 0)				// within bounds - ignore
 			box_diff = 0;
 										// distance to further box
@@ -155,8 +166,8 @@ void ANNkd_split::ann_search(ANNdist box_dist)
 				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
 
 										// visit further child if close enough
-		if (box_dist * ANNkdMaxErr < ANNkdPointMK->max_key())
-			child[ANN_LO]->ann_search(box_dist);
+		if (box_dist * ctx.max_err < ctx.point_mk->max_key())
+			child[ANN_LO]->ann_search(box_dist, ctx);
 
 	}
 	ANN_FLOP(10)						// increment floating ops
@@ -165,46 +176,40 @@ void ANNkd_split::ann_search(ANNdist box_dist)
 
 //----------------------------------------------------------------------
 //	kd_leaf::ann_search - search points in a leaf node
-//		Note: The unreadability of this code is the result of
-//		some fine tuning to replace indexing by pointer operations.
+//		The distance to each point is computed by the distance
+//		kernel (see dist_kernel.h), which gives up as soon as the
+//		distance is known to exceed that of the k-th closest point.
+//		Deleted points (in a dynamic tree) are skipped.
 //----------------------------------------------------------------------
 
-void ANNkd_leaf::ann_search(ANNdist box_dist)
+void ANNkd_leaf::ann_search(ANNdist box_dist, ANNkdSearchCtx &ctx)
 {
 	register ANNdist dist;				// distance to data point
-	register ANNcoord* pp;				// data coordinate pointer
-	register ANNcoord* qq;				// query coordinate pointer
 	register ANNdist min_dist;			// distance to k-th closest point
-	register ANNcoord t;
-	register int d;
-
-	min_dist = ANNkdPointMK->max_key(); // k-th smallest distance so far
-
-	for (int i = 0; i < n_pts; i++) {	// check points in bucket
 
-		pp = ANNkdPts[bkt[i]];			// first coord of next data point
-		qq = ANNkdQ;					// first coord of query point
-		dist = 0;
+	min_dist = ctx.point_mk->max_key(); // k-th smallest distance so far
 
-		for(d = 0; d < ANNkdDim; d++) {
-			ANN_COORD(1)				// one more coordinate hit
-			ANN_FLOP(4)					// increment floating ops
+	const ANNcoord *lp = NULL;			// points in leaf order (if copied)
+	if (ctx.leaf_pts != NULL && n_pts > 0)
+		lp = ctx.leaf_pts + (size_t) (bkt - ctx.pidx) * ctx.dim;
 
-			t = *(qq++) - *(pp++);		// compute length and adv coordinate
-										// exceeds dist to k-th smallest?
-			if( (dist = ANN_SUM(dist, ANN_POW(t))) > min_dist) {
-				break;
-			}
-		}
+	for (int i = 0; i < n_pts; i++) {	// check points in bucket
+		if (annIsDeleted(ctx.deleted, bkt[i]))
+			continue;					// skip deleted points
+										// distance (if not too far)
+		dist = annDistBnd(ctx.dim,
+			(lp != NULL ? lp + i*ctx.dim : ctx.pts[bkt[i]]), ctx.q, min_dist);
 
-		if (d >= ANNkdDim &&					// among the k best?
+		if (dist <= min_dist &&					// among the k best?
 		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
 												// add it to the list
-			ANNkdPointMK->insert(dist, bkt[i]);
-			min_dist = ANNkdPointMK->max_key();
+			ctx.point_mk->insert(dist, bkt[i]);
+			min_dist = ctx.point_mk->max_key();
 		}
 	}
 	ANN_LEAF(1)							// one more leaf node visited
 	ANN_PTS(n_pts)						// increment points visited
-	ANNptsVisited += n_pts;				// increment number of points visited
+	ctx.pts_visited += n_pts;			// increment number of points visited
 }
+
+ANN_NAMESPACE_END
@@ -20,6 +20,9 @@
 // History:
 //	Revision 0.1  03/04/98
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Replaced global search variables by a search context
+//		Added deleted point flags (for dynamic trees)
 //----------------------------------------------------------------------
 
 #ifndef ANN_kd_search_H
@@ -31,18 +34,32 @@
 
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
-//	More global variables
-//		These are active for the life of each call to annkSearch(). They
-//		are set to save the number of variables that need to be passed
-//		among the various search procedures.
+//	Search context
+//		This holds the state which is active for the life of each call
+//		to annkSearch().  It is passed (by reference) among the various
+//		search procedures, in place of the global variables that were
+//		used in earlier versions, so that searches are reentrant.
+//
+//		If deleted is not NULL, the points marked in it (by index) are
+//		skipped.  This is used by dynamic trees (see dyn_tree.cpp).
 //----------------------------------------------------------------------
 
-extern int				ANNkdDim;		// dimension of space (static copy)
-extern ANNpoint			ANNkdQ;			// query point (static copy)
-extern double			ANNkdMaxErr;	// max tolerable squared error
-extern ANNpointArray	ANNkdPts;		// the points (static copy)
-extern ANNmin_k			*ANNkdPointMK;	// set of k closest points
-extern int				ANNptsVisited;	// number of points visited
+class ANNkdSearchCtx {
+public:
+	int					dim;			// dimension of space
+	ANNpoint			q;				// query point
+	double				max_err;		// max tolerable squared error
+	ANNpointArray		pts;			// the points
+	ANNidxArray			pidx;			// the point indices
+	ANNcoord			*leaf_pts;		// points in leaf order (or NULL)
+	const ANNmark		*deleted;		// deleted points (or NULL)
+	ANNmin_k			*point_mk;		// set of k closest points
+	int					pts_visited;	// number of points visited
+};
+
+ANN_NAMESPACE_END
 
 #endif
@@ -27,6 +27,8 @@
 #include "kd_util.h"					// kd-tree utilities
 #include "kd_split.h"					// splitting functions
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Constants
 //----------------------------------------------------------------------
@@ -426,3 +428,5 @@ void sl_fair_split(
 		annMedianSplit(pa, pidx, n, cut_dim, cut_val, n_lo);
 	}
 }
+
+ANN_NAMESPACE_END
@@ -26,13 +26,25 @@
 //		Added optional pa, pi arguments to Skeleton kd_tree constructor
 //			for use in load constructor.
 //		Added annClose() to eliminate KD_TRIVIAL memory leak.
+//	Revision 1.2  10/17/26
+//		annClose() stops the thread pool.
+//		Added optional copy of points in leaf order (leaf_pts)
+//		Added constructor from a subset of a point array
+//		Added deletion of points (annDelete)
+//		Added parallel construction (rkd_tree_par)
+//		Added presorted construction (rkd_tree_presort)
 //----------------------------------------------------------------------
 
 #include "kd_tree.h"					// kd-tree declarations
 #include "kd_split.h"					// kd-tree splitting rules
 #include "kd_util.h"					// kd-tree utilities
+#include "thread_pool.h"				// thread pool
+#include <vector>						// top nodes and tasks
+#include <algorithm>					// std::sort
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Global data
 //
@@ -212,11 +224,14 @@ ANNkd_tree::~ANNkd_tree()				// tree destructor
 	if (pidx != NULL) delete [] pidx;
 	if (bnd_box_lo != NULL) annDeallocPt(bnd_box_lo);
 	if (bnd_box_hi != NULL) annDeallocPt(bnd_box_hi);
+	if (leaf_pts != NULL) annDeallocPts(leaf_pts);
+	if (deleted != NULL) delete [] deleted;
 }
 
 //----------------------------------------------------------------------
 //	This is called with all use of ANN is finished.  It eliminates the
-//	minor memory leak caused by the allocation of KD_TRIVIAL.
+//	minor memory leak caused by the allocation of KD_TRIVIAL, and it
+//	stops the worker threads used by the parallel routines.
 //----------------------------------------------------------------------
 void annClose()				// close use of ANN
 {
@@ -224,6 +239,7 @@ void annClose()				// close use of ANN
 		delete KD_TRIVIAL;
 		KD_TRIVIAL = NULL;
 	}
+	annThreadPoolClose();
 }
 
 //----------------------------------------------------------------------
@@ -266,6 +282,9 @@ void ANNkd_tree::SkeletonTree(			// construct skeleton tree
 	}
 
 	bnd_box_lo = bnd_box_hi = NULL;		// bounding box is nonexistent
+	leaf_pts = NULL;					// no copy of points
+	deleted = NULL;						// no deleted points
+	n_deleted = n_marks = 0;
 	if (KD_TRIVIAL == NULL)				// no trivial leaf node yet?
 		KD_TRIVIAL = new ANNkd_leaf(0, IDX_TRIVIAL);	// allocate it
 }
@@ -276,6 +295,27 @@ ANNkd_tree::ANNkd_tree(					// basic constructor
 		int bs)							// bucket size
 {  SkeletonTree(n, dd, bs);  }			// construct skeleton tree
 
+//----------------------------------------------------------------------
+//	CopyLeafPts - copy the points into leaf order
+//		Since each bucket is a subarray of pidx, copying the points in
+//		the order of pidx places the points of each bucket together.
+//		This is called after the tree has been built (or loaded).
+//----------------------------------------------------------------------
+
+void ANNkd_tree::CopyLeafPts()
+{
+	if (leaf_pts != NULL) annDeallocPts(leaf_pts);
+	leaf_pts = NULL;
+	if (n_pts == 0) return;				// no points--no copy
+
+	leaf_pts = annAllocPts(n_pts, dim);	// allocate contiguous storage
+	for (int i = 0; i < n_pts; i++) {
+		for (int d = 0; d < dim; d++) {
+			leaf_pts[i][d] = pts[pidx[i]][d];
+		}
+	}
+}
+
 //----------------------------------------------------------------------
 //	rkd_tree - recursive procedure to build a kd-tree
 //
@@ -357,12 +397,190 @@ ANNkd_ptr rkd_tree(				// recursive construction of kd-tree
 	}
 } 
 
+//----------------------------------------------------------------------
+//	rkd_tree_par - parallel construction of a kd-tree
+//
+//		This builds the same tree as rkd_tree(), using n_thr threads.
+//		It works in three phases.  First the top levels of the tree
+//		are built by the calling thread (by rkd_tree_top()), down to
+//		subtrees of at most cutoff points, where
+//
+//				cutoff = max(ANN_BUILD_CUTOFF, n/(ANN_BUILD_TASKS*n_thr)).
+//
+//		The scans of the points at these levels (for spreads, bounds,
+//		and partitions) are done in parallel (see annSetScanThreads()
+//		in kd_util.h).  The splits are recorded in preorder in top,
+//		and each subtree below them is recorded as a task.  Second,
+//		the tasks are run by a parallel loop, largest first, each
+//		building its subtree serially by rkd_tree().  The loop hands
+//		out the tasks to the threads as they become free, so a thread
+//		with a small subtree goes on to the next one.  Finally, the
+//		splitting nodes are created bottom-up (by rkd_tree_join()),
+//		since a splitting node must be given its children when it is
+//		constructed.
+//
+//		Each subtree is built from the same points (in the same order)
+//		and box as in the serial construction, and the parallel scans
+//		give the same results as the serial ones.  So the resulting
+//		tree (and the permutation of pidx) is identical to that of
+//		rkd_tree(), for any number of threads.
+//----------------------------------------------------------------------
+
+static void rkd_tree_top(				// build top levels of kd-tree
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in subtree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	ANNkd_splitter		splitter,		// splitting routine
+	int					cutoff,			// max points for a task
+	std::vector<ANNkdBuildTop> &top,	// top nodes (appended)
+	std::vector<ANNkdBuildTask> &tasks)	// tasks (appended)
+{
+	ANNkdBuildTop nd;
+	if (n <= cutoff || n <= bsp) {		// small enough for a task
+		nd.task = annAddBuildTask(pidx, n, dim, bnd_box, tasks);
+		nd.cd = 0;
+		nd.cv = nd.lv = nd.hv = 0;
+		top.push_back(nd);
+		return;
+	}
+	int n_lo;							// number on low side of cut
+										// invoke splitting procedure
+	(*splitter)(pa, pidx, bnd_box, n, dim, nd.cd, nd.cv, n_lo);
+	nd.task = -1;
+	nd.lv = bnd_box.lo[nd.cd];			// save bounds for cutting dimension
+	nd.hv = bnd_box.hi[nd.cd];
+	top.push_back(nd);
+
+	bnd_box.hi[nd.cd] = nd.cv;			// left subtree
+	rkd_tree_top(pa, pidx, n_lo, dim, bsp, bnd_box, splitter,
+				cutoff, top, tasks);
+	bnd_box.hi[nd.cd] = nd.hv;
+
+	bnd_box.lo[nd.cd] = nd.cv;			// right subtree
+	rkd_tree_top(pa, pidx + n_lo, n-n_lo, dim, bsp, bnd_box, splitter,
+				cutoff, top, tasks);
+	bnd_box.lo[nd.cd] = nd.lv;
+}
+
+ANNkd_ptr rkd_tree_join(				// create top nodes of kd-tree
+	const std::vector<ANNkdBuildTop> &top,	// top nodes
+	const std::vector<ANNkdBuildTask> &tasks, // tasks (with results)
+	int					&pos)			// next top node (updated)
+{
+	const ANNkdBuildTop &nd = top[pos++];
+	if (nd.task >= 0) return tasks[nd.task].root;
+	ANNkd_ptr lo = rkd_tree_join(top, tasks, pos);
+	ANNkd_ptr hi = rkd_tree_join(top, tasks, pos);
+	return new ANNkd_split(nd.cd, nd.cv, nd.lv, nd.hv, lo, hi);
+}
+
+ANNkd_ptr rkd_tree_par(					// parallel construction of kd-tree
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in tree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for root
+	ANNkd_splitter		splitter,		// splitting routine
+	int					n_thr)			// number of threads
+{
+	if (n_thr <= 1) {					// just one thread--build serially
+		return rkd_tree(pa, pidx, n, dim, bsp, bnd_box, splitter);
+	}
+	std::vector<ANNkdBuildTop> top;		// build top levels
+	std::vector<ANNkdBuildTask> tasks;
+	int old_thr = annSetScanThreads(n_thr);
+	rkd_tree_top(pa, pidx, n, dim, bsp, bnd_box, splitter,
+				annBuildCutoff(n, n_thr), top, tasks);
+	annSetScanThreads(old_thr);
+										// build the subtrees
+	annRunBuildTasks(tasks, n_thr, [&](ANNkdBuildTask &t) {
+		return rkd_tree(pa, t.pidx, t.n, dim, bsp, *t.bnd_box, splitter);
+	});
+
+	int pos = 0;						// create the top nodes
+	ANNkd_ptr root = rkd_tree_join(top, tasks, pos);
+	for (size_t i = 0; i < tasks.size(); i++) delete tasks[i].bnd_box;
+	return root;
+}
+
+//----------------------------------------------------------------------
+//	Building subtrees in parallel
+//		These are the parts of parallel construction which are shared
+//		by kd-trees and bd-trees (see rbd_tree_par() in bd_tree.cpp).
+//
+//		annBuildCutoff(n, n_thr) is the maximum number of points for
+//		a task.  annAddBuildTask() records a subtree as a task (with a
+//		copy of its box) and returns its number.  annRunBuildTasks()
+//		builds the subtrees of the tasks by a parallel loop, largest
+//		first (ties by task number), using the given procedure, with
+//		serial scans.
+//----------------------------------------------------------------------
+
+int annBuildCutoff(						// max points for a task
+	int					n,				// number of points
+	int					n_thr)			// number of threads
+{
+	int cutoff = n/(ANN_BUILD_TASKS*n_thr);
+	return (cutoff < ANN_BUILD_CUTOFF ? ANN_BUILD_CUTOFF : cutoff);
+}
+
+int annAddBuildTask(					// record a subtree as a task
+	ANNidxArray			pidx,			// point indices
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	const ANNorthRect	&bnd_box,		// bounding box
+	std::vector<ANNkdBuildTask> &tasks)	// tasks (appended)
+{
+	ANNkdBuildTask t;
+	t.pidx = pidx;
+	t.n = n;
+	t.bnd_box = new ANNorthRect(dim, bnd_box);
+	t.root = NULL;
+	tasks.push_back(t);
+	return (int) tasks.size() - 1;
+}
+
+void annRunBuildTasks(					// build subtrees of tasks
+	std::vector<ANNkdBuildTask> &tasks,	// the tasks (roots returned)
+	int					n_thr,			// number of threads
+	const ANNbuildBody	&build)			// builds the subtree of a task
+{
+	int n_tasks = (int) tasks.size();	// order tasks by size
+	std::vector<int> order(n_tasks);
+	for (int i = 0; i < n_tasks; i++) order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return tasks[a].n > tasks[b].n || (tasks[a].n == tasks[b].n && a < b);
+	});
+	annParallelFor(n_tasks, n_thr, [&](int lo, int hi) {
+		int old = annSetScanThreads(1);	// (scans within tasks are serial)
+		for (int i = lo; i < hi; i++) {
+			ANNkdBuildTask &t = tasks[order[i]];
+			t.root = build(t);
+		}
+		annSetScanThreads(old);
+	});
+}
+
 //----------------------------------------------------------------------
 // kd-tree constructor
 //		This is the main constructor for kd-trees given a set of points.
-//		It first builds a skeleton tree, then computes the bounding box
-//		of the data points, and then invokes rkd_tree() to actually
-//		build the tree, passing it the appropriate splitting routine.
+//		It first builds a skeleton tree, and then invokes BuildTree().
+//		This computes the bounding box of the data points, and then
+//		invokes rkd_tree() to actually build the tree, passing it the
+//		appropriate splitting routine.  If n_threads is not 1, the tree
+//		is built by rkd_tree_par() instead, using n_threads threads
+//		(all the hardware threads if n_threads <= 0).  The tree is the
+//		same either way.  If presorting is enabled (see annSetPresort())
+//		and the rule is the standard one, the tree is built by
+//		rkd_tree_presort() (see kd_presort.cpp).
+//
+//		The second constructor (which is protected) builds the tree
+//		for just the points of pa whose indices are given in pi.  The
+//		tree takes over the array pi, as its point index array.
 //----------------------------------------------------------------------
 
 ANNkd_tree::ANNkd_tree(					// construct from point array
@@ -370,36 +588,115 @@ ANNkd_tree::ANNkd_tree(					// construct from point array
 	int					n,				// number of points
 	int					dd,				// dimension
 	int					bs,				// bucket size
-	ANNsplitRule		split)			// splitting method
+	ANNsplitRule		split,			// splitting method
+	ANNbool				copy_pts,		// copy points to leaf order?
+	int					n_threads)		// number of threads for building
 {
-	SkeletonTree(n, dd, bs);			// set up the basic stuff
-	pts = pa;							// where the points are
-	if (n == 0) return;					// no points--no sweat
+	SkeletonTree(n, dd, bs, pa);		// set up the basic stuff
+	BuildTree(split, copy_pts, n_threads);	// build the tree
+}
 
-	ANNorthRect bnd_box(dd);			// bounding box for points
-	annEnclRect(pa, pidx, n, dd, bnd_box);// construct bounding rectangle
-										// copy to tree structure
-	bnd_box_lo = annCopyPt(dd, bnd_box.lo);
-	bnd_box_hi = annCopyPt(dd, bnd_box.hi);
+ANNkd_tree::ANNkd_tree(					// construct from subset of points
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pi,				// indices of points (n of them)
+	int					n,				// number of points
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		split,			// splitting method
+	ANNbool				copy_pts)		// copy points to leaf order?
+{
+	SkeletonTree(n, dd, bs, pa, pi);	// set up the basic stuff
+	BuildTree(split, copy_pts, 1);		// build the tree
+}
+
+void ANNkd_tree::BuildTree(				// build tree for pts[pidx[...]]
+	ANNsplitRule		split,			// splitting method
+	ANNbool				copy_pts,		// copy points to leaf order?
+	int					n_threads)		// number of threads for building
+{
+	if (n_pts == 0) return;				// no points--no sweat
 
-	switch (split) {					// build by rule
+	ANNkd_splitter splitter = NULL;		// splitting routine
+	switch (split) {					// select by rule
 	case ANN_KD_STD:					// standard kd-splitting rule
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, kd_split);
+		splitter = kd_split;
 		break;
 	case ANN_KD_MIDPT:					// midpoint split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, midpt_split);
+		splitter = midpt_split;
 		break;
 	case ANN_KD_FAIR:					// fair split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, fair_split);
+		splitter = fair_split;
 		break;
 	case ANN_KD_SUGGEST:				// best (in our opinion)
 	case ANN_KD_SL_MIDPT:				// sliding midpoint split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, sl_midpt_split);
+		splitter = sl_midpt_split;
 		break;
 	case ANN_KD_SL_FAIR:				// sliding fair split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, sl_fair_split);
+		splitter = sl_fair_split;
 		break;
 	default:
 		annError("Illegal splitting method", ANNabort);
 	}
+
+	int n = n_pts;
+	int bs = bkt_size;
+	int n_thr = annNumThreads(n_threads, n);
+	ANNorthRect bnd_box(dim);			// bounding box for points
+										// construct bounding rectangle
+	int old_thr = annSetScanThreads(n_thr);
+	annEnclRect(pts, pidx, n, dim, bnd_box);
+	annSetScanThreads(old_thr);
+										// copy to tree structure
+	bnd_box_lo = annCopyPt(dim, bnd_box.lo);
+	bnd_box_hi = annCopyPt(dim, bnd_box.hi);
+
+	if (ANNpresort && split == ANN_KD_STD)	// presorted construction
+		root = rkd_tree_presort(pts, pidx, n, dim, bs, bnd_box, n_thr);
+	else if (n_thr > 1)					// build in parallel
+		root = rkd_tree_par(pts, pidx, n, dim, bs, bnd_box, splitter, n_thr);
+	else
+		root = rkd_tree(pts, pidx, n, dim, bs, bnd_box, splitter);
+	if (copy_pts) CopyLeafPts();		// copy points if desired
+}
+
+//----------------------------------------------------------------------
+//	Deleting points
+//		A deleted point is not removed from the tree, but only marked,
+//		and the searches skip the marked points.  The marks (deleted)
+//		are indexed by point index, and are allocated by MarkPoints()
+//		when the first point is deleted.  Since a tree may hold just
+//		some of the points of its point array (see the subset
+//		constructor above), the indices of points which are not in the
+//		tree are marked as well, so that they cannot be deleted.
+//----------------------------------------------------------------------
+
+void ANNkd_tree::MarkPoints()			// allocate deletion marks
+{
+	if (deleted != NULL) return;		// already have them
+
+	n_marks = 0;						// find largest index
+	for (int i = 0; i < n_pts; i++) {
+		if (pidx[i] >= n_marks) n_marks = pidx[i] + 1;
+	}
+	deleted = new ANNmark[n_marks + 1];
+	for (int i = 0; i < n_marks; i++) {	// mark points not in tree
+		deleted[i].store(1, memory_order_relaxed);
+	}
+	for (int i = 0; i < n_pts; i++) {	// ...but not those in it
+		deleted[pidx[i]].store(0, memory_order_relaxed);
+	}
 }
+
+ANNbool ANNkd_tree::annDelete(			// delete a point
+	ANNidx				idx)			// its index
+{
+	MarkPoints();						// make sure we have marks
+	if (idx < 0 || idx >= n_marks || annIsDeleted(deleted, idx)) {
+		return ANNfalse;				// not in tree or already deleted
+	}
+	deleted[idx].store(1, memory_order_relaxed);	// mark it (see kd_tree.h)
+	n_deleted++;
+	return ANNtrue;
+}
+
+ANN_NAMESPACE_END
@@ -22,15 +22,44 @@
 //		Initial release
 //	Revision 1.1  05/03/05
 //		Added fixed radius kNN search
+//	Revision 1.2  10/17/26
+//		Added flatten() for conversion to flat trees
+//		Added subtree point counts and ann_FR_count()
+//		Added ann_group_search() for all k-nearest neighbors
+//		Added rkd_tree_par() for parallel construction
+//		Added annIsDeleted() for reading deletion marks
+//		Added encode() for compressed dumps
 //----------------------------------------------------------------------
 
 #ifndef ANN_kd_tree_H
 #define ANN_kd_tree_H
 
+#include <vector>						// build tasks
+#include <functional>					// std::function
 #include <ANN/ANNx.h>					// all ANN includes
 
 using namespace std;					// make std:: available
 
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Search contexts
+//		The state of a single search (query point, k-best set, counts,
+//		etc.) is held in a context object which is created by the
+//		entry point (e.g., annkSearch()) and passed down through the
+//		recursive node-level search procedures.  Since nothing is
+//		stored in the tree or in global variables, a tree may be
+//		searched by any number of threads at once.  See kd_search.h,
+//		kd_pr_search.h, and kd_fix_rad_search.h for their definitions.
+//----------------------------------------------------------------------
+
+class ANNkdSearchCtx;					// standard search context
+class ANNprSearchCtx;					// priority search context
+class ANNkdFRSearchCtx;					// fixed-radius search context
+class ANNkdGroupCtx;					// group search context (all-kNN)
+class ANNflatBuilder;					// flat tree builder (flat_tree.h)
+class ANNdumpWriter;					// compressed dump writer (kd_dump.cpp)
+
 //----------------------------------------------------------------------
 //	Generic kd-tree node
 //
@@ -47,9 +76,18 @@ class ANNkd_node{						// generic kd-tree node (empty shell)
 public:
 	virtual ~ANNkd_node() {}					// virtual distroyer
 
-	virtual void ann_search(ANNdist) = 0;		// tree search
-	virtual void ann_pri_search(ANNdist) = 0;	// priority search
-	virtual void ann_FR_search(ANNdist) = 0;	// fixed-radius search
+												// tree search
+	virtual void ann_search(ANNdist, ANNkdSearchCtx&) = 0;
+												// priority search
+	virtual void ann_pri_search(ANNdist, ANNprSearchCtx&) = 0;
+												// fixed-radius search
+	virtual void ann_FR_search(ANNdist, ANNkdFRSearchCtx&) = 0;
+												// fixed-radius counting
+	virtual void ann_FR_count(ANNdist, ANNdist, ANNkdFRSearchCtx&) = 0;
+												// group search (all-kNN)
+	virtual void ann_group_search(int, int*, ANNdist*, ANNkdGroupCtx&) = 0;
+												// no. of points in subtree
+	virtual int subtree_pts() = 0;
 
 	virtual void getStats(						// get tree statistics
 				int dim,						// dimension of space
@@ -58,6 +96,10 @@ public:
 												// print node
 	virtual void print(int level, ostream &out) = 0;
 	virtual void dump(ostream &out) = 0;		// dump node
+												// convert to flat node
+	virtual int flatten(ANNflatBuilder &fb) = 0;
+												// write compressed node
+	virtual void encode(ANNdumpWriter &dw) = 0;
 
 	friend class ANNkd_tree;					// allow kd-tree to access us
 };
@@ -103,16 +145,28 @@ public:
 
 	~ANNkd_leaf() { }					// destructor (none)
 
+	virtual int subtree_pts()			// number of points in subtree
+		{ return n_pts; }
+
 	virtual void getStats(						// get tree statistics
 				int dim,						// dimension of space
 				ANNkdStats &st,					// statistics
 				ANNorthRect &bnd_box);			// bounding box
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
+	virtual int flatten(ANNflatBuilder &fb);	// convert to flat node
+	virtual void encode(ANNdumpWriter &dw);		// write compressed node
 
-	virtual void ann_search(ANNdist);			// standard search
-	virtual void ann_pri_search(ANNdist);		// priority search
-	virtual void ann_FR_search(ANNdist);		// fixed-radius search
+												// standard search
+	virtual void ann_search(ANNdist, ANNkdSearchCtx&);
+												// priority search
+	virtual void ann_pri_search(ANNdist, ANNprSearchCtx&);
+												// fixed-radius search
+	virtual void ann_FR_search(ANNdist, ANNkdFRSearchCtx&);
+												// fixed-radius counting
+	virtual void ann_FR_count(ANNdist, ANNdist, ANNkdFRSearchCtx&);
+												// group search (all-kNN)
+	virtual void ann_group_search(int, int*, ANNdist*, ANNkdGroupCtx&);
 };
 
 //----------------------------------------------------------------------
@@ -136,7 +190,8 @@ extern ANNkd_leaf *KD_TRIVIAL;					// trivial (empty) leaf node
 //		cutting dimension is maintained (this is used to speed up point
 //		to box distance calculations) [we do not store the entire bounding
 //		box since this may be wasteful of space in high dimensions].
-//		We also store pointers to the 2 children.
+//		We also store pointers to the 2 children, and the number of
+//		points in the subtree (which is used for range counting).
 //----------------------------------------------------------------------
 
 class ANNkd_split : public ANNkd_node	// splitting node of a kd-tree
@@ -146,6 +201,7 @@ class ANNkd_split : public ANNkd_node	// splitting node of a kd-tree
 	ANNcoord			cd_bnds[2];		// lower and upper bounds of
 										// rectangle along cut_dim
 	ANNkd_ptr			child[2];		// left and right children
+	int					n_sub;			// no. of points in subtree
 public:
 	ANNkd_split(						// constructor
 		int cd,							// cutting dimension
@@ -159,6 +215,8 @@ public:
 			cd_bnds[ANN_HI] = hv;				// upper bound for rectangle
 			child[ANN_LO]	= lc;				// left child
 			child[ANN_HI]	= hc;				// right child
+			n_sub = (lc != NULL ? lc->subtree_pts() : 0) +
+					(hc != NULL ? hc->subtree_pts() : 0);
 		}
 
 	~ANNkd_split()						// destructor
@@ -169,18 +227,46 @@ public:
 				delete child[ANN_HI];
 		}
 
+	virtual int subtree_pts()			// number of points in subtree
+		{ return n_sub; }
+
 	virtual void getStats(						// get tree statistics
 				int dim,						// dimension of space
 				ANNkdStats &st,					// statistics
 				ANNorthRect &bnd_box);			// bounding box
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
+	virtual int flatten(ANNflatBuilder &fb);	// convert to flat node
+	virtual void encode(ANNdumpWriter &dw);		// write compressed node
 
-	virtual void ann_search(ANNdist);			// standard search
-	virtual void ann_pri_search(ANNdist);		// priority search
-	virtual void ann_FR_search(ANNdist);		// fixed-radius search
+												// standard search
+	virtual void ann_search(ANNdist, ANNkdSearchCtx&);
+												// priority search
+	virtual void ann_pri_search(ANNdist, ANNprSearchCtx&);
+												// fixed-radius search
+	virtual void ann_FR_search(ANNdist, ANNkdFRSearchCtx&);
+												// fixed-radius counting
+	virtual void ann_FR_count(ANNdist, ANNdist, ANNkdFRSearchCtx&);
+												// group search (all-kNN)
+	virtual void ann_group_search(int, int*, ANNdist*, ANNkdGroupCtx&);
 };
 
+//----------------------------------------------------------------------
+//	annIsDeleted - is a point marked as deleted?
+//		A point may be deleted while other threads search the tree
+//		(see ANNrebuild_tree), so the marks are atomic.  They are read
+//		and written with relaxed ordering, since each mark is set just
+//		once, and nothing else is published by setting it.
+//----------------------------------------------------------------------
+
+inline ANNbool annIsDeleted(			// is point deleted?
+	const ANNmark		*deleted,		// deletion marks (or NULL)
+	ANNidx				idx)			// index of point
+{
+	return (ANNbool) (deleted != NULL &&
+				deleted[idx].load(memory_order_relaxed) != 0);
+}
+
 //----------------------------------------------------------------------
 //		External entry points
 //----------------------------------------------------------------------
@@ -194,4 +280,79 @@ ANNkd_ptr rkd_tree(				// recursive construction of kd-tree
 	ANNorthRect			&bnd_box,		// bounding box for current node
 	ANNkd_splitter		splitter);		// splitting routine
 
+ANNkd_ptr rkd_tree_par(					// parallel construction of kd-tree
+	ANNpointArray		pa,				// point array (unaltered)
+	ANNidxArray			pidx,			// point indices to store in tree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for root
+	ANNkd_splitter		splitter,		// splitting routine
+	int					n_thr);			// number of threads
+
+//----------------------------------------------------------------------
+//	Parallel construction
+//		In parallel construction (see rkd_tree_par() in kd_tree.cpp)
+//		the top levels of the tree are built first, and the subtrees
+//		below them, of at most annBuildCutoff() points each, are
+//		recorded as tasks, which are then built concurrently.  The
+//		cutoff is at least ANN_BUILD_CUTOFF, and there are at least
+//		about ANN_BUILD_TASKS tasks per thread.  The splitting nodes of
+//		the top levels are recorded in preorder as ANNkdBuildTop's,
+//		and are created by rkd_tree_join() once the tasks are done.
+//----------------------------------------------------------------------
+
+const int ANN_BUILD_CUTOFF	= 4096;		// min points for a task
+const int ANN_BUILD_TASKS	= 8;		// tasks per thread (at least)
+
+class ANNkdBuildTop {					// top node (split or task)
+public:
+	int					task;			// task number (-1 if split)
+	int					cd;				// cutting dimension
+	ANNcoord			cv;				// cutting value
+	ANNcoord			lv, hv;			// bounds along cutting dimension
+};
+
+class ANNkdBuildTask {					// subtree to be built
+public:
+	ANNidxArray			pidx;			// point indices
+	int					n;				// number of points
+	ANNorthRect			*bnd_box;		// bounding box (owned)
+	ANNkd_ptr			root;			// root of subtree (returned)
+};
+										// builds the subtree of a task
+typedef std::function<ANNkd_ptr(ANNkdBuildTask &t)> ANNbuildBody;
+
+int annBuildCutoff(						// max points for a task
+	int					n,				// number of points
+	int					n_thr);			// number of threads
+
+int annAddBuildTask(					// record a subtree as a task
+	ANNidxArray			pidx,			// point indices
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	const ANNorthRect	&bnd_box,		// bounding box
+	std::vector<ANNkdBuildTask> &tasks);// tasks (appended)
+
+void annRunBuildTasks(					// build subtrees of tasks
+	std::vector<ANNkdBuildTask> &tasks,	// the tasks (roots returned)
+	int					n_thr,			// number of threads
+	const ANNbuildBody	&build);		// builds the subtree of a task
+
+ANNkd_ptr rkd_tree_join(				// create top nodes of kd-tree
+	const std::vector<ANNkdBuildTop> &top,	// top nodes (in preorder)
+	const std::vector<ANNkdBuildTask> &tasks, // tasks (with results)
+	int					&pos);			// next top node (updated)
+
+ANNkd_ptr rkd_tree_presort(				// presorted construction of kd-tree
+	ANNpointArray		pa,				// point array (unaltered)
+	ANNidxArray			pidx,			// point indices to store in tree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for root
+	int					n_thr);			// number of threads
+
+ANN_NAMESPACE_END
+
 #endif
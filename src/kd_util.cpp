@@ -20,12 +20,22 @@
 // History:
 //	Revision 0.1  03/04/98
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Added parallel scans for large point sets
+//		annMaxSpread() makes one pass over the points
+//		annMedianSplit() selects from a contiguous buffer (nth_element)
 //----------------------------------------------------------------------
 
 #include "kd_util.h"					// kd-utility declarations
+#include "thread_pool.h"				// parallel loops
 
+#include <vector>						// per-block position lists
+#include <algorithm>					// std::nth_element
+#include <mutex>						// merging partial results
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 // The following routines are utility functions for manipulating
 // points sets, used in determining splitting planes for kd-tree
@@ -43,6 +53,133 @@
 										// accessing a single point
 #define PP(i)			(pa[pidx[(i)]])
 
+//----------------------------------------------------------------------
+//	Parallel scans
+//		ann_scan_threads is the number of threads used for scans by
+//		the calling thread (see annSetScanThreads in kd_util.h).  It
+//		is local to each thread, so that the subtrees which are built
+//		concurrently by parallel construction each scan serially.
+//
+//		annParScan(n) returns the number of threads to use for a scan
+//		of n points, or 1 if the scan should be serial.
+//----------------------------------------------------------------------
+
+static thread_local int ann_scan_threads = 1;
+
+int annSetScanThreads(			// set threads for scans (this thread)
+	int					n_thr)			// number of threads (returns old)
+{
+	int old = ann_scan_threads;
+	ann_scan_threads = n_thr;
+	return old;
+}
+
+static int annParScan(int n)			// threads to use for n points
+{
+	if (ann_scan_threads == 1 || n < ANN_PAR_SCAN_MIN) return 1;
+	return annNumThreads(ann_scan_threads, n);
+}
+
+//----------------------------------------------------------------------
+//	annParMinMax - min and max coordinates along a dimension in parallel
+//		Each subrange finds its own min and max, which are then merged.
+//		The result does not depend on the order of merging.
+//----------------------------------------------------------------------
+
+static void annParMinMax(
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices
+	int					n,				// number of points
+	int					d,				// dimension to check
+	int					n_thr,			// number of threads
+	ANNcoord			&min,			// minimum value (returned)
+	ANNcoord			&max)			// maximum value (returned)
+{
+	std::mutex mtx;						// protects min and max
+	min = max = PA(0,d);
+	annParallelFor(n, n_thr, [&](int lo, int hi) {
+		ANNcoord c_min = PA(lo,d);		// min and max of subrange
+		ANNcoord c_max = PA(lo,d);
+		for (int i = lo+1; i < hi; i++) {
+			ANNcoord c = PA(i,d);
+			if (c < c_min) c_min = c;
+			else if (c > c_max) c_max = c;
+		}
+		std::lock_guard<std::mutex> lock(mtx);
+		if (c_min < min) min = c_min;
+		if (c_max > max) max = c_max;
+	});
+}
+
+//----------------------------------------------------------------------
+//	annParPartition - partition points in parallel
+//		Permutes pidx[0..n-1] so that the points satisfying pred come
+//		first, and returns their number n_lo.  The permutation is the
+//		same as that of the serial two-pointer partition (as used by
+//		annPlaneSplit).  That procedure swaps the k-th point from the
+//		left of pidx[0..n_lo-1] which fails pred with the k-th point
+//		from the right of pidx[n_lo..n-1] which satisfies it.  We count
+//		n_lo, list the positions of these two kinds of points in
+//		ascending order, and then do the same swaps in parallel.
+//
+//		The points are divided into a fixed number of blocks (which
+//		does not depend on the scheduling of the threads), and the
+//		positions found in each block are concatenated in order.
+//----------------------------------------------------------------------
+
+template <class Pred>
+static int annParPartition(
+	ANNidxArray			pidx,			// point indices
+	int					n,				// number of points
+	int					n_thr,			// number of threads
+	const Pred			&pred)			// true for points to go first
+{
+	if (n == 0) return 0;				// nothing to partition
+	int n_blk = 4*n_thr;				// number of blocks
+	int blk_sz = (n + n_blk - 1)/n_blk;	// points per block
+	n_blk = (n + blk_sz - 1)/blk_sz;
+	std::vector<int> cnt(n_blk, 0);		// points satisfying pred
+	annParallelFor(n_blk, n_thr, [&](int b_lo, int b_hi) {
+		for (int b = b_lo; b < b_hi; b++) {
+			int hi = (b+1)*blk_sz < n ? (b+1)*blk_sz : n;
+			int c = 0;
+			for (int i = b*blk_sz; i < hi; i++) {
+				if (pred(pidx[i])) c++;
+			}
+			cnt[b] = c;
+		}
+	});
+	int n_lo = 0;
+	for (int b = 0; b < n_blk; b++) n_lo += cnt[b];
+
+										// misplaced positions per block
+	std::vector<std::vector<int> > bad_lo(n_blk), bad_hi(n_blk);
+	annParallelFor(n_blk, n_thr, [&](int b_lo, int b_hi) {
+		for (int b = b_lo; b < b_hi; b++) {
+			int hi = (b+1)*blk_sz < n ? (b+1)*blk_sz : n;
+			for (int i = b*blk_sz; i < hi; i++) {
+				ANNbool p = pred(pidx[i]) ? ANNtrue : ANNfalse;
+				if (i < n_lo && !p) bad_lo[b].push_back(i);
+				else if (i >= n_lo && p) bad_hi[b].push_back(i);
+			}
+		}
+	});
+	std::vector<int> lo_pos, hi_pos;	// concatenated positions
+	for (int b = 0; b < n_blk; b++) {
+		lo_pos.insert(lo_pos.end(), bad_lo[b].begin(), bad_lo[b].end());
+		hi_pos.insert(hi_pos.end(), bad_hi[b].begin(), bad_hi[b].end());
+	}
+	int m = (int) lo_pos.size();		// (equals hi_pos.size())
+	annParallelFor(m, n_thr, [&](int lo, int hi) {
+		for (int k = lo; k < hi; k++) {	// k-th from left with k-th from right
+			int i = lo_pos[k];
+			int j = hi_pos[m-1-k];
+			int tmp = pidx[i]; pidx[i] = pidx[j]; pidx[j] = tmp;
+		}
+	});
+	return n_lo;
+}
+
 //----------------------------------------------------------------------
 //	annAspectRatio
 //		Compute the aspect ratio (ratio of longest to shortest side)
@@ -77,6 +214,12 @@ void annEnclRect(
 	int					dim,			// dimension
 	ANNorthRect			&bnds)			// bounding cube (returned)
 {
+	if (annParScan(n) > 1) {			// large enough for parallel scan
+		for (int d = 0; d < dim; d++) {
+			annMinMax(pa, pidx, n, d, bnds.lo[d], bnds.hi[d]);
+		}
+		return;
+	}
 	for (int d = 0; d < dim; d++) {		// find smallest enclosing rectangle
 		ANNcoord lo_bnd = PA(0,d);		// lower bound on dimension d
 		ANNcoord hi_bnd = PA(0,d);		// upper bound on dimension d
@@ -159,6 +302,11 @@ ANNcoord annSpread(				// compute point spread along dimension
 {
 	ANNcoord min = PA(0,d);				// compute max and min coords
 	ANNcoord max = PA(0,d);
+	int n_thr = annParScan(n);
+	if (n_thr > 1) {					// large enough for parallel scan
+		annParMinMax(pa, pidx, n, d, n_thr, min, max);
+		return (max - min);
+	}
 	for (int i = 1; i < n; i++) {
 		ANNcoord c = PA(i,d);
 		if (c < min) min = c;
@@ -175,6 +323,11 @@ void annMinMax(					// compute min and max coordinates along dim
 	ANNcoord			&min,			// minimum value (returned)
 	ANNcoord			&max)			// maximum value (returned)
 {
+	int n_thr = annParScan(n);
+	if (n_thr > 1) {					// large enough for parallel scan
+		annParMinMax(pa, pidx, n, d, n_thr, min, max);
+		return;
+	}
 	min = PA(0,d);						// compute max and min coords
 	max = PA(0,d);
 	for (int i = 1; i < n; i++) {
@@ -195,13 +348,35 @@ int annMaxSpread(						// compute dimension of max spread
 
 	if (n == 0) return max_dim;			// no points, who cares?
 
-	for (int d = 0; d < dim; d++) {		// compute spread along each dim
-		ANNcoord spr = annSpread(pa, pidx, n, d);
+	if (annParScan(n) > 1) {			// large enough for parallel scan
+		for (int d = 0; d < dim; d++) {	// compute spread along each dim
+			ANNcoord spr = annSpread(pa, pidx, n, d);
+			if (spr > max_spr) {		// bigger than current max
+				max_spr = spr;
+				max_dim = d;
+			}
+		}
+		return max_dim;
+	}
+										// compute all spreads in one pass
+	ANNpoint lo = annCopyPt(dim, PP(0));
+	ANNpoint hi = annCopyPt(dim, PP(0));
+	for (int i = 1; i < n; i++) {
+		ANNpoint p = PP(i);
+		for (int d = 0; d < dim; d++) {
+			if (p[d] < lo[d]) lo[d] = p[d];
+			else if (p[d] > hi[d]) hi[d] = p[d];
+		}
+	}
+	for (int d = 0; d < dim; d++) {		// find the largest
+		ANNcoord spr = hi[d] - lo[d];
 		if (spr > max_spr) {			// bigger than current max
 			max_spr = spr;
 			max_dim = d;
 		}
 	}
+	annDeallocPt(lo);
+	annDeallocPt(hi);
 	return max_dim;
 }
 
@@ -219,14 +394,43 @@ int annMaxSpread(						// compute dimension of max spread
 //		splitting value.
 //
 //		All indexing is done indirectly through the index array pidx.
-//
-//		This function uses the well known selection algorithm due to
-//		C.A.R. Hoare.
+//		To avoid this indirection while selecting, the coordinates
+//		are first copied (with their indices) into a contiguous buffer,
+//		and the selection is done there by std::nth_element (which is
+//		introselect, a version of C.A.R. Hoare's algorithm which falls
+//		back to a linear-time method if it makes too little progress).
+//		The buffer is on the stack for up to ANN_SELECT_LOCAL points.
 //----------------------------------------------------------------------
 
 										// swap two points in pa array
 #define PASWAP(a,b) { int tmp = pidx[a]; pidx[a] = pidx[b]; pidx[b] = tmp; }
 
+class ANNselectEnt {					// entry in selection buffer
+public:
+	ANNcoord			c;				// coordinate
+	ANNidx				idx;			// point index
+};
+
+const int ANN_SELECT_LOCAL = 256;		// max points for local buffer
+
+static void annSelect(					// select in buffer
+	ANNselectEnt		*buf,			// the buffer (permuted)
+	int					n,				// number of entries
+	int					n_lo)			// rank to select
+{
+	std::nth_element(buf, buf + n_lo, buf + n,
+		[](const ANNselectEnt &a, const ANNselectEnt &b) { return a.c < b.c; });
+	if (n_lo > 0) {						// search for next smaller item
+		int k = 0;						// candidate's index
+		for (int i = 1; i < n_lo; i++) {
+			if (buf[i].c > buf[k].c) k = i;
+		}
+		ANNselectEnt tmp = buf[n_lo-1];	// max among buf[0..n_lo-1] to n_lo-1
+		buf[n_lo-1] = buf[k];
+		buf[k] = tmp;
+	}
+}
+
 void annMedianSplit(
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
@@ -235,43 +439,23 @@ void annMedianSplit(
 	ANNcoord			&cv,			// cutting value
 	int					n_lo)			// split into n_lo and n-n_lo
 {
-	int l = 0;							// left end of current subarray
-	int r = n-1;						// right end of current subarray
-	while (l < r) {
-		register int i = (r+l)/2;		// select middle as pivot
-		register int k;
-
-		if (PA(i,d) > PA(r,d))			// make sure last > pivot
-			PASWAP(i,r)
-		PASWAP(l,i);					// move pivot to first position
-
-		ANNcoord c = PA(l,d);			// pivot value
-		i = l;
-		k = r;
-		for(;;) {						// pivot about c
-			while (PA(++i,d) < c) ;
-			while (PA(--k,d) > c) ;
-			if (i < k) PASWAP(i,k) else break;
-		}
-		PASWAP(l,k);					// pivot winds up in location k
-
-		if (k > n_lo)	   r = k-1;		// recurse on proper subarray
-		else if (k < n_lo) l = k+1;
-		else break;						// got the median exactly
+	ANNselectEnt local[ANN_SELECT_LOCAL];	// buffer for small n
+	std::vector<ANNselectEnt> big;		// buffer for large n
+	ANNselectEnt *buf = local;
+	if (n > ANN_SELECT_LOCAL) {
+		big.resize(n);
+		buf = &big[0];
 	}
-	if (n_lo > 0) {						// search for next smaller item
-		ANNcoord c = PA(0,d);			// candidate for max
-		int k = 0;						// candidate's index
-		for (int i = 1; i < n_lo; i++) {
-			if (PA(i,d) > c) {
-				c = PA(i,d);
-				k = i;
-			}
-		}
-		PASWAP(n_lo-1, k);				// max among pa[0..n_lo-1] to pa[n_lo-1]
+	for (int i = 0; i < n; i++) {		// copy coordinates to buffer
+		buf[i].c = PA(i,d);
+		buf[i].idx = pidx[i];
+	}
+	annSelect(buf, n, n_lo);			// select the median
+	for (int i = 0; i < n; i++) {		// permute indices accordingly
+		pidx[i] = buf[i].idx;
 	}
 										// cut value is midpoint value
-	cv = (PA(n_lo-1,d) + PA(n_lo,d))/2.0;
+	cv = (buf[n_lo-1].c + buf[n_lo].c)/2.0;
 }
 
 //----------------------------------------------------------------------
@@ -285,6 +469,8 @@ void annMedianSplit(
 //				pa[br2.. n -1] >  cv
 //
 //		All indexing is done indirectly through the index array pidx.
+//		For large point sets each partition may be done in parallel
+//		(see annParPartition), with the same result.
 //
 //----------------------------------------------------------------------
 
@@ -297,6 +483,14 @@ void annPlaneSplit(				// split points by a plane
 	int					&br1,			// first break (values < cv)
 	int					&br2)			// second break (values == cv)
 {
+	int n_thr = annParScan(n);
+	if (n_thr > 1) {					// large enough for parallel scan
+		br1 = annParPartition(pidx, n, n_thr,
+				[&](int p) { return pa[p][d] < cv; });
+		br2 = br1 + annParPartition(pidx + br1, n - br1, n_thr,
+				[&](int p) { return pa[p][d] <= cv; });
+		return;
+	}
 	int l = 0;
 	int r = n-1;
 	for(;;) {							// partition pa[0..n-1] about cv
@@ -326,6 +520,8 @@ void annPlaneSplit(				// split points by a plane
 //		that are inside (or on the boundary of) the rectangle.
 //
 //		All indexing is done indirectly through the index array pidx.
+//		For large point sets the partition may be done in parallel
+//		(see annParPartition), with the same result.
 //
 //----------------------------------------------------------------------
 
@@ -337,6 +533,12 @@ void annBoxSplit(				// split points by a box
 	ANNorthRect			&box,			// the box
 	int					&n_in)			// number of points inside (returned)
 {
+	int n_thr = annParScan(n);
+	if (n_thr > 1) {					// large enough for parallel scan
+		n_in = annParPartition(pidx, n, n_thr,
+				[&](int p) { return box.inside(dim, pa[p]); });
+		return;
+	}
 	int l = 0;
 	int r = n-1;
 	for(;;) {							// partition pa[0..n-1] about box
@@ -365,6 +567,19 @@ int annSplitBalance(			// determine balance factor of a split
 	ANNcoord			cv)				// cutting value
 {
 	int n_lo = 0;
+	int n_thr = annParScan(n);
+	if (n_thr > 1) {					// large enough for parallel scan
+		std::mutex mtx;					// protects n_lo
+		annParallelFor(n, n_thr, [&](int lo, int hi) {
+			int c = 0;
+			for (int i = lo; i < hi; i++) {
+				if (PA(i,d) < cv) c++;
+			}
+			std::lock_guard<std::mutex> lock(mtx);
+			n_lo += c;
+		});
+		return n_lo - n/2;
+	}
 	for(int i = 0; i < n; i++) {		// count number less than cv
 		if (PA(i,d) < cv) n_lo++;
 	}
@@ -437,3 +652,5 @@ void annBnds2Box(
 		bnds[i].project(inner_box.hi);
 	}
 }
+
+ANN_NAMESPACE_END
@@ -20,6 +20,8 @@
 // History:
 //	Revision 0.1  03/04/98
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Added parallel scans (annSetScanThreads)
 //----------------------------------------------------------------------
 
 #ifndef ANN_kd_util_H
@@ -27,6 +29,25 @@
 
 #include "kd_tree.h"					// kd-tree declarations
 
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Parallel scans
+//		The functions below which scan all of the points (annEnclRect,
+//		annSpread, annMinMax, annSplitBalance, annPlaneSplit, and
+//		annBoxSplit) are run as parallel loops if there are at least ANN_PAR_SCAN_MIN
+//		points and more than one thread has been set for the calling
+//		thread by annSetScanThreads() (the default is one).  This is
+//		used for the top levels of parallel tree construction.  The
+//		results are the same as those of the serial versions, and in
+//		particular the points are permuted in the same way.
+//----------------------------------------------------------------------
+
+const int ANN_PAR_SCAN_MIN = 1<<16;		// min points for parallel scan
+
+int annSetScanThreads(			// set threads for scans (this thread)
+	int					n_thr);			// number of threads (returns old)
+
 //----------------------------------------------------------------------
 //	externally accessible functions
 //----------------------------------------------------------------------
@@ -121,4 +142,6 @@ void annBnds2Box(				// convert bounds to inner box
 	ANNorthHSArray		bnds,			// bounds array
 	ANNorthRect			&inner_box);	// inner box (returned)
 
+ANN_NAMESPACE_END
+
 #endif
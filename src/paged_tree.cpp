@@ -0,0 +1,495 @@
+//----------------------------------------------------------------------
+// File:			paged_tree.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Paged trees (subtrees read from a binary dump)
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "flat_tree.h"					// flat tree declarations
+#include "search_scratch.h"				// per-thread search scratch
+#include "kd_util.h"					// kd-tree utilities
+#include "pr_queue_k.h"					// k-element priority queue
+
+#include <ANN/ANNperf.h>				// performance evaluation
+
+#include <fstream>						// reading the dump file
+#include <list>							// least recently used pages
+#include <memory>						// shared_ptr
+#include <mutex>						// serializing the cache
+
+using namespace std;					// make std:: available
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Paged trees
+//		The file is a binary dump of a flat tree (see flat_dump.cpp) in
+//		the DFS layout, so the subtree rooted at node i is the range
+//		of nodes from i up to (but not including) the node following
+//		the subtree, which is the second child of the nearest ancestor
+//		of which i is a first descendant (or n_nodes).  The points of
+//		its leaves, and its halfspaces, are also contiguous ranges of
+//		their sections.
+//
+//		When the tree is opened, the nodes of its top levels are read
+//		into an array of flat nodes (top), and each subtree hanging
+//		from them becomes a node of kind ANN_FLAT_PAGE, whose first
+//		field is its page number.  A leaf in the top levels also
+//		becomes a page.  A page, when read, holds its nodes, point
+//		indices, leaf-order coordinates and halfspaces, with their
+//		child and first fields changed to refer to these arrays.
+//
+//		The search is annFlatSearch (see flat_search.cpp) on the top
+//		nodes, which calls searchPage() (below) for each page it
+//		visits, which in turn gets the page and searches it by
+//		annFlatSearch.  So the paged tree visits the same nodes, in
+//		the same order, as the flat tree would.
+//----------------------------------------------------------------------
+
+class ANNpage {							// a subtree read from the file
+public:
+	vector<ANNflatNode>		nodes;		// nodes (root is nodes[0])
+	vector<ANNidx>			pidx;		// point indices
+	vector<ANNcoord>		crd;		// points in leaf order
+	vector<ANNorthHalfSpace> bnds;		// halfspaces
+	int						height;		// height of subtree
+	size_t					bytes;		// size of all of the above
+};
+
+class ANNpageSlot {						// page table entry
+public:
+	int						first;		// first node of subtree
+	int						end;		// node following subtree
+	shared_ptr<ANNpage>		page;		// the page (NULL if not cached)
+	list<int>::iterator		lru;		// place in the list (if cached)
+};
+
+//----------------------------------------------------------------------
+//	Page cache
+//		The cached pages are listed from most to least recently used.
+//		Reading a page and changing the list are done while holding
+//		the lock, so several searches may share the cache (and the
+//		file), but only one page is read at a time.  A search holds a
+//		shared pointer to the page it is searching, so a page can be
+//		dropped from the cache (by another search) while it is being
+//		searched.
+//----------------------------------------------------------------------
+
+class ANNpageCache : public ANNflatPager {
+public:
+	ifstream				in;			// the dump file
+	ANNflatHeader			hdr;		// its header
+	int						dim;		// dimension of space
+	vector<ANNflatNode>		top;		// nodes of the top levels
+	vector<ANNorthHalfSpace> top_bnds;	// halfspaces of the top levels
+	int						top_height;	// height of top levels
+	ANNpoint				bnd_box_lo;	// bounding box low point
+	ANNpoint				bnd_box_hi;	// bounding box high point
+	vector<ANNpageSlot>		slots;		// the pages
+	list<int>				lru;		// cached pages (most recent first)
+	size_t					budget;		// maximum size of cached pages
+	size_t					cached;		// size of cached pages
+	long long				n_reads;	// pages read
+	long long				n_hits;		// pages found in the cache
+	long long				n_bytes;	// bytes read
+	mutex					lock;		// serializes reading and the list
+
+	void Read(							// read from the file
+		long long		off,			// offset in file
+		void			*buf,			// where to put it
+		long long		size);			// number of bytes
+
+	int AddTop(							// add node to top levels
+		int				i,				// node
+		int				end,			// node following its subtree
+		int				levels);		// levels left to keep in memory
+
+	shared_ptr<ANNpage> Get(			// get a page
+		int				pg);			// page number
+
+	int searchPage(						// search a page
+		int				pg,				// page number
+		ANNpoint		q,				// query point
+		ANNdist			box_dist,		// distance to subtree's box
+		double			max_err,		// max tolerable squared error
+		ANNbool			fr,				// fixed-radius search?
+		ANNdist			sq_rad,			// squared radius (if fr)
+		ANNsearchScratch *scr,			// search scratch
+		int				&pts_visited);	// points visited (modified)
+};
+
+void ANNpageCache::Read(				// read from the file
+	long long			off,			// offset in file
+	void				*buf,			// where to put it
+	long long			size)			// number of bytes
+{
+	if (size == 0) return;
+	in.clear();
+	in.seekg((streamoff) off);
+	in.read((char *) buf, (streamsize) size);
+	if (!in || in.gcount() != (streamsize) size) {
+		annError("Cannot read binary dump file", ANNabort);
+	}
+}
+
+//----------------------------------------------------------------------
+//	AddTop - add a node and its top levels
+//		The node is read and added to the top nodes, followed by the
+//		top levels of its subtrees, and its index in the top nodes is
+//		returned.  Below the top levels (or at a leaf), a page is
+//		added instead.  The file must be in the DFS layout.
+//----------------------------------------------------------------------
+
+int ANNpageCache::AddTop(
+	int					i,				// node
+	int					end,			// node following its subtree
+	int					levels)			// levels left to keep in memory
+{
+	ANNflatNode nd;
+	Read(hdr.off_nodes + i * (long long) sizeof(ANNflatNode), &nd, sizeof(nd));
+	int t = (int) top.size();			// its index in the top nodes
+	if (levels == 0 || nd.kind == ANN_FLAT_LEAF) {
+		ANNpageSlot slot;				// subtree becomes a page
+		slot.first = i;
+		slot.end = end;
+		nd.kind = ANN_FLAT_PAGE;
+		nd.n = 0;
+		nd.first = (int) slots.size();
+		nd.child[0] = nd.child[1] = 0;
+		slots.push_back(slot);
+		top.push_back(nd);
+		return t;
+	}
+	if (nd.kind < ANN_FLAT_SHRINK || nd.kind >= dim) {
+		annError("Illegal node in binary dump file", ANNabort);
+	}
+	if (nd.child[0] != i+1 || nd.child[1] <= i+1 || nd.child[1] >= end) {
+		annError("Paged trees need binary dumps in the DFS layout",
+					ANNabort);
+	}
+	if (nd.kind == ANN_FLAT_SHRINK) {	// copy its halfspaces
+		if (nd.n < 0 || nd.first < 0 || nd.first + nd.n > hdr.n_bnds) {
+			annError("Illegal node in binary dump file", ANNabort);
+		}
+		size_t b = top_bnds.size();
+		top_bnds.resize(b + nd.n);
+		Read(hdr.off_bnds + nd.first * (long long) sizeof(ANNorthHalfSpace),
+				&top_bnds[b], nd.n * (long long) sizeof(ANNorthHalfSpace));
+		nd.first = (int) b;
+	}
+	int hi = nd.child[1];
+	top.push_back(nd);
+	int c0 = AddTop(i+1, hi, levels-1);	// add its subtrees
+	int c1 = AddTop(hi, end, levels-1);
+	top[t].child[0] = c0;				// (nodes may have moved)
+	top[t].child[1] = c1;
+	return t;
+}
+
+//----------------------------------------------------------------------
+//	Get - get a page
+//		If the page is not in the cache, it is read, and pages are
+//		dropped from the end of the list until the cache is within its
+//		budget (though the page just read is always kept).  The nodes
+//		of the subtree are checked as they are rebased, since errors in
+//		the file are only found when the page is read.
+//----------------------------------------------------------------------
+
+shared_ptr<ANNpage> ANNpageCache::Get(
+	int					pg)				// page number
+{
+	lock_guard<mutex> guard(lock);
+	ANNpageSlot &slot = slots[pg];
+	if (slot.page) {					// in the cache
+		n_hits++;
+		lru.splice(lru.begin(), lru, slot.lru);	// now most recent
+		return slot.page;
+	}
+
+	shared_ptr<ANNpage> p(new ANNpage);
+	int n = slot.end - slot.first;		// read its nodes
+	p->nodes.resize(n);
+	Read(hdr.off_nodes + slot.first * (long long) sizeof(ANNflatNode),
+			&p->nodes[0], n * (long long) sizeof(ANNflatNode));
+
+	int pt_lo = -1, pt_hi = 0;			// range of point indices
+	int bnd_lo = -1, bnd_hi = 0;		// range of halfspaces
+	for (int j = 0; j < n; j++) {		// check and rebase nodes
+		ANNflatNode &nd = p->nodes[j];
+		if (nd.kind == ANN_FLAT_LEAF) {
+			if (pt_lo < 0) pt_lo = pt_hi = nd.first;
+			if (nd.n < 0 || nd.first != pt_hi || pt_hi + nd.n > hdr.n_idx) {
+				annError("Illegal node in binary dump file", ANNabort);
+			}
+			pt_hi += nd.n;
+			nd.first -= pt_lo;
+			continue;
+		}
+		if (nd.kind < ANN_FLAT_SHRINK || nd.kind >= dim) {
+			annError("Illegal node in binary dump file", ANNabort);
+		}
+		int g = slot.first + j;			// index in file
+		if (nd.child[0] != g+1 || nd.child[1] <= g+1 ||
+			nd.child[1] >= slot.end) {
+			annError("Paged trees need binary dumps in the DFS layout",
+						ANNabort);
+		}
+		nd.child[0] -= slot.first;
+		nd.child[1] -= slot.first;
+		if (nd.kind == ANN_FLAT_SHRINK) {
+			if (bnd_lo < 0) bnd_lo = bnd_hi = nd.first;
+			if (nd.n < 0 || nd.first != bnd_hi || bnd_hi + nd.n > hdr.n_bnds) {
+				annError("Illegal node in binary dump file", ANNabort);
+			}
+			bnd_hi += nd.n;
+			nd.first -= bnd_lo;
+		}
+	}
+	if (pt_lo < 0) pt_lo = 0;
+	if (bnd_lo < 0) bnd_lo = 0;
+										// read points and halfspaces
+	p->pidx.resize(pt_hi - pt_lo);
+	p->crd.resize((size_t) (pt_hi - pt_lo) * dim);
+	p->bnds.resize(bnd_hi - bnd_lo);
+	if (!p->pidx.empty()) {
+		Read(hdr.off_pidx + pt_lo * (long long) sizeof(ANNidx),
+				&p->pidx[0], p->pidx.size() * (long long) sizeof(ANNidx));
+		Read(hdr.off_leaf + pt_lo * (long long) dim * sizeof(ANNcoord),
+				&p->crd[0], p->crd.size() * (long long) sizeof(ANNcoord));
+	}
+	if (!p->bnds.empty()) {
+		Read(hdr.off_bnds + bnd_lo * (long long) sizeof(ANNorthHalfSpace),
+				&p->bnds[0],
+				p->bnds.size() * (long long) sizeof(ANNorthHalfSpace));
+	}
+
+	vector<int> h(n);					// heights (children come later)
+	for (int j = n-1; j >= 0; j--) {
+		const ANNflatNode &nd = p->nodes[j];
+		if (nd.kind == ANN_FLAT_LEAF) h[j] = 1;
+		else h[j] = 1 + max(h[nd.child[0]], h[nd.child[1]]);
+	}
+	p->height = h[0];
+	p->bytes = n * sizeof(ANNflatNode) + p->pidx.size() * sizeof(ANNidx) +
+			p->crd.size() * sizeof(ANNcoord) +
+			p->bnds.size() * sizeof(ANNorthHalfSpace);
+
+	n_reads++;							// count it
+	n_bytes += p->bytes;
+	ANN_PAGE(1)
+	ANN_READ((int) p->bytes)
+
+	slot.page = p;						// add it to the cache
+	lru.push_front(pg);
+	slot.lru = lru.begin();
+	cached += p->bytes;
+	while (cached > budget && lru.size() > 1) {
+		int old = lru.back();			// drop least recently used
+		lru.pop_back();
+		cached -= slots[old].page->bytes;
+		slots[old].page.reset();		// (freed when not in use)
+	}
+	return p;
+}
+
+int ANNpageCache::searchPage(			// search a page
+	int					pg,				// page number
+	ANNpoint			q,				// query point
+	ANNdist				box_dist,		// distance to subtree's box
+	double				max_err,		// max tolerable squared error
+	ANNbool				fr,				// fixed-radius search?
+	ANNdist				sq_rad,			// squared radius (if fr)
+	ANNsearchScratch	*scr,			// search scratch
+	int					&pts_visited)	// points visited (modified)
+{
+	shared_ptr<ANNpage> p = Get(pg);	// (kept until search is done)
+	return annFlatSearch(&p->nodes[0], p->height,
+			(p->bnds.empty() ? NULL : &p->bnds[0]),
+			(p->pidx.empty() ? NULL : &p->pidx[0]), NULL,
+			(p->crd.empty() ? NULL : &p->crd[0]), dim,
+			q, box_dist, max_err, fr, sq_rad, scr, NULL, pts_visited);
+}
+
+//----------------------------------------------------------------------
+//	Paged tree constructor and destructor
+//		The constructor reads the header, the bounding box and the top
+//		levels.  The top levels are at most ANN_FLAT_STACK/2 high, so
+//		that their search uses the local stack of annFlatSearch.
+//----------------------------------------------------------------------
+
+ANNpaged_tree::ANNpaged_tree(			// open binary dump file
+	const char			*file_name,		// name of file
+	size_t				cache_size,		// cache budget (bytes)
+	int					top_levels)		// levels in memory
+{
+	cache = new ANNpageCache;
+	ANNpageCache &c = *cache;
+	c.in.open(file_name, ios::in | ios::binary);
+	if (!c.in) {
+		annError("Cannot open binary dump file", ANNabort);
+	}
+	c.in.seekg(0, ios::end);			// get size of file
+	long long file_size = (long long) c.in.tellg();
+	c.in.seekg(0, ios::beg);
+	if (file_size < (long long) sizeof(c.hdr)) {
+		annError("Incorrect header for binary dump file", ANNabort);
+	}
+	c.Read(0, &c.hdr, sizeof(c.hdr));
+	annFlatCheckHeader(c.hdr, file_size);
+	if (c.hdr.n_idx > 0 && c.hdr.leaf_pts == 0) {
+		annError("Paged trees need binary dumps with points in leaf order",
+					ANNabort);
+	}
+
+	dim = c.dim = c.hdr.dim;
+	n_pts = c.hdr.n_pts;
+	c.budget = cache_size;
+	c.cached = 0;
+	c.n_reads = c.n_hits = c.n_bytes = 0;
+	c.bnd_box_lo = annAllocPt(dim);		// read the bounding box
+	c.bnd_box_hi = annAllocPt(dim);
+	c.Read(c.hdr.off_box, c.bnd_box_lo, dim * (long long) sizeof(ANNcoord));
+	c.Read(c.hdr.off_box + dim * (long long) sizeof(ANNcoord),
+			c.bnd_box_hi, dim * (long long) sizeof(ANNcoord));
+
+	if (top_levels < 0) top_levels = 0;	// read the top levels
+	if (top_levels > ANN_FLAT_STACK/2) top_levels = ANN_FLAT_STACK/2;
+	c.top_height = 0;
+	if (c.hdr.n_nodes > 0) {
+		c.AddTop(0, c.hdr.n_nodes, top_levels);
+		vector<int> h(c.top.size());	// heights (children come later)
+		for (int j = (int) c.top.size()-1; j >= 0; j--) {
+			const ANNflatNode &nd = c.top[j];
+			if (nd.kind == ANN_FLAT_PAGE) h[j] = 1;
+			else h[j] = 1 + max(h[nd.child[0]], h[nd.child[1]]);
+		}
+		c.top_height = h[0];
+	}
+}
+
+ANNpaged_tree::~ANNpaged_tree()			// tree destructor
+{
+	annDeallocPt(cache->bnd_box_lo);
+	annDeallocPt(cache->bnd_box_hi);
+	delete cache;						// (closes the file)
+}
+
+//----------------------------------------------------------------------
+//	annkSearch and annkFRSearch - search the paged tree
+//		These are the same as for flat trees (see flat_search.cpp),
+//		but start with the top levels, and pass the cache as pager.
+//----------------------------------------------------------------------
+
+void ANNpaged_tree::annkSearch(
+	ANNpoint			q,				// the query point
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
+{
+	if (k > n_pts) {					// too many near neighbors?
+		annError("Requesting more near neighbors than data points", ANNabort);
+	}
+	double max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+	ANNsearchScratch *scr = annGetScratch();
+	ANNmin_k *point_mk = &scr->point_mk;// set for closest k points
+	point_mk->reset(k);
+	int pts_visited = 0;				// number of points visited
+	if (!cache->top.empty()) {
+		annFlatSearch(&cache->top[0], cache->top_height,
+				(cache->top_bnds.empty() ? NULL : &cache->top_bnds[0]),
+				NULL, NULL, NULL, dim, q,
+				annBoxDistance(q, cache->bnd_box_lo, cache->bnd_box_hi, dim),
+				max_err, ANNfalse, 0, scr, cache, pts_visited);
+	}
+	for (int i = 0; i < k; i++) {		// extract the k-th closest points
+		dd[i] = point_mk->ith_smallest_key(i);
+		nn_idx[i] = point_mk->ith_smallest_info(i);
+	}
+	annReleaseScratch(scr);				// done with scratch
+}
+
+int ANNpaged_tree::annkFRSearch(
+	ANNpoint			q,				// the query point
+	ANNdist				sqRad,			// squared radius search bound
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
+{
+	double max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+	ANNsearchScratch *scr = annGetScratch();
+	ANNmin_k *point_mk = &scr->point_mk;// set for closest k points
+	point_mk->reset(k);
+	int pts_in_range = 0;				// number of points in range
+	int pts_visited = 0;				// number of points visited
+	if (!cache->top.empty()) {
+		pts_in_range = annFlatSearch(&cache->top[0], cache->top_height,
+				(cache->top_bnds.empty() ? NULL : &cache->top_bnds[0]),
+				NULL, NULL, NULL, dim, q,
+				annBoxDistance(q, cache->bnd_box_lo, cache->bnd_box_hi, dim),
+				max_err, ANNtrue, sqRad, scr, cache, pts_visited);
+	}
+	for (int i = 0; i < k; i++) {		// extract the k-th closest points
+		if (dd != NULL)
+			dd[i] = point_mk->ith_smallest_key(i);
+		if (nn_idx != NULL)
+			nn_idx[i] = point_mk->ith_smallest_info(i);
+	}
+	annReleaseScratch(scr);				// done with scratch
+	return pts_in_range;				// return final point count
+}
+
+//----------------------------------------------------------------------
+//	Cache statistics
+//----------------------------------------------------------------------
+
+int ANNpaged_tree::nPages()				// return number of pages
+{
+	return (int) cache->slots.size();
+}
+
+size_t ANNpaged_tree::cacheBytes()		// return bytes now in cache
+{
+	lock_guard<mutex> guard(cache->lock);
+	return cache->cached;
+}
+
+long long ANNpaged_tree::nPageReads()	// return pages read from file
+{
+	lock_guard<mutex> guard(cache->lock);
+	return cache->n_reads;
+}
+
+long long ANNpaged_tree::nPageHits()	// return pages found in cache
+{
+	lock_guard<mutex> guard(cache->lock);
+	return cache->n_hits;
+}
+
+long long ANNpaged_tree::nBytesRead()	// return bytes read from file
+{
+	lock_guard<mutex> guard(cache->lock);
+	return cache->n_bytes;
+}
+
+ANN_NAMESPACE_END
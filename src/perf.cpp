@@ -26,6 +26,8 @@
 //			in Microsoft Windows version.
 //	Revision 1.1.2  01/27/10
 //		Fixed minor compilation bugs for new versions of gcc
+//	Revision 1.2  10/17/26
+//		Added page reads and bytes read (for paged trees)
 //----------------------------------------------------------------------
 
 #include <ANN/ANN.h>					// basic ANN includes
@@ -33,6 +35,8 @@
 
 using namespace std;					// make std:: available
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Performance statistics
 //		The following data and routines are used for computing
@@ -53,6 +57,8 @@ int				ann_Nvisit_shr = 0;		// number of shrinking nodes visited
 int				ann_Nvisit_pts = 0;		// visited points for one query
 int				ann_Ncoord_hts = 0;		// coordinate hits for one query
 int				ann_Nfloat_ops = 0;		// floating ops for one query
+int				ann_Npage_rds  = 0;		// pages read for one query
+int				ann_Nbytes_rd  = 0;		// bytes read for one query
 ANNsampStat		ann_visit_lfs;			// stats on leaf nodes visits
 ANNsampStat		ann_visit_spl;			// stats on splitting nodes visits
 ANNsampStat		ann_visit_shr;			// stats on shrinking nodes visits
@@ -60,6 +66,8 @@ ANNsampStat		ann_visit_nds;			// stats on total nodes visits
 ANNsampStat		ann_visit_pts;			// stats on points visited
 ANNsampStat		ann_coord_hts;			// stats on coordinate hits
 ANNsampStat		ann_float_ops;			// stats on floating ops
+ANNsampStat		ann_page_rds;			// stats on pages read
+ANNsampStat		ann_bytes_rd;			// stats on bytes read
 //
 ANNsampStat		ann_average_err;		// average error
 ANNsampStat		ann_rank_err;			// rank error
@@ -78,6 +86,8 @@ DLL_API void annResetStats(int data_size) // reset stats for a set of queries
 	ann_visit_pts.reset();
 	ann_coord_hts.reset();
 	ann_float_ops.reset();
+	ann_page_rds.reset();
+	ann_bytes_rd.reset();
 	ann_average_err.reset();
 	ann_rank_err.reset();
 }
@@ -90,6 +100,8 @@ DLL_API void annResetCounts()				// reset counts for one query
 	ann_Nvisit_pts = 0;
 	ann_Ncoord_hts = 0;
 	ann_Nfloat_ops = 0;
+	ann_Npage_rds = 0;
+	ann_Nbytes_rd = 0;
 }
 
 DLL_API void annUpdateStats()				// update stats with current counts
@@ -101,6 +113,8 @@ DLL_API void annUpdateStats()				// update stats with current counts
 	ann_visit_pts += ann_Nvisit_pts;
 	ann_coord_hts += ann_Ncoord_hts;
 	ann_float_ops += ann_Nfloat_ops;
+	ann_page_rds += ann_Npage_rds;
+	ann_bytes_rd += ann_Nbytes_rd;
 }
 
 										// print a single statistic
@@ -126,6 +140,10 @@ DLL_API void annPrintStats(				// print statistics for a run
 	print_one_stat("    points_visited   ", ann_visit_pts, 1);
 	print_one_stat("    coord_hits/pt    ", ann_coord_hts, ann_Ndata_pts);
 	print_one_stat("    floating_ops_(K) ", ann_float_ops, 1000);
+	if (ann_page_rds.max() > 0) {		// (only for paged trees)
+		print_one_stat("    pages_read       ", ann_page_rds, 1);
+		print_one_stat("    bytes_read_(K)   ", ann_bytes_rd, 1000);
+	}
 	if (validate) {
 		print_one_stat("    average_error    ", ann_average_err, 1);
 		print_one_stat("    rank_error       ", ann_rank_err, 1);
@@ -134,3 +152,5 @@ DLL_API void annPrintStats(				// print statistics for a run
 	cout << "  )\n";
 	cout.flush();
 }
+
+ANN_NAMESPACE_END
@@ -0,0 +1,435 @@
+//----------------------------------------------------------------------
+// File:			point_file.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Reading point files (binary and text)
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include <ANN/ANNx.h>					// all ANN includes
+#include "thread_pool.h"				// parallel loops
+
+#include <climits>						// INT_MAX
+#include <cstdlib>						// strtod
+#include <cstring>						// memcpy
+#include <fstream>						// reading without mapping
+#include <string>						// error messages
+#include <vector>						// read buffer
+
+#if defined(__has_include)				// fast number parsing
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+using namespace std;					// make std:: available
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Binary point files
+//		Each point is a record of the same size: for fvecs and bvecs,
+//		a 4-byte dimension, followed by the dim coordinates.  So the
+//		number of points is the size of the file divided by the size
+//		of a record.  The values are little-endian, and are copied
+//		byte by byte (by memcpy), so records need not be aligned.  On
+//		a big-endian machine the bytes of each value are reversed.
+//
+//		When the file is mapped, the records are converted straight
+//		from the mapping.  Otherwise they are read in blocks of about
+//		ANN_PTS_BLOCK bytes.
+//----------------------------------------------------------------------
+
+const int ANN_PTS_BLOCK = 1 << 20;		// size of read blocks
+
+static ANNbool annLittleEndian()		// is this machine little-endian?
+{
+	const int one = 1;
+	return (ANNbool) (*(const char *) &one == 1);
+}
+
+static void annSwapBytes(				// reverse bytes of a value
+	char				*p,				// the value
+	int					size)			// its size
+{
+	for (int i = 0, j = size-1; i < j; i++, j--) {
+		char t = p[i]; p[i] = p[j]; p[j] = t;
+	}
+}
+
+static int annGetInt(					// get little-endian int
+	const char			*p,				// where it is
+	ANNbool				swap)			// reverse bytes?
+{
+	int v;
+	memcpy(&v, p, 4);
+	if (swap) annSwapBytes((char *) &v, 4);
+	return v;
+}
+
+//----------------------------------------------------------------------
+//	annDecodePts - convert records to points
+//----------------------------------------------------------------------
+
+static void annDecodePts(
+	const char			*buf,			// the records
+	int					n,				// number of records
+	ANNptsFormat		format,			// format of records
+	int					dim,			// dimension
+	ANNpointArray		pa,				// the points (modified)
+	ANNbool				swap)			// reverse bytes?
+{
+	ANNbool vecs = (ANNbool) (format == ANN_PTS_FVECS ||
+				format == ANN_PTS_BVECS);
+	int elt = (format == ANN_PTS_DOUBLE ? 8 :
+				format == ANN_PTS_BVECS ? 1 : 4);
+	size_t rec = (vecs ? 4 : 0) + (size_t) dim * elt;
+
+	for (int i = 0; i < n; i++) {
+		const char *r = buf + i * rec;	// this record
+		ANNpoint p = pa[i];
+		if (vecs) {						// check its dimension
+			if (annGetInt(r, swap) != dim) {
+				annError("Points of different dimensions in point file",
+							ANNabort);
+			}
+			r += 4;
+		}
+		switch (format) {
+		case ANN_PTS_FLOAT:
+		case ANN_PTS_FVECS:
+			for (int d = 0; d < dim; d++) {
+				float v;
+				memcpy(&v, r + 4*d, 4);
+				if (swap) annSwapBytes((char *) &v, 4);
+				p[d] = (ANNcoord) v;
+			}
+			break;
+		case ANN_PTS_DOUBLE:
+			for (int d = 0; d < dim; d++) {
+				double v;
+				memcpy(&v, r + 8*d, 8);
+				if (swap) annSwapBytes((char *) &v, 8);
+				p[d] = (ANNcoord) v;
+			}
+			break;
+		case ANN_PTS_BVECS:
+			for (int d = 0; d < dim; d++) {
+				p[d] = (ANNcoord) (unsigned char) r[d];
+			}
+			break;
+		}
+	}
+}
+
+//----------------------------------------------------------------------
+//	annReadPtsBin - read binary point file
+//----------------------------------------------------------------------
+
+ANNpointArray annReadPtsBin(
+	const char			*file_name,		// name of file
+	ANNptsFormat		format,			// format of file
+	int					&dim,			// dimension (may be returned)
+	int					&n,				// max number of points (returned)
+	ANNbool				map_file)		// map the file?
+{
+	if (format < 0 || format >= ANN_N_PTS_FORMATS) {
+		annError("Unknown point file format", ANNabort);
+	}
+	ANNbool vecs = (ANNbool) (format == ANN_PTS_FVECS ||
+				format == ANN_PTS_BVECS);
+	int elt = (format == ANN_PTS_DOUBLE ? 8 :
+				format == ANN_PTS_BVECS ? 1 : 4);
+	ANNbool swap = (ANNbool) !annLittleEndian();
+
+	size_t size = 0;					// size of file
+	char *map = NULL;					// the mapping (or NULL)
+	ifstream in;						// the file (if not mapped)
+	if (map_file) {
+		map = annMapFile(file_name, size);
+	}
+	if (map == NULL) {					// not mapped (or empty)
+		in.open(file_name, ios::in | ios::binary);
+		if (!in) {
+			annError("Cannot open point file", ANNabort);
+		}
+		in.seekg(0, ios::end);
+		size = (size_t) in.tellg();
+		in.seekg(0, ios::beg);
+	}
+
+	if (vecs && size >= 4) {			// get dimension from file
+		char b[4];
+		if (map != NULL) memcpy(b, map, 4);
+		else if (!in.read(b, 4) || !in.seekg(0, ios::beg)) {
+			annError("Cannot read point file", ANNabort);
+		}
+		int file_dim = annGetInt(b, swap);
+		if (file_dim <= 0) {
+			annError("Illegal dimension in point file", ANNabort);
+		}
+		if (dim > 0 && dim != file_dim) {
+			annError("Dimension of point file does not match", ANNabort);
+		}
+		dim = file_dim;
+	}
+	if (dim <= 0) {
+		annError("Dimension of point file must be given", ANNabort);
+	}
+	size_t rec = (vecs ? 4 : 0) + (size_t) dim * elt;
+	if (size % rec != 0) {
+		annError("Point file size is not a multiple of the point size",
+					ANNabort);
+	}
+	if (size / rec > (size_t) INT_MAX) {
+		annError("Too many points in point file", ANNabort);
+	}
+	int n_file = (int) (size / rec);	// number of points in file
+	if (n <= 0 || n > n_file) n = n_file;
+
+										// (allocate one if none, since
+										// annDeallocPts frees pa[0])
+	ANNpointArray pa = annAllocPts(n > 0 ? n : 1, dim);
+	if (map != NULL) {					// convert from the mapping
+		annDecodePts(map, n, format, dim, pa, swap);
+		annUnmapFile(map, size);
+	}
+	else {								// read and convert blocks
+		int blk = (int) (ANN_PTS_BLOCK / rec) + 1;
+		vector<char> buf(blk * rec);
+		for (int i = 0; i < n; i += blk) {
+			int m = (n - i < blk ? n - i : blk);
+			if (!in.read(&buf[0], (streamsize) (m * rec))) {
+				annError("Cannot read point file", ANNabort);
+			}
+			annDecodePts(&buf[0], m, format, dim, pa + i, swap);
+		}
+	}
+	return pa;
+}
+
+//----------------------------------------------------------------------
+//	Text point files
+//		A text point file has one point per line, given by dim
+//		coordinates separated by white space.  Blank lines are
+//		skipped.  Any other line which does not hold exactly dim
+//		numbers is malformed.
+//
+//		The file is mapped (or, if it cannot be, read into memory), and
+//		cut into chunks of about ANN_PTS_CHUNK bytes, each of which
+//		starts at the beginning of a line.  The chunks are processed in
+//		parallel (by annParallelFor) twice.  The first pass counts the
+//		lines and points of each chunk, which tells where the points
+//		of each chunk go in the point array, and the line number at
+//		which it starts.  The second pass parses the points straight
+//		into the point array.
+//
+//		Numbers are parsed by std::from_chars if the library has it
+//		(for floating point), which is much faster than streams, and
+//		otherwise by strtod.  Both round correctly, so the points are
+//		the same as those read by operator>>.
+//----------------------------------------------------------------------
+
+const int ANN_PTS_CHUNK = 1 << 20;		// size of chunks
+const int ANN_PTS_MAX_ERRS = 10;		// malformed lines reported
+
+class ANNptsChunk {						// chunk of a text point file
+public:
+	const char			*start;			// start of chunk
+	const char			*end;			// end of chunk
+	int					n_lines;		// number of lines
+	int					n_pts;			// number of points (nonblank lines)
+	int					first_line;		// number of first line (from 1)
+	int					first_pt;		// index of first point
+	std::vector<int>	bad;			// malformed lines found
+};
+
+static inline ANNbool annIsSpace(char c)	// white space (not newline)?
+{
+	return (ANNbool) (c == ' ' || c == '\t' || c == '\r' ||
+				c == '\f' || c == '\v');
+}
+
+//----------------------------------------------------------------------
+//	annParseCoord - parse a coordinate
+//		Parses the number at p (which ends before e, or at white
+//		space), and returns the end of it, or NULL if it is not a
+//		number.
+//----------------------------------------------------------------------
+
+static const char *annParseCoord(
+	const char			*p,				// start of number
+	const char			*e,				// end of line
+	ANNcoord			&v)				// the number (returned)
+{
+	const char *q = p;					// find end of token
+	while (q < e && !annIsSpace(*q)) q++;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+	if (*p == '+' && q - p > 1 && p[1] != '-') p++;	// (from_chars rejects +)
+	std::from_chars_result r = std::from_chars(p, q, v);
+	if (r.ec != std::errc() || r.ptr != q) return NULL;
+#else
+	char tok[64];						// copy it (strtod needs a '\0')
+	if (q - p >= (int) sizeof(tok)) return NULL;
+	memcpy(tok, p, q - p);
+	tok[q - p] = '\0';
+	char *t;
+	v = (ANNcoord) strtod(tok, &t);
+	if (t != tok + (q - p)) return NULL;
+#endif
+	return q;
+}
+
+//----------------------------------------------------------------------
+//	annCountChunk and annParseChunk - the two passes over a chunk
+//----------------------------------------------------------------------
+
+static void annCountChunk(
+	ANNptsChunk			&c)				// the chunk
+{
+	c.n_lines = c.n_pts = 0;
+	const char *p = c.start;
+	while (p < c.end) {
+		const char *e = (const char *) memchr(p, '\n', c.end - p);
+		if (e == NULL) e = c.end;		// (last line has no newline)
+		c.n_lines++;
+		while (p < e && annIsSpace(*p)) p++;
+		if (p < e) c.n_pts++;			// not blank
+		p = e + 1;
+	}
+}
+
+static void annParseChunk(
+	ANNptsChunk			&c,				// the chunk
+	int					dim,			// dimension
+	int					n,				// number of points wanted
+	ANNpointArray		pa)				// the points (modified)
+{
+	int line = c.first_line;			// current line number
+	int i = c.first_pt;					// current point index
+	const char *p = c.start;
+	while (p < c.end && i < n) {
+		const char *e = (const char *) memchr(p, '\n', c.end - p);
+		if (e == NULL) e = c.end;
+		while (p < e && annIsSpace(*p)) p++;
+		if (p < e) {					// not blank--parse point
+			ANNpoint pt = pa[i++];
+			int d = 0;
+			while (d < dim && p != NULL && p < e) {
+				p = annParseCoord(p, e, pt[d++]);
+				while (p != NULL && p < e && annIsSpace(*p)) p++;
+			}
+			if (p == NULL || d < dim || p < e) {	// malformed
+				if ((int) c.bad.size() < ANN_PTS_MAX_ERRS)
+					c.bad.push_back(line);
+			}
+		}
+		line++;
+		p = e + 1;
+	}
+}
+
+//----------------------------------------------------------------------
+//	annReadPts - read text point file
+//----------------------------------------------------------------------
+
+ANNpointArray annReadPts(
+	const char			*file_name,		// name of file
+	int					dim,			// dimension
+	int					&n,				// max number of points (returned)
+	int					n_threads,		// number of threads
+	int					*n_file)		// points in file (returned)
+{
+	size_t size = 0;					// size of file
+	char *map = annMapFile(file_name, size);
+	vector<char> text;					// the file (if not mapped)
+	const char *buf = map;
+	if (map == NULL) {					// cannot map (or empty)--read
+		ifstream in(file_name, ios::in | ios::binary);
+		if (!in) {
+			annError("Cannot open point file", ANNabort);
+		}
+		in.seekg(0, ios::end);
+		size = (size_t) in.tellg();
+		in.seekg(0, ios::beg);
+		text.resize(size + 1);
+		if (size > 0 && !in.read(&text[0], (streamsize) size)) {
+			annError("Cannot read point file", ANNabort);
+		}
+		buf = &text[0];
+	}
+										// cut it into chunks
+	vector<ANNptsChunk> chunks(size / ANN_PTS_CHUNK + 1);
+	int n_chunks = (int) chunks.size();
+	const char *end = buf + size;
+	const char *p = buf;
+	for (int j = 0; j < n_chunks; j++) {
+		chunks[j].start = p;
+		const char *e = buf + (size_t) (j+1) * size / n_chunks;
+		if (e < p) e = p;
+		if (e < end) {					// move end to start of a line
+			const char *nl = (const char *) memchr(e, '\n', end - e);
+			e = (nl == NULL ? end : nl + 1);
+		}
+		chunks[j].end = e;
+		p = e;
+	}
+										// count lines and points
+	annParallelFor(n_chunks, n_threads, [&](int lo, int hi) {
+		for (int j = lo; j < hi; j++) annCountChunk(chunks[j]);
+	});
+	long long n_pts = 0;				// number of points in file
+	int line = 1;
+	for (int j = 0; j < n_chunks; j++) {
+		chunks[j].first_line = line;
+		chunks[j].first_pt = (int) (n_pts < INT_MAX ? n_pts : INT_MAX);
+		line += chunks[j].n_lines;
+		n_pts += chunks[j].n_pts;
+	}
+	if (n_pts > INT_MAX) {
+		annError("Too many points in point file", ANNabort);
+	}
+	if (n_file != NULL) *n_file = (int) n_pts;
+	if (n <= 0 || n > n_pts) n = (int) n_pts;
+
+										// parse the points (allocating one
+										// if none, as above)
+	ANNpointArray pa = annAllocPts(n > 0 ? n : 1, dim);
+	annParallelFor(n_chunks, n_threads, [&](int lo, int hi) {
+		for (int j = lo; j < hi; j++) annParseChunk(chunks[j], dim, n, pa);
+	});
+	if (map != NULL) annUnmapFile(map, size);
+
+	int n_bad = 0;						// report malformed lines
+	for (int j = 0; j < n_chunks && n_bad < ANN_PTS_MAX_ERRS; j++) {
+		for (size_t b = 0; b < chunks[j].bad.size() &&
+					n_bad < ANN_PTS_MAX_ERRS; b++, n_bad++) {
+			string msg = string(file_name) + ", line " +
+						to_string(chunks[j].bad[b]) + ": not " +
+						to_string(dim) + " numbers";
+			annError(msg.c_str(), ANNwarn);
+		}
+	}
+	if (n_bad > 0) {
+		annError("Malformed lines in point file", ANNabort);
+	}
+	return pa;
+}
+
+ANN_NAMESPACE_END
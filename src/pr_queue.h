@@ -21,6 +21,8 @@
 // History:
 //	Revision 0.1  03/04/98
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Added reset(max) for reuse across queries
 //----------------------------------------------------------------------
 
 #ifndef PR_QUEUE_H
@@ -29,6 +31,8 @@
 #include <ANN/ANNx.h>					// all ANN includes
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Basic types.
 //----------------------------------------------------------------------
@@ -81,6 +85,16 @@ public:
 	void reset()						// make existing queue empty
 		{ n = 0; }
 
+	void reset(int max)					// empty and ensure max size
+		{								// (reallocates only if larger)
+			if (max > max_size) {
+				delete [] pq;
+				max_size = max;
+				pq = new pq_node[max+1];
+			}
+			n = 0;
+		}
+
 	inline void insert(					// insert item (inlined for speed)
 		PQkey kv,						// key value
 		PQinfo inf)						// item info
@@ -122,4 +136,6 @@ public:
 		}
 };
 
+ANN_NAMESPACE_END
+
 #endif
@@ -20,14 +20,20 @@
 // History:
 //	Revision 0.1  03/04/98
 //		Initial release
+//	Revision 1.2  10/17/26
+//		Added reset() for reuse across queries
+//		Added heap representation for large k
 //----------------------------------------------------------------------
 
 #ifndef PR_QUEUE_K_H
 #define PR_QUEUE_K_H
 
+#include <algorithm>					// sort_heap, make_heap
 #include <ANN/ANNx.h>					// all ANN includes
 #include <ANN/ANNperf.h>				// performance evaluation
 
+ANN_NAMESPACE_BEGIN
+
 //----------------------------------------------------------------------
 //	Basic types
 //----------------------------------------------------------------------
@@ -53,11 +59,22 @@ const PQKinfo	PQ_NULL_INFO =  ANN_NULL_IDX;	// nonexistent info value
 //		PQKinfo).  The special info and key values PQ_NULL_INFO and
 //		PQ_NULL_KEY means that thise entry is empty.
 //
-//		It is currently implemented using an array with k items.
-//		Items are stored in increasing sorted order, and insertions
-//		are made through standard insertion sort.  (This is quite
-//		inefficient, but current applications call for small values
-//		of k and relatively few insertions.)
+//		For k <= ANNheapK, it is implemented using an array with k
+//		items.  Items are stored in increasing sorted order, and
+//		insertions are made through standard insertion sort.  This is
+//		the fastest method for small k, but each insertion takes O(k)
+//		time.
+//
+//		For larger k, the items are stored in a binary max-heap
+//		(indexed from [0..n-1]), so the k-th smallest key is at the
+//		root, and each insertion takes O(log k) time.  The heap is
+//		sorted (in place) when the items are first extracted.  (If
+//		more items are inserted after this, the heap is rebuilt.)
+//
+//		In both cases, items with equal keys are ordered by the
+//		order of their insertion (given by seq), and a new item whose
+//		key equals the k-th smallest is ignored, so both methods give
+//		exactly the same results.
 //		
 //		Note that the list contains k+1 entries, but the last entry
 //		is used as a simple placeholder and is otherwise ignored.
@@ -67,39 +84,87 @@ class ANNmin_k {
 	struct mk_node {					// node in min_k structure
 		PQKkey			key;			// key value
 		PQKinfo			info;			// info field (user defined)
+		int				seq;			// insertion order (heap only)
 	};
 
 	int			k;						// max number of keys to store
 	int			n;						// number of keys currently active
+	int			cap;					// allocated size (>= k)
 	mk_node		*mk;					// the list itself
+	ANNbool		heap;					// stored as a heap?
+	ANNbool		sorted;					// heap has been sorted?
+	int			n_ins;					// number of insertions (heap only)
+
+	static bool mk_less(				// order of nodes in heap
+		const mk_node &a,
+		const mk_node &b)
+		{ return a.key < b.key || (a.key == b.key && a.seq < b.seq); }
+
+	void heap_insert(					// insert item into heap
+		PQKkey kv,						// key value
+		PQKinfo inf);					// item info
+
+	void sort()							// sort heap for extraction
+		{
+			if (heap && !sorted) {
+				std::sort_heap(mk, mk+n, mk_less);
+				sorted = ANNtrue;
+				ANN_FLOP(2*n)			// increment floating ops (roughly)
+			}
+		}
 
 public:
 	ANNmin_k(int max)					// constructor (given max size)
 		{
 			n = 0;						// initially no items
 			k = max;					// maximum number of items
+			cap = max;
 			mk = new mk_node[max+1];	// sorted array of keys
+			heap = (max > ANNheapK ? ANNtrue : ANNfalse);
+			sorted = ANNfalse;
+			n_ins = 0;
 		}
 
 	~ANNmin_k()							// destructor
 		{ delete [] mk; }
+
+	void reset(int max)					// empty and set new max size
+		{								// (reallocates only if larger)
+			if (max > cap) {
+				delete [] mk;
+				cap = max;
+				mk = new mk_node[max+1];
+			}
+			n = 0;
+			k = max;
+			heap = (max > ANNheapK ? ANNtrue : ANNfalse);
+			sorted = ANNfalse;
+			n_ins = 0;
+		}
 	
 	PQKkey ANNmin_key()					// return minimum key
-		{ return (n > 0 ? mk[0].key : PQ_NULL_KEY); }
+		{ sort(); return (n > 0 ? mk[0].key : PQ_NULL_KEY); }
 	
 	PQKkey max_key()					// return maximum key
-		{ return (n == k ? mk[k-1].key : PQ_NULL_KEY); }
+		{
+			if (n < k) return PQ_NULL_KEY;
+			return (heap && !sorted ? mk[0].key : mk[k-1].key);
+		}
 	
 	PQKkey ith_smallest_key(int i)		// ith smallest key (i in [0..n-1])
-		{ return (i < n ? mk[i].key : PQ_NULL_KEY); }
+		{ sort(); return (i < n ? mk[i].key : PQ_NULL_KEY); }
 	
 	PQKinfo ith_smallest_info(int i)	// info for ith smallest (i in [0..n-1])
-		{ return (i < n ? mk[i].info : PQ_NULL_INFO); }
+		{ sort(); return (i < n ? mk[i].info : PQ_NULL_INFO); }
 
 	inline void insert(					// insert item (inlined for speed)
 		PQKkey kv,						// key value
 		PQKinfo inf)					// item info
 		{
+			if (heap) {					// large k--use the heap
+				heap_insert(kv, inf);
+				return;
+			}
 			register int i;
 										// slide larger values up
 			for (i = n; i > 0; i--) {
@@ -115,4 +180,57 @@ public:
 		}
 };
 
+//----------------------------------------------------------------------
+//	heap_insert - insert an item into the heap
+//		If the heap is not full, the item is added at the end and
+//		sifted up.  Otherwise, if it is smaller than the root (the
+//		largest item), it replaces the root and is sifted down.
+//----------------------------------------------------------------------
+
+inline void ANNmin_k::heap_insert(
+	PQKkey				kv,				// key value
+	PQKinfo				inf)			// item info
+{
+	if (sorted) {						// sorted for extraction?
+		std::make_heap(mk, mk+n, mk_less);	// restore heap
+		sorted = ANNfalse;
+	}
+	mk_node nd;
+	nd.key = kv;
+	nd.info = inf;
+	nd.seq = n_ins++;
+	int r;
+	if (n < k) {						// not full--sift up from end
+		r = n++;
+		while (r > 0) {
+			int p = (r-1)/2;			// parent of r
+			ANN_FLOP(1)					// increment floating ops
+			if (!mk_less(mk[p], nd))	// in proper order
+				break;
+			mk[r] = mk[p];				// else move parent down
+			r = p;
+		}
+	}
+	else {								// full--replace root
+		ANN_FLOP(1)						// increment floating ops
+		if (!(kv < mk[0].key))			// no smaller than largest
+			return;
+		r = 0;
+		int c = 1;						// left child of r
+		while (c < n) {					// sift down from root
+			ANN_FLOP(2)					// increment floating ops
+										// set c to larger child of r
+			if (c+1 < n && mk_less(mk[c], mk[c+1])) c++;
+			if (!mk_less(nd, mk[c]))	// in proper order
+				break;
+			mk[r] = mk[c];				// else move child up
+			r = c;
+			c = 2*r + 1;
+		}
+	}
+	mk[r] = nd;							// store item here
+}
+
+ANN_NAMESPACE_END
+
 #endif
@@ -0,0 +1,195 @@
+//----------------------------------------------------------------------
+// File:			range_search.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Range search (all points within a radius)
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include <algorithm>					// sort
+#include "kd_fix_rad_search.h"			// kd fixed-radius search decls
+#include "search_scratch.h"				// per-thread search scratch
+#include "dist_kernel.h"				// distance kernels
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	annSortRange - sort range search results
+//		The results from entry first onwards are sorted by increasing
+//		distance, with ties broken by index.  They are copied into
+//		(distance, index) pairs in the thread's search scratch, sorted
+//		there, and copied back.
+//----------------------------------------------------------------------
+
+static void annSortRange(
+	std::vector<ANNidx>	&nn_idx,		// indices of points
+	std::vector<ANNdist> &dd,			// dist to points
+	size_t				first)			// first entry to sort
+{
+	size_t n = nn_idx.size() - first;	// number of entries to sort
+	if (n < 2) return;
+	ANNsearchScratch *scr = annGetScratch();
+	std::vector<std::pair<ANNdist, ANNidx> > &srt = scr->range_srt;
+	srt.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		srt[i].first = dd[first+i];
+		srt[i].second = nn_idx[first+i];
+	}
+	std::sort(srt.begin(), srt.end());
+	for (size_t i = 0; i < n; i++) {
+		dd[first+i] = srt[i].first;
+		nn_idx[first+i] = srt[i].second;
+	}
+	annReleaseScratch(scr);
+}
+
+//----------------------------------------------------------------------
+//	annRangeSearch - generic version
+//		This just calls annkFRSearch twice, once to count the points
+//		in range and once (with k equal to the count) to get them.
+//----------------------------------------------------------------------
+
+int ANNpointSet::annRangeSearch(
+	ANNpoint			q,				// query point
+	ANNdist				sqRad,			// squared radius
+	std::vector<ANNidx>	&nn_idx,		// indices of points (appended)
+	std::vector<ANNdist> &dd,			// dist to points (appended)
+	ANNbool				sorted,			// sort by distance?
+	double				eps)			// error bound
+{
+	size_t first = nn_idx.size();		// where new results start
+	int n_in = annkFRSearch(q, sqRad, 0, NULL, NULL, eps);
+	if (n_in > 0) {
+		nn_idx.resize(first + n_in);
+		dd.resize(first + n_in);
+		annkFRSearch(q, sqRad, n_in, &nn_idx[first], &dd[first], eps);
+	}
+	if (sorted) annSortRange(nn_idx, dd, first);
+	return n_in;
+}
+
+//----------------------------------------------------------------------
+//	annRangeSearch - brute-force version
+//----------------------------------------------------------------------
+
+int ANNbruteForce::annRangeSearch(
+	ANNpoint			q,				// query point
+	ANNdist				sqRad,			// squared radius
+	std::vector<ANNidx>	&nn_idx,		// indices of points (appended)
+	std::vector<ANNdist> &dd,			// dist to points (appended)
+	ANNbool				sorted,			// sort by distance?
+	double				eps)			// error bound (ignored)
+{
+	size_t first = nn_idx.size();		// where new results start
+	for (int i = 0; i < n_pts; i++) {	// run every point through
+										// compute distance to point
+		ANNdist sqDist = annDistBnd(dim, pts[i], q, sqRad);
+		ANN_PTS(1)
+		if (sqDist <= sqRad &&			// within radius bound
+			(ANN_ALLOW_SELF_MATCH || sqDist != 0)) { // ...and no self match
+			nn_idx.push_back(i);
+			dd.push_back(sqDist);
+		}
+	}
+	if (sorted) annSortRange(nn_idx, dd, first);
+	return (int) (nn_idx.size() - first);
+}
+
+//----------------------------------------------------------------------
+//	annRangeSearch - kd- and bd-tree version
+//		This is the same as annkFRSearch, except that the leaves
+//		append the points in range to the results (see
+//		kd_fix_rad_search.cpp), so there is no set of k closest
+//		points.
+//----------------------------------------------------------------------
+
+int ANNkd_tree::annRangeSearch(
+	ANNpoint			q,				// query point
+	ANNdist				sqRad,			// squared radius
+	std::vector<ANNidx>	&nn_idx,		// indices of points (appended)
+	std::vector<ANNdist> &dd,			// dist to points (appended)
+	ANNbool				sorted,			// sort by distance?
+	double				eps)			// error bound
+{
+	ANNkdFRSearchCtx ctx;				// context for this search
+	size_t first = nn_idx.size();		// where new results start
+
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.sq_rad = sqRad;
+	ctx.sq_rad_out = sqRad;
+	ctx.pts = pts;
+	ctx.pidx = pidx;					// ...and points in leaf order
+	ctx.leaf_pts = (leaf_pts != NULL ? leaf_pts[0] : NULL);
+	ctx.deleted = deleted;				// (skip deleted points)
+	ctx.point_mk = NULL;				// (no k closest points)
+	ctx.range_idx = &nn_idx;			// append results here
+	ctx.range_dd = &dd;
+	ctx.cell_lo = ctx.cell_hi = NULL;	// (not counting)
+	ctx.cell_stk = NULL;
+	ctx.pts_visited = 0;				// initialize count of points visited
+	ctx.pts_in_range = 0;				// ...and points in the range
+
+	ctx.max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+										// search starting at the root
+	root->ann_FR_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim), ctx);
+
+	if (sorted) annSortRange(nn_idx, dd, first);
+	return ctx.pts_in_range;			// return final point count
+}
+
+//----------------------------------------------------------------------
+//	annRangeSearch - dynamic tree version
+//		The buffer and each tree are searched as for kd-trees (see
+//		dyn_tree.cpp), skipping deleted points.
+//----------------------------------------------------------------------
+
+int ANNdynamic_tree::annRangeSearch(
+	ANNpoint			q,				// query point
+	ANNdist				sqRad,			// squared radius
+	std::vector<ANNidx>	&nn_idx,		// indices of points (appended)
+	std::vector<ANNdist> &dd,			// dist to points (appended)
+	ANNbool				sorted,			// sort by distance?
+	double				eps)			// error bound
+{
+	ANNkdFRSearchCtx ctx;				// context for this search
+	size_t first = nn_idx.size();		// where new results start
+
+	ctx.dim = dim;						// copy arguments to context
+	ctx.q = q;
+	ctx.sq_rad = sqRad;
+	ctx.sq_rad_out = sqRad;
+	ctx.point_mk = NULL;				// (no k closest points)
+	ctx.range_idx = &nn_idx;			// append results here
+	ctx.range_dd = &dd;
+	ctx.cell_lo = ctx.cell_hi = NULL;	// (not counting)
+	ctx.cell_stk = NULL;
+	ctx.pts_visited = 0;				// initialize count of points visited
+	ctx.pts_in_range = 0;				// ...and points in the range
+
+	ctx.max_err = ANN_POW(1.0 + eps);
+	ANN_FLOP(2)							// increment floating op count
+	FRSearch(ctx);						// search buffer and trees
+
+	if (sorted) annSortRange(nn_idx, dd, first);
+	return ctx.pts_in_range;			// return final point count
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,263 @@
+//----------------------------------------------------------------------
+// File:			rebuild_tree.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Self-rebuilding trees (deletion with rebuilding)
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "bd_tree.h"					// bd-tree declarations
+
+#include <memory>						// shared_ptr
+#include <mutex>						// serializing deletions
+#include <condition_variable>			// waiting for rebuilds
+#include <thread>						// rebuild thread
+#include <vector>						// deletions during rebuild
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Rebuilding tree state
+//		The current tree (tree) is only replaced, and points are only
+//		deleted from it, while holding the lock.  The searches do not
+//		take the lock, but just copy the shared pointer (atomically),
+//		which keeps the tree alive for the rest of the search.
+//
+//		The deletion marks of the current tree are thus changed while
+//		searches (and the rebuild thread) read them.  The marks are
+//		atomic, and are read and written with relaxed ordering (see
+//		annIsDeleted() in kd_tree.h), so a search sees each mark either
+//		before or after the deletion.  To make sure that the array of
+//		marks itself never changes while it is in use, it is allocated
+//		(by MarkPoints()) before the tree is made current.
+//
+//		While a rebuild is running (building is true), the points
+//		deleted are recorded in the log.  The rebuild thread signals
+//		done when it finishes.
+//----------------------------------------------------------------------
+
+class ANNrebuildState {
+public:
+	std::shared_ptr<ANNkd_tree> tree;	// the current tree
+	std::mutex			lock;			// serializes changes
+	std::condition_variable done;		// signals end of rebuild
+	std::thread			builder;		// rebuild thread
+	ANNbool				building;		// is a rebuild running?
+	std::vector<ANNidx>	log;			// deleted during rebuild
+	int					n_pts;			// number of (undeleted) points
+	int					n_rebuilds;		// number of rebuilds done
+};
+
+//----------------------------------------------------------------------
+//	Rebuilding tree constructor and destructor
+//		The initial tree is a bd-tree for all the points (which is a
+//		kd-tree if the shrinking rule is ANN_BD_NONE).  The destructor
+//		waits for any rebuild in progress.
+//----------------------------------------------------------------------
+
+ANNrebuild_tree::ANNrebuild_tree(		// build from point array
+	ANNpointArray		pa,				// point array
+	int					n,				// number of points
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		sp,				// splitting rule
+	ANNshrinkRule		sh,				// shrinking rule
+	ANNbool				cp,				// copy points to leaf order?
+	double				th)				// rebuild threshold
+{
+	dim = dd;
+	bkt_size = bs;
+	split = sp;
+	shrink = sh;
+	copy_pts = cp;
+	threshold = th;
+	pts = pa;
+
+	ANNkd_tree *t = new ANNbd_tree(pa, n, dd, bs, sp, sh, cp);
+	t->MarkPoints();					// (see above)
+	state = new ANNrebuildState;
+	state->tree.reset(t);
+	state->building = ANNfalse;
+	state->n_pts = n;
+	state->n_rebuilds = 0;
+}
+
+ANNrebuild_tree::~ANNrebuild_tree()		// tree destructor
+{
+	annWaitRebuild();					// wait for rebuild to finish
+	if (state->builder.joinable()) state->builder.join();
+	delete state;						// (deletes the tree)
+}
+
+//----------------------------------------------------------------------
+//	annDelete - delete a point
+//		The point is deleted from the current tree.  If a rebuild is
+//		running, it is recorded, and otherwise a rebuild is started if
+//		the fraction of deleted points exceeds the threshold.  (The
+//		previous rebuild thread, if any, has finished, but it is joined
+//		before starting a new one.)
+//----------------------------------------------------------------------
+
+ANNbool ANNrebuild_tree::annDelete(		// delete a point
+	ANNidx				idx)			// its index
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	ANNkd_tree *t = state->tree.get();	// the current tree
+
+	if (!t->annDelete(idx)) return ANNfalse;	// not there
+	state->n_pts--;
+
+	if (state->building) {				// rebuild running?
+		state->log.push_back(idx);		// delete from new tree later
+	}
+	else if (t->n_deleted > threshold * t->n_pts) {
+		if (state->builder.joinable()) state->builder.join();
+		state->building = ANNtrue;		// start a rebuild
+		state->log.clear();
+		state->builder = std::thread(&ANNrebuild_tree::Rebuild, this);
+	}
+	return ANNtrue;
+}
+
+//----------------------------------------------------------------------
+//	Rebuild - rebuild the tree (run by the rebuild thread)
+//		The undeleted points of the current tree are collected and a
+//		new tree is built for them, without holding the lock.  Since
+//		the marks may change while they are being collected, some
+//		points which are deleted meanwhile may be in the new tree, but
+//		all of these are in the log.  So once the points in the log
+//		are deleted from the new tree, it has just the current points,
+//		and it replaces the old tree.  If (because of these deletions)
+//		the new tree is itself over the threshold, it is rebuilt in
+//		turn.
+//
+//		If no points are left, the old tree (with all of its points
+//		deleted) is kept, since an empty tree cannot be searched.
+//----------------------------------------------------------------------
+
+void ANNrebuild_tree::Rebuild()
+{
+	for (;;) {
+		std::shared_ptr<ANNkd_tree> old = std::atomic_load(&state->tree);
+		ANNidxArray pi = new ANNidx[old->n_pts];
+		int n = 0;						// collect undeleted points
+		for (int i = 0; i < old->n_pts; i++) {
+			if (!annIsDeleted(old->deleted, old->pidx[i]))
+				pi[n++] = old->pidx[i];
+		}
+		ANNkd_tree *t = NULL;			// the new tree
+		if (n > 0) {
+			t = new ANNbd_tree(pts, pi, n, dim, bkt_size,
+						split, shrink, copy_pts);
+			t->MarkPoints();			// (see above)
+		}
+		else {
+			delete [] pi;
+		}
+
+		std::lock_guard<std::mutex> guard(state->lock);
+		if (t != NULL) {
+			for (size_t i = 0; i < state->log.size(); i++) {
+				t->annDelete(state->log[i]);	// (may not be there)
+			}
+			std::atomic_store(&state->tree, std::shared_ptr<ANNkd_tree>(t));
+			state->n_rebuilds++;
+		}
+		state->log.clear();
+		if (t == NULL || t->n_deleted <= threshold * t->n_pts) {
+			state->building = ANNfalse;	// done
+			state->done.notify_all();
+			return;
+		}
+	}
+}
+
+void ANNrebuild_tree::annWaitRebuild()	// wait for rebuild to finish
+{
+	std::unique_lock<std::mutex> lk(state->lock);
+	while (state->building) {
+		state->done.wait(lk);
+	}
+}
+
+//----------------------------------------------------------------------
+//	Searches
+//		Each search copies the shared pointer to the current tree, and
+//		searches the tree.
+//----------------------------------------------------------------------
+
+void ANNrebuild_tree::annkSearch(		// approx k near neighbor search
+	ANNpoint			q,				// query point
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps)			// error bound
+{
+	std::shared_ptr<ANNkd_tree> t = std::atomic_load(&state->tree);
+	t->annkSearch(q, k, nn_idx, dd, eps);
+}
+
+void ANNrebuild_tree::annkPriSearch(	// priority k near neighbor search
+	ANNpoint			q,				// query point
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps)			// error bound
+{
+	std::shared_ptr<ANNkd_tree> t = std::atomic_load(&state->tree);
+	t->annkPriSearch(q, k, nn_idx, dd, eps);
+}
+
+int ANNrebuild_tree::annkFRSearch(		// approx fixed-radius kNN search
+	ANNpoint			q,				// the query point
+	ANNdist				sqRad,			// squared radius of query ball
+	int					k,				// number of neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor array (modified)
+	ANNdistArray		dd,				// dist to near neighbors (modified)
+	double				eps)			// error bound
+{
+	std::shared_ptr<ANNkd_tree> t = std::atomic_load(&state->tree);
+	return t->annkFRSearch(q, sqRad, k, nn_idx, dd, eps);
+}
+
+int ANNrebuild_tree::annRangeSearch(	// all points within radius
+	ANNpoint			q,				// query point
+	ANNdist				sqRad,			// squared radius
+	std::vector<ANNidx>	&nn_idx,		// indices of points (appended)
+	std::vector<ANNdist> &dd,			// dist to points (appended)
+	ANNbool				sorted,			// sort by distance?
+	double				eps)			// error bound
+{
+	std::shared_ptr<ANNkd_tree> t = std::atomic_load(&state->tree);
+	return t->annRangeSearch(q, sqRad, nn_idx, dd, sorted, eps);
+}
+
+int ANNrebuild_tree::nPoints()			// return number of points
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	return state->n_pts;
+}
+
+int ANNrebuild_tree::nRebuilds()		// return number of rebuilds
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	return state->n_rebuilds;
+}
+
+ANN_NAMESPACE_END
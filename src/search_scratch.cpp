@@ -0,0 +1,58 @@
+//----------------------------------------------------------------------
+// File:			search_scratch.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Reusable per-thread storage for searches
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "search_scratch.h"				// search scratch declarations
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	The scratch of each thread
+//		This is constructed on the thread's first search, and destroyed
+//		when the thread exits.
+//----------------------------------------------------------------------
+
+static thread_local ANNsearchScratch annThreadScratch;
+
+ANNsearchScratch *annGetScratch()		// get this thread's scratch
+{
+	ANNsearchScratch *scr = &annThreadScratch;
+	if (scr->in_use) {					// nested search--use a new one
+		scr = new ANNsearchScratch;
+	}
+	scr->in_use = ANNtrue;
+	return scr;
+}
+
+void annReleaseScratch(					// release scratch after search
+	ANNsearchScratch	*scr)			// scratch from annGetScratch()
+{
+	if (scr == &annThreadScratch) {		// the thread's own scratch
+		scr->in_use = ANNfalse;
+	}
+	else {								// one made for a nested search
+		delete scr;
+	}
+}
+
+ANN_NAMESPACE_END
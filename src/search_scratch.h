@@ -0,0 +1,80 @@
+//----------------------------------------------------------------------
+// File:			search_scratch.h
+// Programmer:		Sunil Arya and David Mount
+// Description:		Reusable per-thread storage for searches
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#ifndef ANN_search_scratch_H
+#define ANN_search_scratch_H
+
+#include <vector>						// flat search stack
+#include <utility>						// std::pair
+#include <ANN/ANNx.h>					// all ANN includes
+#include "pr_queue.h"					// priority queue declarations
+#include "pr_queue_k.h"					// k-element priority queue
+#include "flat_tree.h"					// flat tree declarations
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Search scratch
+//		Every search needs a set for the k closest points, and priority
+//		search also needs a queue of boxes, which may hold up to one
+//		entry per data point.  Rather than allocating these on each
+//		query, each thread keeps one ANNsearchScratch, whose structures
+//		are reset (and enlarged only when too small) at the start of
+//		each search.  Once a thread's scratch has grown to fit the
+//		largest k and tree it has searched, its queries do no heap
+//		allocation at all.
+//
+//		annGetScratch() returns the calling thread's scratch, and
+//		annReleaseScratch() hands it back when the search is done.  If
+//		the thread's scratch is already in use (because a search was
+//		started from within another one), a new scratch is allocated
+//		for the inner search and deleted when it is released.  The
+//		thread's scratch is freed when the thread exits.
+//----------------------------------------------------------------------
+
+class ANNsearchScratch {
+public:
+	ANNmin_k			point_mk;		// set of k closest points
+	ANNpr_queue			box_pq;			// priority queue for boxes
+	std::vector<ANNflatStackEnt> flat_stk;	// stack for deep flat trees
+										// for sorting range results
+	std::vector<std::pair<ANNdist, ANNidx> > range_srt;
+	std::vector<ANNcoord> cell_lo;		// cell bounds for range counting
+	std::vector<ANNcoord> cell_hi;
+	std::vector<ANNcoord> cell_stk;		// saved cell bounds
+	ANNbool				in_use;			// is a search using this?
+
+	ANNsearchScratch()					// constructor
+		: point_mk(1), box_pq(1)
+		{ in_use = ANNfalse; }
+};
+
+ANNsearchScratch *annGetScratch();		// get this thread's scratch
+
+void annReleaseScratch(					// release scratch after search
+	ANNsearchScratch	*scr);			// scratch from annGetScratch()
+
+ANN_NAMESPACE_END
+
+#endif
@@ -0,0 +1,367 @@
+//----------------------------------------------------------------------
+// File:			stream_build.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Out-of-core construction of kd-tree dump files
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "kd_split.h"					// kd-tree splitting rules
+
+#include <cstdio>						// temporary files
+#include <climits>						// INT_MAX
+#include <vector>						// sample of coordinates
+#include <algorithm>					// std::nth_element
+
+using namespace std;					// make std:: available
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Out-of-core construction
+//		annStreamBuild() builds a kd-tree for points which need not all
+//		fit in memory at once, and writes it as a dump file (see
+//		kd_dump.cpp), which can then be loaded by the ANNkd_tree (or
+//		ANNbd_tree) load constructor.
+//
+//		The points are read from the input stream one at a time, and
+//		are written (with their indices) to a temporary binary file.
+//		Each cell of the top levels of the tree is such a file,
+//		together with the number of its points and their bounding box.
+//		If the points of a cell fit in the memory budget, they are read
+//		into memory, and the subtree for the cell is built by
+//		rkd_tree() with the given splitting rule, dumped, and deleted.
+//		Otherwise, the cell is split in two, and its file is copied to
+//		two new files, one for each side.  Since the dump lists the
+//		nodes in preorder, the split is written before the low cell is
+//		processed, and the high cell waits on disk until the low one is
+//		done.  So only one subtree is in memory at any time.
+//
+//		The top-level splits are made as follows.  The cutting
+//		dimension is the one along which the points have the greatest
+//		spread, and the cutting value is the median of a sample of at
+//		most ANN_STREAM_SAMPLE of their coordinates along it (taken at
+//		even intervals in the file).  If this would leave a side empty,
+//		the midpoint of the spread is used instead.  Points whose
+//		coordinates are less than the cutting value go to the low side,
+//		and the others to the high side.  If all the points of a cell
+//		are equal, its file is just divided in half.  Each split costs
+//		two passes over the file of the cell (one to sample, and one to
+//		copy).
+//
+//		The memory budget (max_mem) covers the points of a subtree, its
+//		point indices, and (roughly) its nodes.  The sample, the input
+//		buffers of the open files, and the parsing of the input, use a
+//		small amount more.  The points in the dump are written from the
+//		first temporary file, in their original order.  The temporary
+//		files are made by tmpfile(), and are deleted as soon as they
+//		have been read.
+//----------------------------------------------------------------------
+
+const int ANN_STREAM_SAMPLE	= 4096;		// max coordinates sampled per split
+const int ANN_STREAM_BUF	= 1<<16;	// buffer size for temporary files
+
+//----------------------------------------------------------------------
+//	ANNstreamCell - the points of a cell, in a temporary file
+//		Each record is a point index followed by the coordinates of
+//		the point.
+//----------------------------------------------------------------------
+
+class ANNstreamCell {
+public:
+	FILE				*f;				// temporary file (NULL if closed)
+	int					dim;			// dimension of space
+	int					n;				// number of points
+	ANNpoint			lo;				// bounding box of points
+	ANNpoint			hi;
+
+	ANNstreamCell(int dd)				// constructor (empty file)
+	{
+		f = tmpfile();
+		if (f == NULL) {
+			annError("Cannot create temporary file", ANNabort);
+		}
+		setvbuf(f, NULL, _IOFBF, ANN_STREAM_BUF);
+		dim = dd;
+		n = 0;
+		lo = annAllocPt(dim);
+		hi = annAllocPt(dim);
+	}
+
+	~ANNstreamCell()					// destructor
+	{
+		Close();
+		annDeallocPt(lo);
+		annDeallocPt(hi);
+	}
+
+	void Close()						// delete the file
+	{
+		if (f != NULL) fclose(f);
+		f = NULL;
+	}
+
+	void Add(							// append a point
+		ANNidx			idx,			// its index
+		ANNpoint		p)				// its coordinates
+	{
+		if (fwrite(&idx, sizeof(ANNidx), 1, f) != 1 ||
+			fwrite(p, sizeof(ANNcoord), dim, f) != (size_t) dim) {
+			annError("Cannot write temporary file", ANNabort);
+		}
+		for (int d = 0; d < dim; d++) {	// update bounding box
+			if (n == 0 || p[d] < lo[d]) lo[d] = p[d];
+			if (n == 0 || p[d] > hi[d]) hi[d] = p[d];
+		}
+		n++;
+	}
+
+	void Rewind()						// get ready to read
+	{
+		fflush(f);
+		rewind(f);
+	}
+
+	void Next(							// read the next point
+		ANNidx			&idx,			// its index (returned)
+		ANNpoint		p)				// its coordinates (returned)
+	{
+		if (fread(&idx, sizeof(ANNidx), 1, f) != 1 ||
+			fread(p, sizeof(ANNcoord), dim, f) != (size_t) dim) {
+			annError("Cannot read temporary file", ANNabort);
+		}
+	}
+};
+
+//----------------------------------------------------------------------
+//	ANNstreamBuilder - information for building the tree
+//----------------------------------------------------------------------
+
+class ANNstreamBuilder {
+public:
+	int					dim;			// dimension of space
+	int					bs;				// bucket size
+	ANNsplitRule		split;			// splitting rule
+	ANNkd_splitter		splitter;		// splitting routine
+	int					cap;			// max points of a subtree
+	ostream				*out;			// output stream for dump
+	ANNpoint			p;				// space for a point
+};
+
+//----------------------------------------------------------------------
+//	annStreamSubtree - build and dump the subtree for a cell in memory
+//		The subtree is built for the points of the cell, numbered in
+//		their order in its file.  Its point indices are then changed
+//		to the original ones, and so dumping the subtree lists the
+//		original indices in its leaves.
+//----------------------------------------------------------------------
+
+static void annStreamSubtree(
+	ANNstreamBuilder	&sb,			// builder information
+	ANNstreamCell		&cell,			// the cell
+	ANNorthRect			&bnd_box)		// bounding box of the cell
+{
+	int m = cell.n;
+	ANNpointArray pa = annAllocPts(m, sb.dim);
+	ANNidxArray idx = new ANNidx[m];	// original indices
+	ANNidxArray pidx = new ANNidx[m];	// indices for the subtree
+
+	cell.Rewind();						// read the points
+	for (int i = 0; i < m; i++) {
+		cell.Next(idx[i], pa[i]);
+		pidx[i] = i;
+	}
+	cell.Close();
+
+	ANNkd_ptr root;						// build the subtree
+	if (ANNpresort && sb.split == ANN_KD_STD)
+		root = rkd_tree_presort(pa, pidx, m, sb.dim, sb.bs, bnd_box, 1);
+	else
+		root = rkd_tree(pa, pidx, m, sb.dim, sb.bs, bnd_box, sb.splitter);
+
+	for (int i = 0; i < m; i++) {		// use the original indices
+		pidx[i] = idx[pidx[i]];
+	}
+	root->dump(*sb.out);				// dump the subtree
+
+	if (root != KD_TRIVIAL) delete root;
+	delete [] pidx;
+	delete [] idx;
+	annDeallocPts(pa);
+}
+
+//----------------------------------------------------------------------
+//	annStreamCell - build and dump the subtree for a cell
+//----------------------------------------------------------------------
+
+static void annStreamCell(
+	ANNstreamBuilder	&sb,			// builder information
+	ANNstreamCell		&cell,			// the cell
+	ANNorthRect			&bnd_box)		// bounding box of the cell
+{
+	if (cell.n <= sb.cap) {				// fits in memory
+		annStreamSubtree(sb, cell, bnd_box);
+		return;
+	}
+	int dim = sb.dim;
+	int cd = 0;							// dimension of max spread
+	for (int d = 1; d < dim; d++) {
+		if (cell.hi[d] - cell.lo[d] > cell.hi[cd] - cell.lo[cd]) cd = d;
+	}
+	ANNcoord cv = cell.lo[cd];			// cutting value
+	ANNidx idx;
+	ANNbool equal = (ANNbool) (cell.hi[cd] == cell.lo[cd]);
+	if (!equal) {						// sample the coordinates
+		int stride = cell.n / ANN_STREAM_SAMPLE + 1;
+		vector<ANNcoord> sample;
+		cell.Rewind();
+		for (int i = 0; i < cell.n; i++) {
+			cell.Next(idx, sb.p);
+			if (i % stride == 0) sample.push_back(sb.p[cd]);
+		}
+		size_t mid = sample.size()/2;
+		nth_element(sample.begin(), sample.begin() + mid, sample.end());
+		cv = sample[mid];
+		if (cv <= cell.lo[cd] || cv > cell.hi[cd]) {
+			cv = (cell.lo[cd] + cell.hi[cd])/2;
+		}
+	}
+	ANNstreamCell lo_cell(dim);			// divide the points
+	ANNstreamCell hi_cell(dim);
+	cell.Rewind();
+	for (int i = 0; i < cell.n; i++) {
+		cell.Next(idx, sb.p);
+		if (equal ? i < cell.n/2 : sb.p[cd] < cv)
+			lo_cell.Add(idx, sb.p);
+		else
+			hi_cell.Add(idx, sb.p);
+	}
+	cell.Close();
+
+	ANNcoord lv = bnd_box.lo[cd];		// save bounds for cutting dimension
+	ANNcoord hv = bnd_box.hi[cd];
+										// dump the splitting node
+	*sb.out << "split " << cd << " " << cv << " ";
+	*sb.out << lv << " " << hv << "\n";
+
+	bnd_box.hi[cd] = cv;				// low subtree
+	annStreamCell(sb, lo_cell, bnd_box);
+	bnd_box.hi[cd] = hv;
+	lo_cell.Close();
+
+	bnd_box.lo[cd] = cv;				// high subtree
+	annStreamCell(sb, hi_cell, bnd_box);
+	bnd_box.lo[cd] = lv;
+}
+
+//----------------------------------------------------------------------
+//	annStreamBuild - out-of-core construction of a kd-tree dump
+//----------------------------------------------------------------------
+
+int annStreamBuild(
+	istream				&in,			// input stream for points
+	int					dim,			// dimension of space
+	ostream				&out,			// output stream for dump
+	int					bs,				// bucket size
+	ANNsplitRule		split,			// splitting rule
+	size_t				max_mem)		// memory budget (bytes)
+{
+	ANNstreamBuilder sb;
+	sb.dim = dim;
+	sb.bs = bs;
+	sb.split = split;
+	sb.out = &out;
+	switch (split) {					// select by rule
+	case ANN_KD_STD:					// standard kd-splitting rule
+		sb.splitter = kd_split;
+		break;
+	case ANN_KD_MIDPT:					// midpoint split
+		sb.splitter = midpt_split;
+		break;
+	case ANN_KD_FAIR:					// fair split
+		sb.splitter = fair_split;
+		break;
+	case ANN_KD_SUGGEST:				// best (in our opinion)
+	case ANN_KD_SL_MIDPT:				// sliding midpoint split
+		sb.splitter = sl_midpt_split;
+		break;
+	case ANN_KD_SL_FAIR:				// sliding fair split
+		sb.splitter = sl_fair_split;
+		break;
+	default:
+		annError("Illegal splitting method", ANNabort);
+	}
+										// memory per point of a subtree
+	size_t pt_mem = dim*sizeof(ANNcoord) + sizeof(ANNpoint)
+				+ 2*sizeof(ANNidx)
+				+ (sizeof(ANNkd_split) + sizeof(ANNkd_leaf))/bs + 1;
+	if (ANNpresort && split == ANN_KD_STD) {
+		pt_mem += (dim + 2)*sizeof(ANNidx) + sizeof(ANNcoord) + 1;
+	}
+	size_t cap = max_mem / pt_mem;
+	sb.cap = (int) (cap < 1 ? 1 : (cap > (size_t) INT_MAX ? INT_MAX : cap));
+	sb.p = annAllocPt(dim);
+
+	ANNstreamCell root(dim);			// read the points
+	for (;;) {
+		int d = 0;
+		while (d < dim && in >> sb.p[d]) d++;
+		if (d < dim) {
+			if (d > 0) annError("Incomplete point at end of input", ANNwarn);
+			break;
+		}
+		root.Add(root.n, sb.p);
+	}
+
+	out << "#ANN " << ANNversion << "\n";
+	out.precision(ANNcoordPrec);		// use full precision in dumping
+	out << "points " << dim << " " << root.n << "\n";
+	root.Rewind();						// print point coordinates
+	for (int i = 0; i < root.n; i++) {
+		ANNidx idx;
+		root.Next(idx, sb.p);
+		out << idx << " ";
+		annPrintPt(sb.p, dim, out);
+		out << "\n";
+	}
+	out << "tree " << dim << " " << root.n << " " << bs << "\n";
+	if (root.n == 0) {					// no points--no tree
+		ANNorthRect bnd_box(dim);
+		annPrintPt(bnd_box.lo, dim, out);
+		out << "\n";
+		annPrintPt(bnd_box.hi, dim, out);
+		out << "\n";
+		out << "null\n";
+	}
+	else {
+		ANNorthRect bnd_box(dim, root.lo, root.hi);
+		annPrintPt(bnd_box.lo, dim, out);	// print bounding box
+		out << "\n";
+		annPrintPt(bnd_box.hi, dim, out);
+		out << "\n";
+		annStreamCell(sb, root, bnd_box);	// build and dump the tree
+	}
+	out.precision(0);					// restore default precision
+
+	annDeallocPt(sb.p);
+	return root.n;
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,241 @@
+//----------------------------------------------------------------------
+// File:			thread_pool.cpp
+// Programmer:		Sunil Arya and David Mount
+// Description:		Worker threads for parallel loops within ANN
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//		Nested loops detected with a thread-local flag
+//----------------------------------------------------------------------
+
+#include "thread_pool.h"				// thread pool declarations
+
+#include <atomic>						// atomic chunk counter
+#include <condition_variable>			// worker wakeup
+#include <mutex>						// mutual exclusion
+#include <thread>						// threads
+#include <vector>						// thread lists
+
+using namespace std;					// make std:: available
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Chunk sizes
+//		Each thread repeatedly grabs the next chunk of the loop range
+//		until the range is exhausted.  We aim for ANN_CHUNKS_PER_THR
+//		chunks per thread, so that threads that finish early can take
+//		up the slack of the slower ones.
+//----------------------------------------------------------------------
+
+const int ANN_CHUNKS_PER_THR = 16;		// target chunks per thread
+
+//----------------------------------------------------------------------
+//	annInLoop is set while a thread (the caller or a worker) is
+//	processing chunks of a loop.  A loop started from within a loop
+//	body must not use the pool, since the caller of the outer loop
+//	already holds run_mtx, and locking it again would be undefined.
+//----------------------------------------------------------------------
+
+static thread_local bool annInLoop = false;	// inside a loop body?
+
+//----------------------------------------------------------------------
+//	ANNloopJob
+//		The state of a single parallel loop.  Every participating
+//		thread calls drain(), which processes chunks until there are
+//		no more.
+//----------------------------------------------------------------------
+
+class ANNloopJob {
+	const ANNloopBody	&body;			// the loop body
+	int					n;				// number of items
+	int					chunk;			// chunk size
+	atomic<int>			next;			// start of next chunk
+public:
+	ANNloopJob(const ANNloopBody &b, int nn, int n_thr)
+		: body(b), n(nn), next(0)
+	{
+		chunk = n / (n_thr*ANN_CHUNKS_PER_THR);
+		if (chunk < 1) chunk = 1;
+	}
+
+	void drain()						// process chunks until done
+	{
+		bool was_in = annInLoop;		// (may be a nested loop)
+		annInLoop = true;
+		for (;;) {
+			int lo = next.fetch_add(chunk);
+			if (lo >= n) break;
+			int hi = (n - lo > chunk ? lo + chunk : n);
+			body(lo, hi);
+		}
+		annInLoop = was_in;
+	}
+};
+
+//----------------------------------------------------------------------
+//	ANNthreadPool
+//		A set of worker threads which sleep between loops.  The pool
+//		runs one job at a time (run_mtx is held for its duration).
+//		To start a job, the caller sets job and n_helpers (the number
+//		of workers which are to join in), bumps the generation count,
+//		and wakes the workers.  Workers whose id is at least n_helpers
+//		go back to sleep.  The caller drains the job itself and then
+//		waits until all the helpers have finished.
+//----------------------------------------------------------------------
+
+class ANNthreadPool {
+	mutex				run_mtx;		// held while a job runs
+	mutex				mtx;			// protects the fields below
+	condition_variable	start_cv;		// signals a new job (or quit)
+	condition_variable	done_cv;		// signals helpers are done
+	vector<thread>		workers;		// the worker threads
+	ANNloopJob			*job;			// the current job
+	int					n_helpers;		// workers helping with the job
+	int					n_busy;			// helpers still working
+	unsigned			gen;			// job generation count
+	bool				quit;			// workers should exit
+
+	void worker(int id)					// worker thread main loop
+	{
+		unsigned seen = 0;				// last generation seen
+		unique_lock<mutex> lk(mtx);
+		for (;;) {
+			while (!quit && gen == seen) start_cv.wait(lk);
+			if (quit) return;
+			seen = gen;
+			if (id >= n_helpers) continue;	// not needed this time
+			ANNloopJob *jb = job;
+			lk.unlock();
+			jb->drain();
+			lk.lock();
+			if (--n_busy == 0) done_cv.notify_one();
+		}
+	}
+
+public:
+	ANNthreadPool() : job(NULL), n_helpers(0), n_busy(0), gen(0), quit(false) {}
+
+	bool run(ANNloopJob &jb, int n_thr)	// run job (false if busy)
+	{
+		unique_lock<mutex> run_lk(run_mtx, try_to_lock);
+		if (!run_lk.owns_lock()) return false;
+
+		unique_lock<mutex> lk(mtx);
+		while ((int) workers.size() < n_thr-1) {	// grow pool if needed
+			int id = (int) workers.size();
+			workers.push_back(thread(&ANNthreadPool::worker, this, id));
+		}
+		job = &jb;
+		n_helpers = n_busy = n_thr-1;
+		gen++;
+		start_cv.notify_all();
+		lk.unlock();
+
+		jb.drain();						// do our share
+
+		lk.lock();
+		while (n_busy > 0) done_cv.wait(lk);
+		job = NULL;
+		return true;
+	}
+
+	void close()						// stop all workers
+	{
+		lock_guard<mutex> run_lk(run_mtx);
+		{
+			lock_guard<mutex> lk(mtx);
+			quit = true;
+			start_cv.notify_all();
+		}
+		for (size_t i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+		workers.clear();
+		quit = false;					// pool may be restarted
+	}
+};
+
+//----------------------------------------------------------------------
+//	The pool is allocated on first use and is never deleted.  (If it
+//	were a static object, its destructor could run at exit while a
+//	loop is in progress, for example if annError() aborts from within
+//	a loop body, and it would then wait forever for the loop to end.)
+//----------------------------------------------------------------------
+
+static ANNthreadPool *annPool()			// the pool
+{
+	static ANNthreadPool *pool = new ANNthreadPool;
+	return pool;
+}
+
+//----------------------------------------------------------------------
+//	annNumThreads - number of threads to use for n items
+//----------------------------------------------------------------------
+
+int annNumThreads(
+	int					n_thr,			// number requested (<= 0 for all)
+	int					n)				// number of items to process
+{
+	if (n_thr <= 0) {					// use all hardware threads
+		n_thr = (int) thread::hardware_concurrency();
+		if (n_thr <= 0) n_thr = 1;		// (unknown)
+	}
+	if (n_thr > n) n_thr = n;			// no more threads than items
+	return (n_thr < 1 ? 1 : n_thr);
+}
+
+//----------------------------------------------------------------------
+//	annParallelFor - run a parallel loop
+//----------------------------------------------------------------------
+
+void annParallelFor(
+	int					n,				// number of items
+	int					n_thr,			// number of threads
+	const ANNloopBody	&body)			// loop body for subrange [lo,hi)
+{
+	if (n <= 0) return;					// nothing to do
+	n_thr = annNumThreads(n_thr, n);
+	if (n_thr == 1) {					// just do it ourselves
+		body(0, n);
+		return;
+	}
+
+	ANNloopJob job(body, n, n_thr);
+	if (!annInLoop && annPool()->run(job, n_thr)) return;
+
+	vector<thread> helpers;				// pool busy - use temp threads
+	for (int i = 0; i < n_thr-1; i++) {
+		helpers.push_back(thread(&ANNloopJob::drain, &job));
+	}
+	job.drain();
+	for (int i = 0; i < n_thr-1; i++) {
+		helpers[i].join();
+	}
+}
+
+//----------------------------------------------------------------------
+//	annThreadPoolClose - stop the worker threads
+//----------------------------------------------------------------------
+
+void annThreadPoolClose()
+{
+	annPool()->close();
+}
+
+ANN_NAMESPACE_END
@@ -0,0 +1,72 @@
+//----------------------------------------------------------------------
+// File:			thread_pool.h
+// Programmer:		Sunil Arya and David Mount
+// Description:		Worker threads for parallel loops within ANN
+// Last modified:	10/17/26 (Version 1.2)
+//----------------------------------------------------------------------
+// Copyright (c) 1997-2005 University of Maryland and Sunil Arya and
+// David Mount.  All Rights Reserved.
+//
+// This software and related documentation is part of the Approximate
+// Nearest Neighbor Library (ANN).  This software is provided under
+// the provisions of the Lesser GNU Public License (LGPL).  See the
+// file ../ReadMe.txt for further information.
+//
+// The University of Maryland (U.M.) and the authors make no
+// representations about the suitability or fitness of this software for
+// any purpose.  It is provided "as is" without express or implied
+// warranty.
+//----------------------------------------------------------------------
+// History:
+//	Revision 1.2  10/17/26
+//		Initial release
+//----------------------------------------------------------------------
+
+#ifndef ANN_thread_pool_H
+#define ANN_thread_pool_H
+
+#include <functional>					// std::function
+#include <ANN/ANNx.h>					// all ANN includes
+
+ANN_NAMESPACE_BEGIN
+
+//----------------------------------------------------------------------
+//	Parallel loops
+//		annParallelFor(n, n_thr, body) applies body(lo, hi) to a set of
+//		disjoint subranges [lo, hi) which together cover [0, n).  The
+//		subranges are handed out dynamically in chunks to a pool of
+//		worker threads, plus the calling thread.  The call returns
+//		after all the subranges have been processed.  The worker
+//		threads are created on first use and persist across calls, so
+//		that short parallel loops do not pay for thread creation.
+//
+//		The number of threads actually used is given by
+//		annNumThreads(n_thr, n).  If n_thr <= 0, the number of hardware
+//		threads is used.  If it is 1, body(0, n) is just invoked
+//		directly by the caller.
+//
+//		The pool runs one loop at a time.  If it is busy (because
+//		another thread is running a loop or because the call is
+//		nested inside another loop body) then temporary threads are
+//		created for the call instead.
+//
+//		annThreadPoolClose() stops the worker threads.  It is called
+//		by annClose().  A later parallel loop restarts them.
+//----------------------------------------------------------------------
+
+typedef std::function<void(int lo, int hi)> ANNloopBody;
+
+int annNumThreads(						// number of threads to use
+	int					n_thr,			// number requested (<= 0 for all)
+	int					n);				// number of items to process
+
+void annParallelFor(					// run a parallel loop
+	int					n,				// number of items
+	int					n_thr,			// number of threads
+	const ANNloopBody	&body);			// loop body for subrange [lo,hi)
+
+void annThreadPoolClose();				// stop the worker threads
+
+ANN_NAMESPACE_END
+
+#endif
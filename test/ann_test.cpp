@@ -35,17 +35,58 @@
 //	Revision 1.1.2  01/27/10
 //		Fixed minor compilation bugs for new versions of gcc
 //		Allow round-off error in validation test
+//	Revision 1.2  10/17/26
+//		Added threads option for batched (multithreaded) search
+//		Added query_order option and cache miss counts for batches
+//		Added simd option
+//		Added flat_layout option
+//		Added copy_pts option
+//		Added compare_float option (uses the float library, libANNf)
+//		Added heap_k option
+//		Added range_search option
+//		Added approx_count option
+//		Added run_all_knn operation
+//		Added run_join operation
+//		Added run_dynamic operation
+//		Added run_rebuild operation
+//		Added build_threads option
+//		Added presort option
+//		Added stream_build operation and stream_memory option
+//		Added dump_binary and load_binary operations
+//		Added load_paged operation and page_cache and page_top options
+//		Added read_data_bin and read_query_bin operations and map_pts
+//			option
+//		Point files are read by annReadPts; added read_threads option
+//		Added dump_compressed operation and pack_pts option
+//		Added count_allocs option
 //----------------------------------------------------------------------
 
 #include <ctime>						// clock
+#include <chrono>						// wall clock (for threads)
+#include <thread>						// searching while deleting
+#include <atomic>						// ...and telling it to stop
 #include <cmath>						// math routines
 #include <cstring>						// C string ops
+#include <cstdlib>						// malloc (for counting allocations)
+#include <new>							// replacing operator new
 #include <fstream>						// file I/O
+#include <sstream>						// comparing tree dumps
 
 #include <ANN/ANN.h>					// ANN declarations
 #include <ANN/ANNx.h>					// more ANN declarations
 #include <ANN/ANNperf.h>				// performance evaluation
 
+#define ANN_FLOAT						// float version (namespace annf)
+#include <ANN/ANN.h>
+#undef ANN_FLOAT
+
+#ifdef __linux__						// hardware counters (Linux only)
+  #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
+#endif
+
 #include "rand.h"						// random point generation
 
 #ifndef CLOCKS_PER_SEC					// define clocks-per-second if needed
@@ -87,7 +128,22 @@ using namespace std;					// make std:: available
 //		Data Generation:
 //		----------------
 //		read_data_pts <file>	Create a set of data points whose
-//								coordinates are input from file <file>.
+//								coordinates are input from file <file>,
+//								one point per line (see annReadPts in
+//								ANN.h).  The time to read them is
+//								reported.
+//		read_data_bin <format> <file>
+//								Create a set of data points whose
+//								coordinates are input from the binary
+//								file <file> (see annReadPtsBin in
+//								ANN.h).  The formats are:
+//									float		= raw floats
+//									double		= raw doubles
+//									fvecs		= fvecs
+//									bvecs		= bvecs
+//								For fvecs and bvecs, dim is set to the
+//								dimension of the points in the file.
+//								The time to read them is reported.
 //		gen_data_pts			Create a set of data points whose
 //								coordinates are generated from the
 //								current point distribution.
@@ -103,6 +159,9 @@ using namespace std;					// make std:: available
 //		---------------------------
 //		read_query_pts <file>	Create a set of query points whose
 //								coordinates are input from file <file>.
+//		read_query_bin <format> <file>
+//								Same as read_data_bin for query points,
+//								except that their dimension must be dim.
 //		gen_query_pts			Create a set of query points whose
 //								coordinates are generated from the
 //								current point distribution.
@@ -112,6 +171,46 @@ using namespace std;					// make std:: available
 //								strategy.  Possible strategies are:
 //									standard = standard kd-tree search
 //									priority = priority search
+//		run_all_knn				Compute the near_neigh nearest neighbors
+//								of every data point (excluding the point
+//								itself) by annAllkNN(), using the
+//								current tree, epsilon, and threads.  If
+//								validation is on, the distances are
+//								checked against brute-force search.
+//		run_join				Find all pairs of a data point and a
+//								query point within distance radius_bound
+//								by annRangeJoin(), using the current
+//								tree and a tree built (with the same
+//								options) on the query points.  If
+//								validation is on, the number of pairs is
+//								checked against brute-force search.
+//		run_dynamic <int>		Build a dynamic tree (ANNdynamic_tree) on
+//								the first half of the data points, add
+//								the others one at a time, delete <int>
+//								of them (spread evenly by index), and
+//								then search for the near_neigh nearest
+//								neighbors of the query points.  The
+//								tree options are as for build_ann (the
+//								shrinking rule is ignored).  The time
+//								for each step is reported.  If
+//								validation is on, the results are
+//								checked against brute-force search.
+//		run_rebuild <int> <float>
+//								Build a self-rebuilding tree
+//								(ANNrebuild_tree) with rebuild
+//								threshold <float> on the data points,
+//								using the tree options of build_ann.
+//								Then delete <int> of the points (spread
+//								evenly by index), while another thread
+//								searches for the near_neigh nearest
+//								neighbors of the query points, over and
+//								over, until any rebuild is done.  The
+//								longest time taken by any of these
+//								searches is reported, followed by the
+//								time for the queries after the
+//								deletions.  If validation is on, the
+//								results are checked against brute-force
+//								search.
 //
 //		Miscellaneous:
 //		--------------
@@ -120,8 +219,50 @@ using namespace std;					// make std:: available
 //								(The dump format is explained further in
 //								the source file kd_tree.cc.)
 //	  	load <file>				Load a tree from a data file which was
-//								created by the dump operation.	Any
-//								existing tree will be destroyed.
+//								created by the dump operation (or by
+//								dump_compressed).	Any existing tree will
+//								be destroyed.  The time to load it is
+//								reported, with the size of the file.
+//		dump_compressed <file>	Dump the current structure to the given
+//								file in compressed form (see
+//								DumpCompressed in ANN.h), with the
+//								points packed if pack_pts is on.  The
+//								size of the file is reported, with the
+//								size of the text dump and their ratio.
+//		stream_build <file> <file>
+//								Build a kd-tree out of core (see
+//								annStreamBuild in ANN.h) for the points
+//								in the first file (dim coordinates
+//								each), and write its dump to the second
+//								file, which can then be loaded by the
+//								load operation.  The points are not
+//								kept in memory.  The bucket size and
+//								splitting rule are as for build_ann,
+//								and the memory budget is stream_memory.
+//		dump_binary <file>		Dump the flat version of the current
+//								tree (see flat_layout) to the given file
+//								in binary (see DumpBinary in ANN.h).  If
+//								flat_layout is "none", a flat tree with
+//								the depth-first layout is made for it.
+//		load_binary <file>		Load a flat tree from a file which was
+//								created by dump_binary, by mapping the
+//								file.  Any existing tree is destroyed,
+//								and the flat tree is used for searching.
+//								The time to load it is reported.  (The
+//								data points are then copied from it, for
+//								validation.)
+//		load_paged <file>		Open a file which was created by
+//								dump_binary (with flat_layout "none" or
+//								"dfs", and copy_pts on) as a paged tree
+//								(see ANNpaged_tree in ANN.h), with a
+//								cache of page_cache megabytes, and
+//								page_top levels in memory.  Any existing
+//								tree is destroyed, and the paged tree is
+//								used for searching.  The points are not
+//								read, so the current data points must be
+//								those of the dump (for validation).
+//								Each run_queries reports the pages and
+//								bytes read per query.
 //
 // Options:
 // --------
@@ -156,6 +297,46 @@ using namespace std;					// make std:: available
 //								bd_tree.cc for more information.
 //		bucket_size <int>		Bucket size, that is, the maximum number of
 //								points stored in each leaf node.
+//		flat_layout <type>		If not "none", then whenever a tree is
+//								built or loaded, it is also compiled into
+//								a flat tree (see ANNflat_tree in ANN.h),
+//								which is then used for all searches.
+//								Choices are:
+//									none		= no flat tree
+//									dfs			= depth-first layout
+//									veb			= van Emde Boas layout
+//								The default is "none".
+//		copy_pts <string>		Whether trees that are built keep a copy
+//								of the points in leaf order (see the
+//								copy_pts argument of the ANNkd_tree
+//								constructor in ANN.h).  Valid arguments
+//								are "on" and "off".  The default is "off".
+//		presort <string>		Whether trees built with the standard
+//								splitting rule (and no shrinking) are
+//								built from the points presorted along
+//								each dimension (see annSetPresort in
+//								ANN.h).  Valid arguments are "on" and
+//								"off".  The default is "off".
+//		stream_memory <float>	Memory budget of stream_build, in
+//								megabytes.  (Default = 256.)
+//		page_cache <float>		Cache size of paged trees (load_paged),
+//								in megabytes.  (Default = 64.)
+//		page_top <int>			Number of levels of paged trees kept in
+//								memory.  (Default = 10.)
+//		pack_pts <string>		Whether dump_compressed packs the points
+//								(see DumpCompressed in ANN.h).  Valid
+//								arguments are "on" and "off".  The
+//								default is "on".
+//		compare_float <string>	If "on", then whenever a tree is built or
+//								loaded, the single-precision version of
+//								ANN (see ANN_FLOAT in ANN.h) also builds
+//								a tree from a float copy of the data
+//								points.  Each run_queries then runs the
+//								same queries on it as well, and reports
+//								its query time and its recall, that is,
+//								the fraction of the (double) results
+//								that it also returns.  Valid arguments
+//								are "on" and "off".  The default is "off".
 //
 // Options affecting data and query point generation:
 // --------------------------------------------------
@@ -166,6 +347,14 @@ using namespace std;					// make std:: available
 //								maximum number of points for storage
 //								allocation. Default = 100.
 //		query_size <int>		Same as data_size for query points.
+//		map_pts <string>		Whether read_data_bin and read_query_bin
+//								map the file into memory, rather than
+//								reading it.  Valid arguments are "on"
+//								and "off".  The default is "on".
+//		read_threads <int>		Number of threads used by read_data_pts
+//								and read_query_pts to parse the file.
+//								If it is 0, all hardware threads are
+//								used.  (Default = 0.)
 //		std_dev <float>			Standard deviation (used in gauss,
 //								planted, and clustered distributions).
 //								This is the "small" distribution for
@@ -216,6 +405,82 @@ using namespace std;					// make std:: available
 //								This can only be used with standard, not
 //								priority, search.  (Default = 0, which
 //								means standard search.)
+//		range_search <string>	If "on", then searches with a radius
+//								bound are done by annRangeSearch(),
+//								which returns all the points in range,
+//								sorted by distance.  The first
+//								near_neigh of them are reported (and
+//								validated) as usual.  Valid arguments
+//								are "on" and "off".  The default is
+//								"off", which means annkFRSearch() is
+//								used.
+//		approx_count <string>	If "on", then searches with a radius
+//								bound and near_neigh 0 are done by
+//								annApproxRangeCount(), and the counts
+//								are validated against the balls of
+//								radius r/(1+eps) and r*(1+eps), where r
+//								is the radius bound.  Valid arguments
+//								are "on" and "off".  (Default = "off".)
+//		threads <int>			Number of threads for batched searching.
+//								If positive, then standard searches
+//								without a radius bound are run as a
+//								single batch by annkSearchBatch() (and
+//								the same is done for the brute-force
+//								searches used in validation).  Query
+//								times are then measured by the wall
+//								clock rather than by the processor
+//								time.  (Default = 0, which means that
+//								queries are run one at a time.)
+//		query_order <string>	Order in which batched queries are run.
+//								Choices are:
+//									none		= order given
+//									morton		= Morton (Z-order) curve
+//									hilbert		= Hilbert curve
+//								When batching, the number of processor
+//								cache misses per query is reported, if
+//								the hardware counters are available.
+//								Only the misses of the main thread are
+//								counted, so it is best to set threads to
+//								1 when comparing orders.
+//								(Default = "none".)
+//		build_threads <int>		Number of threads used by build_ann to
+//								build the tree (see the n_threads
+//								argument of the ANNkd_tree constructor
+//								in ANN.h).  If it is not 1, the build
+//								time is measured by the wall clock, and
+//								if validation is on, the tree is also
+//								built by one thread, the two are
+//								checked to be identical, and the speedup
+//								over one thread is reported.
+//								(Default = 1.)
+//		simd <string>			Distance kernel to use.  Choices are:
+//									none		= scalar kernel
+//									avx2		= AVX2 kernel
+//									avx512		= AVX-512 kernel
+//								If the processor does not support the
+//								kernel, the best one it does support is
+//								used instead.  The kernel is reported
+//								with the query results.  (Default is the
+//								best kernel supported by the processor.)
+//		heap_k <int>			Number of nearest neighbors above which
+//								the k closest points are kept in a heap
+//								rather than a sorted array (see
+//								annSetHeapK in ANN.h).  The results are
+//								the same, but the heap is faster for
+//								large k.  (Default = 128.)
+//		count_allocs <string>	If "on", then the calls to operator new
+//								made by each run_queries (other than
+//								batched queries) after its first query
+//								are counted and reported.  The first
+//								query may allocate the search storage
+//								of the thread (see search_scratch.h),
+//								but the others should not allocate.
+//								If validation is on, a warning is given
+//								if they do.  (This excludes range_search
+//								and paged trees, whose results and
+//								caches are allocated as they grow.)
+//								Valid arguments are "on" and "off".
+//								(Default = "off".)
 //
 // Options affection general program behavior:
 // -------------------------------------------
@@ -366,6 +631,46 @@ const char shrink_table[N_SHRINK_RULES][STRING_LEN] = {
 		"centroid",						// centroid shrinking
 		"suggest"};						// authors' choice for best
 
+//------------------------------------------------------------------------
+//	Query orders for batched search (see ANN.h for types)
+//------------------------------------------------------------------------
+
+const int N_QUERY_ORDERS = 3;
+const char order_table[N_QUERY_ORDERS][STRING_LEN] = {
+		"none",							// order given
+		"morton",						// Morton (Z-order) curve
+		"hilbert"};						// Hilbert curve
+
+//------------------------------------------------------------------------
+//	Flat tree layouts (entry i+1 is layout i in ANN.h)
+//------------------------------------------------------------------------
+
+const int N_FLAT_LAYOUTS = 3;
+const char flat_table[N_FLAT_LAYOUTS][STRING_LEN] = {
+		"none",							// no flat tree
+		"dfs",							// depth-first order
+		"veb"};							// van Emde Boas order
+
+//------------------------------------------------------------------------
+//	Binary point file formats (see ANN.h for types)
+//------------------------------------------------------------------------
+
+const char pts_format_table[ANN_N_PTS_FORMATS][STRING_LEN] = {
+		"float",						// raw floats
+		"double",						// raw doubles
+		"fvecs",						// fvecs
+		"bvecs"};						// bvecs
+
+//------------------------------------------------------------------------
+//	Distance kernels (see ANN.h for types)
+//------------------------------------------------------------------------
+
+const int N_SIMD = 3;
+const char simd_table[N_SIMD][STRING_LEN] = {
+		"none",							// scalar kernel
+		"avx2",							// AVX2 kernel
+		"avx512"};						// AVX-512 kernel
+
 //----------------------------------------------------------------------
 //	Short utility functions
 //		Error - general error routine
@@ -428,6 +733,21 @@ void readPts(							// read data/query points from file
 	char				*file_nm,		// file name
 	PtType				type);			// point type (DATA, QUERY)
 
+void readPtsBin(						// read data/query points (binary)
+	ANNpointArray		&pa,			// point array (returned)
+	int					&n,				// number of points
+	ANNptsFormat		format,			// file format
+	char				*file_nm,		// file name
+	PtType				type);			// point type (DATA, QUERY)
+
+void printReadPts(						// print summary of points read
+	ANNpointArray		pa,				// point array
+	int					n,				// number of points
+	char				*file_nm,		// file name
+	PtType				type,			// point type (DATA, QUERY)
+	const char			*format,		// file format (or NULL for text)
+	double				read_time);		// time to read
+
 void doValidation();					// perform validation
 void getTrueNN();						// compute true nearest neighbors
 
@@ -435,6 +755,24 @@ void treeStats(							// print statistics on kd- or bd-tree
 	ostream				&out,			// output stream
 	ANNbool				verbose);		// print stats
 
+void buildFlat();						// build flat tree (if wanted)
+void buildFloat();						// build float tree (if wanted)
+
+double runFloatQueries(					// run queries on float tree
+	ANNbool				priority,		// priority search?
+	ANNbool				batch,			// batched search?
+	double				&recall);		// recall (returned)
+
+int startCacheMisses();					// start counting cache misses
+long long stopCacheMisses(int fd);		// stop counting cache misses
+
+void joinCount(							// join callback (run_join)
+	int					n,				// number of pairs
+	const ANNidx		*idx,			// data points
+	const ANNidx		*other_idx,		// query points
+	const ANNdist		*dd,			// squared distances
+	void				*data);			// number of calls (modified)
+
 //------------------------------------------------------------------------
 //	Default execution parameters
 //------------------------------------------------------------------------
@@ -454,6 +792,10 @@ const double	def_epsilon		= 0.0;			// def error bound
 const int		def_near_neigh	= 1;			// def number of near neighbors
 const int		def_max_visit	= 0;			// def number of points visited
 const int		def_rad_bound	= 0;			// def radius bound
+const int		def_threads		= 0;			// def threads (no batching)
+const int		def_build_thr	= 1;			// def threads for building
+const ANNqueryOrder								// def query order
+				def_order		= ANN_ORDER_NONE;
 												// def number of true nn's
 const int		def_true_nn		= def_near_neigh + extra_nn;
 const int		def_seed		= 0;			// def seed for random numbers
@@ -485,11 +827,29 @@ double			epsilon;				// error bound
 int				near_neigh;				// number of near neighbors
 int				max_pts_visit;			// max number of points to visit
 double			radius_bound;			// maximum radius search bound
+int				threads;				// threads for batched search
+int				build_threads;			// threads for building
+ANNbool			simd_set;				// distance kernel selected?
+int				heap_k;					// threshold for heap of k closest
+ANNqueryOrder	order;					// query order for batched search
 int				true_nn;				// number of true nn's
 ANNbool			validate;				// validation flag
 StatLev			stats;					// statistics output level
 ANNsplitRule	split;					// splitting rule
 ANNshrinkRule	shrink;					// shrinking rule
+int				flat_layout;			// flat tree layout (0 if none)
+ANNbool			copy_pts;				// copy points to leaf order?
+ANNbool			presort;				// presorted construction?
+double			stream_memory;			// memory for stream_build (MB)
+double			page_cache;				// cache of paged trees (MB)
+ANNbool			map_pts;				// map binary point files?
+int				read_threads;			// threads for reading points
+int				page_top;				// levels of paged trees in memory
+ANNbool			pack_pts;				// pack points of compressed dumps?
+ANNbool			range_search;			// use annRangeSearch?
+ANNbool			approx_count;			// use annApproxRangeCount?
+ANNbool			compare_float;			// compare with float version?
+ANNbool			count_allocs;			// count allocations by queries?
 
 //------------------------------------------------------------------------
 //	More globals - pointers to dynamically allocated arrays and structures
@@ -500,6 +860,15 @@ ANNshrinkRule	shrink;					// shrinking rule
 //		data_pts, query_pts				The data and query points
 //		the_tree						Points to the kd- or bd-tree for
 //										nearest neighbor searching.
+//		the_flat						Points to the flat tree made from
+//										the_tree (if flat_layout is set),
+//										which is used for searching.
+//		the_paged						Points to the paged tree opened by
+//										load_paged, which (if not NULL)
+//										is used for searching.
+//		fdata_pts, the_ftree			Float copy of the data points, and
+//										the float tree built from them
+//										(if compare_float is set).
 //		apx_nn_idx, apx_dists			Record approximate near neighbor
 //										indices and distances
 //		apx_pts_in_range				Counts of the number of points in
@@ -533,6 +902,10 @@ ANNshrinkRule	shrink;					// shrinking rule
 ANNpointArray	data_pts;				// data points
 ANNpointArray	query_pts;				// query points
 ANNbd_tree*		the_tree;				// kd- or bd-tree search structure
+ANNflat_tree*	the_flat;				// flat version of the_tree
+ANNpaged_tree*	the_paged;				// paged tree (from load_paged)
+annf::ANNpointArray fdata_pts;			// data points (float copy)
+annf::ANNbd_tree* the_ftree;			// float version of the_tree
 ANNidxArray		apx_nn_idx;				// storage for near neighbor indices
 ANNdistArray	apx_dists;				// storage for near neighbor distances
 int*			apx_pts_in_range;		// storage for no. of points in range
@@ -543,6 +916,8 @@ int*			max_pts_in_range;		// max points in approx range
 
 ANNbool			valid_dirty;			// validation is no longer valid
 
+atomic<long long> n_allocs(0);			// calls to operator new so far
+
 //------------------------------------------------------------------------
 //	Initialize global parameters
 //------------------------------------------------------------------------
@@ -565,16 +940,38 @@ void initGlobals()
 	near_neigh			= def_near_neigh;
 	max_pts_visit		= def_max_visit;
 	radius_bound		= def_rad_bound;
+	threads				= def_threads;
+	build_threads		= def_build_thr;
+	simd_set			= ANNfalse;
+	heap_k				= ANN_DEF_HEAP_K;
+	order				= def_order;
 	true_nn				= def_true_nn;
 	validate			= def_validate;
 	stats				= def_stats;
 	split				= def_split;
 	shrink				= def_shrink;
+	flat_layout			= 0;
+	copy_pts			= ANNfalse;
+	presort				= ANNfalse;
+	stream_memory		= double(ANN_STREAM_MEM) / (1 << 20);
+	page_cache			= double(ANN_PAGE_CACHE) / (1 << 20);
+	map_pts				= ANNtrue;
+	read_threads		= 0;
+	page_top			= ANN_PAGE_TOP;
+	pack_pts			= ANNtrue;
+	range_search		= ANNfalse;
+	approx_count		= ANNfalse;
+	compare_float		= ANNfalse;
+	count_allocs		= ANNfalse;
 	annIdum				= -def_seed;			// init. global seed for ran0()
 
 	data_pts			= NULL;					// initialize storage pointers
 	query_pts			= NULL;
 	the_tree			= NULL;
+	the_flat			= NULL;
+	the_paged			= NULL;
+	fdata_pts			= NULL;
+	the_ftree			= NULL;
 	apx_nn_idx			= NULL;
 	apx_dists			= NULL;
 	apx_pts_in_range	= NULL;
@@ -691,6 +1088,43 @@ int main(int argc, char** argv)
 			cin >> radius_bound;
 			valid_dirty = ANNtrue;				// validation must be redone
 		}
+		else if (!strcmp(directive,"threads")) {
+			cin >> threads;
+		}
+		else if (!strcmp(directive,"build_threads")) {
+			cin >> build_threads;
+		}
+		//----------------------------------------------------------------
+		//	query_order option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"query_order")) {
+			cin >> arg;							// input query order name
+			order = (ANNqueryOrder) lookUp(arg, order_table, N_QUERY_ORDERS);
+			if (order >= N_QUERY_ORDERS) {		// not something we recognize
+				cerr << "Query order: " << arg << "\n";
+				Error("Unknown query order", ANNabort);
+			}
+		}
+		//----------------------------------------------------------------
+		//	simd option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"simd")) {
+			cin >> arg;							// input kernel name
+			int lev = lookUp(arg, simd_table, N_SIMD);
+			if (lev >= N_SIMD) {				// not something we recognize
+				cerr << "Distance kernel: " << arg << "\n";
+				Error("Unknown distance kernel", ANNabort);
+			}
+			annSetSimd((ANNsimd) lev);			// (may fall back to lower)
+			simd_set = ANNtrue;
+		}
+		//----------------------------------------------------------------
+		//	heap_k option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"heap_k")) {
+			cin >> heap_k;
+			annSetHeapK(heap_k);
+		}
 		else if (!strcmp(directive,"near_neigh")) {
 			cin >> near_neigh;
 			true_nn = near_neigh + extra_nn;	// also reset true near neighs
@@ -774,6 +1208,141 @@ int main(int argc, char** argv)
 			}
 		}
 		//----------------------------------------------------------------
+		//	flat_layout option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"flat_layout")) {
+			cin >> arg;							// input layout name
+			flat_layout = lookUp(arg, flat_table, N_FLAT_LAYOUTS);
+			if (flat_layout >= N_FLAT_LAYOUTS) {// not something we recognize
+				cerr << "Flat tree layout: " << arg << "\n";
+				Error("Unknown flat tree layout", ANNabort);
+			}
+		}
+		//----------------------------------------------------------------
+		//	copy_pts option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"copy_pts")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				copy_pts = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				copy_pts = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("copy_pts argument must be \"on\" or \"off\"", ANNabort);
+			}
+		}
+		//----------------------------------------------------------------
+		//	presort option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"presort")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				presort = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				presort = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("presort argument must be \"on\" or \"off\"", ANNabort);
+			}
+			annSetPresort(presort);
+		}
+		else if (!strcmp(directive,"stream_memory")) {
+			cin >> stream_memory;
+		}
+		else if (!strcmp(directive,"page_cache")) {
+			cin >> page_cache;
+		}
+		else if (!strcmp(directive,"page_top")) {
+			cin >> page_top;
+		}
+		else if (!strcmp(directive,"pack_pts")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				pack_pts = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				pack_pts = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("pack_pts argument must be \"on\" or \"off\"", ANNabort);
+			}
+		}
+		//----------------------------------------------------------------
+		//	range_search option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"range_search")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				range_search = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				range_search = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("range_search argument must be \"on\" or \"off\"",
+					ANNabort);
+			}
+		}
+		//----------------------------------------------------------------
+		//	approx_count option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"approx_count")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				approx_count = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				approx_count = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("approx_count argument must be \"on\" or \"off\"",
+					ANNabort);
+			}
+			valid_dirty = ANNtrue;				// validation must be redone
+		}
+		//----------------------------------------------------------------
+		//	count_allocs option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"count_allocs")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				count_allocs = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				count_allocs = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("count_allocs argument must be \"on\" or \"off\"",
+					ANNabort);
+			}
+		}
+		//----------------------------------------------------------------
+		//	compare_float option
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"compare_float")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				compare_float = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				compare_float = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("compare_float argument must be \"on\" or \"off\"",
+						ANNabort);
+			}
+		}
+		//----------------------------------------------------------------
 		//	label operation
 		//----------------------------------------------------------------
 		else if (!strcmp(directive,"output_label")) {
@@ -850,6 +1419,44 @@ int main(int argc, char** argv)
 			valid_dirty = ANNtrue;				// validation must be redone
 		}
 		//----------------------------------------------------------------
+		//	read_data_bin and read_query_bin operations
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"read_data_bin") ||
+				 !strcmp(directive,"read_query_bin")) {
+			cin >> arg;							// input format name
+			int format = lookUp(arg, pts_format_table, ANN_N_PTS_FORMATS);
+			if (format >= ANN_N_PTS_FORMATS) {	// not something we recognize
+				cerr << "Point file format: " << arg << "\n";
+				Error("Unknown point file format", ANNabort);
+			}
+			cin >> arg;							// input file name
+			if (!strcmp(directive,"read_data_bin")) {
+				readPtsBin(data_pts, data_size, (ANNptsFormat) format,
+						arg, DATA);
+			}
+			else {
+				readPtsBin(query_pts, query_size, (ANNptsFormat) format,
+						arg, QUERY);
+			}
+			valid_dirty = ANNtrue;				// validation must be redone
+		}
+		else if (!strcmp(directive,"map_pts")) {
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "on")) {
+				map_pts = ANNtrue;
+			}
+			else if (!strcmp(arg, "off")) {
+				map_pts = ANNfalse;
+			}
+			else {
+				cerr << "Argument: " << arg << "\n";
+				Error("map_pts argument must be \"on\" or \"off\"", ANNabort);
+			}
+		}
+		else if (!strcmp(directive,"read_threads")) {
+			cin >> read_threads;
+		}
+		//----------------------------------------------------------------
 		//	build_ann operation
 		//		We always invoke the constructor for bd-trees.  Note
 		//		that when the shrinking rule is NONE (which is true by
@@ -863,6 +1470,7 @@ int main(int argc, char** argv)
 				delete the_tree;				// get rid of it
 			}
 			clock0 = clock();					// start time
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
 
 			the_tree = new ANNbd_tree(			// build it
 					data_pts,					// the data points
@@ -870,13 +1478,39 @@ int main(int argc, char** argv)
 					dim,						// dimension of space
 					bucket_size,				// maximum bucket size
 					split,						// splitting rule
-					shrink);					// shrinking rule
+					shrink,						// shrinking rule
+					copy_pts,					// copy points to leaf order?
+					build_threads);				// number of threads
+			double build_wall = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+			buildFlat();						// flat version (if wanted)
 
 			//------------------------------------------------------------
 			//	Print summary
 			//------------------------------------------------------------
 			long prep_time = clock() - clock0;	// end of prep time
 
+			double serial_wall = 0;				// time for serial build
+			if (validate && build_threads != 1) {
+				wall0 = chrono::steady_clock::now();
+				ANNbd_tree *serial_tree = new ANNbd_tree(
+						data_pts, data_size, dim, bucket_size,
+						split, shrink, copy_pts, 1);
+				serial_wall = chrono::duration<double>(
+						chrono::steady_clock::now() - wall0).count();
+				ostringstream par_dump, serial_dump;
+				the_tree->Dump(ANNfalse, par_dump);
+				serial_tree->Dump(ANNfalse, serial_dump);
+				delete serial_tree;
+				if (par_dump.str() != serial_dump.str())
+					Error("INTERNAL ERROR: Parallel build differs from serial",
+						ANNabort);
+			}
+
+			clock0 = clock();					// float version (if wanted)
+			buildFloat();
+			long float_prep_time = clock() - clock0;
+
 			if (stats > SILENT) {
 				cout << "[Build ann-structure:\n";
 				cout << "  split_rule    = " << split_table[split] << "\n";
@@ -884,10 +1518,43 @@ int main(int argc, char** argv)
 				cout << "  data_size     = " << data_size << "\n";
 				cout << "  dim           = " << dim << "\n";
 				cout << "  bucket_size   = " << bucket_size << "\n";
+				if (copy_pts) {
+					cout << "  copy_pts      = on\n";
+				}
+				if (presort) {
+					cout << "  presort       = on\n";
+				}
+				if (the_ftree != NULL) {
+					cout << "  compare_float = on\n";
+				}
+				if (the_flat != NULL) {
+					cout << "  flat_layout   = " << flat_table[flat_layout]
+						 << " (" << the_flat->nNodes() << " nodes)\n";
+				}
+				if (build_threads != 1) {
+					cout << "  build_threads = " << build_threads << "\n";
+					if (validate)
+						cout << "  validated     = yes\n";
+				}
 
 				if (stats >= EXEC_TIME) {		// output processing time
 					cout << "  process_time  = "
 						 << double(prep_time)/CLOCKS_PER_SEC << " sec\n";
+					if (build_threads != 1) {
+						cout << "  build_time    = " << build_wall
+							 << " sec (wall clock)\n";
+						if (validate) {
+							cout << "  serial_time   = " << serial_wall
+								 << " sec (wall clock)\n";
+							cout << "  speedup       = "
+								 << serial_wall/build_wall << "\n";
+						}
+					}
+					if (the_ftree != NULL) {
+						cout << "  float_time    = "
+							 << double(float_prep_time)/CLOCKS_PER_SEC
+							 << " sec\n";
+					}
 				}
 
 				if (stats >= PREP_STATS)		// output or check tree stats
@@ -939,22 +1606,38 @@ int main(int argc, char** argv)
 				delete data_pts;				// get rid of them
 			}
 
-			ifstream in_dump_file(arg);			// try to open file
+												// try to open file
+			ifstream in_dump_file(arg, ios::binary);
 			if (!in_dump_file) {
 				cerr << "File name: " << arg << "\n";
 				Error("Cannot open file for loading", ANNabort);
 			}
+			in_dump_file.seekg(0, ios::end);	// get size of file
+			long long dump_bytes = (long long) in_dump_file.tellg();
+			in_dump_file.seekg(0, ios::beg);
 												// build tree by loading
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
 			the_tree = new ANNbd_tree(in_dump_file);
+			double load_wall = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+			buildFlat();						// flat version (if wanted)
 
 			dim = the_tree->theDim();			// new dimension
 			data_size = the_tree->nPoints();	// number of points
 			data_pts = the_tree->thePoints();	// new points
+			buildFloat();						// float version (if wanted)
 
 			valid_dirty = ANNtrue;				// validation must be redone
 
 			if (stats > SILENT) {
 					cout << "(Tree has been loaded from file " << arg << ")\n";
+				if (stats >= EXEC_TIME) {		// output processing time
+					cout << "  dump_bytes    = " << dump_bytes << "\n";
+					cout << "  load_time     = " << load_wall
+						 << " sec (wall clock)\n";
+					cout << "  load_rate     = "
+						 << dump_bytes / double(1 << 20) / load_wall << " MB/sec\n";
+				}
 			}
 			if (stats >= SHOW_STRUCT) {			// print the tree
 				cout << "  (Structure Contents:\n";
@@ -963,48 +1646,253 @@ int main(int argc, char** argv)
 			}
 		}
 		//----------------------------------------------------------------
-		//	run_queries operation
-		//		This section does all the query processing.  It consists
-		//		of the following subsections:
-		//
-		//		**	input the argument (standard or priority) and output
-		//			the header describing the essential information.
-		//		**	allocate space for the results to be stored.
-		//		**	run the queries by invoking the appropriate search
-		//			procedure on the query points.  Print nearest neighbor
-		//			if requested.
-		//		**	print final summaries
-		//
-		//	The approach for processing multiple nearest neighbors is
-		//	pretty crude.  We allocate an array whose size is the
-		//	product of the total number of queries times the number of
-		//	nearest neighbors (k), and then use each k consecutive
-		//	entries to store the results of each query.
+		//	dump_compressed operation
+		//		The text dump is also made (in memory), to report the
+		//		compression ratio.
 		//----------------------------------------------------------------
-		else if (!strcmp(directive,"run_queries")) {
+		else if (!strcmp(directive,"dump_compressed")) {
+			cin >> arg;							// input file name
+			if (the_tree == NULL) {				// no tree
+				Error("Cannot dump.  No tree has been built yet", ANNwarn);
+			}
+			else {								// there is a tree
+												// try to open file
+				ofstream out_dump_file(arg, ios::binary);
+				if (!out_dump_file) {
+					cerr << "File name: " << arg << "\n";
+					Error("Cannot open dump file", ANNabort);
+				}
+				chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+				the_tree->DumpCompressed(pack_pts, out_dump_file);
+				double dump_wall = chrono::duration<double>(
+						chrono::steady_clock::now() - wall0).count();
+				long long dump_bytes = (long long) out_dump_file.tellp();
 
-			//------------------------------------------------------------
-			//	Input arguments and print summary
-			//------------------------------------------------------------
-			enum {STANDARD, PRIORITY} method;
+				if (stats > SILENT) {
+					ostringstream text_dump;	// text dump (for its size)
+					the_tree->Dump(ANNtrue, text_dump);
+					long long text_bytes = (long long) text_dump.str().size();
+					cout << "[Compressed dump:\n";
+					cout << "  pack_pts      = "
+						 << (pack_pts ? "on" : "off") << "\n";
+					cout << "  dump_bytes    = " << dump_bytes << "\n";
+					cout << "  text_bytes    = " << text_bytes << "\n";
+					cout << "  ratio         = "
+						 << double(text_bytes) / dump_bytes << "\n";
+					if (stats >= EXEC_TIME) {	// output processing time
+						cout << "  dump_time     = " << dump_wall
+							 << " sec (wall clock)\n";
+					}
+					cout << "]\n";
+					cout << "(Tree has been dumped to file " << arg << ")\n";
+				}
+			}
+		}
+		//----------------------------------------------------------------
+		//	stream_build operation
+		//		This builds a dump file without building a tree (or
+		//		reading the points) in memory.  The current tree and
+		//		points are not affected.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"stream_build")) {
+			cin >> arg;							// input points file name
+			ifstream in_pts_file(arg);			// try to open file
+			if (!in_pts_file) {
+				cerr << "File name: " << arg << "\n";
+				Error("Cannot open input data/query file", ANNabort);
+			}
+			cin >> arg;							// output dump file name
+			ofstream out_dump_file(arg);
+			if (!out_dump_file) {
+				cerr << "File name: " << arg << "\n";
+				Error("Cannot open dump file", ANNabort);
+			}
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+			int n = annStreamBuild(				// build the dump
+					in_pts_file,				// input points
+					dim,						// dimension of space
+					out_dump_file,				// output dump
+					bucket_size,				// maximum bucket size
+					split,						// splitting rule
+					(size_t) (stream_memory * (1 << 20)));	// budget
+			double build_wall = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
 
-			cin >> arg;							// input argument
-			if (!strcmp(arg, "standard")) {
-				method = STANDARD;
+			if (stats > SILENT) {
+				cout << "[Stream build:\n";
+				cout << "  split_rule    = " << split_table[split] << "\n";
+				cout << "  data_size     = " << n << "\n";
+				cout << "  dim           = " << dim << "\n";
+				cout << "  bucket_size   = " << bucket_size << "\n";
+				cout << "  stream_memory = " << stream_memory << " MB\n";
+				if (stats >= EXEC_TIME) {		// output processing time
+					cout << "  build_time    = " << build_wall
+						 << " sec (wall clock)\n";
+				}
+				cout << "]\n";
+				cout << "(Tree has been dumped to file " << arg << ")\n";
 			}
-			else if (!strcmp(arg, "priority")) {
-				method = PRIORITY;
+		}
+		//----------------------------------------------------------------
+		//	dump_binary operation
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"dump_binary")) {
+			cin >> arg;							// input file name
+			if (the_tree == NULL && the_flat == NULL) {	// no tree
+				Error("Cannot dump.  No tree has been built yet", ANNwarn);
 			}
-			else {
-				cerr << "Search type: " << arg << "\n";
-				Error("Search type must be \"standard\" or \"priority\"",
-						ANNabort);
+			else {								// there is a tree
+												// try to open file
+				ofstream out_dump_file(arg, ios::binary);
+				if (!out_dump_file) {
+					cerr << "File name: " << arg << "\n";
+					Error("Cannot open dump file", ANNabort);
+				}
+				if (the_flat != NULL) {			// dump the flat tree
+					the_flat->DumpBinary(out_dump_file);
+				}
+				else {							// flatten the tree first
+					ANNflat_tree flat(*the_tree, ANN_FLAT_DFS, copy_pts);
+					flat.DumpBinary(out_dump_file);
+				}
+				if (stats > SILENT) {
+					cout << "(Tree has been dumped to file " << arg << ")\n";
+				}
 			}
-			if (data_pts == NULL || query_pts == NULL) {
-				Error("Either data set and query set not constructed", ANNabort);
+		}
+		//----------------------------------------------------------------
+		//	load_binary operation
+		//		This replaces the tree and the data points, as load does.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"load_binary")) {
+			cin >> arg;							// input file name
+			if (the_tree != NULL) {				// tree exists already
+				delete the_tree;				// get rid of it
+				the_tree = NULL;
 			}
-			if (the_tree == NULL) {
-				Error("No search tree built.", ANNabort);
+			if (the_flat != NULL) {				// so does flat tree
+				delete the_flat;
+				the_flat = NULL;
+			}
+			if (the_paged != NULL) {			// ...or paged tree
+				delete the_paged;
+				the_paged = NULL;
+			}
+			if (data_pts != NULL) {				// data points exist already
+				annDeallocPts(data_pts);		// get rid of them
+			}
+
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+			the_flat = new ANNflat_tree(arg);	// map the file
+			double load_wall = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+
+			dim = the_flat->theDim();			// new dimension
+			data_size = the_flat->nPoints();	// number of points
+			data_pts = annAllocPts(data_size, dim);	// copy the points
+			ANNpointArray flat_pts = the_flat->thePoints();
+			for (int i = 0; i < data_size; i++) {
+				for (int d = 0; d < dim; d++) {
+					data_pts[i][d] = flat_pts[i][d];
+				}
+			}
+			buildFloat();						// float version (if wanted)
+
+			valid_dirty = ANNtrue;				// validation must be redone
+
+			if (stats > SILENT) {
+				cout << "(Tree has been loaded from file " << arg << ")\n";
+				if (stats >= EXEC_TIME) {		// output processing time
+					cout << "  load_time     = " << load_wall
+						 << " sec (wall clock)\n";
+				}
+			}
+		}
+		//----------------------------------------------------------------
+		//	load_paged operation
+		//		This replaces the tree, but not the data points.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"load_paged")) {
+			cin >> arg;							// input file name
+			if (the_tree != NULL) {				// tree exists already
+				delete the_tree;				// get rid of it
+				the_tree = NULL;
+			}
+			buildFlat();						// (deletes any flat tree)
+
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+			the_paged = new ANNpaged_tree(arg,	// open the file
+					(size_t) (page_cache * (1 << 20)), page_top);
+			double load_wall = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+
+			if (data_pts == NULL || the_paged->theDim() != dim ||
+				the_paged->nPoints() != data_size) {
+				Error("Data points do not match the paged tree", ANNabort);
+			}
+			valid_dirty = ANNtrue;				// validation must be redone
+
+			if (stats > SILENT) {
+				cout << "(Paged tree has been opened from file " << arg
+					 << ")\n";
+				cout << "  page_cache    = " << page_cache << " MB\n";
+				cout << "  page_top      = " << page_top
+					 << " (" << the_paged->nPages() << " pages)\n";
+				if (stats >= EXEC_TIME) {		// output processing time
+					cout << "  load_time     = " << load_wall
+						 << " sec (wall clock)\n";
+				}
+			}
+		}
+		//----------------------------------------------------------------
+		//	run_queries operation
+		//		This section does all the query processing.  It consists
+		//		of the following subsections:
+		//
+		//		**	input the argument (standard or priority) and output
+		//			the header describing the essential information.
+		//		**	allocate space for the results to be stored.
+		//		**	run the queries by invoking the appropriate search
+		//			procedure on the query points.  Print nearest neighbor
+		//			if requested.
+		//		**	print final summaries
+		//
+		//	The approach for processing multiple nearest neighbors is
+		//	pretty crude.  We allocate an array whose size is the
+		//	product of the total number of queries times the number of
+		//	nearest neighbors (k), and then use each k consecutive
+		//	entries to store the results of each query.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"run_queries")) {
+
+			//------------------------------------------------------------
+			//	Input arguments and print summary
+			//------------------------------------------------------------
+			enum {STANDARD, PRIORITY} method;
+
+			cin >> arg;							// input argument
+			if (!strcmp(arg, "standard")) {
+				method = STANDARD;
+			}
+			else if (!strcmp(arg, "priority")) {
+				method = PRIORITY;
+			}
+			else {
+				cerr << "Search type: " << arg << "\n";
+				Error("Search type must be \"standard\" or \"priority\"",
+						ANNabort);
+			}
+			if (data_pts == NULL || query_pts == NULL) {
+				Error("Either data set and query set not constructed", ANNabort);
+			}
+			if (the_tree == NULL && the_flat == NULL && the_paged == NULL) {
+				Error("No search tree built.", ANNabort);
+			}
+			if (the_paged != NULL && method == PRIORITY) {
+				Error("Paged trees do not support priority search", ANNabort);
+			}
+			if (the_tree == NULL && approx_count && near_neigh == 0) {
+				Error("Approximate counts need a kd- or bd-tree", ANNabort);
 			}
 
 			//------------------------------------------------------------
@@ -1015,7 +1903,12 @@ int main(int argc, char** argv)
 				annResetStats(data_size);			// reset statistics
 			#endif
 
+												// batched search?
+			ANNbool batch = (ANNbool) (threads > 0 && radius_bound == 0
+									&& method == STANDARD);
+
 			clock0 = clock();					// start time
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
 												// deallocate existing storage
 			if (apx_nn_idx	 	 != NULL) delete [] apx_nn_idx;
 			if (apx_dists		 != NULL) delete [] apx_dists;
@@ -1034,7 +1927,37 @@ int main(int argc, char** argv)
 			ANNidxArray	  curr_nn_idx = apx_nn_idx;
 			ANNdistArray  curr_dists  = apx_dists;
 
-			for (int i = 0; i < query_size; i++) {
+			ANNpointSet *the_set = (the_flat != NULL ?	// structure to search
+					(ANNpointSet *) the_flat : (ANNpointSet *) the_tree);
+			long long page_rds = 0, page_hts = 0, bytes_rd = 0;
+			if (the_paged != NULL) {			// search paged tree
+				the_set = the_paged;
+				page_rds = the_paged->nPageReads();	// (counts so far)
+				page_hts = the_paged->nPageHits();
+				bytes_rd = the_paged->nBytesRead();
+			}
+			vector<ANNidx> range_idx;			// range search results
+			vector<ANNdist> range_dd;
+
+			long long cache_misses = -1;		// cache misses (-1 if unknown)
+			long long allocs0 = n_allocs;		// allocations before counting
+			if (batch) {						// run all queries at once
+				int cm_fd = startCacheMisses();
+				the_set->annkSearchBatch(
+					query_pts,					// query points
+					query_size,					// number of queries
+					near_neigh,					// number of near neighbors
+					apx_nn_idx,					// nearest neighbors (returned)
+					apx_dists,					// distance (returned)
+					epsilon,					// error bound
+					threads,					// number of threads
+					order);						// query order
+				cache_misses = stopCacheMisses(cm_fd);
+				for (int i = 0; i < query_size; i++) {
+					apx_pts_in_range[i] = 0;
+				}
+			}
+			for (int i = 0; i < query_size && !batch; i++) {
 				#ifdef ANN_PERF
 					annResetCounts();			// reset counters
 				#endif
@@ -1042,7 +1965,15 @@ int main(int argc, char** argv)
 
 				if (radius_bound == 0) {		// no radius bound
 					if (method == STANDARD) {
-						the_tree->annkSearch(
+						the_set->annkSearch(
+							query_pts[i],		// query point
+							near_neigh,			// number of near neighbors
+							curr_nn_idx,		// nearest neighbors (returned)
+							curr_dists,			// distance (returned)
+							epsilon);			// error bound
+					}
+					else if (method == PRIORITY && the_flat != NULL) {
+						the_flat->annkPriSearch(
 							query_pts[i],		// query point
 							near_neigh,			// number of near neighbors
 							curr_nn_idx,		// nearest neighbors (returned)
@@ -1066,16 +1997,46 @@ int main(int argc, char** argv)
 						Error("A nonzero radius bound assumes standard search",
 							ANNwarn);
 					}
-					apx_pts_in_range[i] = the_tree->annkFRSearch(
-						query_pts[i],			// query point
-						ANN_POW(radius_bound),	// squared radius search bound
-						near_neigh,				// number of near neighbors
-						curr_nn_idx,			// nearest neighbors (returned)
-						curr_dists,				// distance (returned)
-						epsilon);				// error bound
+					if (approx_count && near_neigh == 0) {
+						apx_pts_in_range[i] = the_tree->annApproxRangeCount(
+							query_pts[i],		// query point
+							ANN_POW(radius_bound),	// squared radius bound
+							epsilon);			// error bound
+					}
+					else if (range_search) {	// get all points in range
+						range_idx.clear();
+						range_dd.clear();
+						apx_pts_in_range[i] = the_set->annRangeSearch(
+							query_pts[i],		// query point
+							ANN_POW(radius_bound),	// squared radius bound
+							range_idx,			// points in range (returned)
+							range_dd,			// distances (returned)
+							ANNtrue,			// sorted by distance
+							epsilon);			// error bound
+						for (int j = 0; j < near_neigh; j++) {
+							if (j < apx_pts_in_range[i]) {
+								curr_nn_idx[j] = range_idx[j];
+								curr_dists[j] = range_dd[j];
+							}
+							else {				// fewer than near_neigh
+								curr_nn_idx[j] = ANN_NULL_IDX;
+								curr_dists[j] = ANN_DIST_INF;
+							}
+						}
+					}
+					else {
+						apx_pts_in_range[i] = the_set->annkFRSearch(
+							query_pts[i],		// query point
+							ANN_POW(radius_bound),	// squared radius bound
+							near_neigh,			// number of near neighbors
+							curr_nn_idx,		// nearest neighbors (returned)
+							curr_dists,			// distance (returned)
+							epsilon);			// error bound
+					}
 				}
 				curr_nn_idx += near_neigh;		// increment current pointers
 				curr_dists	+= near_neigh;
+				if (i == 0) allocs0 = n_allocs;	// (first may allocate)
 
 				#ifdef ANN_PERF
 					annUpdateStats();			// update stats
@@ -1083,12 +2044,27 @@ int main(int argc, char** argv)
 			}
 
 			long query_time = clock() - clock0; // end of query time
+			double wall_time = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+			long long allocs = n_allocs - allocs0;	// allocations by queries
+
+			if (count_allocs && !batch && validate && allocs > 0
+					&& !range_search && the_paged == NULL) {
+				Error("Queries allocated memory after the first", ANNwarn);
+			}
 
 			if (validate) {						// validation requested
 				if (valid_dirty) getTrueNN();	// get true near neighbors
 				doValidation();					// validate
 			}
 
+			double float_time = 0;				// float version (if any)
+			double float_recall = 0;
+			if (the_ftree != NULL) {
+				float_time = runFloatQueries(
+						(ANNbool) (method == PRIORITY), batch, float_recall);
+			}
+
 			//------------------------------------------------------------
 			//	Print summaries
 			//------------------------------------------------------------
@@ -1104,10 +2080,36 @@ int main(int argc, char** argv)
 					cout << "  max_pts_visit = " << max_pts_visit << "\n";
 				if (radius_bound != 0)
 					cout << "  radius_bound  = " << radius_bound << "\n";
+				if (radius_bound != 0 && range_search)
+					cout << "  range_search  = on\n";
+				if (radius_bound != 0 && approx_count && near_neigh == 0)
+					cout << "  approx_count  = on\n";
 				if (validate)
 					cout << "  true_nn       = " << true_nn << "\n";
+				if (batch) {
+					cout << "  threads       = " << threads << "\n";
+					cout << "  query_order   = " << order_table[order] << "\n";
+				}
+				if (simd_set)
+					cout << "  simd          = " << simd_table[annSimd()] << "\n";
+				if (heap_k != ANN_DEF_HEAP_K)
+					cout << "  heap_k        = " << heap_k << "\n";
 
-				if (stats >= EXEC_TIME) {		// print exec time summary
+				if (stats >= EXEC_TIME && batch) {	// batch wall time
+					cout << "  query_time    = " <<
+						wall_time/query_size << " sec/query (wall clock)\n";
+					if (wall_time > 0) {
+						cout << "  throughput    = " <<
+							query_size/wall_time << " queries/sec\n";
+					}
+					if (cache_misses >= 0) {
+						cout << "  cache_misses  = " <<
+							double(cache_misses)/query_size << " per query"
+							<< (threads > 1 ? " (main thread only)" : "")
+							<< "\n";
+					}
+				}
+				else if (stats >= EXEC_TIME) {	// print exec time summary
 					cout << "  query_time    = " <<
 						double(query_time)/(query_size*CLOCKS_PER_SEC)
 						 << " sec/query";
@@ -1116,11 +2118,39 @@ int main(int argc, char** argv)
 					#endif
 					cout << "\n";
 				}
+				if (count_allocs && !batch) {	// allocations by queries
+					cout << "  allocs        = " << allocs
+						 << " (after the first query)\n";
+				}
+				if (the_paged != NULL) {		// pages read by queries
+					cout << "  pages_read    = " << double(
+						the_paged->nPageReads() - page_rds)/query_size
+						 << " per query (" << the_paged->nPageHits() - page_hts
+						 << " found in cache)\n";
+					cout << "  bytes_read    = " << double(
+						the_paged->nBytesRead() - bytes_rd)/query_size
+						 << " per query\n";
+					cout << "  cache_bytes   = " << the_paged->cacheBytes()
+						 << "\n";
+				}
+				if (the_ftree != NULL) {		// float version
+					if (stats >= EXEC_TIME) {
+						cout << "  float_time    = " << float_time
+							 << " sec/query"
+							 << (batch ? " (wall clock)" : "") << "\n";
+					}
+					cout << "  float_recall  = " << float_recall << "\n";
+				}
 
 				if (stats >= QUERY_STATS) {		// output performance stats
 					#ifdef ANN_PERF
+					if (batch) {
+						cout << "  (Performance statistics unavailable for batched queries.)\n";
+					}
+					else {
 						cout.flush();
 						annPrintStats(validate);
+					}
 					#else
 						cout << "  (Performance statistics unavailable.)\n";
 					#endif
@@ -1161,6 +2191,422 @@ int main(int argc, char** argv)
 			}
 		}
 		//----------------------------------------------------------------
+		//	run_all_knn operation
+		//		The near neighbors of all the data points are computed
+		//		together.  For validation, the true near neighbors of
+		//		each point are computed by brute force, and the distance
+		//		to each of the approximate near neighbors must be within
+		//		a factor of 1+epsilon of the true one.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"run_all_knn")) {
+			if (data_pts == NULL) {
+				Error("Data set not constructed", ANNabort);
+			}
+			if (the_tree == NULL) {
+				Error("No search tree built.", ANNabort);
+			}
+			int k = near_neigh;
+			ANNidxArray all_idx = new ANNidx[(size_t) data_size*k + 1];
+			ANNdistArray all_dists = new ANNdist[(size_t) data_size*k + 1];
+
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+			the_tree->annAllkNN(k, all_idx, all_dists, epsilon, ANNfalse,
+						threads);
+			double wall_time = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+
+			if (validate) {						// check against brute force
+				ANNbruteForce *the_brute = new ANNbruteForce(
+						data_pts, data_size, dim);
+				ANNidxArray tru_idx = new ANNidx[k+1];
+				ANNdistArray tru_dists = new ANNdist[k+1];
+				ANNdist max_err = ANN_POW(1 + epsilon);
+				for (int i = 0; i < data_size; i++) {
+												// (first is the point itself)
+					the_brute->annkSearch(data_pts[i], k+1, tru_idx, tru_dists);
+					for (int j = 0; j < k; j++) {
+						if (all_idx[(size_t) i*k+j] == i ||
+							all_dists[(size_t) i*k+j] > tru_dists[j+1]*max_err)
+							Error("INTERNAL ERROR: Invalid all-kNN result",
+								ANNabort);
+					}
+				}
+				delete [] tru_idx;
+				delete [] tru_dists;
+				delete the_brute;
+			}
+
+			if (stats > SILENT) {
+				cout << "[Run All kNN:\n";
+				cout << "  data_size     = " << data_size << "\n";
+				cout << "  dim           = " << dim << "\n";
+				cout << "  epsilon       = " << epsilon << "\n";
+				cout << "  near_neigh    = " << near_neigh << "\n";
+				cout << "  threads       = " << threads << "\n";
+				if (validate)
+					cout << "  validated     = yes\n";
+				if (stats >= EXEC_TIME) {
+					cout << "  query_time    = " << wall_time/data_size
+						 << " sec/point (wall clock)\n";
+				}
+				cout << "]\n";
+			}
+			delete [] all_idx;
+			delete [] all_dists;
+		}
+		//----------------------------------------------------------------
+		//	run_join operation
+		//		A tree is built on the query points, and joined with the
+		//		tree on the data points.  The callback just counts the
+		//		pairs.  For validation, the number of pairs must lie
+		//		between the numbers of pairs within distance
+		//		radius_bound/(1+epsilon) and within radius_bound, as
+		//		counted by brute force.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"run_join")) {
+			if (data_pts == NULL || query_pts == NULL) {
+				Error("Either data set and query set not constructed", ANNabort);
+			}
+			if (the_tree == NULL) {
+				Error("No search tree built.", ANNabort);
+			}
+			if (radius_bound == 0) {
+				Error("A join needs a nonzero radius bound", ANNabort);
+			}
+			ANNkd_tree *query_tree = new ANNbd_tree(	// tree on queries
+					query_pts, query_size, dim, bucket_size,
+					split, shrink, copy_pts);
+			size_t n_calls = 0;					// number of callbacks
+
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+			size_t n_pairs = the_tree->annRangeJoin(
+					*query_tree,				// the other tree
+					ANN_POW(radius_bound),		// squared radius bound
+					joinCount,					// callback
+					&n_calls,					// ...and its data
+					epsilon,					// error bound
+					threads);					// number of threads
+			double wall_time = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+			delete query_tree;
+
+			if (validate) {						// check against brute force
+				ANNbruteForce *the_brute = new ANNbruteForce(
+						data_pts, data_size, dim);
+				size_t min_pairs = 0;
+				size_t max_pairs = 0;
+				for (int i = 0; i < query_size; i++) {
+					min_pairs += the_brute->annkFRSearch(query_pts[i],
+							ANN_POW(radius_bound / (1+epsilon)), 0);
+					max_pairs += the_brute->annkFRSearch(query_pts[i],
+							ANN_POW(radius_bound), 0);
+				}
+				delete the_brute;
+				if (n_pairs < min_pairs || n_pairs > max_pairs)
+					Error("INTERNAL ERROR: Invalid number of join pairs",
+						ANNabort);
+			}
+
+			if (stats > SILENT) {
+				cout << "[Run Join:\n";
+				cout << "  data_size     = " << data_size << "\n";
+				cout << "  query_size    = " << query_size << "\n";
+				cout << "  dim           = " << dim << "\n";
+				cout << "  epsilon       = " << epsilon << "\n";
+				cout << "  radius_bound  = " << radius_bound << "\n";
+				cout << "  threads       = " << threads << "\n";
+				cout << "  pairs         = " << n_pairs << "\n";
+				cout << "  callbacks     = " << n_calls << "\n";
+				if (validate)
+					cout << "  validated     = yes\n";
+				if (stats >= EXEC_TIME) {
+					cout << "  join_time     = " << wall_time
+						 << " sec (wall clock)\n";
+					cout << "  query_time    = " << wall_time/query_size
+						 << " sec/query (wall clock)\n";
+				}
+				cout << "]\n";
+			}
+		}
+		//----------------------------------------------------------------
+		//	run_dynamic operation
+		//		The deleted points are those with indices i*data_size/n_del
+		//		for i = 0, ..., n_del-1.  (Since the points are added in
+		//		order, a point's index in the dynamic tree is its index
+		//		in data_pts.)  For validation, a brute-force structure is
+		//		built on the remaining points, and the distance to each
+		//		near neighbor must be within a factor of 1+epsilon of
+		//		the true one.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"run_dynamic")) {
+			int n_del;
+			cin >> n_del;						// number of points to delete
+			if (data_pts == NULL || query_pts == NULL) {
+				Error("Either data set and query set not constructed", ANNabort);
+			}
+			if (n_del < 0 || n_del > data_size) {
+				Error("Invalid number of points to delete", ANNabort);
+			}
+			int k = near_neigh;
+			if (k > data_size - n_del) {
+				Error("Too few points left for near neighbors", ANNabort);
+			}
+			int n_init = data_size/2;			// initial points
+
+			clock0 = clock();					// start time
+			ANNdynamic_tree *dyn_tree = new ANNdynamic_tree(
+					data_pts,					// the initial points
+					n_init,						// number of them
+					dim,						// dimension of space
+					bucket_size,				// maximum bucket size
+					split,						// splitting rule
+					copy_pts);					// copy points to leaf order?
+			long build_time = clock() - clock0;	// end of build time
+
+			clock0 = clock();
+			for (int i = n_init; i < data_size; i++) {
+				dyn_tree->annInsert(data_pts[i]);	// add the others
+			}
+			long insert_time = clock() - clock0;	// end of insertions
+
+			clock0 = clock();
+			for (int i = 0; i < n_del; i++) {	// delete some
+				dyn_tree->annDelete((ANNidx) ((double) i*data_size/n_del));
+			}
+			long delete_time = clock() - clock0;	// end of deletions
+
+			ANNidxArray dyn_idx = new ANNidx[k+1];
+			ANNdistArray dyn_dists = new ANNdist[k+1];
+			clock0 = clock();					// run the queries
+			for (int i = 0; i < query_size; i++) {
+				dyn_tree->annkSearch(query_pts[i], k, dyn_idx, dyn_dists, epsilon);
+			}
+			long query_time = clock() - clock0;	// end of queries
+
+			if (validate) {						// check against brute force
+				char *gone = new char[data_size];	// deleted points
+				for (int i = 0; i < data_size; i++) gone[i] = 0;
+				for (int i = 0; i < n_del; i++) {
+					gone[(int) ((double) i*data_size/n_del)] = 1;
+				}
+				int n_live = 0;					// remaining points
+				ANNpointArray live_pts = new ANNpoint[data_size];
+				for (int i = 0; i < data_size; i++) {
+					if (!gone[i]) live_pts[n_live++] = data_pts[i];
+				}
+				if (n_live != dyn_tree->nPoints())
+					Error("INTERNAL ERROR: Wrong number of points", ANNabort);
+				ANNbruteForce *the_brute = new ANNbruteForce(
+						live_pts, n_live, dim);
+				ANNidxArray tru_idx = new ANNidx[k+1];
+				ANNdistArray tru_dists = new ANNdist[k+1];
+				ANNdist max_err = ANN_POW(1 + epsilon);
+				for (int i = 0; i < query_size; i++) {
+					dyn_tree->annkSearch(query_pts[i], k, dyn_idx, dyn_dists,
+								epsilon);
+					the_brute->annkSearch(query_pts[i], k, tru_idx, tru_dists);
+					for (int j = 0; j < k; j++) {
+						if (gone[dyn_idx[j]] ||
+							dyn_dists[j] > tru_dists[j]*max_err)
+							Error("INTERNAL ERROR: Invalid dynamic tree result",
+								ANNabort);
+					}
+				}
+				delete [] tru_idx;
+				delete [] tru_dists;
+				delete the_brute;
+				delete [] live_pts;
+				delete [] gone;
+			}
+
+			if (stats > SILENT) {
+				cout << "[Run Dynamic:\n";
+				cout << "  split_rule    = " << split_table[split] << "\n";
+				cout << "  data_size     = " << data_size << "\n";
+				cout << "  query_size    = " << query_size << "\n";
+				cout << "  dim           = " << dim << "\n";
+				cout << "  bucket_size   = " << bucket_size << "\n";
+				cout << "  epsilon       = " << epsilon << "\n";
+				cout << "  near_neigh    = " << near_neigh << "\n";
+				cout << "  initial_pts   = " << n_init << "\n";
+				cout << "  inserted      = " << data_size - n_init << "\n";
+				cout << "  deleted       = " << n_del << "\n";
+				cout << "  trees         = " << dyn_tree->nTrees() << "\n";
+				if (validate)
+					cout << "  validated     = yes\n";
+				if (stats >= EXEC_TIME) {
+					cout << "  build_time    = "
+						 << double(build_time)/CLOCKS_PER_SEC << " sec\n";
+					if (data_size > n_init) {
+						cout << "  insert_time   = "
+							 << double(insert_time)/CLOCKS_PER_SEC
+								/ (data_size - n_init) << " sec/point\n";
+					}
+					if (n_del > 0) {
+						cout << "  delete_time   = "
+							 << double(delete_time)/CLOCKS_PER_SEC / n_del
+							 << " sec/point\n";
+					}
+					cout << "  query_time    = "
+						 << double(query_time)/CLOCKS_PER_SEC/query_size
+						 << " sec/query\n";
+				}
+				cout << "]\n";
+			}
+			delete [] dyn_idx;
+			delete [] dyn_dists;
+			delete dyn_tree;
+		}
+		//----------------------------------------------------------------
+		//	run_rebuild operation
+		//		The deleted points are chosen as in run_dynamic.  The
+		//		searches run during the deletions are timed individually
+		//		(by the wall clock, since two threads are running), and
+		//		the longest is reported as max_latency.  Without a
+		//		background rebuild, this would be at least the time to
+		//		build a tree.  Validation is as for run_dynamic.
+		//----------------------------------------------------------------
+		else if (!strcmp(directive,"run_rebuild")) {
+			int n_del;
+			double threshold;
+			cin >> n_del >> threshold;			// deletions and threshold
+			if (data_pts == NULL || query_pts == NULL) {
+				Error("Either data set and query set not constructed", ANNabort);
+			}
+			if (n_del < 0 || n_del > data_size) {
+				Error("Invalid number of points to delete", ANNabort);
+			}
+			int k = near_neigh;
+			if (k > data_size - n_del) {
+				Error("Too few points left for near neighbors", ANNabort);
+			}
+
+			clock0 = clock();					// start time
+			ANNrebuild_tree *rb_tree = new ANNrebuild_tree(
+					data_pts,					// the data points
+					data_size,					// number of points
+					dim,						// dimension of space
+					bucket_size,				// maximum bucket size
+					split,						// splitting rule
+					shrink,						// shrinking rule
+					copy_pts,					// copy points to leaf order?
+					threshold);					// rebuild threshold
+			long build_time = clock() - clock0;	// end of build time
+
+			atomic<bool> deleting(true);		// still deleting?
+			int n_busy = 0;						// searches while deleting
+			double max_latency = 0;				// longest of them
+			thread searcher([&]() {
+				ANNidxArray s_idx = new ANNidx[k+1];
+				ANNdistArray s_dists = new ANNdist[k+1];
+				for (int i = 0; deleting; i = (i+1) % query_size) {
+					chrono::steady_clock::time_point t0 =
+							chrono::steady_clock::now();
+					rb_tree->annkSearch(query_pts[i], k, s_idx, s_dists,
+								epsilon);
+					double t = chrono::duration<double>(
+							chrono::steady_clock::now() - t0).count();
+					if (t > max_latency) max_latency = t;
+					n_busy++;
+				}
+				delete [] s_idx;
+				delete [] s_dists;
+			});
+
+			chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+			for (int i = 0; i < n_del; i++) {	// delete some
+				rb_tree->annDelete((ANNidx) ((double) i*data_size/n_del));
+			}
+			double delete_time = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count();
+			rb_tree->annWaitRebuild();			// let rebuild finish
+			double wait_time = chrono::duration<double>(
+					chrono::steady_clock::now() - wall0).count() - delete_time;
+			deleting = false;					// stop searching
+			searcher.join();
+
+			ANNidxArray rb_idx = new ANNidx[k+1];
+			ANNdistArray rb_dists = new ANNdist[k+1];
+			clock0 = clock();					// run the queries
+			for (int i = 0; i < query_size; i++) {
+				rb_tree->annkSearch(query_pts[i], k, rb_idx, rb_dists, epsilon);
+			}
+			long query_time = clock() - clock0;	// end of queries
+
+			if (validate) {						// check against brute force
+				char *gone = new char[data_size];	// deleted points
+				for (int i = 0; i < data_size; i++) gone[i] = 0;
+				for (int i = 0; i < n_del; i++) {
+					gone[(int) ((double) i*data_size/n_del)] = 1;
+				}
+				int n_live = 0;					// remaining points
+				ANNpointArray live_pts = new ANNpoint[data_size];
+				for (int i = 0; i < data_size; i++) {
+					if (!gone[i]) live_pts[n_live++] = data_pts[i];
+				}
+				if (n_live != rb_tree->nPoints())
+					Error("INTERNAL ERROR: Wrong number of points", ANNabort);
+				ANNbruteForce *the_brute = new ANNbruteForce(
+						live_pts, n_live, dim);
+				ANNidxArray tru_idx = new ANNidx[k+1];
+				ANNdistArray tru_dists = new ANNdist[k+1];
+				ANNdist max_err = ANN_POW(1 + epsilon);
+				for (int i = 0; i < query_size; i++) {
+					rb_tree->annkSearch(query_pts[i], k, rb_idx, rb_dists,
+								epsilon);
+					the_brute->annkSearch(query_pts[i], k, tru_idx, tru_dists);
+					for (int j = 0; j < k; j++) {
+						if (gone[rb_idx[j]] ||
+							rb_dists[j] > tru_dists[j]*max_err)
+							Error("INTERNAL ERROR: Invalid rebuild tree result",
+								ANNabort);
+					}
+				}
+				delete [] tru_idx;
+				delete [] tru_dists;
+				delete the_brute;
+				delete [] live_pts;
+				delete [] gone;
+			}
+
+			if (stats > SILENT) {
+				cout << "[Run Rebuild:\n";
+				cout << "  split_rule    = " << split_table[split] << "\n";
+				cout << "  shrink_rule   = " << shrink_table[shrink] << "\n";
+				cout << "  data_size     = " << data_size << "\n";
+				cout << "  query_size    = " << query_size << "\n";
+				cout << "  dim           = " << dim << "\n";
+				cout << "  bucket_size   = " << bucket_size << "\n";
+				cout << "  epsilon       = " << epsilon << "\n";
+				cout << "  near_neigh    = " << near_neigh << "\n";
+				cout << "  deleted       = " << n_del << "\n";
+				cout << "  threshold     = " << threshold << "\n";
+				cout << "  rebuilds      = " << rb_tree->nRebuilds() << "\n";
+				cout << "  busy_searches = " << n_busy << "\n";
+				if (validate)
+					cout << "  validated     = yes\n";
+				if (stats >= EXEC_TIME) {
+					cout << "  build_time    = "
+						 << double(build_time)/CLOCKS_PER_SEC << " sec\n";
+					if (n_del > 0) {
+						cout << "  delete_time   = " << delete_time/n_del
+							 << " sec/point (wall clock)\n";
+					}
+					cout << "  rebuild_wait  = " << wait_time
+						 << " sec (wall clock)\n";
+					cout << "  max_latency   = " << max_latency
+						 << " sec (wall clock)\n";
+					cout << "  query_time    = "
+						 << double(query_time)/CLOCKS_PER_SEC/query_size
+						 << " sec/query\n";
+				}
+				cout << "]\n";
+			}
+			delete [] rb_idx;
+			delete [] rb_dists;
+			delete rb_tree;
+		}
+		//----------------------------------------------------------------
 		//	Unknown directive
 		//----------------------------------------------------------------
 		else {
@@ -1177,8 +2623,13 @@ int main(int argc, char** argv)
 	if (apx_nn_idx		!= NULL) delete [] apx_nn_idx;
 	if (apx_dists		!= NULL) delete [] apx_dists;
 	if (apx_pts_in_range != NULL) delete [] apx_pts_in_range;
+	if (the_flat != NULL) delete the_flat;
+	if (the_paged != NULL) delete the_paged;
+	if (the_ftree != NULL) delete the_ftree;
+	if (fdata_pts != NULL) annf::annDeallocPts(fdata_pts);
 
 	annClose();			// close ANN
+	annf::annClose();	// ...and its float version
 
 	return EXIT_SUCCESS;
 }
@@ -1278,6 +2729,7 @@ void generatePts(
 
 //------------------------------------------------------------------------
 // readPts - read a collection of data or query points.
+//		Up to n points are read (by annReadPts, in parallel).
 //------------------------------------------------------------------------
 
 void readPts(
@@ -1286,39 +2738,72 @@ void readPts(
 	char				*file_nm,		// file name
 	PtType				type)			// point type (DATA, QUERY)
 {
-	int i;
-	//--------------------------------------------------------------------
-	//	Open input file and read points
-	//--------------------------------------------------------------------
-	ifstream in_file(file_nm);					// try to open data file
-	if (!in_file) {
-		cerr << "File name: " << file_nm << "\n";
-		Error("Cannot open input data/query file", ANNabort);
-	}
-												// allocate storage for points
 	if (pa != NULL) annDeallocPts(pa);			// get rid of old points
-	pa = annAllocPts(n, dim);
+	pa = NULL;
+	int n_file = 0;								// points in file
 
-	for (i = 0; i < n; i++) {					// read the data
-		if (!(in_file >> pa[i][0])) break;
-		for (int d = 1; d < dim; d++) {
-			in_file >> pa[i][d];
-		}
+	chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+	if (n > 0) {
+		pa = annReadPts(file_nm, dim, n, read_threads, &n_file);
+	}
+	else {										// (none wanted)
+		pa = annAllocPts(1, dim);				// (annDeallocPts needs one)
+		n = 0;
 	}
+	double read_wall = chrono::duration<double>(
+			chrono::steady_clock::now() - wall0).count();
 
-	char ignore_me;								// character for EOF test
-	in_file >> ignore_me;						// try to get one more character
-	if (!in_file.eof()) {						// exhausted space before eof
+	if (n_file > n) {							// exhausted space before eof
 		if (type == DATA) 
 			Error("`data_size' too small. Input file truncated.", ANNwarn);
 		else
 			Error("`query_size' too small. Input file truncated.", ANNwarn);
 	}
-	n = i;										// number of points read
 
-	//--------------------------------------------------------------------
-	//	Print summary
-	//--------------------------------------------------------------------
+	printReadPts(pa, n, file_nm, type, NULL, read_wall);
+}
+
+//------------------------------------------------------------------------
+// readPtsBin - read a collection of data or query points from a binary
+//		file.  Up to n points are read, and for data points in fvecs or
+//		bvecs format, dim is set to the dimension of the file.
+//------------------------------------------------------------------------
+
+void readPtsBin(
+	ANNpointArray		&pa,			// point array (returned)
+	int					&n,				// number of points
+	ANNptsFormat		format,			// file format
+	char				*file_nm,		// file name
+	PtType				type)			// point type (DATA, QUERY)
+{
+	if (pa != NULL) annDeallocPts(pa);			// get rid of old points
+	pa = NULL;
+	int pts_dim = dim;							// dimension of points
+	if (type == DATA && (format == ANN_PTS_FVECS || format == ANN_PTS_BVECS))
+		pts_dim = 0;							// (take it from the file)
+
+	chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+	pa = annReadPtsBin(file_nm, format, pts_dim, n, map_pts);
+	double read_wall = chrono::duration<double>(
+			chrono::steady_clock::now() - wall0).count();
+	dim = pts_dim;
+
+	printReadPts(pa, n, file_nm, type, pts_format_table[format], read_wall);
+}
+
+//------------------------------------------------------------------------
+// printReadPts - print summary of points read
+//------------------------------------------------------------------------
+
+void printReadPts(
+	ANNpointArray		pa,				// point array
+	int					n,				// number of points
+	char				*file_nm,		// file name
+	PtType				type,			// point type (DATA, QUERY)
+	const char			*format,		// file format (or NULL for text)
+	double				read_time)		// time to read
+{
+	int i;
 	if (stats > SILENT) {
 		if (type == DATA) {
 			cout << "[Read Data Points:\n";
@@ -1329,7 +2814,13 @@ void readPts(
 			cout << "  query_size = " << n << "\n";
 		}
 		cout << "  file_name  = " << file_nm << "\n";
+		if (format != NULL)
+			cout << "  format     = " << format << "\n";
 		cout << "  dim        = " << dim << "\n";
+		if (stats >= EXEC_TIME) {
+			cout << "  read_time  = " << read_time
+				 << " sec (wall clock)\n";
+		}
 												// print if results requested
 		if ((type == DATA && stats >= SHOW_PTS) ||
 			(type == QUERY && stats >= QUERY_RES)) {
@@ -1369,6 +2860,8 @@ void readPts(
 //		allowed to ignore points within the shrunken radius, we only
 //		compute exact neighbors within this smaller distance (for we
 //		cannot guarantee that we will even visit the other points).
+//		For approximate range counting (approx_count) the upper count
+//		is taken with a radius expanded by the error factor instead.
 //------------------------------------------------------------------------
 
 void getTrueNN()						// compute true nearest neighbors
@@ -1397,6 +2890,19 @@ void getTrueNN()						// compute true nearest neighbors
 
 												// allocate search structure
 	ANNbruteForce *the_brute = new ANNbruteForce(data_pts, data_size, dim);
+	if (threads > 0 && radius_bound == 0) {		// batched kNN search
+		the_brute->annkSearchBatch(				// compute true near neighbors
+					query_pts,					// query points
+					query_size,					// number of queries
+					true_nn,					// number of nearest neighbors
+					true_nn_idx,				// where to put indices
+					true_dists,					// where to put distances
+					0.0,						// (exact)
+					threads);					// number of threads
+		delete the_brute;						// delete brute-force struct
+		valid_dirty = ANNfalse;					// validation good for now
+		return;
+	}
 												// compute nearest neighbors
 	for (int i = 0; i < query_size; i++) {
 		if (radius_bound == 0) {				// standard kNN search
@@ -1410,6 +2916,9 @@ void getTrueNN()						// compute true nearest neighbors
 												// search radii limits
 			ANNdist trueSqRadius = ANN_POW(radius_bound);
 			ANNdist minSqRadius = ANN_POW(radius_bound / (1+epsilon));
+			ANNdist maxSqRadius = trueSqRadius;
+			if (approx_count && near_neigh == 0)	// two-sided count
+				maxSqRadius = ANN_POW(radius_bound * (1+epsilon));
 			min_pts_in_range[i] = the_brute->annkFRSearch(
 						query_pts[i],			// query point
 						minSqRadius,			// shrunken search radius
@@ -1418,7 +2927,7 @@ void getTrueNN()						// compute true nearest neighbors
 						curr_dists);			// distance (returned)
 			max_pts_in_range[i] = the_brute->annkFRSearch(
 						query_pts[i],			// query point
-						trueSqRadius,			// true search radius
+						maxSqRadius,			// expanded search radius
 						0, NULL, NULL);			// (ignore kNN info)
 		}
 		curr_nn_idx += true_nn;					// increment nn index pointer
@@ -1559,6 +3068,192 @@ void doValidation()						// perform validation
 	}
 }
 
+//------------------------------------------------------------------------
+//	buildFlat - build the flat version of the current tree
+//		Any existing flat (or paged) tree is deleted first.  If
+//		flat_layout is "none" no new one is built, and the_tree is
+//		searched instead.
+//------------------------------------------------------------------------
+
+void buildFlat()
+{
+	if (the_flat != NULL) {						// flat tree exists already
+		delete the_flat;						// get rid of it
+		the_flat = NULL;
+	}
+	if (the_paged != NULL) {					// so does paged tree
+		delete the_paged;
+		the_paged = NULL;
+	}
+	if (flat_layout > 0 && the_tree != NULL) {						// build it
+		the_flat = new ANNflat_tree(*the_tree,
+				(ANNflatLayout) (flat_layout - 1), copy_pts);
+	}
+}
+
+//------------------------------------------------------------------------
+//	buildFloat - build the float version of the current tree
+//		Any existing float tree is deleted first.  If compare_float is
+//		set, the data points are copied into float points, and a tree
+//		is built from them by the float version of ANN, with the same
+//		parameters as the_tree.
+//------------------------------------------------------------------------
+
+static annf::ANNpointArray floatPts(		// float copy of points
+	ANNpointArray		pa,				// the points
+	int					n)				// number of points
+{
+	annf::ANNpointArray fpa = annf::annAllocPts(n, dim);
+	for (int i = 0; i < n; i++) {
+		for (int d = 0; d < dim; d++) {
+			fpa[i][d] = (annf::ANNcoord) pa[i][d];
+		}
+	}
+	return fpa;
+}
+
+void buildFloat()
+{
+	if (the_ftree != NULL) {					// float tree exists already
+		delete the_ftree;						// get rid of it
+		the_ftree = NULL;
+	}
+	if (fdata_pts != NULL) {
+		annf::annDeallocPts(fdata_pts);
+		fdata_pts = NULL;
+	}
+	if (compare_float) {						// build it
+		fdata_pts = floatPts(data_pts, data_size);
+		annf::annSetPresort((annf::ANNbool) presort);
+		the_ftree = new annf::ANNbd_tree(
+				fdata_pts,						// the data points
+				data_size,						// number of points
+				dim,							// dimension of space
+				bucket_size,					// maximum bucket size
+				(annf::ANNsplitRule) split,		// splitting rule
+				(annf::ANNshrinkRule) shrink,	// shrinking rule
+				(annf::ANNbool) copy_pts);		// copy points to leaf order?
+	}
+}
+
+//------------------------------------------------------------------------
+//	runFloatQueries - run the current queries on the float tree
+//		The queries are converted to float and searched in the same
+//		way as they were by run_queries (whose results must be in
+//		apx_nn_idx).  Returns the time per query, and sets recall to
+//		the fraction of the near neighbors in apx_nn_idx that the
+//		float tree also returned.
+//------------------------------------------------------------------------
+
+double runFloatQueries(
+	ANNbool				priority,		// priority search?
+	ANNbool				batch,			// batched search?
+	double				&recall)		// recall (returned)
+{
+	annf::ANNpointArray fquery_pts = floatPts(query_pts, query_size);
+	annf::ANNidxArray f_nn_idx = new annf::ANNidx[near_neigh*query_size];
+	annf::ANNdistArray f_dists = new annf::ANNdist[near_neigh*query_size];
+
+	annf::annMaxPtsVisit(max_pts_visit);		// same settings as ANN
+	annf::annSetSimd((annf::ANNsimd) annSimd());
+	annf::annSetHeapK(heap_k);
+
+	clock_t clock0 = clock();					// start time
+	chrono::steady_clock::time_point wall0 = chrono::steady_clock::now();
+	if (batch) {
+		the_ftree->annkSearchBatch(fquery_pts, query_size, near_neigh,
+				f_nn_idx, f_dists, epsilon, threads,
+				(annf::ANNqueryOrder) order);
+	}
+	for (int i = 0; i < query_size && !batch; i++) {
+		annf::ANNidxArray nn_idx = f_nn_idx + i*near_neigh;
+		annf::ANNdistArray dists = f_dists + i*near_neigh;
+		if (radius_bound != 0) {
+			the_ftree->annkFRSearch(fquery_pts[i], ANN_POW(radius_bound),
+					near_neigh, nn_idx, dists, epsilon);
+		}
+		else if (priority) {
+			the_ftree->annkPriSearch(fquery_pts[i], near_neigh,
+					nn_idx, dists, epsilon);
+		}
+		else {
+			the_ftree->annkSearch(fquery_pts[i], near_neigh,
+					nn_idx, dists, epsilon);
+		}
+	}
+	double time = (batch ?
+			chrono::duration<double>(chrono::steady_clock::now() - wall0).count()
+			: double(clock() - clock0)/CLOCKS_PER_SEC);
+
+	int found = 0;								// results also found
+	int total = 0;								// total results
+	for (int i = 0; i < query_size; i++) {
+		ANNidxArray nn_idx = apx_nn_idx + i*near_neigh;
+		annf::ANNidxArray f_idx = f_nn_idx + i*near_neigh;
+		for (int j = 0; j < near_neigh; j++) {
+			if (nn_idx[j] == ANN_NULL_IDX) continue;
+			total++;
+			for (int l = 0; l < near_neigh; l++) {
+				if (f_idx[l] == nn_idx[j]) {
+					found++;
+					break;
+				}
+			}
+		}
+	}
+	recall = (total > 0 ? double(found)/total : 1.0);
+
+	delete [] f_nn_idx;
+	delete [] f_dists;
+	annf::annDeallocPts(fquery_pts);
+	return time/query_size;
+}
+
+//------------------------------------------------------------------------
+//	startCacheMisses, stopCacheMisses
+//		Count the hardware cache misses of the calling thread between
+//		the two calls, using the Linux perf_event interface.  If the
+//		counter is unavailable (on other systems, or if the kernel does
+//		not permit it) startCacheMisses returns -1 and stopCacheMisses
+//		returns -1.
+//------------------------------------------------------------------------
+
+int startCacheMisses()
+{
+#ifdef __linux__
+	struct perf_event_attr pe;
+	memset(&pe, 0, sizeof(pe));
+	pe.type = PERF_TYPE_HARDWARE;
+	pe.size = sizeof(pe);
+	pe.config = PERF_COUNT_HW_CACHE_MISSES;
+	pe.disabled = 1;
+	pe.exclude_kernel = 1;
+	pe.exclude_hv = 1;
+										// this thread, any cpu
+	int fd = (int) syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+	if (fd < 0) return -1;
+	ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	return fd;
+#else
+	return -1;
+#endif
+}
+
+long long stopCacheMisses(int fd)
+{
+	if (fd < 0) return -1;
+#ifdef __linux__
+	long long count;
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	ssize_t nr = read(fd, &count, sizeof(count));
+	close(fd);
+	return (nr == (ssize_t) sizeof(count) ? count : -1);
+#else
+	return -1;
+#endif
+}
+
 //----------------------------------------------------------------------
 //	treeStats
 //		Computes a number of statistics related to kd_trees and
@@ -1642,3 +3337,48 @@ void treeStats(
 		out << "  )\n";
 	}
 }
+
+//------------------------------------------------------------------------
+// joinCount - callback for run_join
+//		The pairs themselves are not needed (annRangeJoin returns their
+//		number), so this just counts the calls.
+//------------------------------------------------------------------------
+
+void joinCount(
+	int					n,				// number of pairs
+	const ANNidx		*idx,			// data points
+	const ANNidx		*other_idx,		// query points
+	const ANNdist		*dd,			// squared distances
+	void				*data)			// number of calls (modified)
+{
+	(*(size_t *) data)++;
+}
+
+//------------------------------------------------------------------------
+// operator new/delete - count allocations (for count_allocs)
+//		These replace the global operators (for the library as well as
+//		this program), counting each call to operator new.
+//------------------------------------------------------------------------
+
+void* operator new(size_t size)
+{
+	n_allocs++;							// count it
+	void *p = malloc(size > 0 ? size : 1);
+	if (p == NULL) throw bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}